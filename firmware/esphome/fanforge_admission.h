@@ -0,0 +1,173 @@
+#pragma once
+
+// HTTP admission control: keeps API traffic from starving the control loop.
+// Portable (no ESPHome or ESP-IDF calls); fanforge_api.h feeds it the client
+// address, tick lateness and free heap, and sends the rejections.
+//
+// A request passes three checks, cheapest first:
+//   - concurrency: at most FT_ADMIT_MAX_INFLIGHT requests in progress (503)
+//   - shedding: while control ticks run late or the heap is low, and for a
+//     hold time after, sheddable requests are refused outright (503)
+//   - rate: a token bucket per client address (429)
+// Every rejection carries Retry-After. Rejected requests cost no tokens.
+
+#include <cstdint>
+
+static constexpr int FT_ADMIT_MAX_CLIENTS = 8;
+// httpd runs one request at a time; responses that outlive their handler count until they finish.
+static constexpr uint8_t FT_ADMIT_MAX_INFLIGHT = 4;
+static constexpr uint32_t FT_ADMIT_SHED_LATE_MS = 50;  // tick lateness past its period that starts shedding
+static constexpr uint32_t FT_ADMIT_SHED_HEAP_BYTES = 16384;
+static constexpr uint32_t FT_ADMIT_SHED_HOLD_MS = 2000;  // shedding outlasts its last trigger by this much
+static constexpr uint8_t FT_ADMIT_COST = 1;
+static constexpr uint8_t FT_ADMIT_COST_CONFIG_POST = 4;  // parse, validate, rules compile and NVS writes
+
+enum FtAdmitResult : uint8_t {
+  FT_ADMIT_OK = 0,
+  FT_ADMIT_BUSY,
+  FT_ADMIT_RATE_LIMITED,
+  FT_ADMIT_SHED_LATE,
+  FT_ADMIT_SHED_HEAP,
+  FT_ADMIT_RESULT_COUNT,
+};
+
+struct FtAdmitClient {
+  uint32_t addr;
+  float tokens;
+  uint32_t last_ms;
+  bool used;
+};
+
+struct FtAdmitStats {
+  uint32_t admitted = 0;
+  uint32_t rejected[FT_ADMIT_RESULT_COUNT] = {0};  // FT_ADMIT_OK unused
+  uint32_t clients_evicted = 0;                     // bucket slots handed to a new address
+};
+
+/**
+ * Admission decisions for the API handlers, one admit()/release() pair per
+ * request. Client buckets live in a small fixed table; a new address takes
+ * a free slot with a full burst, or else the least recently seen slot with
+ * only what that bucket had refilled to. Rotating through more addresses than
+ * there are slots (privacy addresses, many hosts) then keeps the debt instead
+ * of resetting it.
+ */
+class FtAdmission {
+ public:
+  // per_s 0 disables rate limiting.
+  void set_rate(float per_s, float burst) {
+    this->rate_per_s_ = per_s;
+    this->burst_ = burst < 1.0f ? 1.0f : burst;
+  }
+
+  // Called once per control tick with how far it started past its nominal period.
+  void note_tick_late(uint32_t late_ms, uint32_t now_ms) {
+    if (late_ms < FT_ADMIT_SHED_LATE_MS) return;
+    this->late_ms_ = now_ms;
+    this->late_seen_ = true;
+  }
+
+  // retry_after_s receives the Retry-After value for a rejection.
+  FtAdmitResult admit(uint32_t client, uint8_t cost, bool sheddable, uint32_t free_heap, uint32_t now_ms,
+                      uint32_t &retry_after_s) {
+    retry_after_s = 1;
+    FtAdmitResult r = FT_ADMIT_OK;
+    if (this->inflight_ >= FT_ADMIT_MAX_INFLIGHT) {
+      r = FT_ADMIT_BUSY;
+    } else if (sheddable) {
+      if (free_heap < FT_ADMIT_SHED_HEAP_BYTES) {
+        this->heap_ms_ = now_ms;
+        this->heap_seen_ = true;
+      }
+      if (this->holding_(this->heap_seen_, this->heap_ms_, now_ms)) {
+        r = FT_ADMIT_SHED_HEAP;
+        retry_after_s = this->hold_left_s_(this->heap_ms_, now_ms);
+      } else if (this->holding_(this->late_seen_, this->late_ms_, now_ms)) {
+        r = FT_ADMIT_SHED_LATE;
+        retry_after_s = this->hold_left_s_(this->late_ms_, now_ms);
+      }
+    }
+    if (r == FT_ADMIT_OK && this->rate_per_s_ > 0.0f) {
+      FtAdmitClient &c = this->client_(client, now_ms);
+      if (c.tokens < cost) {
+        r = FT_ADMIT_RATE_LIMITED;
+        const float wait_s = (cost - c.tokens) / this->rate_per_s_;
+        retry_after_s = static_cast<uint32_t>(wait_s) + 1;
+      } else {
+        c.tokens -= cost;
+      }
+    }
+    if (r != FT_ADMIT_OK) {
+      this->stats_.rejected[r]++;
+      return r;
+    }
+    this->inflight_++;
+    this->stats_.admitted++;
+    return r;
+  }
+
+  void release() {
+    if (this->inflight_ > 0) this->inflight_--;
+  }
+
+  uint8_t inflight() const { return this->inflight_; }
+  bool shedding(uint32_t now_ms) const {
+    return this->holding_(this->heap_seen_, this->heap_ms_, now_ms) ||
+           this->holding_(this->late_seen_, this->late_ms_, now_ms);
+  }
+  int clients() const {
+    int n = 0;
+    for (const FtAdmitClient &c : this->clients_) n += c.used;
+    return n;
+  }
+  const FtAdmitStats &stats() const { return this->stats_; }
+
+ private:
+  bool holding_(bool seen, uint32_t since_ms, uint32_t now_ms) const {
+    return seen && now_ms - since_ms < FT_ADMIT_SHED_HOLD_MS;
+  }
+  uint32_t hold_left_s_(uint32_t since_ms, uint32_t now_ms) const {
+    return (FT_ADMIT_SHED_HOLD_MS - (now_ms - since_ms) + 999) / 1000;
+  }
+
+  // Finds or assigns the client's bucket and refills it to now.
+  FtAdmitClient &client_(uint32_t addr, uint32_t now_ms) {
+    FtAdmitClient *slot = nullptr;
+    FtAdmitClient *victim = nullptr;
+    for (FtAdmitClient &c : this->clients_) {
+      if (c.used && c.addr == addr) {
+        slot = &c;
+        break;
+      }
+      if (victim == nullptr || (victim->used && (!c.used || now_ms - c.last_ms > now_ms - victim->last_ms)))
+        victim = &c;
+    }
+    if (slot == nullptr) {
+      float tokens = this->burst_;
+      if (victim->used) {
+        this->stats_.clients_evicted++;
+        tokens = this->refilled_(*victim, now_ms);
+      }
+      *victim = FtAdmitClient{addr, tokens, now_ms, true};
+      return *victim;
+    }
+    slot->tokens = this->refilled_(*slot, now_ms);
+    slot->last_ms = now_ms;
+    return *slot;
+  }
+
+  float refilled_(const FtAdmitClient &c, uint32_t now_ms) const {
+    const float tokens = c.tokens + (now_ms - c.last_ms) / 1000.0f * this->rate_per_s_;
+    return tokens > this->burst_ ? this->burst_ : tokens;
+  }
+
+  float rate_per_s_ = 10.0f;
+  float burst_ = 20.0f;
+  uint8_t inflight_ = 0;
+  bool late_seen_ = false;
+  uint32_t late_ms_ = 0;
+  bool heap_seen_ = false;
+  uint32_t heap_ms_ = 0;
+  FtAdmitClient clients_[FT_ADMIT_MAX_CLIENTS] = {};
+  FtAdmitStats stats_;
+};
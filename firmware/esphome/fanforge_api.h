@@ -4,7 +4,6 @@
 #include "esphome/components/web_server_base/web_server_base.h"
 
 #ifdef USE_ESP32
-#include <ArduinoJson.h>
 #include <cmath>
 #include <cstring>
 #include <string>
@@ -13,13 +12,53 @@
 #include "esphome/components/web_server_idf/web_server_idf.h"
 #endif
 
+#include "fanforge_admission.h"
+#include "fanforge_api_gen.h"
+#include "fanforge_async.h"
+#include "fanforge_cbor.h"
+#include "fanforge_control.h"
+#include "fanforge_deflate.h"
+#include "fanforge_history.h"
+#include "fanforge_ingest.h"
+#include "fanforge_json.h"
+#include "fanforge_lttb.h"
+#include "fanforge_metrics.h"
+#include "fanforge_power.h"
+#include "fanforge_rack.h"
+#include "fanforge_rollup.h"
+#include "fanforge_stagetrace.h"
+#include "fanforge_telemetry.h"
+
+// Optional UI build: host/codegen/gen_ui_assets.py writes this header from the
+// Vite output and the UI is then served from flash under /ui/.
+#if __has_include("fanforge_ui_assets.h")
+#include "fanforge_ui_assets.h"
+#define FT_UI_ENABLED 1
+#endif
+
+#include <esp_idf_version.h>
+#include <esp_partition.h>
+#include <esp_pm.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+
+#ifdef USE_MQTT
+#include "esphome/components/mqtt/mqtt_client.h"
+#endif
+
+// httpd_req_async_handler_begin() arrived in ESP-IDF 5.1; older builds send every response from its handler.
+#if ESP_IDF_VERSION_MAJOR > 5 || (ESP_IDF_VERSION_MAJOR == 5 && ESP_IDF_VERSION_MINOR >= 1)
+#define FT_HTTP_ASYNC 1
+#endif
+
 using esphome::web_server_base::global_web_server_base;
 using esphome::web_server_idf::AsyncWebHandler;
 using esphome::web_server_idf::AsyncWebServerRequest;
 using esphome::web_server_idf::AsyncWebServerResponse;
 
-static constexpr int FT_MAX_POINTS = 16;
-
 /**
  * Hardware: EC fan "yellow" control input has an internal pull-up to ~5V.
  * We drive it using an NPN open-collector pull-down:
@@ -38,30 +77,131 @@ static constexpr int FT_MAX_POINTS = 16;
  */
 static constexpr bool FT_PWM_INVERTED = true;
 
-// Ignore only DS18B20 half-degree chatter around a stable point.
-// Any movement >= ~0.5 C should be considered "real" for control.
-static constexpr float FT_TEMP_CONTROL_DEADBAND_C = 0.51f;
+// UDP ingest of virtual sources (host CPU/GPU temperatures, load).
+static FtIngestTable ft_ingest;
+static int ft_ingest_fd = -1;
+static uint8_t ft_ingest_buf[FT_INGEST_MAX_DATAGRAM + 1];
+static constexpr int FT_INGEST_MAX_PER_POLL = 16;
+
+// Rack coordination: peer summaries received on, and ours sent to, a multicast group.
+static FtRackTable ft_rack;
+static int ft_rack_fd = -1;
+static struct sockaddr_in ft_rack_group_addr = {};
+static uint8_t ft_rack_buf[FT_RACK_DATAGRAM_BYTES + 1];
+static uint32_t ft_rack_seq = 0;
+static uint32_t ft_rack_last_tx_ms = 0;
+static FtRackAggregate ft_rack_last;  // what the last tick's control temperature came from
+// Bumped whenever a persisted setting changes; consumers compare against their last seen value.
+static uint32_t ft_config_generation = 0;
+
+// The control loop instance; its config is mirrored from the cfg_* globals each tick.
+static FtController ft_ctl;
+static bool ft_ctl_program_loaded = false;  // curves and rules installed in ft_ctl.config
+
+// The string settings (curves, rules) are std::string globals that ESPHome
+// reads on the loop task to persist them, so only the loop task writes them.
+// POST /api/config (httpd task) stages the new strings, and the curves and
+// rules compiled from them, here; the next tick commits both. The httpd task
+// reads the strings only through ft_config_strings(), under ft_config_lock.
+struct FtConfigStrings {
+  std::string points_json;
+  std::string ff_points_json;
+  std::string falling_points_json;
+  std::string rules;
+};
+struct FtControlProgram {
+  FtCurve curve;
+  FtCurve ff_curve;
+  FtCurve falling_curve;
+  FtRuleProgram rules;
+};
+static SemaphoreHandle_t ft_config_lock = nullptr;
+static FtConfigStrings ft_config_pending;
+static FtControlProgram ft_config_pending_program;
+static bool ft_config_pending_ready = false;
 
-// No additional PWM deadband: temperature gating above is the only ignore rule.
-static constexpr float FT_PWM_DEADBAND_PCT = 0.0f;
+class FtConfigLock {
+ public:
+  FtConfigLock() {
+    if (ft_config_lock != nullptr) xSemaphoreTake(ft_config_lock, portMAX_DELAY);
+  }
+  ~FtConfigLock() {
+    if (ft_config_lock != nullptr) xSemaphoreGive(ft_config_lock);
+  }
+};
 
-// Failsafe hysteresis.
-static constexpr float FT_FAILSAFE_HYST_C = 1.0f;
-static float ft_last_target_pwm_pct = 0.0f;
-static float ft_last_output_level = 0.0f;
-static bool ft_control_temp_initialized = false;
-static float ft_control_temp_c = NAN;
+// Per-tick stage trace, downloadable from /api/trace.
+static FtStageTrace ft_stage_trace;
+static uint32_t ft_stage_last_tick_ms = 0;
+// A tick this late (2.5x the 200 ms period) counts as a loop stall and triggers the trace.
+// Scaled with the tick period in low-power mode.
+static constexpr uint32_t FT_STAGE_LATE_TICK_MS = 500;
+
+// Low-power mode: policy and energy estimate, plus what was last applied to the hardware.
+static FtPowerGovernor ft_power;
+static FtPowerState ft_power_applied = FT_POWER_STATE_FULL;
+static FtPowerMode ft_power_applied_mode = FT_POWER_MODE_FULL;
+static uint32_t ft_power_applied_ms = 0;
+static bool ft_power_light_sleep = false;  // the power manager accepted automatic light sleep
+static esp_pm_lock_handle_t ft_power_sleep_lock = nullptr;  // ESP_PM_NO_LIGHT_SLEEP, held while the fan runs
+static esp_pm_lock_handle_t ft_power_apb_lock = nullptr;    // ESP_PM_APB_FREQ_MAX, likewise
+static bool ft_power_fan_held = false;
+
+// HTTP admission control: concurrency bound, per-client rate limits, load shedding.
+static FtAdmission ft_admission;
+// Responses pumped in chunks after their handler returned (history, rollups, trace, UI files).
+static FtAsyncPool ft_async;
+// Compressed responses (Content-Encoding gzip or deflate): the async slots' and the /metrics encoder's totals.
+static FtDeflateStats ft_deflate_stats;
+
+static inline uint32_t ft_cycle_count() { return ESP.getCycleCount(); }
+
+// The "history" data partition from fanforge-partitions.csv.
+class FtPartitionFlash : public FtHistoryFlash {
+ public:
+  bool begin() {
+    this->part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "history");
+    return this->part_ != nullptr;
+  }
+  uint32_t size() const override { return this->part_ != nullptr ? this->part_->size : 0; }
+  bool read(uint32_t offset, void *dst, uint32_t len) override {
+    return esp_partition_read(this->part_, offset, dst, len) == ESP_OK;
+  }
+  bool write(uint32_t offset, const void *src, uint32_t len) override {
+    return esp_partition_write(this->part_, offset, src, len) == ESP_OK;
+  }
+  bool erase_sector(uint32_t offset) override {
+    return esp_partition_erase_range(this->part_, offset, FT_HISTORY_SECTOR) == ESP_OK;
+  }
 
-struct FtPoint {
-  float t;
-  float p;
+ protected:
+  const esp_partition_t *part_ = nullptr;
 };
 
-static inline float ft_clampf(float v, float lo, float hi) {
-  if (v < lo) return lo;
-  if (v > hi) return hi;
-  return v;
-}
+// Persistent 1 s telemetry history, served by /api/history.
+static FtPartitionFlash ft_history_flash;
+static FtHistoryStore ft_history;
+static uint32_t ft_history_uptime_s = 0;
+static uint32_t ft_history_last_ms = 0;
+static bool ft_history_started = false;
+static constexpr uint32_t FT_HISTORY_DEFAULT_SPAN_S = 3600;
+static constexpr uint32_t FT_HISTORY_DEFAULT_LIMIT = 1000;
+// Sent synchronously (no async responses) the page is buffered first; this bounds it to about 32 KB.
+static constexpr uint32_t FT_HISTORY_MAX_LIMIT = 1500;
+
+// 1 s / 1 min / 1 h rollups of every tick, served by /api/history?resolution=.
+static FtRollups ft_rollups;
+// Rollup rows are about 60 bytes, so fewer fit in the same response budget.
+static constexpr uint32_t FT_ROLLUP_MAX_LIMIT = 500;
+
+// Bucket state for /api/history?points=N; one pass at a time, held across an
+// async response's steps while ft_history_lttb_busy.
+static FtLttb ft_history_lttb;
+static bool ft_history_lttb_busy = false;
+// Samples folded per step of an async LTTB pass, a few milliseconds of work on the C3.
+static constexpr uint32_t FT_LTTB_STEP_SAMPLES = 2048;
+// Without async responses the pass runs inside the handler, so it covers at most the last 6 h of the range.
+static constexpr uint32_t FT_LTTB_SYNC_SPAN_S = 6 * 3600;
 
 static inline void ft_add_cors(AsyncWebServerResponse *res) {
   // ESPHome web_server already emits Access-Control-Allow-Origin.
@@ -71,6 +211,74 @@ static inline void ft_add_cors(AsyncWebServerResponse *res) {
   res->addHeader("Access-Control-Allow-Private-Network", "true");
 }
 
+// Peer address of the request's socket: IPv4, or the low 32 bits of an IPv6
+// address (the IPv4 address for mapped clients). 0 when unknown.
+static inline uint32_t ft_http_client_addr(AsyncWebServerRequest *request) {
+  const int fd = httpd_req_to_sockfd(*request);
+  struct sockaddr_storage addr = {};
+  socklen_t len = sizeof(addr);
+  if (fd < 0 || getpeername(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0) return 0;
+  if (addr.ss_family == AF_INET) return reinterpret_cast<struct sockaddr_in *>(&addr)->sin_addr.s_addr;
+#if !defined(LWIP_IPV6) || LWIP_IPV6
+  if (addr.ss_family == AF_INET6) {
+    uint32_t low;
+    memcpy(&low, reinterpret_cast<struct sockaddr_in6 *>(&addr)->sin6_addr.s6_addr + 12, sizeof(low));
+    return low;
+  }
+#endif
+  return 0;
+}
+
+// Sends a refusal straight through httpd from static strings: no response
+// object and no body to build, so a flood of rejections allocates nothing.
+// This bypasses web_server_idf, so Access-Control-Allow-Origin is set here.
+static inline void ft_send_rejection(AsyncWebServerRequest *request, FtAdmitResult r, uint32_t retry_after_s) {
+  static char retry_after[12];
+  const char *body = "{\"error\":\"server busy\"}";
+  if (r == FT_ADMIT_RATE_LIMITED)
+    body = "{\"error\":\"rate limited\"}";
+  else if (r == FT_ADMIT_SHED_LATE || r == FT_ADMIT_SHED_HEAP)
+    body = "{\"error\":\"shedding load\"}";
+  snprintf(retry_after, sizeof(retry_after), "%u", static_cast<unsigned>(retry_after_s));
+  httpd_req_t *req = *request;
+  httpd_resp_set_status(req, r == FT_ADMIT_RATE_LIMITED ? "429 Too Many Requests" : "503 Service Unavailable");
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Retry-After", retry_after);
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_send(req, body, HTTPD_RESP_USE_STRLEN);
+  ft_metrics_http_response(r == FT_ADMIT_RATE_LIMITED ? 429 : 503);
+}
+
+// Admits a request or answers it with a refusal; an admitted request holds
+// its concurrency slot until the ticket goes out of scope.
+class FtAdmitTicket {
+ public:
+  FtAdmitTicket(AsyncWebServerRequest *request, uint8_t cost, bool sheddable) {
+    ft_admission.set_rate(id(cfg_http_rate_per_s), id(cfg_http_burst));
+    uint32_t retry_after_s;
+    const FtAdmitResult r = ft_admission.admit(ft_http_client_addr(request), cost, sheddable,
+                                               heap_caps_get_free_size(MALLOC_CAP_8BIT), millis(), retry_after_s);
+    this->admitted_ = r == FT_ADMIT_OK;
+    if (!this->admitted_) ft_send_rejection(request, r, retry_after_s);
+  }
+  ~FtAdmitTicket() {
+    if (this->admitted_ && !this->handed_off_) ft_admission.release();
+  }
+  bool admitted() const { return this->admitted_; }
+  // The response outlives the handler; whoever finishes it releases the slot.
+  void hand_off() { this->handed_off_ = true; }
+
+ private:
+  bool admitted_;
+  bool handed_off_ = false;
+};
+
+static inline void ft_note_config_changed(uint32_t changed_fields) {
+  if (changed_fields == 0) return;
+  ft_metrics_note_persist(changed_fields);
+  ft_config_generation++;
+}
+
 static inline const char *ft_mode_to_str(int mode) {
   switch (mode) {
     case 1:
@@ -82,420 +290,1651 @@ static inline const char *ft_mode_to_str(int mode) {
   }
 }
 
-static inline int ft_str_to_mode(const char *mode) {
-  if (strcmp(mode, "manual") == 0) return 1;
-  if (strcmp(mode, "off") == 0) return 2;
-  return 0;
+static constexpr size_t FT_API_ERROR_LEN = 128;
+static constexpr size_t FT_CBOR_RESPONSE_LEN = 1024;  // a full config encodes to ~400 bytes
+
+static inline void ft_send_json(AsyncWebServerRequest *req, const std::string &payload, int status = 200) {
+  auto *res = req->beginResponse(status, "application/json", payload);
+  req->send(res);
+  ft_metrics_http_response(status);
 }
 
-static inline const char *ft_smoothing_to_str(int smoothing_mode) {
-  return smoothing_mode == 0 ? "linear" : "smooth";
+// /api/status and /api/config speak JSON unless the client asks for CBOR:
+// an Accept naming application/cbor wins, then one naming application/json;
+// without either, replies match the request body's format.
+static inline bool ft_wants_cbor(AsyncWebServerRequest *req, bool body_cbor = false) {
+  const auto accept = req->get_header("Accept");
+  if (accept.has_value() && accept->find("application/cbor") != std::string::npos) return true;
+  if (accept.has_value() && accept->find("application/json") != std::string::npos) return false;
+  return body_cbor;
 }
 
-static inline int ft_str_to_smoothing(const char *smoothing_mode) {
-  return (strcmp(smoothing_mode, "linear") == 0) ? 0 : 1;
+// Large downloads (history, rollups, trace, metrics) are compressed when Accept-Encoding allows it.
+static inline FtContentEncoding ft_response_encoding(AsyncWebServerRequest *req) {
+  const auto accept = req->get_header("Accept-Encoding");
+  return accept.has_value() ? ft_accept_encoding(accept->c_str()) : FT_ENCODING_IDENTITY;
 }
 
-static inline void ft_send_json(AsyncWebServerRequest *req, JsonDocument &doc, int status = 200) {
-  std::string payload;
-  serializeJson(doc, payload);
-  auto *res = req->beginResponse(status, "application/json", payload);
+static inline bool ft_body_is_cbor(AsyncWebServerRequest *req) {
+  const auto type = req->get_header("Content-Type");
+  return type.has_value() && type->compare(0, 16, "application/cbor") == 0;
+}
+
+static constexpr size_t FT_CONFIG_BODY_MAX = 4096;
+
+// Fetches a POSTed config. web_server_idf parses form-encoded bodies only (the
+// config then comes as a plain, payload or config field); any other body, JSON
+// or CBOR, is left unread on the socket and is read here, bytes untouched.
+// Returns nullptr or an error message.
+static inline const char *ft_read_config_body(AsyncWebServerRequest *req, std::string &body) {
+  for (const char *field : {"plain", "payload", "config"}) {
+    if (req->hasArg(field)) {
+      body = req->arg(field);
+      return nullptr;
+    }
+  }
+  httpd_req_t *r = *req;
+  if (r->content_len > FT_CONFIG_BODY_MAX) return "request body too large";
+  body.resize(r->content_len);
+  size_t got = 0;
+  int timeouts = 0;
+  while (got < body.size()) {
+    const int n = httpd_req_recv(r, &body[got], body.size() - got);
+    if (n == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < 3) continue;
+    if (n <= 0) return "request body read failed";
+    got += static_cast<size_t>(n);
+  }
+  return nullptr;
+}
+
+// Encodes one API message with write(writer) in the negotiated format. CBOR
+// goes through a fixed buffer; httpd serves one request at a time.
+template<typename F> static inline void ft_send_api(AsyncWebServerRequest *req, int status, bool cbor, F &&write) {
+  AsyncWebServerResponse *res;
+  std::string json;
+  if (cbor) {
+    static uint8_t buf[FT_CBOR_RESPONSE_LEN];
+    FtCborWriter w(buf, sizeof(buf));
+    write(w);
+    if (w.overflow()) {
+      status = 500;
+      json = "{\"error\":\"response exceeds the CBOR buffer\"}";
+      res = req->beginResponse(status, "application/json", json);
+    } else {
+      res = req->beginResponse_P(status, "application/cbor", buf, w.size());
+    }
+  } else {
+    FtJsonWriter w(json);
+    write(w);
+    res = req->beginResponse(status, "application/json", json);
+  }
+  res->addHeader("Vary", "Accept, Content-Type");
   req->send(res);
+  ft_metrics_http_response(status);
 }
 
-static inline int ft_load_points(FtPoint *out_points, int max_points) {
-  JsonDocument points_doc;
-  DeserializationError err = deserializeJson(points_doc, id(cfg_points_json).c_str());
-  if (err || !points_doc.is<JsonArray>()) return 0;
+static inline void ft_send_error(AsyncWebServerRequest *req, int status, const char *message, bool cbor = false) {
+  ft_send_api(req, status, cbor, [message](auto &w) {
+    w.begin_object();
+    w.key("error");
+    w.value(message);
+    w.end_object();
+  });
+}
 
+// Reads a persisted curve ([{"t":..,"p":..}, ...]); stops at the first entry
+// the schema rejects.
+static inline int ft_load_points_json(const std::string &json, FtPoint *out_points, int max_points) {
+  FtJsonReader r(json);
+  FtApiCurvePoint p;
+  FtApiError err;
   int n = 0;
-  for (JsonObject p : points_doc.as<JsonArray>()) {
-    if (n >= max_points) break;
-    if (!p["t"].is<float>() || !p["p"].is<float>()) continue;
-    out_points[n].t = p["t"].as<float>();
-    out_points[n].p = p["p"].as<float>();
+  if (!r.begin_array()) return 0;
+  while (n < max_points && r.next_item()) {
+    if (!ft_api_parse_curve_point(r, p, err)) break;
+    out_points[n].t = p.t;
+    out_points[n].p = p.p;
     n++;
   }
   return n;
 }
 
-static inline float ft_curve_linear(float temp, const FtPoint *pts, int n) {
-  if (n <= 0) return 0.0f;
-  if (temp <= pts[0].t) return pts[0].p;
-  if (temp >= pts[n - 1].t) return pts[n - 1].p;
-
-  for (int i = 0; i < n - 1; i++) {
-    const FtPoint &a = pts[i];
-    const FtPoint &b = pts[i + 1];
-    if (temp >= a.t && temp <= b.t) {
-      float u = (temp - a.t) / fmaxf(1e-6f, (b.t - a.t));
-      return a.p + (b.p - a.p) * u;
-    }
+// The newest string settings: staged by a POST but not yet committed, or stored.
+static inline void ft_config_strings(FtConfigStrings &out) {
+  FtConfigLock lock;
+  if (ft_config_pending_ready) {
+    out = ft_config_pending;
+    return;
   }
-  return pts[n - 1].p;
+  out.points_json = id(cfg_points_json);
+  out.ff_points_json = id(cfg_ff_points_json);
+  out.falling_points_json = id(cfg_falling_points_json);
+  out.rules = id(cfg_rules);
 }
 
-static inline float ft_curve_smooth(float temp, const FtPoint *pts, int n) {
-  if (n <= 0) return 0.0f;
-  if (n == 1) return pts[0].p;
-
-  if (temp <= pts[0].t) return pts[0].p;
-  if (temp >= pts[n - 1].t) return pts[n - 1].p;
-
-  float m[FT_MAX_POINTS] = {0};
-  float tg[FT_MAX_POINTS] = {0};
-
-  for (int i = 0; i < n - 1; i++) {
-    float dx = pts[i + 1].t - pts[i].t;
-    float dy = pts[i + 1].p - pts[i].p;
-    m[i] = dy / fmaxf(1e-6f, dx);
+// Parses the curves, computes their tangents and compiles the rules; false
+// (with err set and no rules) if the rules do not compile.
+static inline bool ft_compile_program(const FtConfigStrings &cs, FtControlProgram &p, char *err, size_t cap) {
+  FtPoint points[FT_MAX_POINTS];
+  int n = ft_load_points_json(cs.points_json, points, FT_MAX_POINTS);
+  if (n < 2) {
+    points[0] = {20.0f, 20.0f};
+    points[1] = {50.0f, 100.0f};
+    n = 2;
   }
+  p.curve.set(points, n);
+  n = ft_load_points_json(cs.ff_points_json, points, FT_MAX_POINTS);
+  p.ff_curve.set(points, n);
+  n = ft_load_points_json(cs.falling_points_json, points, FT_MAX_POINTS);
+  p.falling_curve.set(points, n >= 2 ? n : 0);
+  return ft_rules_compile(cs.rules.c_str(), p.rules, err, cap);
+}
 
-  tg[0] = m[0];
-  tg[n - 1] = m[n - 2];
-  for (int i = 1; i < n - 1; i++) {
-    if (m[i - 1] * m[i] <= 0.0f)
-      tg[i] = 0.0f;
-    else
-      tg[i] = (m[i - 1] + m[i]) * 0.5f;
-  }
+static inline std::string ft_points_json(const FtApiCurvePoint *points, uint8_t n) {
+  std::string json;
+  FtJsonWriter w(json);
+  w.begin_array();
+  for (uint8_t i = 0; i < n; i++) ft_api_write_curve_point(w, points[i]);
+  w.end_array();
+  return json;
+}
 
-  for (int i = 0; i < n - 1; i++) {
-    if (fabsf(m[i]) < 1e-6f) {
-      tg[i] = 0.0f;
-      tg[i + 1] = 0.0f;
-      continue;
-    }
-    float a = tg[i] / m[i];
-    float b = tg[i + 1] / m[i];
-    float s = a * a + b * b;
-    if (s > 9.0f) {
-      float k = 3.0f / sqrtf(s);
-      tg[i] = k * a * m[i];
-      tg[i + 1] = k * b * m[i];
-    }
+// Copies a persisted curve into a Config array field.
+static inline uint8_t ft_config_points(const std::string &json, FtApiCurvePoint *out, uint8_t max_points) {
+  FtPoint points[FT_MAX_POINTS];
+  const int n = ft_load_points_json(json, points, max_points < FT_MAX_POINTS ? max_points : FT_MAX_POINTS);
+  for (int i = 0; i < n; i++) {
+    out[i].present = FT_API_CURVE_POINT_ALL;
+    out[i].t = points[i].t;
+    out[i].p = points[i].p;
   }
+  return static_cast<uint8_t>(n);
+}
 
-  int seg = 0;
-  for (; seg < n - 1; seg++) {
-    if (temp >= pts[seg].t && temp <= pts[seg + 1].t) break;
+static inline void ft_build_config(FtApiConfig &c) {
+  FtConfigStrings cs;
+  ft_config_strings(cs);
+  c.present = FT_API_CONFIG_ALL;
+  c.mode = static_cast<FtApiMode>(id(cfg_mode));
+  c.smoothing_mode = static_cast<FtApiSmoothingMode>(id(cfg_smoothing_mode));
+  c.points_count = ft_config_points(cs.points_json, c.points, FT_API_CONFIG_POINTS_MAX_ITEMS);
+  if (c.points_count < 2) {
+    c.points[0] = {FT_API_CURVE_POINT_ALL, 20.0f, 20.0f};
+    c.points[1] = {FT_API_CURVE_POINT_ALL, 50.0f, 100.0f};
+    c.points_count = 2;
   }
+  c.manual_pwm = id(cfg_manual_pwm);
+  c.min_pwm = id(cfg_min_pwm);
+  c.max_pwm = id(cfg_max_pwm);
+  c.curve_min = id(cfg_curve_min);
+  c.curve_max = id(cfg_curve_max);
+  c.slew_pct_per_sec = id(cfg_slew_pct_per_sec);
+  c.failsafe_temp = id(cfg_failsafe_temp);
+  c.failsafe_pwm = id(cfg_failsafe_pwm);
+  c.temp_source = id(cfg_temp_source);
+  c.ff_source = id(cfg_ff_source);
+  c.ff_points_count = ft_config_points(cs.ff_points_json, c.ff_points, FT_API_CONFIG_FF_POINTS_MAX_ITEMS);
+  c.falling_points_count =
+      ft_config_points(cs.falling_points_json, c.falling_points, FT_API_CONFIG_FALLING_POINTS_MAX_ITEMS);
+  c.ff_blend = id(cfg_ff_blend) == 1 ? FT_API_CONFIG_FF_BLEND_ADD : FT_API_CONFIG_FF_BLEND_MAX;
+  c.ff_decay_s = id(cfg_ff_decay_s);
+  snprintf(c.rules, sizeof(c.rules), "%s", cs.rules.c_str());
+  c.rack_aggregate = static_cast<FtApiConfigRackAggregate>(id(cfg_rack_aggregate));
+  c.rack_weight = id(cfg_rack_weight);
+  c.rack_stale_s = id(cfg_rack_stale_s);
+  c.power_mode = static_cast<FtApiConfigPowerMode>(id(cfg_power_mode));
+  c.power_ui_hold_s = id(cfg_power_ui_hold_s);
+  c.http_rate_per_s = id(cfg_http_rate_per_s);
+  c.http_burst = id(cfg_http_burst);
+}
 
-  float x0 = pts[seg].t;
-  float x1 = pts[seg + 1].t;
-  float y0 = pts[seg].p;
-  float y1 = pts[seg + 1].p;
-  float h = x1 - x0;
-  float u = (temp - x0) / fmaxf(1e-6f, h);
-
-  float h00 = 2.0f * u * u * u - 3.0f * u * u + 1.0f;
-  float h10 = u * u * u - 2.0f * u * u + u;
-  float h01 = -2.0f * u * u * u + 3.0f * u * u;
-  float h11 = u * u * u - u * u;
+// The stored config as JSON. An FtApiConfig is close to 1 KB, so callers pass
+// one they own (kept off the task stacks), one per task: the httpd task and
+// the loop task must never share it.
+static inline std::string ft_config_json(FtApiConfig &c) {
+  ft_build_config(c);
+  std::string json;
+  FtJsonWriter w(json);
+  ft_api_write_config(w, c);
+  return json;
+}
 
-  return h00 * y0 + h10 * h * tg[seg] + h01 * y1 + h11 * h * tg[seg + 1];
+static inline void ft_send_config(AsyncWebServerRequest *req, bool cbor, FtApiConfig &c) {
+  ft_build_config(c);
+  ft_send_api(req, 200, cbor, [&c](auto &w) { ft_api_write_config(w, c); });
 }
 
-static inline bool ft_parse_points(JsonArray in_points, JsonArray out_points, String &err) {
-  if (in_points.size() < 2) {
-    err = "points must contain at least 2 items";
-    return false;
-  }
+// One pass over a POST /api/config body: types, required fields and schema
+// ranges. syntax names the wire format in the error message.
+template<typename R>
+static inline bool ft_parse_config_body(R &reader, FtApiConfig &in, const char *syntax, char *err, size_t cap) {
+  FtApiError parse_err;
+  const bool parsed = ft_api_parse_config(reader, in, parse_err);
+  if (parsed && reader.finish()) return true;
+  if (parsed) ft_api_fail_(reader, parse_err, nullptr, nullptr);
+  ft_api_format_error(parse_err, err, cap, syntax);
+  return false;
+}
 
+// Checks the temperatures strictly increase, then rounds the points to whole units.
+static inline bool ft_round_points(FtApiCurvePoint *points, uint8_t n, const char *field, char *err, size_t cap) {
   float prev_t = -100000.0f;
-  for (JsonObject p : in_points) {
-    if (!p["t"].is<float>() || !p["p"].is<float>()) {
-      err = "each point must include numeric t and p";
+  for (uint8_t i = 0; i < n; i++) {
+    if (points[i].t <= prev_t) {
+      snprintf(err, cap, "%s: point temperatures must be strictly increasing", field);
       return false;
     }
+    prev_t = points[i].t;
+    points[i].t = roundf(points[i].t);
+    points[i].p = roundf(points[i].p);
+  }
+  return true;
+}
 
-    float t = p["t"].as<float>();
-    float pwm = p["p"].as<float>();
-
-    if (pwm < 0.0f || pwm > 100.0f) {
-      err = "point.p must be within 0..100";
+// A falling curve needs two points, the PWM window and, at every breakpoint of
+// either curve, no less PWM than the rising curve: it only delays coming down.
+// Rounds the falling points like ft_round_points; the rising ones are rounded already.
+static inline bool ft_check_falling_points(FtApiConfig &in, char *err, size_t cap) {
+  const uint8_t n = in.falling_points_count;
+  if (n == 0) return true;
+  if (n == 1) {
+    snprintf(err, cap, "falling_points needs at least 2 points (or none)");
+    return false;
+  }
+  if (!ft_round_points(in.falling_points, n, "falling_points", err, cap)) return false;
+  FtPoint rising[FT_MAX_POINTS], falling[FT_MAX_POINTS];
+  for (uint8_t i = 0; i < in.points_count; i++) rising[i] = {in.points[i].t, in.points[i].p};
+  for (uint8_t i = 0; i < n; i++) {
+    if (in.falling_points[i].p < in.min_pwm || in.falling_points[i].p > in.max_pwm) {
+      snprintf(err, cap, "falling_points[%u].p must be within min_pwm..max_pwm", static_cast<unsigned>(i));
       return false;
     }
-
-    if (t <= prev_t) {
-      err = "point temperatures must be strictly increasing";
+    falling[i] = {in.falling_points[i].t, in.falling_points[i].p};
+  }
+  for (int k = 0; k < in.points_count + n; k++) {
+    const float t = k < in.points_count ? rising[k].t : falling[k - in.points_count].t;
+    if (ft_curve_linear(t, falling, n) < ft_curve_linear(t, rising, in.points_count)) {
+      snprintf(err, cap, "falling_points must not lie below points (at %.0f C)", t);
       return false;
     }
+  }
+  return true;
+}
 
-    prev_t = t;
+// Applies a Config the generated parser accepted (types, required fields and
+// the schema ranges are already checked). Only the cross-field rules the
+// schema cannot express are left here.
+static inline bool ft_apply_config(FtApiConfig &in, char *err, size_t cap) {
+  const int prev_mode = id(cfg_mode);
+  const float prev_manual_pwm = id(cfg_manual_pwm);
 
-    JsonObject dst = out_points.add<JsonObject>();
-    dst["t"] = roundf(t);
-    dst["p"] = roundf(pwm);
+  if (in.max_pwm < in.min_pwm) {
+    snprintf(err, cap, "max_pwm must be >= min_pwm");
+    return false;
   }
 
-  return true;
-}
+  const float curve_min = roundf(in.present & FT_API_CONFIG_HAS_CURVE_MIN ? in.curve_min : id(cfg_curve_min));
+  const float curve_max = roundf(in.present & FT_API_CONFIG_HAS_CURVE_MAX ? in.curve_max : id(cfg_curve_max));
+  if (curve_max - curve_min < 1.0f) {
+    snprintf(err, cap, "curve_max must be at least curve_min + 1");
+    return false;
+  }
+
+  if (!ft_round_points(in.points, in.points_count, "points", err, cap)) return false;
+  for (uint8_t i = 0; i < in.points_count; i++) {
+    if (in.points[i].p < in.min_pwm || in.points[i].p > in.max_pwm) {
+      snprintf(err, cap, "points[%u].p must be within min_pwm..max_pwm", static_cast<unsigned>(i));
+      return false;
+    }
+  }
+  FtConfigStrings cur;
+  ft_config_strings(cur);
+  FtConfigStrings next;
+  next.points_json = ft_points_json(in.points, in.points_count);
+
+  std::string &ff_points_json = next.ff_points_json;
+  ff_points_json = cur.ff_points_json;
+  if (in.present & FT_API_CONFIG_HAS_FF_POINTS) {
+    if (!ft_round_points(in.ff_points, in.ff_points_count, "ff_points", err, cap)) return false;
+    for (uint8_t i = 0; i < in.ff_points_count; i++) {
+      if (in.ff_points[i].t > 100.0f) {
+        snprintf(err, cap, "ff_points[%u].t (load) must be within 0..100", static_cast<unsigned>(i));
+        return false;
+      }
+    }
+    ff_points_json = ft_points_json(in.ff_points, in.ff_points_count);
+  }
+
+  std::string &falling_points_json = next.falling_points_json;
+  falling_points_json = cur.falling_points_json;
+  if (in.present & FT_API_CONFIG_HAS_FALLING_POINTS) {
+    if (!ft_check_falling_points(in, err, cap)) return false;
+    falling_points_json = ft_points_json(in.falling_points, in.falling_points_count);
+  } else if (falling_points_json != "[]") {
+    // A stored falling curve must still hold against the new rising curve.
+    in.falling_points_count =
+        ft_config_points(falling_points_json, in.falling_points, FT_API_CONFIG_FALLING_POINTS_MAX_ITEMS);
+    if (!ft_check_falling_points(in, err, cap)) return false;
+  }
 
-static inline void ft_build_config_doc(JsonDocument &doc) {
-  doc["mode"] = ft_mode_to_str(id(cfg_mode));
-  doc["smoothing_mode"] = ft_smoothing_to_str(id(cfg_smoothing_mode));
+  const int mode = in.mode;
+  const int smoothing_mode = in.smoothing_mode;
+  const int temp_source = in.present & FT_API_CONFIG_HAS_TEMP_SOURCE ? in.temp_source : id(cfg_temp_source);
+  const int ff_source = in.present & FT_API_CONFIG_HAS_FF_SOURCE ? in.ff_source : id(cfg_ff_source);
+  const int ff_blend = in.present & FT_API_CONFIG_HAS_FF_BLEND ? in.ff_blend : id(cfg_ff_blend);
+  const float ff_decay_s = in.present & FT_API_CONFIG_HAS_FF_DECAY_S ? in.ff_decay_s : id(cfg_ff_decay_s);
+  const int rack_aggregate =
+      in.present & FT_API_CONFIG_HAS_RACK_AGGREGATE ? in.rack_aggregate : id(cfg_rack_aggregate);
+  const int rack_weight = in.present & FT_API_CONFIG_HAS_RACK_WEIGHT ? in.rack_weight : id(cfg_rack_weight);
+  const float rack_stale_s = in.present & FT_API_CONFIG_HAS_RACK_STALE_S ? in.rack_stale_s : id(cfg_rack_stale_s);
+  const int power_mode = in.present & FT_API_CONFIG_HAS_POWER_MODE ? in.power_mode : id(cfg_power_mode);
+  const float power_ui_hold_s =
+      in.present & FT_API_CONFIG_HAS_POWER_UI_HOLD_S ? in.power_ui_hold_s : id(cfg_power_ui_hold_s);
+  const float http_rate_per_s =
+      in.present & FT_API_CONFIG_HAS_HTTP_RATE_PER_S ? in.http_rate_per_s : id(cfg_http_rate_per_s);
+  const int http_burst = in.present & FT_API_CONFIG_HAS_HTTP_BURST ? in.http_burst : id(cfg_http_burst);
+
+  // Curves and rules are compiled here, off the loop task; bad rules reject the config.
+  next.rules = in.present & FT_API_CONFIG_HAS_RULES ? std::string(in.rules) : cur.rules;
+  static FtControlProgram program;  // httpd task only
+  if (!ft_compile_program(next, program, err, cap)) return false;
+
+  uint32_t changed = 0;
+  changed += id(cfg_mode) != mode;
+  changed += id(cfg_smoothing_mode) != smoothing_mode;
+  changed += cur.points_json != next.points_json;
+  changed += id(cfg_min_pwm) != in.min_pwm;
+  changed += id(cfg_max_pwm) != in.max_pwm;
+  changed += id(cfg_curve_min) != curve_min;
+  changed += id(cfg_curve_max) != curve_max;
+  changed += id(cfg_slew_pct_per_sec) != in.slew_pct_per_sec;
+  changed += id(cfg_failsafe_temp) != in.failsafe_temp;
+  changed += id(cfg_failsafe_pwm) != in.failsafe_pwm;
+  changed += id(cfg_temp_source) != temp_source;
+  changed += id(cfg_ff_source) != ff_source;
+  changed += id(cfg_ff_blend) != ff_blend;
+  changed += id(cfg_ff_decay_s) != ff_decay_s;
+  changed += cur.ff_points_json != next.ff_points_json;
+  changed += cur.falling_points_json != next.falling_points_json;
+  changed += cur.rules != next.rules;
+  changed += id(cfg_rack_aggregate) != rack_aggregate;
+  changed += id(cfg_rack_weight) != rack_weight;
+  changed += id(cfg_rack_stale_s) != rack_stale_s;
+  changed += id(cfg_power_mode) != power_mode;
+  changed += id(cfg_power_ui_hold_s) != power_ui_hold_s;
+  changed += id(cfg_http_rate_per_s) != http_rate_per_s;
+  changed += id(cfg_http_burst) != http_burst;
+
+  id(cfg_mode) = mode;
+  id(cfg_smoothing_mode) = smoothing_mode;
+  id(cfg_min_pwm) = in.min_pwm;
+  id(cfg_max_pwm) = in.max_pwm;
+  id(cfg_curve_min) = curve_min;
+  id(cfg_curve_max) = curve_max;
+  id(cfg_slew_pct_per_sec) = in.slew_pct_per_sec;
+  id(cfg_failsafe_temp) = in.failsafe_temp;
+  id(cfg_failsafe_pwm) = in.failsafe_pwm;
+  id(cfg_temp_source) = temp_source;
+  id(cfg_ff_source) = ff_source;
+  id(cfg_ff_blend) = ff_blend;
+  id(cfg_ff_decay_s) = ff_decay_s;
+  id(cfg_rack_aggregate) = rack_aggregate;
+  id(cfg_rack_weight) = rack_weight;
+  id(cfg_rack_stale_s) = rack_stale_s;
+  id(cfg_power_mode) = power_mode;
+  id(cfg_power_ui_hold_s) = power_ui_hold_s;
+  id(cfg_http_rate_per_s) = http_rate_per_s;
+  id(cfg_http_burst) = http_burst;
+  {
+    FtConfigLock lock;
+    ft_config_pending = std::move(next);
+    ft_config_pending_program = program;
+    ft_config_pending_ready = true;
+  }
+
+  // Optional
+  const bool has_manual_pwm = in.present & FT_API_CONFIG_HAS_MANUAL_PWM;
+  if (has_manual_pwm) id(cfg_manual_pwm) = in.manual_pwm;
+  changed += id(cfg_manual_pwm) != prev_manual_pwm;
+  ft_note_config_changed(changed);
+  ft_metrics.config_applies++;
 
-  JsonDocument points_doc;
-  DeserializationError points_err = deserializeJson(points_doc, id(cfg_points_json).c_str());
-  JsonArray dst_points = doc["points"].to<JsonArray>();
+  if (id(cfg_mode) != prev_mode) {
+    id(fan_mode).publish_state(ft_mode_to_str(id(cfg_mode)));
+  }
 
-  if (!points_err && points_doc.is<JsonArray>()) {
-    for (JsonObject p : points_doc.as<JsonArray>()) {
-      JsonObject out_p = dst_points.add<JsonObject>();
-      out_p["t"] = p["t"].as<float>();
-      out_p["p"] = p["p"].as<float>();
+  if (id(cfg_mode) == 1) {
+    if (id(cfg_manual_pwm) != prev_manual_pwm || has_manual_pwm) {
+      id(fan_manual_pwm).publish_state(id(cfg_manual_pwm));
     }
   } else {
-    JsonObject p1 = dst_points.add<JsonObject>();
-    p1["t"] = 20;
-    p1["p"] = 20;
-    JsonObject p2 = dst_points.add<JsonObject>();
-    p2["t"] = 50;
-    p2["p"] = 100;
+    id(fan_manual_pwm).publish_state(NAN);
   }
 
-  doc["min_pwm"] = id(cfg_min_pwm);
-  doc["max_pwm"] = id(cfg_max_pwm);
-  doc["curve_min"] = id(cfg_curve_min);
-  doc["curve_max"] = id(cfg_curve_max);
-  doc["slew_pct_per_sec"] = id(cfg_slew_pct_per_sec);
-  doc["failsafe_temp"] = id(cfg_failsafe_temp);
-  doc["failsafe_pwm"] = id(cfg_failsafe_pwm);
-
-  // Optional: expose manual pwm for UI convenience (doesn't change API contract)
-  doc["manual_pwm"] = id(cfg_manual_pwm);
+  return true;
 }
 
-static inline bool ft_apply_config_doc(JsonDocument &doc, String &err) {
-  const int prev_mode = id(cfg_mode);
-  const float prev_manual_pwm = id(cfg_manual_pwm);
+#ifdef USE_MQTT
+// Optional MQTT telemetry. Active only when the YAML has an `mqtt:` block.
+static constexpr FtTelemetryFormat FT_MQTT_FORMAT = FT_TELEMETRY_JSON;
+static constexpr uint32_t FT_MQTT_HEARTBEAT_MS = 30000;
+static FtTelemetryPublisher ft_mqtt_pub;
+static uint32_t ft_mqtt_config_generation = UINT32_MAX;
+static bool ft_mqtt_was_connected = false;
+static FtApiConfig ft_mqtt_config;  // loop task only; see ft_config_json()
+
+static inline void ft_mqtt_setup() {
+  FtTelemetryOptions opts;
+  opts.format = FT_MQTT_FORMAT;
+  opts.heartbeat_ms = FT_MQTT_HEARTBEAT_MS;
+  ft_mqtt_pub.configure(opts);
+}
 
-  if (!doc["mode"].is<const char *>()) {
-    err = "mode is required";
-    return false;
+static inline void ft_mqtt_publish_config(esphome::mqtt::MQTTClientComponent *client) {
+  const std::string payload = ft_config_json(ft_mqtt_config);
+  if (client->publish(client->get_topic_prefix() + "/fanforge/config", payload.data(), payload.size(), 0, true)) {
+    ft_mqtt_config_generation = ft_config_generation;
   }
+}
 
-  if (!doc["points"].is<JsonArray>()) {
-    err = "points array is required";
-    return false;
+static inline void ft_mqtt_after_tick() {
+  FtTelemetrySample s;
+  s.ts_ms = millis();
+  s.temp_c = id(control_temp_valid) ? ft_ctl.state.control_temp_c : NAN;
+  s.pwm_pct = id(current_pwm_pct);
+  s.target_pwm_pct = ft_ctl.state.last_target_pwm_pct;
+  s.mode = static_cast<uint8_t>(id(cfg_mode));
+  s.failsafe = ft_ctl.state.failsafe_latched;
+  ft_mqtt_pub.on_tick(s);
+
+  auto *client = esphome::mqtt::global_mqtt_client;
+  if (client == nullptr || !client->is_connected()) {
+    ft_mqtt_was_connected = false;
+    return;
   }
+  // Retained config snapshot on (re)connect and after every config change.
+  if (!ft_mqtt_was_connected || ft_mqtt_config_generation != ft_config_generation) ft_mqtt_publish_config(client);
+  ft_mqtt_was_connected = true;
+
+  const std::string topic = client->get_topic_prefix() + "/fanforge/telemetry";
+  ft_mqtt_pub.drain([&](const uint8_t *data, size_t len) {
+    return client->publish(topic, reinterpret_cast<const char *>(data), len, 0, false);
+  });
+}
+#endif
 
-  if (!doc["smoothing_mode"].is<const char *>()) {
-    err = "smoothing_mode is required";
-    return false;
+// Binds the ingest socket. key_hex is 32 hex chars; an empty key leaves ingest disabled.
+static inline void fanforge_udp_ingest_begin(uint16_t port, const char *key_hex) {
+  uint8_t key[16];
+  if (key_hex == nullptr || key_hex[0] == '\0') return;
+  if (!ft_parse_key_hex(key_hex, key)) {
+    ESP_LOGW("fanforge_api", "UDP ingest key must be 32 hex characters; ingest disabled");
+    return;
   }
+  ft_ingest.set_key(key);
 
-  if (!doc["min_pwm"].is<float>() || !doc["max_pwm"].is<float>() || !doc["slew_pct_per_sec"].is<float>() ||
-      !doc["failsafe_temp"].is<float>() || !doc["failsafe_pwm"].is<float>()) {
-    err = "numeric fields are required: min_pwm, max_pwm, slew_pct_per_sec, failsafe_temp, failsafe_pwm";
-    return false;
+  int fd = lwip_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd < 0) {
+    ESP_LOGW("fanforge_api", "UDP ingest socket failed");
+    return;
+  }
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (lwip_bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ESP_LOGW("fanforge_api", "UDP ingest bind to port %u failed", port);
+    lwip_close(fd);
+    return;
   }
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  ft_ingest_fd = fd;
+  ESP_LOGI("fanforge_api", "UDP ingest listening on port %u", port);
+}
 
-  const char *mode_str = doc["mode"].as<const char *>();
-  const char *smoothing_str = doc["smoothing_mode"].as<const char *>();
-  if (strcmp(smoothing_str, "linear") != 0 && strcmp(smoothing_str, "smooth") != 0) {
-    err = "smoothing_mode must be linear or smooth";
-    return false;
+// Drains pending datagrams into the virtual source table; never blocks or allocates.
+static inline void ft_ingest_poll(uint32_t now) {
+  if (ft_ingest_fd < 0) return;
+  for (int i = 0; i < FT_INGEST_MAX_PER_POLL; i++) {
+    int len = lwip_recvfrom(ft_ingest_fd, ft_ingest_buf, sizeof(ft_ingest_buf), 0, nullptr, nullptr);
+    if (len <= 0) break;
+    ft_ingest.handle_datagram(ft_ingest_buf, static_cast<size_t>(len), now);
   }
+}
 
-  int mode = ft_str_to_mode(mode_str);
-  int smoothing_mode = ft_str_to_smoothing(smoothing_str);
-  float min_pwm = ft_clampf(doc["min_pwm"].as<float>(), 0.0f, 100.0f);
-  float max_pwm = ft_clampf(doc["max_pwm"].as<float>(), 0.0f, 100.0f);
-  float slew = ft_clampf(doc["slew_pct_per_sec"].as<float>(), 0.0f, 100.0f);
-  float failsafe_temp = ft_clampf(doc["failsafe_temp"].as<float>(), 0.0f, 120.0f);
-  float failsafe_pwm = ft_clampf(doc["failsafe_pwm"].as<float>(), 0.0f, 100.0f);
-  float curve_min = id(cfg_curve_min);
-  float curve_max = id(cfg_curve_max);
+// Raw control temperature from the configured source. A stale or missing external
+// source falls back to the local DS18B20 so AUTO keeps running.
+static inline float ft_read_source_temp(uint32_t now, bool &external) {
+  const int source = id(cfg_temp_source);
+  float value = NAN;
+  external = source > 0 && ft_ingest.get(static_cast<uint8_t>(source), FT_SOURCE_TEMP_C, now, value);
+  return external ? value : id(temp_c).state;
+}
 
-  if (doc["curve_min"].is<float>()) curve_min = doc["curve_min"].as<float>();
-  if (doc["curve_max"].is<float>()) curve_max = doc["curve_max"].as<float>();
+// Feed-forward load input: a finite load_pct is a fresh sample; otherwise the
+// configured UDP load source is used while it is fresh. NAN means no new input.
+static inline float ft_read_source_load(float load_pct, uint32_t now) {
+  if (isfinite(load_pct)) return load_pct;
+  const int source = id(cfg_ff_source);
+  float value = NAN;
+  if (source > 0) ft_ingest.get(static_cast<uint8_t>(source), FT_SOURCE_LOAD_PCT, now, value);
+  return value;
+}
 
-  curve_min = ft_clampf(roundf(curve_min), 15.0f, 50.0f);
-  curve_max = ft_clampf(roundf(curve_max), 15.0f, 50.0f);
-  if (curve_max < curve_min) {
-    float tmp = curve_min;
-    curve_min = curve_max;
-    curve_max = tmp;
+// Peers reject summaries whose (epoch, seq) is not above the last one they heard
+// from this unit, however long ago, so each join takes a new epoch and writes it
+// to flash before the first summary: ESPHome defers preference writes
+// (flash_write_interval), and a reboot before the flush would reuse the epoch.
+// The epoch has its own preference; the rack_epoch global mirrors it and
+// carries the count over from firmware that only kept the global.
+static constexpr uint32_t FT_RACK_EPOCH_PREF = 0x46465245;  // "FFRE"
+
+static inline bool ft_rack_next_epoch() {
+  ESPPreferenceObject pref = global_preferences->make_preference<uint32_t>(FT_RACK_EPOCH_PREF);
+  uint32_t epoch = 0;
+  if (!pref.load(&epoch)) epoch = 0;
+  if (epoch < id(rack_epoch)) epoch = id(rack_epoch);
+  epoch++;
+  if (!pref.save(&epoch) || !global_preferences->sync()) return false;
+  id(rack_epoch) = epoch;
+  return true;
+}
+
+// Joins the rack multicast group and starts publishing this unit's summaries.
+// An empty group leaves rack coordination disabled; unit_id 0 derives an id from
+// the MAC address. iface picks the multicast interface (the twin uses loopback).
+static inline void fanforge_rack_begin(const char *group, uint16_t port, const char *key_hex, uint16_t unit_id,
+                                       const char *iface = nullptr) {
+  uint8_t key[16];
+  if (group == nullptr || group[0] == '\0') return;
+  if (!ft_parse_key_hex(key_hex, key)) {
+    ESP_LOGW("fanforge_api", "Rack coordination needs a 32 hex character udp_ingest_key; disabled");
+    return;
+  }
+  struct ip_mreq mreq = {};
+  if (inet_aton(group, &mreq.imr_multiaddr) == 0 || !IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))) {
+    ESP_LOGW("fanforge_api", "Rack group %s is not an IPv4 multicast address; disabled", group);
+    return;
   }
-  if ((curve_max - curve_min) < 1.0f) {
-    if ((curve_max + 1.0f) <= 50.0f) curve_max = curve_min + 1.0f;
-    else curve_min = curve_max - 1.0f;
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (iface != nullptr && iface[0] != '\0') inet_aton(iface, &mreq.imr_interface);
+  if (unit_id == 0) {
+    uint8_t mac[6];
+    get_mac_address_raw(mac);
+    unit_id = static_cast<uint16_t>((mac[4] << 8) | mac[5]);
+    if (unit_id == 0) unit_id = 1;
   }
 
-  if (max_pwm < min_pwm) {
-    err = "max_pwm must be >= min_pwm";
-    return false;
+  int fd = lwip_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd < 0) {
+    ESP_LOGW("fanforge_api", "Rack socket failed");
+    return;
+  }
+  // Every unit on a host (the twin) binds the same port.
+  int one = 1;
+  lwip_setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (lwip_bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      lwip_setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+    ESP_LOGW("fanforge_api", "Rack join of %s:%u failed", group, port);
+    lwip_close(fd);
+    return;
+  }
+  // Summaries stay on the local segment; loopback lets units on one host hear each other.
+  uint8_t ttl = 1, loop = 1;
+  lwip_setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  lwip_setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  if (mreq.imr_interface.s_addr != htonl(INADDR_ANY))
+    lwip_setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq.imr_interface, sizeof(mreq.imr_interface));
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  if (!ft_rack_next_epoch()) {
+    ESP_LOGW("fanforge_api", "Rack epoch could not be saved; rack coordination disabled");
+    lwip_close(fd);
+    return;
   }
 
-  JsonDocument points_doc;
-  JsonArray points = points_doc.to<JsonArray>();
-  if (!ft_parse_points(doc["points"].as<JsonArray>(), points, err)) return false;
-  for (JsonObject p : points) {
-    float point_pwm = p["p"].as<float>();
-    if (point_pwm < min_pwm || point_pwm > max_pwm) {
-      err = "point.p must be within min_pwm..max_pwm";
-      return false;
-    }
+  ft_rack.set_key(key);
+  ft_rack.set_unit_id(unit_id);
+  ft_rack_group_addr = addr;
+  ft_rack_group_addr.sin_addr = mreq.imr_multiaddr;
+  ft_rack_fd = fd;
+  ESP_LOGI("fanforge_api", "Rack unit %u joined %s:%u (epoch %u)", unit_id, group, port,
+           static_cast<unsigned>(id(rack_epoch)));
+}
+
+// Drains pending peer summaries; never blocks or allocates.
+static inline void ft_rack_poll(uint32_t now) {
+  if (ft_rack_fd < 0) return;
+  for (int i = 0; i < FT_INGEST_MAX_PER_POLL; i++) {
+    int len = lwip_recvfrom(ft_rack_fd, ft_rack_buf, sizeof(ft_rack_buf), 0, nullptr, nullptr);
+    if (len <= 0) break;
+    ft_rack.handle_datagram(ft_rack_buf, static_cast<size_t>(len), now);
   }
+}
 
-  std::string points_json;
-  serializeJson(points, points_json);
+// Control temperature once the rack is taken into account: the configured
+// aggregate over this unit's source reading and its fresh peers, or the source
+// reading itself when the aggregate is off or has nothing to go on.
+static inline float ft_rack_control_temp(float source_temp, uint32_t now) {
+  ft_rack.set_stale_ms(static_cast<uint32_t>(id(cfg_rack_stale_s) * 1000.0f));
+  const int mode = id(cfg_rack_aggregate);
+  if (mode == FT_RACK_AGG_OFF || ft_rack_fd < 0) {
+    ft_rack_last = FtRackAggregate();
+    return source_temp;
+  }
+  const uint8_t weight = static_cast<uint8_t>(id(cfg_rack_weight));
+  ft_rack_last = ft_rack.aggregate(static_cast<FtRackAggregateMode>(mode), source_temp, weight, now);
+  return isfinite(ft_rack_last.temp_c) ? ft_rack_last.temp_c : source_temp;
+}
 
-  id(cfg_mode) = mode;
-  id(cfg_smoothing_mode) = smoothing_mode;
-  id(cfg_points_json) = points_json;
-  id(cfg_min_pwm) = min_pwm;
-  id(cfg_max_pwm) = max_pwm;
-  id(cfg_curve_min) = curve_min;
-  id(cfg_curve_max) = curve_max;
-  id(cfg_slew_pct_per_sec) = slew;
-  id(cfg_failsafe_temp) = failsafe_temp;
-  id(cfg_failsafe_pwm) = failsafe_pwm;
+// Publishes this unit's own reading (never the aggregate) once per FT_RACK_TX_PERIOD_MS.
+static inline void ft_rack_publish(float source_temp, uint32_t now) {
+  if (ft_rack_fd < 0 || (ft_rack_seq > 0 && now - ft_rack_last_tx_ms < FT_RACK_TX_PERIOD_MS)) return;
+  ft_rack_last_tx_ms = now;
+  FtRackSummary s;
+  s.unit_id = ft_rack.unit_id();
+  s.flags = isfinite(source_temp) ? FT_RACK_F_TEMP_VALID : 0;
+  if (ft_ctl.state.failsafe_latched) s.flags |= FT_RACK_F_FAILSAFE;
+  s.weight = static_cast<uint8_t>(id(cfg_rack_weight));
+  s.epoch = id(rack_epoch);
+  s.seq = ++ft_rack_seq;
+  s.temp_c = source_temp;
+  s.pwm_pct = ft_ctl.state.current_pwm_pct;
+  uint8_t out[FT_RACK_DATAGRAM_BYTES];
+  const size_t len = ft_rack_encode(ft_rack.key(), s, out, sizeof(out));
+  const int sent = lwip_sendto(ft_rack_fd, out, len, 0, reinterpret_cast<struct sockaddr *>(&ft_rack_group_addr),
+                               sizeof(ft_rack_group_addr));
+  if (sent == static_cast<int>(len))
+    ft_rack.stats().sent++;
+  else
+    ft_rack.stats().send_errors++;
+}
 
-  // Optional
-  if (doc["manual_pwm"].is<float>()) {
-    id(cfg_manual_pwm) = ft_clampf(doc["manual_pwm"].as<float>(), 0.0f, 100.0f);
+static inline void ft_install_program(const FtControlProgram &p) {
+  FtControlConfig &c = ft_ctl.config;
+  c.curve = p.curve;
+  c.ff_curve = p.ff_curve;
+  c.falling_curve = p.falling_curve;
+  c.rules = p.rules;
+}
+
+// Mirrors the persisted settings into the controller. Curves and rules are
+// compiled only when the config changes: by the POST that staged them, or
+// here on the first tick from what was restored.
+static inline void ft_sync_control_config() {
+  FtControlConfig &c = ft_ctl.config;
+  {
+    FtConfigLock lock;
+    if (ft_config_pending_ready) {
+      id(cfg_points_json) = std::move(ft_config_pending.points_json);
+      id(cfg_ff_points_json) = std::move(ft_config_pending.ff_points_json);
+      id(cfg_falling_points_json) = std::move(ft_config_pending.falling_points_json);
+      id(cfg_rules) = std::move(ft_config_pending.rules);
+      ft_install_program(ft_config_pending_program);
+      ft_config_pending_ready = false;
+      ft_ctl_program_loaded = true;
+    }
+  }
+  if (!ft_ctl_program_loaded) {
+    static FtControlProgram restored;
+    FtConfigStrings cs;
+    ft_config_strings(cs);
+    char err[FT_API_ERROR_LEN];
+    if (!ft_compile_program(cs, restored, err, sizeof(err)))
+      ESP_LOGW("fanforge_api", "Stored %s; running without rules", err);
+    ft_install_program(restored);
+    ft_ctl_program_loaded = true;
   }
+  c.mode = id(cfg_mode);
+  c.curve.smooth = id(cfg_smoothing_mode) == 1;
+  c.falling_curve.smooth = c.curve.smooth;
+  c.min_pwm = id(cfg_min_pwm);
+  c.max_pwm = id(cfg_max_pwm);
+  c.slew_pct_per_sec = id(cfg_slew_pct_per_sec);
+  c.failsafe_temp = id(cfg_failsafe_temp);
+  c.failsafe_pwm = id(cfg_failsafe_pwm);
+  c.manual_pwm = id(cfg_manual_pwm);
+  c.ff_enabled = id(cfg_ff_source) > 0;
+  c.ff_blend = id(cfg_ff_blend);
+  c.ff_decay_s = id(cfg_ff_decay_s);
+  c.output_inverted = FT_PWM_INVERTED;
+}
 
-  if (id(cfg_mode) != prev_mode) {
-    id(fan_mode).publish_state(ft_mode_to_str(id(cfg_mode)));
+// Advances the history clock, feeds every tick into the rollups and appends
+// one history sample per second of uptime; a stalled loop leaves a gap.
+static inline void ft_history_record(uint32_t now) {
+  bool new_second = true;
+  if (!ft_history_started) {
+    ft_history_started = true;
+    ft_history_last_ms = now;
+  } else {
+    const uint32_t elapsed_s = (now - ft_history_last_ms) / 1000;
+    new_second = elapsed_s > 0;
+    ft_history_last_ms += elapsed_s * 1000;
+    ft_history_uptime_s += elapsed_s;
   }
+  const FtControlState &st = ft_ctl.state;
+  const uint32_t t = ft_history.now_s(ft_history_uptime_s);
+  const float temp = st.control_temp_valid ? st.control_temp_c : NAN;
+  ft_rollups.add(t, temp, st.current_pwm_pct);
+  if (!new_second || !ft_history.mounted()) return;
+
+  uint8_t flags = static_cast<uint8_t>((id(cfg_mode) << FT_HISTORY_MODE_SHIFT) & FT_HISTORY_F_MODE);
+  if (st.failsafe_latched) flags |= FT_HISTORY_F_FAILSAFE;
+  if (st.temp_external) flags |= FT_HISTORY_F_EXTERNAL;
+  ft_history.append(t, temp, st.current_pwm_pct, flags);
+  ft_history.poll(t);
+}
 
-  if (id(cfg_mode) == 1) {
-    if (id(cfg_manual_pwm) != prev_manual_pwm || doc["manual_pwm"].is<float>()) {
-      id(fan_manual_pwm).publish_state(id(cfg_manual_pwm));
+// Writes out samples still staged in RAM; called from on_shutdown.
+static inline void fanforge_history_flush() { ft_history.flush(); }
+
+static inline void ft_after_tick() {
+#ifdef USE_MQTT
+  ft_mqtt_after_tick();
+#endif
+}
+
+// A new DS18B20 reading (on_value): stamps it for latency tracing and, in
+// low-power mode, starts the next tick.
+static inline void fanforge_sensor_event() {
+  ft_latency.on_reading(micros());
+  ft_power.note_sensor();
+}
+
+// Enables or disables automatic light sleep; false where the framework was built
+// without power management / tickless idle (the Arduino core by default).
+static inline bool ft_power_set_light_sleep(bool enable) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_pm_config_t pm = {};
+#else
+  esp_pm_config_esp32c3_t pm = {};
+#endif
+  pm.max_freq_mhz = static_cast<int>(ESP.getCpuFreqMHz());
+  pm.min_freq_mhz = enable ? 40 : pm.max_freq_mhz;  // XTAL frequency while idle
+  pm.light_sleep_enable = enable;
+  return esp_pm_configure(&pm) == ESP_OK;
+}
+
+// ESPHome's LEDC output is clocked from APB, which light sleep gates and the
+// 40 MHz idle frequency slows: the fan PWM would stop or change frequency
+// whenever the loop idles. While the LEDC duty is non-zero the power manager is
+// held at full APB speed and out of light sleep. With the stock inverted drive
+// a stopped fan is full duty, so the hold never lets go there: dropping the pin
+// would run the fan at full speed. Without power management there is nothing
+// to hold.
+static inline void ft_power_hold_for_fan(bool running) {
+  static bool locks_tried = false;
+  if (running == ft_power_fan_held) return;
+  if (!locks_tried) {
+    locks_tried = true;
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "fanforge_pwm", &ft_power_sleep_lock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "fanforge_pwm", &ft_power_apb_lock) != ESP_OK) {
+      ft_power_sleep_lock = nullptr;
+      ft_power_apb_lock = nullptr;
     }
+  }
+  if (ft_power_sleep_lock == nullptr || ft_power_apb_lock == nullptr) return;
+  if (running) {
+    esp_pm_lock_acquire(ft_power_apb_lock);
+    esp_pm_lock_acquire(ft_power_sleep_lock);
   } else {
-    id(fan_manual_pwm).publish_state(NAN);
+    esp_pm_lock_release(ft_power_sleep_lock);
+    esp_pm_lock_release(ft_power_apb_lock);
   }
+  ft_power_fan_held = running;
+}
 
-  return true;
+// True while the CPU may actually light-sleep when idle.
+static inline bool ft_power_sleeping() { return ft_power_light_sleep && !ft_power_fan_held; }
+
+// Moves the radio, the power manager and the main loop to the governor's state.
+// Low power is re-asserted periodically because ESPHome restores its own
+// power_save_mode when Wi-Fi reconnects.
+static inline void ft_power_apply(uint32_t now) {
+  const FtPowerState state = ft_power.state();
+  const FtPowerMode mode = ft_power.mode();
+  const bool changed = state != ft_power_applied || (state == FT_POWER_STATE_LOW && mode != ft_power_applied_mode);
+  ft_power_hold_for_fan(ft_ctl.state.output_level > 0.0f);  // before light sleep can start
+  if (!changed && (state == FT_POWER_STATE_FULL || now - ft_power_applied_ms < FT_POWER_REAPPLY_MS)) return;
+  ft_power_applied_ms = now;
+  if (state == FT_POWER_STATE_LOW) {
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    App.set_loop_interval(FT_POWER_LOW_LOOP_MS);
+    const bool light = mode == FT_POWER_MODE_LIGHT && ft_power_set_light_sleep(true);
+    if (!light && ft_power_light_sleep) ft_power_set_light_sleep(false);
+    if (changed && mode == FT_POWER_MODE_LIGHT && !light)
+      ESP_LOGW("fanforge_api", "Automatic light sleep unavailable in this build; using modem sleep");
+    ft_power_light_sleep = light;
+  } else {
+    if (ft_power_light_sleep) ft_power_set_light_sleep(false);
+    ft_power_light_sleep = false;
+    esp_wifi_set_ps(WIFI_PS_NONE);
+    App.set_loop_interval(FT_POWER_FULL_LOOP_MS);
+  }
+  if (changed) {
+    const char *label = state == FT_POWER_STATE_FULL ? "full" : ft_power_light_sleep ? "light sleep" : "modem sleep";
+    ESP_LOGI("fanforge_api", "Power: %s", label);
+  }
+  ft_power_applied = state;
+  ft_power_applied_mode = mode;
 }
 
-static inline void ft_apply_pwm_percent(float pwm_pct) {
-  // pwm_pct here is the "user meaning": 0..100, where 0 should truly be off/min.
-  pwm_pct = ft_clampf(pwm_pct, 0.0f, 100.0f);
+// Completes the tick's stage record with loop timing and hands it to the trace buffer.
+static inline void ft_stage_trace_commit(FtStageRecord *rec, uint32_t interval_ms, uint32_t start_us) {
+  const uint32_t tick_us = micros() - start_us;
+  const uint32_t late_ms = FT_STAGE_LATE_TICK_MS * ft_power.expected_interval_ms() / FT_POWER_FULL_TICK_MS;
+  rec->interval_ms = interval_ms > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(interval_ms);
+  rec->tick_us = tick_us > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(tick_us);
+  if (interval_ms > late_ms) rec->flags |= FT_STAGE_F_LATE;
+  ft_stage_trace.commit();
+}
 
-  float level = pwm_pct / 100.0f;          // 0..1
-  if (FT_PWM_INVERTED) level = 1.0f - level;
+static inline void fanforge_control_tick(float load_pct = NAN) {
+  const uint32_t start_us = micros();
+  const uint32_t now = millis();
+  ft_power.update(static_cast<FtPowerMode>(id(cfg_power_mode)),
+                  static_cast<uint32_t>(id(cfg_power_ui_hold_s) * 1000.0f), now);
+  ft_power_apply(now);
+  if (!ft_power.tick_due(now)) {
+    ft_power.account(now, 0, ft_power_sleeping());
+    return;
+  }
+  FtTickTimer tick_timer(ft_power.expected_interval_ms());
+
+  const uint32_t interval_ms = ft_stage_last_tick_ms != 0 ? now - ft_stage_last_tick_ms : 0;
+  ft_stage_last_tick_ms = now;
+  const uint32_t expected_ms = ft_power.expected_interval_ms();
+  ft_admission.note_tick_late(interval_ms > expected_ms ? interval_ms - expected_ms : 0, now);
+  ft_ingest_poll(now);
+  ft_rack_poll(now);
+  ft_sync_control_config();
+
+  FtControlInput in;
+  in.now_ms = now;
+  const float source_temp = ft_read_source_temp(now, in.temp_external);
+  in.temp_c = ft_rack_control_temp(source_temp, now);
+  in.load_pct = ft_read_source_load(load_pct, now);
+  FtStageRecord *stage_rec = ft_stage_trace.begin();
+  const FtControlState &st = ft_ctl.state;
+  const bool had_control_temp = st.control_temp_initialized;
+  const float prev_control_temp = st.control_temp_c;
+  const float prev_pwm = st.current_pwm_pct;
+  const bool output_updated = ft_ctl.tick(in, stage_rec);
+  ft_reversal_rate.update(st.reversals, now);
+
+  // Mirror the loop state into the globals read by the template sensors.
+  if (st.control_temp_valid) id(control_temp_c) = st.control_temp_c;
+  id(control_temp_valid) = st.control_temp_valid;
+  id(last_update_ms) = st.last_update_ms;
+  if (output_updated) {
+    id(current_pwm_pct) = st.current_pwm_pct;
+    // Drive hardware output
+    ft_power_hold_for_fan(st.output_level > 0.0f);
+    id(fan_pwm_output).set_level(st.output_level);
+  }
 
-  level = ft_clampf(level, 0.0f, 1.0f);
-  ft_last_output_level = level;
-  id(fan_pwm_output).set_level(level);
+  FtLatencyTick lat;
+  lat.start_us = start_us;
+  lat.write_us = micros();
+  lat.traced = isfinite(source_temp) && !in.temp_external && in.temp_c == source_temp;
+  lat.accepted = st.control_temp_valid && (!had_control_temp || st.control_temp_c != prev_control_temp);
+  lat.held = st.control_temp_valid && in.temp_c != st.control_temp_c;
+  lat.output_changed = output_updated && st.current_pwm_pct != prev_pwm;
+  lat.settled = st.current_pwm_pct == st.last_target_pwm_pct;
+  ft_latency.on_tick(lat);
+  if (stage_rec != nullptr) ft_stage_trace_commit(stage_rec, interval_ms, start_us);
+  ft_history_record(now);
+  ft_rack_publish(source_temp, now);
+  ft_after_tick();
+  ft_power.ran_tick(now);
+  ft_power.account(now, micros() - start_us, ft_power_sleeping());
 }
 
-static inline void fanforge_control_tick() {
-  static bool failsafe_latched = false;
+static inline void ft_write_metrics(FtPromWriter &w) {
+  float temp = NAN;
+  if (ft_ctl.state.control_temp_initialized && isfinite(ft_ctl.state.control_temp_c))
+    temp = ft_ctl.state.control_temp_c;
+  else if (isfinite(id(temp_c).state))
+    temp = id(temp_c).state;
+
+  w.gauge("fanforge_temperature_celsius", "Control temperature after deadband filtering.", temp);
+  w.gauge("fanforge_temperature_raw_celsius", "Last raw DS18B20 reading.", id(temp_c).state);
+  w.gauge("fanforge_temperature_valid", "1 when the control temperature is valid.", id(control_temp_valid) ? 1.0f : 0.0f);
+  w.gauge("fanforge_pwm_percent", "Current PWM output after slew limiting.", id(current_pwm_pct));
+  w.gauge("fanforge_target_pwm_percent", "PWM target before slew limiting.", ft_ctl.state.last_target_pwm_pct);
+  w.gauge("fanforge_output_level", "LEDC duty level written to hardware (after inversion).",
+          ft_ctl.state.output_level);
+  w.counter("fanforge_pwm_reversals_total", "Output direction changes (rising to falling PWM or back).",
+            ft_ctl.state.reversals);
+  w.gauge("fanforge_pwm_reversals_per_hour", "Output direction changes over the last hour.",
+          ft_reversal_rate.per_hour());
+
+  w.family("fanforge_mode", "gauge", "Active control mode (1 for the active mode label).");
+  for (int m = 0; m <= 2; m++) {
+    char labels[24];
+    snprintf(labels, sizeof(labels), "mode=\"%s\"", ft_mode_to_str(m));
+    w.sample("fanforge_mode", labels, id(cfg_mode) == m ? 1.0f : 0.0f);
+  }
+  w.gauge("fanforge_failsafe_latched", "1 while the temperature failsafe is latched.",
+          ft_ctl.state.failsafe_latched ? 1.0f : 0.0f);
+  w.gauge("fanforge_failsafe_temperature_celsius", "Configured failsafe threshold.", id(cfg_failsafe_temp));
+  w.gauge("fanforge_stage_trace_frozen", "1 while a trigger holds the /api/trace buffer frozen.",
+          ft_stage_trace.frozen() ? 1.0f : 0.0f);
+
+  w.gauge("fanforge_temperature_source_external", "1 while control runs on an external (UDP) source.",
+          ft_ctl.state.temp_external ? 1.0f : 0.0f);
+  w.gauge("fanforge_load_percent", "Last normalized load input to the feed-forward channel.",
+          ft_ctl.state.ff_load_pct);
+  w.gauge("fanforge_feedforward_pwm_percent", "Current feed-forward PWM contribution.", ft_ctl.state.ff_pwm_pct);
+  w.family("fanforge_virtual_source_value", "gauge", "Last value per UDP virtual source (kind 0=C, 1=load %, 2=W).");
+  w.family("fanforge_virtual_source_age_seconds", "gauge", "Time since each UDP virtual source was last heard.");
+  const uint32_t now = millis();
+  for (int i = 0; i < FT_VSRC_MAX; i++) {
+    const FtVirtualSource &src = ft_ingest.sources()[i];
+    if (!src.used) continue;
+    char labels[32];
+    snprintf(labels, sizeof(labels), "sensor=\"%u\",kind=\"%u\"", src.sensor_id, src.kind);
+    w.sample("fanforge_virtual_source_value", labels, src.value);
+    w.sample("fanforge_virtual_source_age_seconds", labels, (now - src.last_rx_ms) / 1000.0f);
+  }
+  const FtIngestStats &ist = ft_ingest.stats();
+  w.family("fanforge_udp_ingest_datagrams_total", "counter", "UDP ingest datagrams, by outcome.");
+  w.sample_u64("fanforge_udp_ingest_datagrams_total", "result=\"accepted\"", ist.accepted);
+  w.sample_u64("fanforge_udp_ingest_datagrams_total", "result=\"bad_format\"", ist.bad_format);
+  w.sample_u64("fanforge_udp_ingest_datagrams_total", "result=\"bad_tag\"", ist.bad_tag);
+  w.sample_u64("fanforge_udp_ingest_datagrams_total", "result=\"replayed\"", ist.replayed);
+  w.sample_u64("fanforge_udp_ingest_datagrams_total", "result=\"no_slot\"", ist.no_slot);
+
+  w.gauge("fanforge_rack_temperature_celsius", "Rack aggregate the curve ran on (NaN when off or nothing fresh).",
+          ft_rack_last.temp_c);
+  w.gauge("fanforge_rack_peers", "Fresh rack peers in the aggregate.", ft_rack_last.peers);
+  w.family("fanforge_rack_peer_temperature_celsius", "gauge", "Last temperature each rack peer published.");
+  w.family("fanforge_rack_peer_pwm_percent", "gauge", "Last PWM each rack peer published.");
+  w.family("fanforge_rack_peer_age_seconds", "gauge", "Time since each rack peer was last heard.");
+  for (int i = 0; i < FT_RACK_MAX_PEERS; i++) {
+    const FtRackPeer &peer = ft_rack.peers()[i];
+    if (!peer.used) continue;
+    char labels[24];
+    snprintf(labels, sizeof(labels), "unit=\"%u\"", peer.last.unit_id);
+    w.sample("fanforge_rack_peer_temperature_celsius", labels,
+             peer.last.flags & FT_RACK_F_TEMP_VALID ? peer.last.temp_c : NAN);
+    w.sample("fanforge_rack_peer_pwm_percent", labels, peer.last.pwm_pct);
+    w.sample("fanforge_rack_peer_age_seconds", labels, (now - peer.last_rx_ms) / 1000.0f);
+  }
+  const FtRackStats &rst = ft_rack.stats();
+  w.family("fanforge_rack_datagrams_total", "counter", "Rack summaries received, by outcome.");
+  w.sample_u64("fanforge_rack_datagrams_total", "result=\"accepted\"", rst.accepted);
+  w.sample_u64("fanforge_rack_datagrams_total", "result=\"bad_format\"", rst.bad_format);
+  w.sample_u64("fanforge_rack_datagrams_total", "result=\"bad_tag\"", rst.bad_tag);
+  w.sample_u64("fanforge_rack_datagrams_total", "result=\"replayed\"", rst.replayed);
+  w.sample_u64("fanforge_rack_datagrams_total", "result=\"no_slot\"", rst.no_slot);
+  w.sample_u64("fanforge_rack_datagrams_total", "result=\"self\"", rst.self);
+  w.counter("fanforge_rack_sent_total", "Rack summaries this unit published.", rst.sent);
+  w.counter("fanforge_rack_send_errors_total", "Rack summaries that failed to send.", rst.send_errors);
+
+  const FtPowerStats &ps = ft_power.stats();
+  w.gauge("fanforge_power_low", "1 while in low-power mode (modem or light sleep).", ft_power.low() ? 1.0f : 0.0f);
+  w.gauge("fanforge_power_light_sleep", "1 while the power manager light-sleeps the CPU when idle.",
+          ft_power_sleeping() ? 1.0f : 0.0f);
+  w.gauge("fanforge_power_fan_hold", "1 while the running fan keeps the CPU out of light sleep.",
+          ft_power_fan_held ? 1.0f : 0.0f);
+  w.gauge("fanforge_power_estimated_milliwatts", "Estimated module power over the last interval (model).",
+          ps.power_mw);
+  w.family("fanforge_power_seconds_total", "counter", "Time by power state (light_sleep is estimated).");
+  w.sample_u64("fanforge_power_seconds_total", "state=\"full\"", ps.full_ms / 1000);
+  w.sample_u64("fanforge_power_seconds_total", "state=\"modem_sleep\"", ps.modem_ms / 1000);
+  w.sample_u64("fanforge_power_seconds_total", "state=\"light_sleep\"", ps.light_sleep_ms / 1000);
+  w.counter("fanforge_energy_millijoules_total", "Estimated module energy since boot (power model).",
+            ps.energy_uj / 1000);
+  w.counter("fanforge_power_transitions_total", "Switches between full and low power.", ps.transitions);
+  w.counter("fanforge_power_skipped_ticks_total", "Low-power intervals that did not run the control tick.",
+            ps.skipped_ticks);
+  w.counter("fanforge_power_sensor_wakes_total", "Low-power ticks started by a new sensor reading.",
+            ps.sensor_wakes);
+
+  w.histogram_seconds("fanforge_tick_duration_seconds", "Wall time spent inside fanforge_control_tick().",
+                      ft_metrics.tick_duration);
+  w.gauge("fanforge_tick_duration_max_seconds", "Longest observed control tick.", ft_metrics.tick_duration.max_us / 1e6f);
+  w.histogram_seconds("fanforge_tick_interval_seconds",
+                      "Start-to-start interval between control ticks, scaled to the 200 ms period.",
+                      ft_metrics.tick_interval);
+  w.gauge("fanforge_tick_interval_max_seconds", "Longest observed interval between control ticks (unscaled).",
+          ft_metrics.tick_interval_max_us / 1e6f);
+
+  w.family("fanforge_latency_seconds", "histogram", "Sensor-to-output latency of DS18B20 readings, by stage.");
+  for (int i = 0; i < FT_LAT_STAGE_COUNT; i++)
+    w.histogram_samples("fanforge_latency_seconds", FT_LAT_STAGE_LABELS[i], ft_latency.stages[i]);
+  w.family("fanforge_latency_max_seconds", "gauge", "Longest observed latency, by stage.");
+  for (int i = 0; i < FT_LAT_STAGE_COUNT; i++)
+    w.sample("fanforge_latency_max_seconds", FT_LAT_STAGE_LABELS[i], ft_latency.stages[i].max_us / 1e6f);
+  w.family("fanforge_latency_readings_total", "counter", "DS18B20 readings, by what they did to the output.");
+  for (int i = 0; i < FT_LAT_OUT_COUNT; i++)
+    w.sample_u64("fanforge_latency_readings_total", FT_LAT_OUTCOME_LABELS[i], ft_latency.outcomes[i]);
+
+  const FtControlState &st = ft_ctl.state;
+  w.gauge("fanforge_rules", "Compiled rules in the active program.", ft_ctl.config.rules.n_rules);
+  w.gauge("fanforge_rules_program_bytes", "Bytecode size of the active rules program.", ft_ctl.config.rules.len);
+  w.gauge("fanforge_rules_steps", "VM instructions the rules took in the last tick.", st.rules_steps);
+  w.gauge("fanforge_rules_cycles", "CPU cycles the rules took in the last tick.", st.rules_cycles);
+  w.gauge("fanforge_rules_mode_override", "Mode a rule forced in the last tick (0 auto, 1 manual, 2 off), -1 if none.",
+          st.rules_mode);
+  w.counter("fanforge_rules_runs_total", "Ticks that ran the rules program.", st.rules_runs);
+  w.counter("fanforge_rules_cycles_total", "CPU cycles spent running rules.", st.rules_cycles_total);
+  w.counter("fanforge_rules_fired_total", "Rule actions taken.", st.rules_fired);
+  w.counter("fanforge_rules_budget_overruns_total", "Ticks whose rules hit the step budget (effects dropped).",
+            st.rules_overruns);
+  w.gauge("fanforge_temperature_rise_celsius_per_minute", "Raw temperature slope (the rules' rise input).",
+          st.temp_rise_c_per_min);
+
+  w.family("fanforge_http_requests_total", "counter", "API requests handled, by route.");
+  for (int r = 0; r < FT_ROUTE_COUNT; r++) {
+    w.sample_u64("fanforge_http_requests_total", FT_ROUTE_LABELS[r], ft_metrics.http_requests[r]);
+  }
+  w.gauge("fanforge_http_inflight", "API requests in progress.", ft_admission.inflight());
+  w.gauge("fanforge_http_shedding", "1 while load shedding refuses API requests.",
+          ft_admission.shedding(millis()) ? 1.0f : 0.0f);
+  w.gauge("fanforge_http_clients", "Client addresses holding a rate-limit bucket.", ft_admission.clients());
+  const FtAdmitStats &ast = ft_admission.stats();
+  w.family("fanforge_http_rejected_total", "counter", "API requests refused before running, by reason.");
+  w.sample_u64("fanforge_http_rejected_total", "reason=\"busy\"", ast.rejected[FT_ADMIT_BUSY]);
+  w.sample_u64("fanforge_http_rejected_total", "reason=\"rate_limited\"", ast.rejected[FT_ADMIT_RATE_LIMITED]);
+  w.sample_u64("fanforge_http_rejected_total", "reason=\"shed_late\"", ast.rejected[FT_ADMIT_SHED_LATE]);
+  w.sample_u64("fanforge_http_rejected_total", "reason=\"shed_heap\"", ast.rejected[FT_ADMIT_SHED_HEAP]);
+  w.counter("fanforge_http_clients_evicted_total", "Rate-limit buckets handed to a new client address.",
+            ast.clients_evicted);
+  const FtAsyncStats &xst = ft_async.stats();
+  w.gauge("fanforge_http_async_active", "Responses being sent in chunks after their handler returned.",
+          ft_async.active());
+  w.gauge("fanforge_http_async_active_max", "Most async responses in progress at once since boot.", xst.max_active);
+  w.gauge("fanforge_http_async_memory_bytes", "Static chunk buffers, compressors and slot state for async responses.",
+          sizeof(ft_async));
+  w.family("fanforge_http_async_responses_total", "counter", "Async responses, by outcome.");
+  w.sample_u64("fanforge_http_async_responses_total", "outcome=\"completed\"", xst.completed);
+  w.sample_u64("fanforge_http_async_responses_total", "outcome=\"aborted\"", xst.aborted);
+  w.sample_u64("fanforge_http_async_responses_total", "outcome=\"refused\"", xst.refused);
+  w.counter("fanforge_http_async_chunks_total", "Body chunks sent by async responses.", xst.chunks);
+  w.counter("fanforge_http_async_bytes_total", "Body bytes sent by async responses.", xst.bytes);
+  w.gauge("fanforge_http_async_max_seconds", "Longest async response since boot, detach to last chunk.",
+          xst.max_ms / 1000.0f);
+  const FtDeflateStats &dst = ft_deflate_stats;
+  w.family("fanforge_http_compressed_responses_total", "counter", "Responses sent with a Content-Encoding, by coding.");
+  w.sample_u64("fanforge_http_compressed_responses_total", "encoding=\"gzip\"", dst.responses[FT_ENCODING_GZIP]);
+  w.sample_u64("fanforge_http_compressed_responses_total", "encoding=\"deflate\"", dst.responses[FT_ENCODING_DEFLATE]);
+  w.counter("fanforge_http_compress_in_bytes_total", "Body bytes fed to the response compressor.", dst.in_bytes);
+  w.counter("fanforge_http_compress_out_bytes_total", "Compressed body bytes it produced.", dst.out_bytes);
+  w.counter("fanforge_http_compress_cpu_microseconds_total", "CPU time spent compressing responses.",
+            dst.cycles / ESP.getCpuFreqMHz());
+  w.family("fanforge_http_responses_total", "counter", "API responses sent, by status class.");
+  w.sample_u64("fanforge_http_responses_total", "code=\"2xx\"", ft_metrics.http_responses_2xx);
+  w.sample_u64("fanforge_http_responses_total", "code=\"4xx\"", ft_metrics.http_responses_4xx);
+  w.sample_u64("fanforge_http_responses_total", "code=\"5xx\"", ft_metrics.http_responses_5xx);
+
+  w.gauge("fanforge_heap_free_bytes", "Free 8-bit capable heap.", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+  w.gauge("fanforge_heap_largest_free_block_bytes", "Largest allocatable 8-bit heap block.",
+          heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  w.gauge("fanforge_heap_min_free_bytes", "Low-water mark of free 8-bit heap since boot.",
+          heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+
+  w.gauge("fanforge_history_mounted", "1 when the history partition is mounted.", ft_history.mounted() ? 1.0f : 0.0f);
+  w.gauge("fanforge_history_segments", "4 KB segments in the history partition.", ft_history.segments());
+  w.gauge("fanforge_history_segments_used", "History segments holding samples.", ft_history.segments_used());
+  w.gauge("fanforge_history_staged_samples", "Samples held in RAM until the next history flush.", ft_history.staged());
+  w.counter("fanforge_history_flash_writes_total", "History chunks written to flash.", ft_history.flash_writes());
+  w.counter("fanforge_history_flash_bytes_total", "Bytes written to the history partition.", ft_history.bytes_written());
+  w.counter("fanforge_history_segments_recycled_total", "Oldest history segments erased for reuse.",
+            ft_history.segments_recycled());
+  w.counter("fanforge_history_write_errors_total", "Failed history flash writes.", ft_history.write_errors());
+
+  w.family("fanforge_rollup_buckets", "gauge", "Closed buckets held per rollup tier.");
+  w.sample("fanforge_rollup_buckets", "resolution=\"1s\"", ft_rollups.sec.count());
+  w.sample("fanforge_rollup_buckets", "resolution=\"1m\"", ft_rollups.min.count());
+  w.sample("fanforge_rollup_buckets", "resolution=\"1h\"", ft_rollups.hour.count());
+
+  w.counter("fanforge_nvs_writes_total", "Persisted settings changed (each is one preferences write).",
+            ft_metrics.nvs_writes);
+  w.counter("fanforge_config_applies_total", "Accepted POST /api/config requests.", ft_metrics.config_applies);
+  w.gauge("fanforge_uptime_seconds", "Time since boot.", millis() / 1000.0f);
+}
 
-  // Load curve points
-  FtPoint points[FT_MAX_POINTS];
-  int n = ft_load_points(points, FT_MAX_POINTS);
-  if (n < 2) {
-    points[0] = {20.0f, 20.0f};
-    points[1] = {50.0f, 100.0f};
-    n = 2;
+// A compressed scrape is built whole (~6 KB against ~20 KB plain), through its own encoder.
+static FtDeflate ft_metrics_deflate;
+
+static inline void ft_send_metrics(AsyncWebServerRequest *req) {
+  static const char *const TYPE = "text/plain; version=0.0.4; charset=utf-8";
+  const FtContentEncoding encoding = ft_response_encoding(req);
+  if (encoding == FT_ENCODING_IDENTITY) {
+    auto *stream = req->beginResponseStream(TYPE);
+    FtPromWriter w(stream);
+    ft_write_metrics(w);
+    stream->addHeader("Vary", "Accept-Encoding");
+    req->send(stream);
+    ft_metrics_http_response(200);
+    return;
   }
+  std::string body;
+  ft_metrics_deflate.begin(encoding, ft_cycle_count);
+  FtPromWriter w(&ft_metrics_deflate, &body);
+  ft_write_metrics(w);
+  ft_metrics_deflate.append_finish(body);
+  ft_deflate_stats.add(ft_metrics_deflate);
+  auto *res = req->beginResponse(200, TYPE, body);
+  res->addHeader("Content-Encoding", FT_ENCODING_NAMES[encoding]);
+  res->addHeader("Vary", "Accept-Encoding");
+  req->send(res);
+  ft_metrics_http_response(200);
+}
 
-  // Compute target
-  float target_pwm = 0.0f;
-  float temp = NAN;
-  bool is_auto_mode = false;
-  bool use_output_shaping = false;
-
-  float raw_temp = id(temp_c).state;
-  if (isfinite(raw_temp)) {
-    // Temperature deadband before curve evaluation: ignore 0.5 C chatter,
-    // but accept larger movement immediately.
-    if (!ft_control_temp_initialized || !isfinite(ft_control_temp_c)) {
-      ft_control_temp_c = raw_temp;
-      ft_control_temp_initialized = true;
-    } else if (fabsf(raw_temp - ft_control_temp_c) >= FT_TEMP_CONTROL_DEADBAND_C) {
-      ft_control_temp_c = raw_temp;
-    }
-    id(control_temp_c) = ft_control_temp_c;
-    id(control_temp_valid) = true;
-  } else {
-    id(control_temp_valid) = false;
+static inline bool ft_parse_trace_triggers(const std::string &list, uint8_t &mask) {
+  mask = 0;
+  size_t pos = 0;
+  while (pos <= list.size()) {
+    size_t comma = list.find(',', pos);
+    if (comma == std::string::npos) comma = list.size();
+    const std::string name = list.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (name == "failsafe")
+      mask |= FT_STAGE_TRIGGER_FAILSAFE;
+    else if (name == "late")
+      mask |= FT_STAGE_TRIGGER_LATE;
+    else if (name != "none")
+      return false;
   }
+  return true;
+}
 
-  if (id(cfg_mode) == 2) {
-    // OFF: force to 0 immediately.
-    target_pwm = 0.0f;
-  } else if (id(cfg_mode) == 1) {
-    // MANUAL: direct operator control for validation/tuning.
-    target_pwm = ft_clampf(id(cfg_manual_pwm), 0.0f, 100.0f);
-  } else {
-    // AUTO
-    // AUTO depends on temperature validity. MANUAL/OFF should still operate without a sensor reading.
-    if (!isfinite(raw_temp) || !ft_control_temp_initialized || !isfinite(ft_control_temp_c)) {
-      id(last_update_ms) = millis();
-      return;
+static inline std::string ft_trace_json() {
+  std::string json;
+  FtJsonWriter w(json);
+  w.begin_object();
+  w.key("frozen");
+  w.value(ft_stage_trace.frozen());
+  w.key("trigger");
+  const uint8_t fired = ft_stage_trace.trigger();
+  if (fired & FT_STAGE_TRIGGER_FAILSAFE)
+    w.value("failsafe");
+  else if (fired & FT_STAGE_TRIGGER_LATE)
+    w.value("late");
+  else if (fired & FT_STAGE_TRIGGER_MANUAL)
+    w.value("manual");
+  else
+    w.null();
+  w.key("triggers");
+  w.begin_array();
+  if (ft_stage_trace.trigger_mask() & FT_STAGE_TRIGGER_FAILSAFE) w.value("failsafe");
+  if (ft_stage_trace.trigger_mask() & FT_STAGE_TRIGGER_LATE) w.value("late");
+  w.end_array();
+  w.key("count");
+  w.value(static_cast<int64_t>(ft_stage_trace.count()));
+  w.key("capacity");
+  w.value(static_cast<int64_t>(FT_STAGE_TRACE_LEN));
+  w.end_object();
+  return json;
+}
+
+// Parses a history clock query argument: negative values are seconds before now.
+static inline bool ft_parse_history_time(const std::string &arg, uint32_t now, uint32_t &out) {
+  char *end = nullptr;
+  const long long v = strtoll(arg.c_str(), &end, 10);
+  if (arg.empty() || end == nullptr || *end != '\0' || v > static_cast<long long>(UINT32_MAX)) return false;
+  out = v >= 0 ? static_cast<uint32_t>(v) : (-v >= static_cast<long long>(now) ? 0 : now - static_cast<uint32_t>(-v));
+  return true;
+}
+
+template<typename S> static inline void ft_print_history_row(S *stream, const FtHistorySample &s, bool first) {
+  if (isfinite(s.temp_c))
+    stream->printf("%s[%u,%.1f,%.1f,%u]", first ? "" : ",", static_cast<unsigned>(s.t), s.temp_c, s.pwm_pct, s.flags);
+  else
+    stream->printf("%s[%u,null,%.1f,%u]", first ? "" : ",", static_cast<unsigned>(s.t), s.pwm_pct, s.flags);
+}
+
+template<typename S> static inline void ft_print_history_head(S *stream, uint32_t from, uint32_t to) {
+  const uint32_t now = ft_history.now_s(ft_history_uptime_s);
+  stream->printf("{\"now\":%u,\"boot\":%u,\"from\":%u,\"to\":%u,\"samples\":[", static_cast<unsigned>(now),
+                 ft_history.boot(), static_cast<unsigned>(from), static_cast<unsigned>(to));
+}
+
+template<typename S> static inline void ft_print_page_tail(S *stream, uint32_t count, uint32_t next) {
+  if (next != FT_HISTORY_NONE)
+    stream->printf("],\"count\":%u,\"next\":%u}", static_cast<unsigned>(count), static_cast<unsigned>(next));
+  else
+    stream->printf("],\"count\":%u,\"next\":null}", static_cast<unsigned>(count));
+}
+
+// Streams samples in [from, to] as JSON rows [t, temp_c|null, pwm_pct, flags].
+// Stops after limit rows; next is the time to pass as from to continue.
+static inline void ft_send_history(AsyncWebServerRequest *req, uint32_t from, uint32_t to, uint32_t limit) {
+  auto *stream = req->beginResponseStream("application/json");
+  ft_print_history_head(stream, from, to);
+  uint32_t count = 0;
+  uint32_t next = FT_HISTORY_NONE;
+  ft_history.query(from, to, [&](const FtHistorySample &s) {
+    if (count == limit) {
+      next = s.t;
+      return false;
     }
-    temp = ft_control_temp_c;
+    ft_print_history_row(stream, s, count == 0);
+    count++;
+    return true;
+  });
+  ft_print_page_tail(stream, count, next);
+  req->send(stream);
+  ft_metrics_http_response(200);
+}
 
-    is_auto_mode = true;
-    use_output_shaping = true;
-    target_pwm = (id(cfg_smoothing_mode) == 1) ? ft_curve_smooth(temp, points, n) : ft_curve_linear(temp, points, n);
-    target_pwm = ft_clampf(target_pwm, 0.0f, 100.0f);
+template<typename S>
+static inline void ft_print_lttb_head(S *stream, uint32_t from, uint32_t to, FtLttbMetric metric) {
+  const uint32_t now = ft_history.now_s(ft_history_uptime_s);
+  stream->printf("{\"now\":%u,\"boot\":%u,\"from\":%u,\"to\":%u,\"metric\":\"%s\",\"samples\":[",
+                 static_cast<unsigned>(now), ft_history.boot(), static_cast<unsigned>(from), static_cast<unsigned>(to),
+                 metric == FT_LTTB_PWM ? "pwm" : "temp");
+}
+
+// Downsamples [from, to] to at most points samples with LTTB on the chosen
+// metric, in one pass over the flash log. Ranges that already fit are sent raw.
+// This runs the whole pass in the handler, so from is first moved up to
+// FT_LTTB_SYNC_SPAN_S before to; the response's "from" shows where it started.
+static inline void ft_send_history_lttb(AsyncWebServerRequest *req, uint32_t from, uint32_t to, uint32_t points,
+                                        FtLttbMetric metric) {
+  if (to - from > FT_LTTB_SYNC_SPAN_S) from = to - FT_LTTB_SYNC_SPAN_S;
+  ft_history_lttb.begin(from, to, static_cast<uint16_t>(points), metric);
+  ft_history.query(from, to, [](const FtHistorySample &s) {
+    ft_history_lttb.add(s);
+    return true;
+  });
+  if (ft_history_lttb.seen() <= points) {
+    ft_send_history(req, from, to, points);
+    return;
   }
+  auto *stream = req->beginResponseStream("application/json");
+  ft_print_lttb_head(stream, from, to, metric);
+  uint32_t count = 0;
+  ft_history_lttb.finish([&](const FtHistorySample &s) {
+    ft_print_history_row(stream, s, count == 0);
+    count++;
+    return true;
+  });
+  stream->printf("],\"count\":%u,\"next\":null}", static_cast<unsigned>(count));
+  req->send(stream);
+  ft_metrics_http_response(200);
+}
 
-  if (is_auto_mode) {
-    // In AUTO, enforce a practical running window once we're above 0.
-    if (target_pwm > 0.0f) {
-      target_pwm = ft_clampf(target_pwm, id(cfg_min_pwm), id(cfg_max_pwm));
-    } else {
-      target_pwm = 0.0f;
+template<typename S> static inline void ft_print_rollup_head(S *stream, int tier, uint32_t from, uint32_t to) {
+  const uint32_t now = ft_history.now_s(ft_history_uptime_s);
+  stream->printf("{\"now\":%u,\"boot\":%u,\"from\":%u,\"to\":%u,\"resolution\":%u,\"buckets\":[",
+                 static_cast<unsigned>(now), ft_history.boot(), static_cast<unsigned>(from), static_cast<unsigned>(to),
+                 static_cast<unsigned>(ft_rollups.width_s(tier)));
+}
+
+template<typename S> static inline void ft_print_rollup_row(S *stream, const FtRollupBucket &b, bool first) {
+  stream->printf("%s[%u,%u,", first ? "" : ",", static_cast<unsigned>(b.t), b.count);
+  if (b.temp_min != FT_ROLLUP_TEMP_NONE)
+    stream->printf("%.1f,%.1f,%.1f,%.1f,", b.temp_min / 10.0f, b.temp_max / 10.0f, b.temp_mean / 10.0f,
+                   b.temp_p95 / 10.0f);
+  else
+    stream->print("null,null,null,null,");
+  stream->printf("%.1f,%.1f,%.1f,%.1f]", b.pwm_min / 10.0f, b.pwm_max / 10.0f, b.pwm_mean / 10.0f,
+                 b.pwm_p95 / 10.0f);
+}
+
+// Streams the rollup tier picked for resolution_s as JSON rows
+// [t, count, temp_min, temp_max, temp_mean, temp_p95, pwm_min, pwm_max,
+// pwm_mean, pwm_p95]; temperatures are null for buckets without a reading.
+static inline void ft_send_rollups(AsyncWebServerRequest *req, uint32_t from, uint32_t to, uint32_t limit,
+                                   uint32_t resolution_s) {
+  auto *stream = req->beginResponseStream("application/json");
+  const int tier = ft_rollups.tier_for(resolution_s);
+  ft_print_rollup_head(stream, tier, from, to);
+  uint32_t count = 0;
+  uint32_t next = FT_HISTORY_NONE;
+  ft_rollups.query(tier, from, to, [&](const FtRollupBucket &b) {
+    if (count == limit) {
+      next = b.t;
+      return false;
+    }
+    ft_print_rollup_row(stream, b, count == 0);
+    count++;
+    return true;
+  });
+  ft_print_page_tail(stream, count, next);
+  req->send(stream);
+  ft_metrics_http_response(200);
+}
+
+// Upper bounds of one printed row or page tail, checked before printing into a chunk.
+static constexpr size_t FT_HISTORY_ROW_MAX = 64;
+static constexpr size_t FT_ROLLUP_ROW_MAX = 96;
+static constexpr size_t FT_PAGE_TAIL_MAX = 48;
+
+/**
+ * Async body of a history or rollup page: the same JSON as the synchronous
+ * senders, produced a chunk at a time. Each fill() re-enters the query just
+ * past the last row sent, so nothing is buffered beyond the chunk; rows
+ * appended meanwhile are included up to `to`, as a later request would see.
+ */
+class FtPageStream : public FtAsyncSource {
+ public:
+  size_t fill(char *buf, size_t cap) override {
+    FtChunkWriter out(buf, cap);
+    if (this->phase_ == PHASE_HEAD) {
+      this->print_head_(out);
+      this->phase_ = PHASE_ROWS;
     }
+    if (this->phase_ == PHASE_ROWS && this->print_rows_(out)) this->phase_ = PHASE_TAIL;
+    if (this->phase_ == PHASE_TAIL && out.room() >= FT_PAGE_TAIL_MAX) {
+      ft_print_page_tail(&out, this->count_, this->next_);
+      this->phase_ = PHASE_DONE;
+    }
+    return out.size();
   }
 
-  // Failsafe applies only during AUTO control.
-  if (is_auto_mode) {
-    if (temp >= id(cfg_failsafe_temp)) {
-      failsafe_latched = true;
-    } else if (temp <= (id(cfg_failsafe_temp) - FT_FAILSAFE_HYST_C)) {
-      failsafe_latched = false;
+ protected:
+  enum Phase : uint8_t { PHASE_HEAD, PHASE_ROWS, PHASE_TAIL, PHASE_DONE };
+
+  void reset_(uint32_t from, uint32_t to, uint32_t limit) {
+    this->from_ = from;
+    this->cursor_ = from;
+    this->to_ = to;
+    this->limit_ = limit;
+    this->count_ = 0;
+    this->next_ = FT_HISTORY_NONE;
+    this->phase_ = PHASE_HEAD;
+  }
+  virtual void print_head_(FtChunkWriter &out) = 0;
+  // Prints rows while they fit; true once the page has no more.
+  virtual bool print_rows_(FtChunkWriter &out) = 0;
+
+  // Takes one row at time t; false when the page is complete or the chunk is full.
+  template<typename F> bool take_(uint32_t t, FtChunkWriter &out, size_t row_max, bool &full, F &&print) {
+    if (this->count_ == this->limit_) {
+      this->next_ = t;
+      return false;
     }
-    if (failsafe_latched) target_pwm = fmaxf(target_pwm, id(cfg_failsafe_pwm));
-  } else {
-    failsafe_latched = false;
+    if (out.room() < row_max) {
+      full = true;
+      return false;
+    }
+    print();
+    this->count_++;
+    this->cursor_ = t + 1;
+    return true;
+  }
+
+  uint32_t from_ = 0;
+  uint32_t cursor_ = 0;  // time of the first row not yet sent
+  uint32_t to_ = 0;
+  uint32_t limit_ = 0;
+  uint32_t count_ = 0;
+  uint32_t next_ = FT_HISTORY_NONE;
+  Phase phase_ = PHASE_HEAD;
+};
+
+class FtHistoryStream : public FtPageStream {
+ public:
+  void setup(uint32_t from, uint32_t to, uint32_t limit) { this->reset_(from, to, limit); }
+
+ protected:
+  void print_head_(FtChunkWriter &out) override { ft_print_history_head(&out, this->from_, this->to_); }
+  bool print_rows_(FtChunkWriter &out) override {
+    bool full = false;
+    ft_history.query(this->cursor_, this->to_, [&](const FtHistorySample &s) {
+      return this->take_(s.t, out, FT_HISTORY_ROW_MAX, full,
+                         [&]() { ft_print_history_row(&out, s, this->count_ == 0); });
+    });
+    return !full;
   }
-  target_pwm = ft_clampf(target_pwm, 0.0f, 100.0f);
+};
+
+class FtRollupStream : public FtPageStream {
+ public:
+  void setup(uint32_t from, uint32_t to, uint32_t limit, uint32_t resolution_s) {
+    this->reset_(from, to, limit);
+    this->tier_ = ft_rollups.tier_for(resolution_s);
+  }
+
+ protected:
+  void print_head_(FtChunkWriter &out) override { ft_print_rollup_head(&out, this->tier_, this->from_, this->to_); }
+  bool print_rows_(FtChunkWriter &out) override {
+    bool full = false;
+    ft_rollups.query(this->tier_, this->cursor_, this->to_, [&](const FtRollupBucket &b) {
+      return this->take_(b.t, out, FT_ROLLUP_ROW_MAX, full, [&]() { ft_print_rollup_row(&out, b, this->count_ == 0); });
+    });
+    return !full;
+  }
+
+  int tier_ = 0;
+};
 
-  float next_pwm = target_pwm;
-  uint32_t now = millis();
-  if (use_output_shaping) {
-    // Deadband: avoid micro-hunting due to quantization/noise
-    if (fabsf(target_pwm - id(current_pwm_pct)) < FT_PWM_DEADBAND_PCT) {
-      target_pwm = id(current_pwm_pct);
+/**
+ * Async body of /api/history?points=N. The LTTB pass folds
+ * FT_LTTB_STEP_SAMPLES samples per fill() and stays pending() until the range
+ * is done, so httpd serves other sockets and the control loop runs between
+ * steps; the selected rows then go out a chunk at a time. A range that already
+ * fits is sent raw, as ft_send_history_lttb does. Holds ft_history_lttb from
+ * setup() to end().
+ */
+class FtLttbStream : public FtAsyncSource {
+ public:
+  void setup(uint32_t from, uint32_t to, uint32_t points, FtLttbMetric metric) {
+    ft_history_lttb_busy = true;
+    ft_history_lttb.begin(from, to, static_cast<uint16_t>(points), metric);
+    this->from_ = from;
+    this->cursor_ = from;
+    this->to_ = to;
+    this->points_ = points;
+    this->metric_ = metric;
+    this->count_ = 0;
+    this->phase_ = PHASE_SCAN;
+  }
+  bool pending() const override { return this->phase_ == PHASE_SCAN; }
+  size_t fill(char *buf, size_t cap) override {
+    if (this->phase_ == PHASE_SCAN && !this->step_()) return 0;
+    if (this->phase_ == PHASE_RAW) return this->raw_.fill(buf, cap);
+    FtChunkWriter out(buf, cap);
+    if (this->phase_ == PHASE_HEAD) {
+      ft_print_lttb_head(&out, this->from_, this->to_, this->metric_);
+      this->phase_ = PHASE_ROWS;
+    }
+    if (this->phase_ == PHASE_ROWS) {
+      // Rows already sent are selected again and skipped.
+      uint32_t index = 0;
+      bool full = false;
+      ft_history_lttb.finish([&](const FtHistorySample &s) {
+        if (index++ < this->count_) return true;
+        if (out.room() < FT_HISTORY_ROW_MAX) {
+          full = true;
+          return false;
+        }
+        ft_print_history_row(&out, s, this->count_ == 0);
+        this->count_++;
+        return true;
+      });
+      if (!full) this->phase_ = PHASE_TAIL;
+    }
+    if (this->phase_ == PHASE_TAIL && out.room() >= FT_PAGE_TAIL_MAX) {
+      ft_print_page_tail(&out, this->count_, FT_HISTORY_NONE);
+      this->phase_ = PHASE_DONE;
     }
+    return out.size();
+  }
+  void end() override { ft_history_lttb_busy = false; }
+
+ protected:
+  enum Phase : uint8_t { PHASE_SCAN, PHASE_RAW, PHASE_HEAD, PHASE_ROWS, PHASE_TAIL, PHASE_DONE };
+
+  // Folds the next step of samples; true once the pass is complete.
+  bool step_() {
+    uint32_t folded = 0;
+    bool more = false;
+    ft_history.query(this->cursor_, this->to_, [&](const FtHistorySample &s) {
+      if (folded == FT_LTTB_STEP_SAMPLES) {
+        more = true;
+        return false;
+      }
+      ft_history_lttb.add(s);
+      this->cursor_ = s.t + 1;
+      folded++;
+      return true;
+    });
+    if (more) return false;
+    if (ft_history_lttb.seen() <= this->points_) {
+      this->raw_.setup(this->from_, this->to_, this->points_);
+      this->phase_ = PHASE_RAW;
+    } else {
+      this->phase_ = PHASE_HEAD;
+    }
+    return true;
+  }
 
-    // Slew limiting
-    float dt = 0.2f;
-    if (id(last_update_ms) > 0 && now >= id(last_update_ms)) {
-      dt = fmaxf(0.02f, (now - id(last_update_ms)) / 1000.0f);
+  FtHistoryStream raw_;
+  uint32_t from_ = 0;
+  uint32_t cursor_ = 0;  // time of the first sample not yet folded
+  uint32_t to_ = 0;
+  uint32_t points_ = 0;
+  FtLttbMetric metric_ = FT_LTTB_TEMP;
+  uint32_t count_ = 0;
+  Phase phase_ = PHASE_SCAN;
+};
+
+// The /api/trace dump, record by record. The ring is held still while it is
+// read, so the download is as consistent as the synchronous one.
+class FtTraceStream : public FtAsyncSource {
+ public:
+  void setup(uint32_t now_ms, uint16_t cycles_per_us) {
+    this->now_ms_ = now_ms;
+    this->cycles_per_us_ = cycles_per_us;
+    this->started_ = false;
+    this->next_ = 0;
+  }
+  size_t fill(char *buf, size_t cap) override {
+    FtChunkWriter out(buf, cap);
+    if (!this->started_) {
+      ft_stage_trace.hold();
+      this->started_ = true;
+      const FtStageTraceHeader h = ft_stage_trace.header(this->now_ms_, this->cycles_per_us_);
+      this->count_ = h.count;
+      out.write(&h, sizeof(h));
+    }
+    while (this->next_ < this->count_ && out.room() >= sizeof(FtStageRecord)) {
+      out.write(&ft_stage_trace.record(this->next_), sizeof(FtStageRecord));
+      this->next_++;
     }
+    return out.size();
+  }
+  void end() override {
+    if (this->started_) ft_stage_trace.release();
+    this->started_ = false;
+  }
+
+ protected:
+  uint32_t now_ms_ = 0;
+  uint16_t cycles_per_us_ = 0;
+  bool started_ = false;
+  uint16_t next_ = 0;
+  uint16_t count_ = 0;
+};
 
-    float max_step = ft_clampf(id(cfg_slew_pct_per_sec), 0.0f, 100.0f) * dt;
-    float delta = target_pwm - id(current_pwm_pct);
-    float step = ft_clampf(delta, -max_step, max_step);
-    next_pwm = ft_clampf(id(current_pwm_pct) + step, 0.0f, 100.0f);
+// A constant byte range (a UI file in flash).
+class FtBytesStream : public FtAsyncSource {
+ public:
+  void setup(const uint8_t *data, uint32_t size) {
+    this->data_ = data;
+    this->size_ = size;
+    this->off_ = 0;
+  }
+  size_t fill(char *buf, size_t cap) override {
+    const size_t n = this->size_ - this->off_ < cap ? this->size_ - this->off_ : cap;
+    memcpy(buf, this->data_ + this->off_, n);
+    this->off_ += n;
+    return n;
   }
 
-  id(current_pwm_pct) = next_pwm;
-  ft_last_target_pwm_pct = target_pwm;
-  id(last_update_ms) = now;
+ protected:
+  const uint8_t *data_ = nullptr;
+  uint32_t size_ = 0;
+  uint32_t off_ = 0;
+};
+
+// One source of each kind per slot; a response uses the instances at its slot's index.
+static FtHistoryStream ft_async_history[FT_ASYNC_SLOTS];
+static FtLttbStream ft_async_lttb[FT_ASYNC_SLOTS];
+static FtRollupStream ft_async_rollups[FT_ASYNC_SLOTS];
+static FtTraceStream ft_async_trace[FT_ASYNC_SLOTS];
+static FtBytesStream ft_async_bytes[FT_ASYNC_SLOTS];
+
+#ifdef FT_HTTP_ASYNC
+static void ft_async_finish(FtAsyncSlot &s, bool complete) {
+  httpd_req_async_handler_complete(static_cast<httpd_req_t *>(s.req));
+  if (s.deflate.encoding() != FT_ENCODING_IDENTITY) ft_deflate_stats.add(s.deflate);
+  ft_async.finish(s, complete, millis());
+  ft_admission.release();
+}
 
-  // Drive hardware output
-  ft_apply_pwm_percent(next_pwm);
+// httpd work item: sends the slot's next chunk and queues the one after, so
+// requests on other sockets are served in between.
+static void ft_async_pump(void *arg) {
+  FtAsyncSlot &s = *static_cast<FtAsyncSlot *>(arg);
+  httpd_req_t *req = static_cast<httpd_req_t *>(s.req);
+  const size_t n = ft_async.next(s);
+  if (n == 0 && !s.ended) {
+    // The source is between steps of its work: sleep a tick so lower-priority
+    // tasks, the control loop among them, run before the next one.
+    vTaskDelay(1);
+    if (httpd_queue_work(req->handle, ft_async_pump, &s) != ESP_OK) ft_async_finish(s, false);
+    return;
+  }
+  const bool sent = httpd_resp_send_chunk(req, n > 0 ? s.buf : nullptr, n) == ESP_OK;
+  if (sent && n > 0 && httpd_queue_work(req->handle, ft_async_pump, &s) == ESP_OK) return;
+  ft_async_finish(s, sent && n == 0);
+}
+#endif
+
+// Answers the request with a chunked response from sources[slot], configured
+// by setup(source). headers is a nullptr-terminated name/value list of strings
+// that outlive the response; compress negotiates a Content-Encoding. True when
+// the request was answered: streamed, or refused with 503 because every slot
+// is busy. False leaves it to the synchronous sender (IDF before 5.1, or httpd
+// could not detach the request), which sends it uncompressed.
+template<typename S, typename F>
+static inline bool ft_async_send(AsyncWebServerRequest *request, FtAdmitTicket &ticket, S (&sources)[FT_ASYNC_SLOTS],
+                                 F &&setup, const char *type, const char *const *headers = nullptr,
+                                 bool compress = false) {
+#ifdef FT_HTTP_ASYNC
+  const int slot = ft_async.reserve();
+  if (slot < 0) {
+    ft_send_rejection(request, FT_ADMIT_BUSY, 1);
+    return true;
+  }
+  httpd_req_t *req = nullptr;
+  if (httpd_req_async_handler_begin(*request, &req) != ESP_OK) return false;
+  setup(sources[slot]);
+  httpd_resp_set_type(req, type);
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  for (size_t i = 0; headers != nullptr && headers[i] != nullptr; i += 2)
+    httpd_resp_set_hdr(req, headers[i], headers[i + 1]);
+  const FtContentEncoding encoding = compress ? ft_response_encoding(request) : FT_ENCODING_IDENTITY;
+  if (compress) httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+  if (encoding != FT_ENCODING_IDENTITY) httpd_resp_set_hdr(req, "Content-Encoding", FT_ENCODING_NAMES[encoding]);
+  ticket.hand_off();
+  FtAsyncSlot &s = ft_async.start(slot, req, &sources[slot], millis(), encoding, ft_cycle_count);
+  ft_metrics_http_response(200);
+  if (httpd_queue_work(req->handle, ft_async_pump, &s) != ESP_OK) ft_async_finish(s, false);
+  return true;
+#else
+  return false;
+#endif
 }
 
 class FanForgeApiHandler : public AsyncWebHandler {
  public:
   bool canHandle(AsyncWebServerRequest *request) const override {
     const std::string url = request->url();
-    if (url != "/api/status" && url != "/api/config") return false;
+    if (url == "/metrics" || url == "/api/history") return request->method() == HTTP_GET;
+    if (url != "/api/status" && url != "/api/config" && url != "/api/trace") return false;
     const http_method m = request->method();
     return m == HTTP_GET || m == HTTP_POST || m == HTTP_OPTIONS;
   }
@@ -505,101 +1944,315 @@ class FanForgeApiHandler : public AsyncWebHandler {
   void handleRequest(AsyncWebServerRequest *request) override {
     const std::string url = request->url();
     const http_method m = request->method();
+    // Scrapes are never shed (they are how shedding is observed), only rate limited.
+    const uint8_t cost = m == HTTP_POST && url == "/api/config" ? FT_ADMIT_COST_CONFIG_POST : FT_ADMIT_COST;
+    FtAdmitTicket ticket(request, cost, url != "/metrics");
+    if (!ticket.admitted()) return;
+    // Everything but scrapes is someone looking at the device: stay at full power.
+    if (url != "/metrics") ft_power.note_ui(millis());
 
     if (m == HTTP_OPTIONS) {
+      ft_metrics_http_request(FT_ROUTE_OPTIONS);
       auto *res = request->beginResponse(200, "text/plain", "ok");
       ft_add_cors(res);
       res->addHeader("Access-Control-Max-Age", "600");
       request->send(res);
+      ft_metrics_http_response(200);
       return;
     }
 
-    if (m == HTTP_GET && url == "/api/status") {
-      JsonDocument doc;
+    if (m == HTTP_GET && url == "/metrics") {
+      ft_metrics_http_request(FT_ROUTE_METRICS);
+      ft_send_metrics(request);
+      return;
+    }
 
-      if (ft_control_temp_initialized && isfinite(ft_control_temp_c))
-        doc["temp_c"] = ft_control_temp_c;
-      else if (isfinite(id(temp_c).state))
-        doc["temp_c"] = id(temp_c).state;
+    if (m == HTTP_GET && url == "/api/status") {
+      ft_metrics_http_request(FT_ROUTE_STATUS);
+      FtApiStatusResponse st;
+      st.present = FT_API_STATUS_RESPONSE_ALL;
+      if (ft_ctl.state.control_temp_initialized && isfinite(ft_ctl.state.control_temp_c))
+        st.temp_c = ft_ctl.state.control_temp_c;
       else
-        doc["temp_c"] = nullptr;
-
-      doc["pwm_pct"] = id(current_pwm_pct);
-      doc["target_pwm_pct"] = ft_last_target_pwm_pct;
-      doc["output_level"] = ft_last_output_level;
-      doc["mode"] = ft_mode_to_str(id(cfg_mode));
-      doc["smoothing_mode"] = ft_smoothing_to_str(id(cfg_smoothing_mode));
-      doc["min_pwm"] = id(cfg_min_pwm);
-      doc["max_pwm"] = id(cfg_max_pwm);
-      doc["slew_pct_per_sec"] = id(cfg_slew_pct_per_sec);
-      doc["manual_pwm"] = id(cfg_manual_pwm);
-      doc["last_update_ms"] = id(last_update_ms);
-
-      ft_send_json(request, doc, 200);
+        st.temp_c = id(temp_c).state;  // NAN (null) without a reading
+      st.pwm_pct = id(current_pwm_pct);
+      st.target_pwm_pct = ft_ctl.state.last_target_pwm_pct;
+      st.output_level = ft_ctl.state.output_level;
+      st.mode = static_cast<FtApiMode>(id(cfg_mode));
+      st.smoothing_mode = static_cast<FtApiSmoothingMode>(id(cfg_smoothing_mode));
+      st.min_pwm = id(cfg_min_pwm);
+      st.max_pwm = id(cfg_max_pwm);
+      st.slew_pct_per_sec = id(cfg_slew_pct_per_sec);
+      st.manual_pwm = id(cfg_manual_pwm);
+      st.last_update_ms = id(last_update_ms);
+      st.temp_source = id(cfg_temp_source);
+      st.temp_source_active = ft_ctl.state.temp_external ? FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_EXTERNAL
+                                                         : FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_LOCAL;
+      st.load_pct = ft_ctl.state.ff_load_pct;
+      st.ff_pwm_pct = ft_ctl.state.ff_pwm_pct;
+      st.rack_temp_c = ft_rack_last.temp_c;
+      st.rack_peers = ft_rack_last.peers;
+      const FtPowerStats &ps = ft_power.stats();
+      st.power_state =
+          ft_power.low() ? FT_API_STATUS_RESPONSE_POWER_STATE_LOW : FT_API_STATUS_RESPONSE_POWER_STATE_FULL;
+      st.asleep_s = ps.light_sleep_ms / 1000.0f;
+      st.energy_j = ps.energy_uj / 1e6f;
+      st.pwm_reversals_per_hour = ft_reversal_rate.per_hour();
+
+      ft_send_api(request, 200, ft_wants_cbor(request), [&st](auto &w) { ft_api_write_status_response(w, st); });
       return;
     }
 
     if (m == HTTP_GET && url == "/api/config") {
-      JsonDocument doc;
-      ft_build_config_doc(doc);
-      ft_send_json(request, doc, 200);
+      ft_metrics_http_request(FT_ROUTE_CONFIG_GET);
+      ft_send_config(request, ft_wants_cbor(request), this->config_);
       return;
     }
 
     if (m == HTTP_POST && url == "/api/config") {
+      ft_metrics_http_request(FT_ROUTE_CONFIG_POST);
       std::string body;
-      if (request->hasArg("plain")) {
-        body = request->arg("plain");
-      } else if (request->hasArg("payload")) {
-        body = request->arg("payload");
-      } else if (request->hasArg("config")) {
-        body = request->arg("config");
+      const char *read_err = ft_read_config_body(request, body);
+      const bool body_cbor = ft_body_is_cbor(request);
+      const bool cbor = ft_wants_cbor(request, body_cbor);
+      if (read_err != nullptr) {
+        ft_send_error(request, 400, read_err, cbor);
+        return;
       }
-
       if (body.empty()) {
-        JsonDocument err_doc;
-        err_doc["error"] = "empty request body";
-        ft_send_json(request, err_doc, 400);
+        ft_send_error(request, 400, "empty request body", cbor);
         return;
       }
 
-      JsonDocument in_doc;
-      DeserializationError parse_err = deserializeJson(in_doc, body);
-      if (parse_err) {
-        JsonDocument err_doc;
-        err_doc["error"] = String("invalid JSON: ") + parse_err.c_str();
-        ft_send_json(request, err_doc, 400);
+      static FtApiConfig in;
+      char err[FT_API_ERROR_LEN];
+      bool parsed;
+      if (body_cbor) {
+        FtCborReader reader(body);
+        parsed = ft_parse_config_body(reader, in, "CBOR", err, sizeof(err));
+      } else {
+        FtJsonReader reader(body);
+        parsed = ft_parse_config_body(reader, in, "JSON", err, sizeof(err));
+      }
+      if (!parsed || !ft_apply_config(in, err, sizeof(err))) {
+        ft_send_error(request, 400, err, cbor);
         return;
       }
 
-      String err;
-      if (!ft_apply_config_doc(in_doc, err)) {
-        JsonDocument err_doc;
-        err_doc["error"] = err;
-        ft_send_json(request, err_doc, 400);
+      ft_send_config(request, cbor, this->config_);
+      return;
+    }
+
+    if (m == HTTP_GET && url == "/api/trace") {
+      ft_metrics_http_request(FT_ROUTE_TRACE);
+      const uint16_t cycles_per_us = static_cast<uint16_t>(ESP.getCpuFreqMHz());
+      static const char *const TRACE_HEADERS[] = {"Content-Disposition", "attachment; filename=\"fanforge-trace.bin\"",
+                                                  nullptr};
+      if (ft_async_send(
+              request, ticket, ft_async_trace, [&](FtTraceStream &t) { t.setup(millis(), cycles_per_us); },
+              "application/octet-stream", TRACE_HEADERS, true))
         return;
+      std::string dump;
+      ft_stage_trace.dump(dump, millis(), cycles_per_us);
+      auto *res = request->beginResponse(200, "application/octet-stream", dump);
+      res->addHeader("Content-Disposition", "attachment; filename=\"fanforge-trace.bin\"");
+      request->send(res);
+      ft_metrics_http_response(200);
+      return;
+    }
+
+    if (m == HTTP_POST && url == "/api/trace") {
+      ft_metrics_http_request(FT_ROUTE_TRACE);
+      if (request->hasArg("trigger")) {
+        uint8_t mask = 0;
+        if (!ft_parse_trace_triggers(request->arg("trigger"), mask)) {
+          ft_send_error(request, 400, "trigger must be a comma list of failsafe, late, or none");
+          return;
+        }
+        ft_stage_trace.set_trigger_mask(mask);
       }
+      if (request->hasArg("rearm")) ft_stage_trace.rearm();
+      if (request->hasArg("freeze")) ft_stage_trace.freeze();
+
+      ft_send_json(request, ft_trace_json(), 200);
+      return;
+    }
 
-      JsonDocument out_doc;
-      ft_build_config_doc(out_doc);
-      ft_send_json(request, out_doc, 200);
+    if (m == HTTP_GET && url == "/api/history") {
+      ft_metrics_http_request(FT_ROUTE_HISTORY);
+      const uint32_t now = ft_history.now_s(ft_history_uptime_s);
+      uint32_t from = now > FT_HISTORY_DEFAULT_SPAN_S ? now - FT_HISTORY_DEFAULT_SPAN_S : 0;
+      uint32_t to = now;
+      int resolution = 0;
+      int points = 0;
+      FtLttbMetric metric = FT_LTTB_TEMP;
+      bool ok = (!request->hasArg("from") || ft_parse_history_time(request->arg("from"), now, from)) &&
+                (!request->hasArg("to") || ft_parse_history_time(request->arg("to"), now, to));
+      if (ok && request->hasArg("resolution")) {
+        resolution = atoi(request->arg("resolution").c_str());
+        ok = resolution >= 1;
+      }
+      if (ok && request->hasArg("points")) {
+        points = atoi(request->arg("points").c_str());
+        ok = resolution == 0 && points >= 3 && points <= FT_LTTB_MAX_POINTS;
+      }
+      if (ok && request->hasArg("metric")) {
+        const std::string name = request->arg("metric");
+        ok = name == "temp" || name == "pwm";
+        metric = name == "pwm" ? FT_LTTB_PWM : FT_LTTB_TEMP;
+      }
+      const uint32_t max_limit = resolution > 0 ? FT_ROLLUP_MAX_LIMIT : FT_HISTORY_MAX_LIMIT;
+      uint32_t limit = resolution > 0 ? FT_ROLLUP_MAX_LIMIT : FT_HISTORY_DEFAULT_LIMIT;
+      if (ok && request->hasArg("limit")) {
+        const int v = atoi(request->arg("limit").c_str());
+        ok = v >= 1 && v <= static_cast<int>(max_limit);
+        limit = static_cast<uint32_t>(v);
+      }
+      if (!ok || from > to) {
+        ft_send_error(request, 400,
+                      "from/to must be history times (negative: seconds before now), from <= to, "
+                      "resolution >= 1 s, limit 1-1500 (1-500 with resolution), "
+                      "points 3-500 without resolution, metric temp or pwm");
+        return;
+      }
+      // Rollups live in RAM; only raw samples need the flash partition.
+      if (resolution > 0) {
+        if (!ft_async_send(
+                request, ticket, ft_async_rollups,
+                [&](FtRollupStream &r) { r.setup(from, to, limit, static_cast<uint32_t>(resolution)); },
+                "application/json", nullptr, true))
+          ft_send_rollups(request, from, to, limit, static_cast<uint32_t>(resolution));
+        return;
+      }
+      if (!ft_history.mounted()) {
+        ft_send_error(request, 503, "history partition not available");
+        return;
+      }
+      if (points > 0) {
+        // Buckets before the oldest sample would only come back empty.
+        const uint32_t oldest = ft_history.oldest_t();
+        if (oldest != FT_HISTORY_NONE && oldest > from && oldest <= to) from = oldest;
+        if (ft_history_lttb_busy) {
+          ft_send_rejection(request, FT_ADMIT_BUSY, 1);
+          return;
+        }
+        if (!ft_async_send(
+                request, ticket, ft_async_lttb,
+                [&](FtLttbStream &l) { l.setup(from, to, static_cast<uint32_t>(points), metric); },
+                "application/json", nullptr, true))
+          ft_send_history_lttb(request, from, to, static_cast<uint32_t>(points), metric);
+      } else if (!ft_async_send(
+                   request, ticket, ft_async_history, [&](FtHistoryStream &h) { h.setup(from, to, limit); },
+                   "application/json", nullptr, true))
+        ft_send_history(request, from, to, limit);
       return;
     }
 
+    ft_metrics_http_request(FT_ROUTE_OTHER);
     auto *res = request->beginResponse(404, "application/json", "{}");
     request->send(res);
+    ft_metrics_http_response(404);
+  }
+
+ private:
+  FtApiConfig config_;  // config responses, httpd task only
+};
+
+#ifdef FT_UI_ENABLED
+// Serves the embedded UI. Files go out exactly as stored (gzip where it paid
+// off); content-hashed assets are cached for a year and the rest revalidate
+// against their ETag, so a reload normally costs one 304 for index.html.
+class FanForgeUiHandler : public AsyncWebHandler {
+ public:
+  bool canHandle(AsyncWebServerRequest *request) const override {
+    const http_method m = request->method();
+    if (m != HTTP_GET && m != HTTP_HEAD) return false;
+    const std::string url = request->url();
+    return url == "/ui" || ft_ui_find(FT_UI_ASSETS, FT_UI_ASSET_COUNT, url.c_str()) != nullptr;
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    FtAdmitTicket ticket(request, FT_ADMIT_COST, true);
+    if (!ticket.admitted()) return;
+    ft_metrics_http_request(FT_ROUTE_UI);
+    ft_power.note_ui(millis());
+    const std::string url = request->url();
+    if (url == "/ui") {
+      auto *res = request->beginResponse(301, "text/plain", "");
+      res->addHeader("Location", FT_UI_ROOT);
+      request->send(res);
+      ft_metrics_http_response(301);
+      return;
+    }
+    const FtUiAsset *asset = ft_ui_find(FT_UI_ASSETS, FT_UI_ASSET_COUNT, url.c_str());
+    // Only the gzip copy is in flash, and inflating it here would cost a 32 KiB
+    // window; a client that does not take gzip gets 406 instead of bytes it
+    // cannot read. Same Accept-Encoding rules as the compressed downloads.
+    if (asset->gzip) {
+      const auto accept_encoding = request->get_header("Accept-Encoding");
+      if (!accept_encoding.has_value() || ft_accept_encoding(accept_encoding->c_str()) != FT_ENCODING_GZIP) {
+        auto *res = request->beginResponse(406, "text/plain", "gzip required");
+        res->addHeader("Vary", "Accept-Encoding");
+        request->send(res);
+        ft_metrics_http_response(406);
+        return;
+      }
+    }
+    const auto if_none_match = request->get_header("If-None-Match");
+    const bool not_modified = if_none_match.has_value() && ft_ui_etag_matches(if_none_match->c_str(), asset->etag);
+    // Files past one chunk go out asynchronously rather than in one blocking send.
+    if (!not_modified && request->method() == HTTP_GET && asset->size > FT_ASYNC_CHUNK_BYTES) {
+      const char *headers[] = {"Cache-Control", asset->immutable ? FT_UI_CACHE_IMMUTABLE : FT_UI_CACHE_REVALIDATE,
+                               "ETag", asset->etag, asset->gzip ? "Content-Encoding" : nullptr, "gzip",
+                               "Vary", "Accept-Encoding", nullptr};
+      if (ft_async_send(
+              request, ticket, ft_async_bytes, [&](FtBytesStream &b) { b.setup(asset->data, asset->size); },
+              asset->content_type, headers))
+        return;
+    }
+    AsyncWebServerResponse *res;
+    if (not_modified) {
+      res = request->beginResponse(304, asset->content_type, "");
+    } else {
+      res = request->beginResponse_P(200, asset->content_type, asset->data, asset->size);
+      if (asset->gzip) res->addHeader("Content-Encoding", "gzip");
+    }
+    res->addHeader("Cache-Control", asset->immutable ? FT_UI_CACHE_IMMUTABLE : FT_UI_CACHE_REVALIDATE);
+    res->addHeader("ETag", asset->etag);
+    if (asset->gzip) res->addHeader("Vary", "Accept-Encoding");
+    request->send(res);
+    ft_metrics_http_response(not_modified ? 304 : 200);
   }
 };
+#endif
 
 static inline void fanforge_api_init() {
+  ft_ctl.stage_clock = ft_cycle_count;
+  ft_config_lock = xSemaphoreCreateMutex();
+  if (!ft_history_flash.begin()) {
+    ESP_LOGW("fanforge_api", "No \"history\" partition; /api/history disabled");
+  } else if (ft_history.mount(&ft_history_flash)) {
+    ESP_LOGI("fanforge_api", "History: %u segments, %u used, boot %u", static_cast<unsigned>(ft_history.segments()),
+             static_cast<unsigned>(ft_history.segments_used()), ft_history.boot());
+  } else {
+    ESP_LOGW("fanforge_api", "History partition unreadable or too small; /api/history disabled");
+  }
   auto *ws = global_web_server_base;
   if (ws == nullptr) {
     ESP_LOGW("fanforge_api", "web_server_base not initialized; API routes not registered");
     return;
   }
 
+#ifdef USE_MQTT
+  ft_mqtt_setup();
+#endif
   ws->add_handler(new FanForgeApiHandler());
-  ESP_LOGI("fanforge_api", "Registered /api/status and /api/config");
+  ESP_LOGI("fanforge_api", "Registered /api/status, /api/config, /api/trace, /api/history and /metrics");
+#ifdef FT_UI_ENABLED
+  ws->add_handler(new FanForgeUiHandler());
+  ESP_LOGI("fanforge_api", "Serving the UI at /ui/ (%u files, %u bytes in flash)",
+           static_cast<unsigned>(FT_UI_ASSET_COUNT), static_cast<unsigned>(FT_UI_TOTAL_BYTES));
+#endif
 }
 
 #endif  // USE_ESP32
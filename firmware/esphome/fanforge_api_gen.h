@@ -0,0 +1,942 @@
+#pragma once
+
+// Generated by host/codegen/gen_api.py from openapi/esp32-api.yaml; do not edit.
+//
+// API structs with presence bits, schema range tables, single-pass parsers
+// and direct writers. Parsers and writers are templates over the reader and
+// writer classes of fanforge_json.h (JSON) and fanforge_cbor.h (CBOR).
+// No ESPHome dependencies.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+struct FtApiRange {
+  float min;
+  float max;
+  constexpr bool contains(float v) const { return v >= this->min && v <= this->max; }
+};
+
+// Where a parse failed. Syntax errors carry the byte offset; schema errors the
+// field (and, inside arrays, the parent field and item index).
+struct FtApiError {
+  const char *message = nullptr;
+  const char *field = nullptr;
+  const char *parent = nullptr;
+  int index = -1;
+  int offset = -1;
+};
+
+// Index of the name s[0..n) in names, or -1.
+static inline int ft_api_enum_parse_(const char *const *names, uint8_t count, const char *s, size_t n) {
+  for (int i = 0; i < count; i++) {
+    if (strlen(names[i]) == n && memcmp(names[i], s, n) == 0) return i;
+  }
+  return -1;
+}
+
+template<typename R>
+static inline bool ft_api_fail_(const R &r, FtApiError &err, const char *field, const char *message) {
+  err = FtApiError{};
+  if (!r.ok()) {
+    // A syntax error wins over the type check that tripped on it.
+    err.message = r.error();
+    err.offset = static_cast<int>(r.offset());
+  } else {
+    err.field = field;
+    err.message = message;
+  }
+  return false;
+}
+
+static inline bool ft_api_nest_(FtApiError &err, const char *parent, int index) {
+  if (err.offset < 0) {
+    err.parent = parent;
+    err.index = index;
+  }
+  return false;
+}
+
+static inline bool ft_api_require_(FtApiError &err, uint32_t present, uint32_t required, const char *const *fields) {
+  const uint32_t missing = required & ~present;
+  if (missing == 0) return true;
+  int i = 0;
+  while (!(missing & (1u << i))) i++;
+  err = FtApiError{};
+  err.field = fields[i];
+  err.message = "is required";
+  return false;
+}
+
+// "points[2].p must be a number within 0..100", "mode is required", ...
+// syntax names the wire format in syntax errors ("JSON", "CBOR").
+static inline void ft_api_format_error(const FtApiError &e, char *buf, size_t cap, const char *syntax = "JSON") {
+  const char *msg = e.message != nullptr ? e.message : "is invalid";
+  if (e.offset >= 0)
+    snprintf(buf, cap, "invalid %s at offset %d: %s", syntax, e.offset, msg);
+  else if (e.parent != nullptr && e.field != nullptr)
+    snprintf(buf, cap, "%s[%d].%s %s", e.parent, e.index, e.field, msg);
+  else if (e.parent != nullptr)
+    snprintf(buf, cap, "%s[%d] %s", e.parent, e.index, msg);
+  else if (e.field != nullptr)
+    snprintf(buf, cap, "%s %s", e.field, msg);
+  else
+    snprintf(buf, cap, "body %s", msg);
+}
+
+enum FtApiMode : uint8_t {
+  FT_API_MODE_AUTO = 0,
+  FT_API_MODE_MANUAL = 1,
+  FT_API_MODE_OFF = 2,
+};
+static constexpr uint8_t FT_API_MODE_COUNT = 3;
+static constexpr const char *FT_API_MODE_NAMES[] = {"auto", "manual", "off"};
+
+static inline const char *ft_api_mode_name(FtApiMode v) {
+  return FT_API_MODE_NAMES[v < FT_API_MODE_COUNT ? v : 0];
+}
+static inline int ft_api_mode_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_MODE_NAMES, FT_API_MODE_COUNT, s, n);
+}
+
+enum FtApiSmoothingMode : uint8_t {
+  FT_API_SMOOTHING_MODE_LINEAR = 0,
+  FT_API_SMOOTHING_MODE_SMOOTH = 1,
+};
+static constexpr uint8_t FT_API_SMOOTHING_MODE_COUNT = 2;
+static constexpr const char *FT_API_SMOOTHING_MODE_NAMES[] = {"linear", "smooth"};
+
+static inline const char *ft_api_smoothing_mode_name(FtApiSmoothingMode v) {
+  return FT_API_SMOOTHING_MODE_NAMES[v < FT_API_SMOOTHING_MODE_COUNT ? v : 0];
+}
+static inline int ft_api_smoothing_mode_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_SMOOTHING_MODE_NAMES, FT_API_SMOOTHING_MODE_COUNT, s, n);
+}
+
+enum FtApiConfigFfBlend : uint8_t {
+  FT_API_CONFIG_FF_BLEND_MAX = 0,
+  FT_API_CONFIG_FF_BLEND_ADD = 1,
+};
+static constexpr uint8_t FT_API_CONFIG_FF_BLEND_COUNT = 2;
+static constexpr const char *FT_API_CONFIG_FF_BLEND_NAMES[] = {"max", "add"};
+
+static inline const char *ft_api_config_ff_blend_name(FtApiConfigFfBlend v) {
+  return FT_API_CONFIG_FF_BLEND_NAMES[v < FT_API_CONFIG_FF_BLEND_COUNT ? v : 0];
+}
+static inline int ft_api_config_ff_blend_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_CONFIG_FF_BLEND_NAMES, FT_API_CONFIG_FF_BLEND_COUNT, s, n);
+}
+
+enum FtApiConfigRackAggregate : uint8_t {
+  FT_API_CONFIG_RACK_AGGREGATE_OFF = 0,
+  FT_API_CONFIG_RACK_AGGREGATE_MAX = 1,
+  FT_API_CONFIG_RACK_AGGREGATE_MEAN = 2,
+};
+static constexpr uint8_t FT_API_CONFIG_RACK_AGGREGATE_COUNT = 3;
+static constexpr const char *FT_API_CONFIG_RACK_AGGREGATE_NAMES[] = {"off", "max", "mean"};
+
+static inline const char *ft_api_config_rack_aggregate_name(FtApiConfigRackAggregate v) {
+  return FT_API_CONFIG_RACK_AGGREGATE_NAMES[v < FT_API_CONFIG_RACK_AGGREGATE_COUNT ? v : 0];
+}
+static inline int ft_api_config_rack_aggregate_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_CONFIG_RACK_AGGREGATE_NAMES, FT_API_CONFIG_RACK_AGGREGATE_COUNT, s, n);
+}
+
+enum FtApiConfigPowerMode : uint8_t {
+  FT_API_CONFIG_POWER_MODE_FULL = 0,
+  FT_API_CONFIG_POWER_MODE_MODEM = 1,
+  FT_API_CONFIG_POWER_MODE_LIGHT = 2,
+};
+static constexpr uint8_t FT_API_CONFIG_POWER_MODE_COUNT = 3;
+static constexpr const char *FT_API_CONFIG_POWER_MODE_NAMES[] = {"full", "modem", "light"};
+
+static inline const char *ft_api_config_power_mode_name(FtApiConfigPowerMode v) {
+  return FT_API_CONFIG_POWER_MODE_NAMES[v < FT_API_CONFIG_POWER_MODE_COUNT ? v : 0];
+}
+static inline int ft_api_config_power_mode_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_CONFIG_POWER_MODE_NAMES, FT_API_CONFIG_POWER_MODE_COUNT, s, n);
+}
+
+enum FtApiStatusResponseTempSourceActive : uint8_t {
+  FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_LOCAL = 0,
+  FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_EXTERNAL = 1,
+};
+static constexpr uint8_t FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_COUNT = 2;
+static constexpr const char *FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_NAMES[] = {"local", "external"};
+
+static inline const char *ft_api_status_response_temp_source_active_name(FtApiStatusResponseTempSourceActive v) {
+  return FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_NAMES[v < FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_COUNT ? v : 0];
+}
+static inline int ft_api_status_response_temp_source_active_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_NAMES, FT_API_STATUS_RESPONSE_TEMP_SOURCE_ACTIVE_COUNT, s, n);
+}
+
+enum FtApiStatusResponsePowerState : uint8_t {
+  FT_API_STATUS_RESPONSE_POWER_STATE_FULL = 0,
+  FT_API_STATUS_RESPONSE_POWER_STATE_LOW = 1,
+};
+static constexpr uint8_t FT_API_STATUS_RESPONSE_POWER_STATE_COUNT = 2;
+static constexpr const char *FT_API_STATUS_RESPONSE_POWER_STATE_NAMES[] = {"full", "low"};
+
+static inline const char *ft_api_status_response_power_state_name(FtApiStatusResponsePowerState v) {
+  return FT_API_STATUS_RESPONSE_POWER_STATE_NAMES[v < FT_API_STATUS_RESPONSE_POWER_STATE_COUNT ? v : 0];
+}
+static inline int ft_api_status_response_power_state_parse(const char *s, size_t n) {
+  return ft_api_enum_parse_(FT_API_STATUS_RESPONSE_POWER_STATE_NAMES, FT_API_STATUS_RESPONSE_POWER_STATE_COUNT, s, n);
+}
+
+// --- CurvePoint --------------------------------------------------------------
+
+enum FtApiCurvePointKey : uint8_t {
+  FT_API_CURVE_POINT_K_T = 0,
+  FT_API_CURVE_POINT_K_P = 1,
+  FT_API_CURVE_POINT_K_UNKNOWN = 2,
+};
+static constexpr uint32_t FT_API_CURVE_POINT_HAS_T = 1u << 0;
+static constexpr uint32_t FT_API_CURVE_POINT_HAS_P = 1u << 1;
+static constexpr uint32_t FT_API_CURVE_POINT_REQUIRED = FT_API_CURVE_POINT_HAS_T | FT_API_CURVE_POINT_HAS_P;
+static constexpr uint32_t FT_API_CURVE_POINT_ALL = 0x3u;
+static constexpr const char *FT_API_CURVE_POINT_FIELDS[] = {"t", "p"};
+
+static constexpr FtApiRange FT_API_CURVE_POINT_T_RANGE = {0.0f, 120.0f};
+static constexpr FtApiRange FT_API_CURVE_POINT_P_RANGE = {0.0f, 100.0f};
+
+struct FtApiCurvePoint {
+  uint32_t present = 0;  // FT_API_CURVE_POINT_HAS_* bits
+  float t = 0.0f;
+  float p = 0.0f;
+};
+
+static inline FtApiCurvePointKey ft_api_curve_point_key(const char *k, size_t n) {
+  switch (n) {
+    case 1:
+      if (memcmp(k, "t", 1) == 0) return FT_API_CURVE_POINT_K_T;
+      if (memcmp(k, "p", 1) == 0) return FT_API_CURVE_POINT_K_P;
+      break;
+  }
+  return FT_API_CURVE_POINT_K_UNKNOWN;
+}
+
+// Reads one CurvePoint object. Unknown keys are skipped; out.present records what was
+// given. On failure err names the first offending field.
+template<typename R> static inline bool ft_api_parse_curve_point(R &r, FtApiCurvePoint &out, FtApiError &err) {
+  out.present = 0;
+  if (!r.begin_object()) return ft_api_fail_(r, err, nullptr, "must be an object");
+  const char *key;
+  size_t key_len;
+  while (r.next_key(key, key_len)) {
+    switch (ft_api_curve_point_key(key, key_len)) {
+      case FT_API_CURVE_POINT_K_T: {
+        if (!r.read_number(out.t) || !FT_API_CURVE_POINT_T_RANGE.contains(out.t))
+          return ft_api_fail_(r, err, "t", "must be a number within 0..120");
+        out.present |= FT_API_CURVE_POINT_HAS_T;
+        break;
+      }
+      case FT_API_CURVE_POINT_K_P: {
+        if (!r.read_number(out.p) || !FT_API_CURVE_POINT_P_RANGE.contains(out.p))
+          return ft_api_fail_(r, err, "p", "must be a number within 0..100");
+        out.present |= FT_API_CURVE_POINT_HAS_P;
+        break;
+      }
+      default:
+        if (!r.skip_value()) return ft_api_fail_(r, err, nullptr, "is malformed");
+        break;
+    }
+  }
+  if (!r.ok()) return ft_api_fail_(r, err, nullptr, nullptr);
+  return ft_api_require_(err, out.present, FT_API_CURVE_POINT_REQUIRED, FT_API_CURVE_POINT_FIELDS);
+}
+
+// Writes the fields in v.present, in schema order.
+template<typename W> static inline void ft_api_write_curve_point(W &w, const FtApiCurvePoint &v) {
+  w.begin_object();
+  if (v.present & FT_API_CURVE_POINT_HAS_T) {
+    w.key("t");
+    w.value(v.t);
+  }
+  if (v.present & FT_API_CURVE_POINT_HAS_P) {
+    w.key("p");
+    w.value(v.p);
+  }
+  w.end_object();
+}
+
+// --- Config ------------------------------------------------------------------
+
+enum FtApiConfigKey : uint8_t {
+  FT_API_CONFIG_K_MODE = 0,
+  FT_API_CONFIG_K_SMOOTHING_MODE = 1,
+  FT_API_CONFIG_K_POINTS = 2,
+  FT_API_CONFIG_K_MANUAL_PWM = 3,
+  FT_API_CONFIG_K_MIN_PWM = 4,
+  FT_API_CONFIG_K_MAX_PWM = 5,
+  FT_API_CONFIG_K_CURVE_MIN = 6,
+  FT_API_CONFIG_K_CURVE_MAX = 7,
+  FT_API_CONFIG_K_SLEW_PCT_PER_SEC = 8,
+  FT_API_CONFIG_K_FAILSAFE_TEMP = 9,
+  FT_API_CONFIG_K_FAILSAFE_PWM = 10,
+  FT_API_CONFIG_K_TEMP_SOURCE = 11,
+  FT_API_CONFIG_K_FF_SOURCE = 12,
+  FT_API_CONFIG_K_FF_POINTS = 13,
+  FT_API_CONFIG_K_FALLING_POINTS = 14,
+  FT_API_CONFIG_K_FF_BLEND = 15,
+  FT_API_CONFIG_K_FF_DECAY_S = 16,
+  FT_API_CONFIG_K_RULES = 17,
+  FT_API_CONFIG_K_RACK_AGGREGATE = 18,
+  FT_API_CONFIG_K_RACK_WEIGHT = 19,
+  FT_API_CONFIG_K_RACK_STALE_S = 20,
+  FT_API_CONFIG_K_POWER_MODE = 21,
+  FT_API_CONFIG_K_POWER_UI_HOLD_S = 22,
+  FT_API_CONFIG_K_HTTP_RATE_PER_S = 23,
+  FT_API_CONFIG_K_HTTP_BURST = 24,
+  FT_API_CONFIG_K_UNKNOWN = 25,
+};
+static constexpr uint32_t FT_API_CONFIG_HAS_MODE = 1u << 0;
+static constexpr uint32_t FT_API_CONFIG_HAS_SMOOTHING_MODE = 1u << 1;
+static constexpr uint32_t FT_API_CONFIG_HAS_POINTS = 1u << 2;
+static constexpr uint32_t FT_API_CONFIG_HAS_MANUAL_PWM = 1u << 3;
+static constexpr uint32_t FT_API_CONFIG_HAS_MIN_PWM = 1u << 4;
+static constexpr uint32_t FT_API_CONFIG_HAS_MAX_PWM = 1u << 5;
+static constexpr uint32_t FT_API_CONFIG_HAS_CURVE_MIN = 1u << 6;
+static constexpr uint32_t FT_API_CONFIG_HAS_CURVE_MAX = 1u << 7;
+static constexpr uint32_t FT_API_CONFIG_HAS_SLEW_PCT_PER_SEC = 1u << 8;
+static constexpr uint32_t FT_API_CONFIG_HAS_FAILSAFE_TEMP = 1u << 9;
+static constexpr uint32_t FT_API_CONFIG_HAS_FAILSAFE_PWM = 1u << 10;
+static constexpr uint32_t FT_API_CONFIG_HAS_TEMP_SOURCE = 1u << 11;
+static constexpr uint32_t FT_API_CONFIG_HAS_FF_SOURCE = 1u << 12;
+static constexpr uint32_t FT_API_CONFIG_HAS_FF_POINTS = 1u << 13;
+static constexpr uint32_t FT_API_CONFIG_HAS_FALLING_POINTS = 1u << 14;
+static constexpr uint32_t FT_API_CONFIG_HAS_FF_BLEND = 1u << 15;
+static constexpr uint32_t FT_API_CONFIG_HAS_FF_DECAY_S = 1u << 16;
+static constexpr uint32_t FT_API_CONFIG_HAS_RULES = 1u << 17;
+static constexpr uint32_t FT_API_CONFIG_HAS_RACK_AGGREGATE = 1u << 18;
+static constexpr uint32_t FT_API_CONFIG_HAS_RACK_WEIGHT = 1u << 19;
+static constexpr uint32_t FT_API_CONFIG_HAS_RACK_STALE_S = 1u << 20;
+static constexpr uint32_t FT_API_CONFIG_HAS_POWER_MODE = 1u << 21;
+static constexpr uint32_t FT_API_CONFIG_HAS_POWER_UI_HOLD_S = 1u << 22;
+static constexpr uint32_t FT_API_CONFIG_HAS_HTTP_RATE_PER_S = 1u << 23;
+static constexpr uint32_t FT_API_CONFIG_HAS_HTTP_BURST = 1u << 24;
+static constexpr uint32_t FT_API_CONFIG_REQUIRED = FT_API_CONFIG_HAS_MODE | FT_API_CONFIG_HAS_SMOOTHING_MODE |
+    FT_API_CONFIG_HAS_POINTS | FT_API_CONFIG_HAS_MIN_PWM | FT_API_CONFIG_HAS_MAX_PWM |
+    FT_API_CONFIG_HAS_SLEW_PCT_PER_SEC | FT_API_CONFIG_HAS_FAILSAFE_TEMP | FT_API_CONFIG_HAS_FAILSAFE_PWM;
+static constexpr uint32_t FT_API_CONFIG_ALL = 0x1ffffffu;
+static constexpr const char *FT_API_CONFIG_FIELDS[] = {"mode", "smoothing_mode", "points", "manual_pwm", "min_pwm",
+    "max_pwm", "curve_min", "curve_max", "slew_pct_per_sec", "failsafe_temp", "failsafe_pwm", "temp_source",
+    "ff_source", "ff_points", "falling_points", "ff_blend", "ff_decay_s", "rules", "rack_aggregate", "rack_weight",
+    "rack_stale_s", "power_mode", "power_ui_hold_s", "http_rate_per_s", "http_burst"};
+
+static constexpr uint8_t FT_API_CONFIG_POINTS_MIN_ITEMS = 2;
+static constexpr uint8_t FT_API_CONFIG_POINTS_MAX_ITEMS = 16;
+static constexpr FtApiRange FT_API_CONFIG_MANUAL_PWM_RANGE = {0.0f, 100.0f};
+static constexpr FtApiRange FT_API_CONFIG_MIN_PWM_RANGE = {0.0f, 100.0f};
+static constexpr FtApiRange FT_API_CONFIG_MAX_PWM_RANGE = {0.0f, 100.0f};
+static constexpr FtApiRange FT_API_CONFIG_CURVE_MIN_RANGE = {15.0f, 50.0f};
+static constexpr FtApiRange FT_API_CONFIG_CURVE_MAX_RANGE = {15.0f, 50.0f};
+static constexpr FtApiRange FT_API_CONFIG_SLEW_PCT_PER_SEC_RANGE = {0.0f, 100.0f};
+static constexpr FtApiRange FT_API_CONFIG_FAILSAFE_TEMP_RANGE = {0.0f, 120.0f};
+static constexpr FtApiRange FT_API_CONFIG_FAILSAFE_PWM_RANGE = {0.0f, 100.0f};
+static constexpr FtApiRange FT_API_CONFIG_TEMP_SOURCE_RANGE = {0.0f, 255.0f};
+static constexpr FtApiRange FT_API_CONFIG_FF_SOURCE_RANGE = {0.0f, 255.0f};
+static constexpr uint8_t FT_API_CONFIG_FF_POINTS_MIN_ITEMS = 2;
+static constexpr uint8_t FT_API_CONFIG_FF_POINTS_MAX_ITEMS = 16;
+static constexpr uint8_t FT_API_CONFIG_FALLING_POINTS_MIN_ITEMS = 0;
+static constexpr uint8_t FT_API_CONFIG_FALLING_POINTS_MAX_ITEMS = 16;
+static constexpr FtApiRange FT_API_CONFIG_FF_DECAY_S_RANGE = {0.0f, 600.0f};
+static constexpr size_t FT_API_CONFIG_RULES_MAX_LENGTH = 254;
+static constexpr FtApiRange FT_API_CONFIG_RACK_WEIGHT_RANGE = {0.0f, 255.0f};
+static constexpr FtApiRange FT_API_CONFIG_RACK_STALE_S_RANGE = {1.0f, 60.0f};
+static constexpr FtApiRange FT_API_CONFIG_POWER_UI_HOLD_S_RANGE = {0.0f, 3600.0f};
+static constexpr FtApiRange FT_API_CONFIG_HTTP_RATE_PER_S_RANGE = {0.0f, 100.0f};
+static constexpr FtApiRange FT_API_CONFIG_HTTP_BURST_RANGE = {1.0f, 100.0f};
+
+struct FtApiConfig {
+  uint32_t present = 0;  // FT_API_CONFIG_HAS_* bits
+  FtApiMode mode = static_cast<FtApiMode>(0);
+  FtApiSmoothingMode smoothing_mode = static_cast<FtApiSmoothingMode>(0);
+  FtApiCurvePoint points[FT_API_CONFIG_POINTS_MAX_ITEMS];
+  uint8_t points_count = 0;
+  float manual_pwm = 0.0f;
+  float min_pwm = 0.0f;
+  float max_pwm = 0.0f;
+  float curve_min = 0.0f;
+  float curve_max = 0.0f;
+  float slew_pct_per_sec = 0.0f;
+  float failsafe_temp = 0.0f;
+  float failsafe_pwm = 0.0f;
+  int32_t temp_source = 0;
+  int32_t ff_source = 0;
+  FtApiCurvePoint ff_points[FT_API_CONFIG_FF_POINTS_MAX_ITEMS];
+  uint8_t ff_points_count = 0;
+  FtApiCurvePoint falling_points[FT_API_CONFIG_FALLING_POINTS_MAX_ITEMS];
+  uint8_t falling_points_count = 0;
+  FtApiConfigFfBlend ff_blend = static_cast<FtApiConfigFfBlend>(0);
+  float ff_decay_s = 0.0f;
+  char rules[FT_API_CONFIG_RULES_MAX_LENGTH + 1] = {};  // NUL terminated
+  FtApiConfigRackAggregate rack_aggregate = static_cast<FtApiConfigRackAggregate>(0);
+  int32_t rack_weight = 0;
+  float rack_stale_s = 0.0f;
+  FtApiConfigPowerMode power_mode = static_cast<FtApiConfigPowerMode>(0);
+  float power_ui_hold_s = 0.0f;
+  float http_rate_per_s = 0.0f;
+  int32_t http_burst = 0;
+};
+
+static inline FtApiConfigKey ft_api_config_key(const char *k, size_t n) {
+  switch (n) {
+    case 4:
+      if (memcmp(k, "mode", 4) == 0) return FT_API_CONFIG_K_MODE;
+      break;
+    case 5:
+      if (memcmp(k, "rules", 5) == 0) return FT_API_CONFIG_K_RULES;
+      break;
+    case 6:
+      if (memcmp(k, "points", 6) == 0) return FT_API_CONFIG_K_POINTS;
+      break;
+    case 7:
+      if (memcmp(k, "min_pwm", 7) == 0) return FT_API_CONFIG_K_MIN_PWM;
+      if (memcmp(k, "max_pwm", 7) == 0) return FT_API_CONFIG_K_MAX_PWM;
+      break;
+    case 8:
+      if (memcmp(k, "ff_blend", 8) == 0) return FT_API_CONFIG_K_FF_BLEND;
+      break;
+    case 9:
+      if (memcmp(k, "curve_min", 9) == 0) return FT_API_CONFIG_K_CURVE_MIN;
+      if (memcmp(k, "curve_max", 9) == 0) return FT_API_CONFIG_K_CURVE_MAX;
+      if (memcmp(k, "ff_source", 9) == 0) return FT_API_CONFIG_K_FF_SOURCE;
+      if (memcmp(k, "ff_points", 9) == 0) return FT_API_CONFIG_K_FF_POINTS;
+      break;
+    case 10:
+      if (memcmp(k, "manual_pwm", 10) == 0) return FT_API_CONFIG_K_MANUAL_PWM;
+      if (memcmp(k, "ff_decay_s", 10) == 0) return FT_API_CONFIG_K_FF_DECAY_S;
+      if (memcmp(k, "power_mode", 10) == 0) return FT_API_CONFIG_K_POWER_MODE;
+      if (memcmp(k, "http_burst", 10) == 0) return FT_API_CONFIG_K_HTTP_BURST;
+      break;
+    case 11:
+      if (memcmp(k, "temp_source", 11) == 0) return FT_API_CONFIG_K_TEMP_SOURCE;
+      if (memcmp(k, "rack_weight", 11) == 0) return FT_API_CONFIG_K_RACK_WEIGHT;
+      break;
+    case 12:
+      if (memcmp(k, "failsafe_pwm", 12) == 0) return FT_API_CONFIG_K_FAILSAFE_PWM;
+      if (memcmp(k, "rack_stale_s", 12) == 0) return FT_API_CONFIG_K_RACK_STALE_S;
+      break;
+    case 13:
+      if (memcmp(k, "failsafe_temp", 13) == 0) return FT_API_CONFIG_K_FAILSAFE_TEMP;
+      break;
+    case 14:
+      if (memcmp(k, "smoothing_mode", 14) == 0) return FT_API_CONFIG_K_SMOOTHING_MODE;
+      if (memcmp(k, "falling_points", 14) == 0) return FT_API_CONFIG_K_FALLING_POINTS;
+      if (memcmp(k, "rack_aggregate", 14) == 0) return FT_API_CONFIG_K_RACK_AGGREGATE;
+      break;
+    case 15:
+      if (memcmp(k, "power_ui_hold_s", 15) == 0) return FT_API_CONFIG_K_POWER_UI_HOLD_S;
+      if (memcmp(k, "http_rate_per_s", 15) == 0) return FT_API_CONFIG_K_HTTP_RATE_PER_S;
+      break;
+    case 16:
+      if (memcmp(k, "slew_pct_per_sec", 16) == 0) return FT_API_CONFIG_K_SLEW_PCT_PER_SEC;
+      break;
+  }
+  return FT_API_CONFIG_K_UNKNOWN;
+}
+
+// Reads one Config object. Unknown keys are skipped; out.present records what was
+// given. On failure err names the first offending field.
+template<typename R> static inline bool ft_api_parse_config(R &r, FtApiConfig &out, FtApiError &err) {
+  out.present = 0;
+  if (!r.begin_object()) return ft_api_fail_(r, err, nullptr, "must be an object");
+  const char *key;
+  size_t key_len;
+  while (r.next_key(key, key_len)) {
+    switch (ft_api_config_key(key, key_len)) {
+      case FT_API_CONFIG_K_MODE: {
+        const char *s;
+        size_t len;
+        const int v = r.read_string(s, len) ? ft_api_mode_parse(s, len) : -1;
+        if (v < 0) return ft_api_fail_(r, err, "mode", "must be one of auto, manual, off");
+        out.mode = static_cast<FtApiMode>(v);
+        out.present |= FT_API_CONFIG_HAS_MODE;
+        break;
+      }
+      case FT_API_CONFIG_K_SMOOTHING_MODE: {
+        const char *s;
+        size_t len;
+        const int v = r.read_string(s, len) ? ft_api_smoothing_mode_parse(s, len) : -1;
+        if (v < 0) return ft_api_fail_(r, err, "smoothing_mode", "must be one of linear, smooth");
+        out.smoothing_mode = static_cast<FtApiSmoothingMode>(v);
+        out.present |= FT_API_CONFIG_HAS_SMOOTHING_MODE;
+        break;
+      }
+      case FT_API_CONFIG_K_POINTS: {
+        if (!r.begin_array()) return ft_api_fail_(r, err, "points", "must be an array of 2..16 items");
+        out.points_count = 0;
+        while (r.next_item()) {
+          if (out.points_count >= FT_API_CONFIG_POINTS_MAX_ITEMS)
+            return ft_api_fail_(r, err, "points", "must be an array of 2..16 items");
+          if (!ft_api_parse_curve_point(r, out.points[out.points_count], err))
+            return ft_api_nest_(err, "points", out.points_count);
+          out.points_count++;
+        }
+        if (!r.ok() || out.points_count < FT_API_CONFIG_POINTS_MIN_ITEMS)
+          return ft_api_fail_(r, err, "points", "must be an array of 2..16 items");
+        out.present |= FT_API_CONFIG_HAS_POINTS;
+        break;
+      }
+      case FT_API_CONFIG_K_MANUAL_PWM: {
+        if (!r.read_number(out.manual_pwm) || !FT_API_CONFIG_MANUAL_PWM_RANGE.contains(out.manual_pwm))
+          return ft_api_fail_(r, err, "manual_pwm", "must be a number within 0..100");
+        out.present |= FT_API_CONFIG_HAS_MANUAL_PWM;
+        break;
+      }
+      case FT_API_CONFIG_K_MIN_PWM: {
+        if (!r.read_number(out.min_pwm) || !FT_API_CONFIG_MIN_PWM_RANGE.contains(out.min_pwm))
+          return ft_api_fail_(r, err, "min_pwm", "must be a number within 0..100");
+        out.present |= FT_API_CONFIG_HAS_MIN_PWM;
+        break;
+      }
+      case FT_API_CONFIG_K_MAX_PWM: {
+        if (!r.read_number(out.max_pwm) || !FT_API_CONFIG_MAX_PWM_RANGE.contains(out.max_pwm))
+          return ft_api_fail_(r, err, "max_pwm", "must be a number within 0..100");
+        out.present |= FT_API_CONFIG_HAS_MAX_PWM;
+        break;
+      }
+      case FT_API_CONFIG_K_CURVE_MIN: {
+        if (!r.read_number(out.curve_min) || !FT_API_CONFIG_CURVE_MIN_RANGE.contains(out.curve_min))
+          return ft_api_fail_(r, err, "curve_min", "must be a number within 15..50");
+        out.present |= FT_API_CONFIG_HAS_CURVE_MIN;
+        break;
+      }
+      case FT_API_CONFIG_K_CURVE_MAX: {
+        if (!r.read_number(out.curve_max) || !FT_API_CONFIG_CURVE_MAX_RANGE.contains(out.curve_max))
+          return ft_api_fail_(r, err, "curve_max", "must be a number within 15..50");
+        out.present |= FT_API_CONFIG_HAS_CURVE_MAX;
+        break;
+      }
+      case FT_API_CONFIG_K_SLEW_PCT_PER_SEC: {
+        if (!r.read_number(out.slew_pct_per_sec) || !FT_API_CONFIG_SLEW_PCT_PER_SEC_RANGE.contains(out.slew_pct_per_sec))
+          return ft_api_fail_(r, err, "slew_pct_per_sec", "must be a number within 0..100");
+        out.present |= FT_API_CONFIG_HAS_SLEW_PCT_PER_SEC;
+        break;
+      }
+      case FT_API_CONFIG_K_FAILSAFE_TEMP: {
+        if (!r.read_number(out.failsafe_temp) || !FT_API_CONFIG_FAILSAFE_TEMP_RANGE.contains(out.failsafe_temp))
+          return ft_api_fail_(r, err, "failsafe_temp", "must be a number within 0..120");
+        out.present |= FT_API_CONFIG_HAS_FAILSAFE_TEMP;
+        break;
+      }
+      case FT_API_CONFIG_K_FAILSAFE_PWM: {
+        if (!r.read_number(out.failsafe_pwm) || !FT_API_CONFIG_FAILSAFE_PWM_RANGE.contains(out.failsafe_pwm))
+          return ft_api_fail_(r, err, "failsafe_pwm", "must be a number within 0..100");
+        out.present |= FT_API_CONFIG_HAS_FAILSAFE_PWM;
+        break;
+      }
+      case FT_API_CONFIG_K_TEMP_SOURCE: {
+        int64_t v;
+        if (!r.read_int(v) || !FT_API_CONFIG_TEMP_SOURCE_RANGE.contains(static_cast<float>(v)))
+          return ft_api_fail_(r, err, "temp_source", "must be an integer within 0..255");
+        out.temp_source = static_cast<int32_t>(v);
+        out.present |= FT_API_CONFIG_HAS_TEMP_SOURCE;
+        break;
+      }
+      case FT_API_CONFIG_K_FF_SOURCE: {
+        int64_t v;
+        if (!r.read_int(v) || !FT_API_CONFIG_FF_SOURCE_RANGE.contains(static_cast<float>(v)))
+          return ft_api_fail_(r, err, "ff_source", "must be an integer within 0..255");
+        out.ff_source = static_cast<int32_t>(v);
+        out.present |= FT_API_CONFIG_HAS_FF_SOURCE;
+        break;
+      }
+      case FT_API_CONFIG_K_FF_POINTS: {
+        if (!r.begin_array()) return ft_api_fail_(r, err, "ff_points", "must be an array of 2..16 items");
+        out.ff_points_count = 0;
+        while (r.next_item()) {
+          if (out.ff_points_count >= FT_API_CONFIG_FF_POINTS_MAX_ITEMS)
+            return ft_api_fail_(r, err, "ff_points", "must be an array of 2..16 items");
+          if (!ft_api_parse_curve_point(r, out.ff_points[out.ff_points_count], err))
+            return ft_api_nest_(err, "ff_points", out.ff_points_count);
+          out.ff_points_count++;
+        }
+        if (!r.ok() || out.ff_points_count < FT_API_CONFIG_FF_POINTS_MIN_ITEMS)
+          return ft_api_fail_(r, err, "ff_points", "must be an array of 2..16 items");
+        out.present |= FT_API_CONFIG_HAS_FF_POINTS;
+        break;
+      }
+      case FT_API_CONFIG_K_FALLING_POINTS: {
+        if (!r.begin_array()) return ft_api_fail_(r, err, "falling_points", "must be an array of 0..16 items");
+        out.falling_points_count = 0;
+        while (r.next_item()) {
+          if (out.falling_points_count >= FT_API_CONFIG_FALLING_POINTS_MAX_ITEMS)
+            return ft_api_fail_(r, err, "falling_points", "must be an array of 0..16 items");
+          if (!ft_api_parse_curve_point(r, out.falling_points[out.falling_points_count], err))
+            return ft_api_nest_(err, "falling_points", out.falling_points_count);
+          out.falling_points_count++;
+        }
+        if (!r.ok() || out.falling_points_count < FT_API_CONFIG_FALLING_POINTS_MIN_ITEMS)
+          return ft_api_fail_(r, err, "falling_points", "must be an array of 0..16 items");
+        out.present |= FT_API_CONFIG_HAS_FALLING_POINTS;
+        break;
+      }
+      case FT_API_CONFIG_K_FF_BLEND: {
+        const char *s;
+        size_t len;
+        const int v = r.read_string(s, len) ? ft_api_config_ff_blend_parse(s, len) : -1;
+        if (v < 0) return ft_api_fail_(r, err, "ff_blend", "must be one of max, add");
+        out.ff_blend = static_cast<FtApiConfigFfBlend>(v);
+        out.present |= FT_API_CONFIG_HAS_FF_BLEND;
+        break;
+      }
+      case FT_API_CONFIG_K_FF_DECAY_S: {
+        if (!r.read_number(out.ff_decay_s) || !FT_API_CONFIG_FF_DECAY_S_RANGE.contains(out.ff_decay_s))
+          return ft_api_fail_(r, err, "ff_decay_s", "must be a number within 0..600");
+        out.present |= FT_API_CONFIG_HAS_FF_DECAY_S;
+        break;
+      }
+      case FT_API_CONFIG_K_RULES: {
+        if (!r.read_text(out.rules, sizeof(out.rules)))
+          return ft_api_fail_(r, err, "rules", "must be a string of at most 254 bytes");
+        out.present |= FT_API_CONFIG_HAS_RULES;
+        break;
+      }
+      case FT_API_CONFIG_K_RACK_AGGREGATE: {
+        const char *s;
+        size_t len;
+        const int v = r.read_string(s, len) ? ft_api_config_rack_aggregate_parse(s, len) : -1;
+        if (v < 0) return ft_api_fail_(r, err, "rack_aggregate", "must be one of off, max, mean");
+        out.rack_aggregate = static_cast<FtApiConfigRackAggregate>(v);
+        out.present |= FT_API_CONFIG_HAS_RACK_AGGREGATE;
+        break;
+      }
+      case FT_API_CONFIG_K_RACK_WEIGHT: {
+        int64_t v;
+        if (!r.read_int(v) || !FT_API_CONFIG_RACK_WEIGHT_RANGE.contains(static_cast<float>(v)))
+          return ft_api_fail_(r, err, "rack_weight", "must be an integer within 0..255");
+        out.rack_weight = static_cast<int32_t>(v);
+        out.present |= FT_API_CONFIG_HAS_RACK_WEIGHT;
+        break;
+      }
+      case FT_API_CONFIG_K_RACK_STALE_S: {
+        if (!r.read_number(out.rack_stale_s) || !FT_API_CONFIG_RACK_STALE_S_RANGE.contains(out.rack_stale_s))
+          return ft_api_fail_(r, err, "rack_stale_s", "must be a number within 1..60");
+        out.present |= FT_API_CONFIG_HAS_RACK_STALE_S;
+        break;
+      }
+      case FT_API_CONFIG_K_POWER_MODE: {
+        const char *s;
+        size_t len;
+        const int v = r.read_string(s, len) ? ft_api_config_power_mode_parse(s, len) : -1;
+        if (v < 0) return ft_api_fail_(r, err, "power_mode", "must be one of full, modem, light");
+        out.power_mode = static_cast<FtApiConfigPowerMode>(v);
+        out.present |= FT_API_CONFIG_HAS_POWER_MODE;
+        break;
+      }
+      case FT_API_CONFIG_K_POWER_UI_HOLD_S: {
+        if (!r.read_number(out.power_ui_hold_s) || !FT_API_CONFIG_POWER_UI_HOLD_S_RANGE.contains(out.power_ui_hold_s))
+          return ft_api_fail_(r, err, "power_ui_hold_s", "must be a number within 0..3600");
+        out.present |= FT_API_CONFIG_HAS_POWER_UI_HOLD_S;
+        break;
+      }
+      case FT_API_CONFIG_K_HTTP_RATE_PER_S: {
+        if (!r.read_number(out.http_rate_per_s) || !FT_API_CONFIG_HTTP_RATE_PER_S_RANGE.contains(out.http_rate_per_s))
+          return ft_api_fail_(r, err, "http_rate_per_s", "must be a number within 0..100");
+        out.present |= FT_API_CONFIG_HAS_HTTP_RATE_PER_S;
+        break;
+      }
+      case FT_API_CONFIG_K_HTTP_BURST: {
+        int64_t v;
+        if (!r.read_int(v) || !FT_API_CONFIG_HTTP_BURST_RANGE.contains(static_cast<float>(v)))
+          return ft_api_fail_(r, err, "http_burst", "must be an integer within 1..100");
+        out.http_burst = static_cast<int32_t>(v);
+        out.present |= FT_API_CONFIG_HAS_HTTP_BURST;
+        break;
+      }
+      default:
+        if (!r.skip_value()) return ft_api_fail_(r, err, nullptr, "is malformed");
+        break;
+    }
+  }
+  if (!r.ok()) return ft_api_fail_(r, err, nullptr, nullptr);
+  return ft_api_require_(err, out.present, FT_API_CONFIG_REQUIRED, FT_API_CONFIG_FIELDS);
+}
+
+// Writes the fields in v.present, in schema order.
+template<typename W> static inline void ft_api_write_config(W &w, const FtApiConfig &v) {
+  w.begin_object();
+  if (v.present & FT_API_CONFIG_HAS_MODE) {
+    w.key("mode");
+    w.value(ft_api_mode_name(v.mode));
+  }
+  if (v.present & FT_API_CONFIG_HAS_SMOOTHING_MODE) {
+    w.key("smoothing_mode");
+    w.value(ft_api_smoothing_mode_name(v.smoothing_mode));
+  }
+  if (v.present & FT_API_CONFIG_HAS_POINTS) {
+    w.key("points");
+    w.begin_array();
+    for (uint8_t i = 0; i < v.points_count; i++) ft_api_write_curve_point(w, v.points[i]);
+    w.end_array();
+  }
+  if (v.present & FT_API_CONFIG_HAS_MANUAL_PWM) {
+    w.key("manual_pwm");
+    w.value(v.manual_pwm);
+  }
+  if (v.present & FT_API_CONFIG_HAS_MIN_PWM) {
+    w.key("min_pwm");
+    w.value(v.min_pwm);
+  }
+  if (v.present & FT_API_CONFIG_HAS_MAX_PWM) {
+    w.key("max_pwm");
+    w.value(v.max_pwm);
+  }
+  if (v.present & FT_API_CONFIG_HAS_CURVE_MIN) {
+    w.key("curve_min");
+    w.value(v.curve_min);
+  }
+  if (v.present & FT_API_CONFIG_HAS_CURVE_MAX) {
+    w.key("curve_max");
+    w.value(v.curve_max);
+  }
+  if (v.present & FT_API_CONFIG_HAS_SLEW_PCT_PER_SEC) {
+    w.key("slew_pct_per_sec");
+    w.value(v.slew_pct_per_sec);
+  }
+  if (v.present & FT_API_CONFIG_HAS_FAILSAFE_TEMP) {
+    w.key("failsafe_temp");
+    w.value(v.failsafe_temp);
+  }
+  if (v.present & FT_API_CONFIG_HAS_FAILSAFE_PWM) {
+    w.key("failsafe_pwm");
+    w.value(v.failsafe_pwm);
+  }
+  if (v.present & FT_API_CONFIG_HAS_TEMP_SOURCE) {
+    w.key("temp_source");
+    w.value(static_cast<int64_t>(v.temp_source));
+  }
+  if (v.present & FT_API_CONFIG_HAS_FF_SOURCE) {
+    w.key("ff_source");
+    w.value(static_cast<int64_t>(v.ff_source));
+  }
+  if (v.present & FT_API_CONFIG_HAS_FF_POINTS) {
+    w.key("ff_points");
+    w.begin_array();
+    for (uint8_t i = 0; i < v.ff_points_count; i++) ft_api_write_curve_point(w, v.ff_points[i]);
+    w.end_array();
+  }
+  if (v.present & FT_API_CONFIG_HAS_FALLING_POINTS) {
+    w.key("falling_points");
+    w.begin_array();
+    for (uint8_t i = 0; i < v.falling_points_count; i++) ft_api_write_curve_point(w, v.falling_points[i]);
+    w.end_array();
+  }
+  if (v.present & FT_API_CONFIG_HAS_FF_BLEND) {
+    w.key("ff_blend");
+    w.value(ft_api_config_ff_blend_name(v.ff_blend));
+  }
+  if (v.present & FT_API_CONFIG_HAS_FF_DECAY_S) {
+    w.key("ff_decay_s");
+    w.value(v.ff_decay_s);
+  }
+  if (v.present & FT_API_CONFIG_HAS_RULES) {
+    w.key("rules");
+    w.value(v.rules);
+  }
+  if (v.present & FT_API_CONFIG_HAS_RACK_AGGREGATE) {
+    w.key("rack_aggregate");
+    w.value(ft_api_config_rack_aggregate_name(v.rack_aggregate));
+  }
+  if (v.present & FT_API_CONFIG_HAS_RACK_WEIGHT) {
+    w.key("rack_weight");
+    w.value(static_cast<int64_t>(v.rack_weight));
+  }
+  if (v.present & FT_API_CONFIG_HAS_RACK_STALE_S) {
+    w.key("rack_stale_s");
+    w.value(v.rack_stale_s);
+  }
+  if (v.present & FT_API_CONFIG_HAS_POWER_MODE) {
+    w.key("power_mode");
+    w.value(ft_api_config_power_mode_name(v.power_mode));
+  }
+  if (v.present & FT_API_CONFIG_HAS_POWER_UI_HOLD_S) {
+    w.key("power_ui_hold_s");
+    w.value(v.power_ui_hold_s);
+  }
+  if (v.present & FT_API_CONFIG_HAS_HTTP_RATE_PER_S) {
+    w.key("http_rate_per_s");
+    w.value(v.http_rate_per_s);
+  }
+  if (v.present & FT_API_CONFIG_HAS_HTTP_BURST) {
+    w.key("http_burst");
+    w.value(static_cast<int64_t>(v.http_burst));
+  }
+  w.end_object();
+}
+
+// --- StatusResponse ----------------------------------------------------------
+
+enum FtApiStatusResponseKey : uint8_t {
+  FT_API_STATUS_RESPONSE_K_TEMP_C = 0,
+  FT_API_STATUS_RESPONSE_K_PWM_PCT = 1,
+  FT_API_STATUS_RESPONSE_K_TARGET_PWM_PCT = 2,
+  FT_API_STATUS_RESPONSE_K_OUTPUT_LEVEL = 3,
+  FT_API_STATUS_RESPONSE_K_MODE = 4,
+  FT_API_STATUS_RESPONSE_K_SMOOTHING_MODE = 5,
+  FT_API_STATUS_RESPONSE_K_MIN_PWM = 6,
+  FT_API_STATUS_RESPONSE_K_MAX_PWM = 7,
+  FT_API_STATUS_RESPONSE_K_SLEW_PCT_PER_SEC = 8,
+  FT_API_STATUS_RESPONSE_K_MANUAL_PWM = 9,
+  FT_API_STATUS_RESPONSE_K_LAST_UPDATE_MS = 10,
+  FT_API_STATUS_RESPONSE_K_TEMP_SOURCE = 11,
+  FT_API_STATUS_RESPONSE_K_TEMP_SOURCE_ACTIVE = 12,
+  FT_API_STATUS_RESPONSE_K_LOAD_PCT = 13,
+  FT_API_STATUS_RESPONSE_K_FF_PWM_PCT = 14,
+  FT_API_STATUS_RESPONSE_K_RACK_TEMP_C = 15,
+  FT_API_STATUS_RESPONSE_K_RACK_PEERS = 16,
+  FT_API_STATUS_RESPONSE_K_POWER_STATE = 17,
+  FT_API_STATUS_RESPONSE_K_ASLEEP_S = 18,
+  FT_API_STATUS_RESPONSE_K_ENERGY_J = 19,
+  FT_API_STATUS_RESPONSE_K_PWM_REVERSALS_PER_HOUR = 20,
+  FT_API_STATUS_RESPONSE_K_UNKNOWN = 21,
+};
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_TEMP_C = 1u << 0;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_PWM_PCT = 1u << 1;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_TARGET_PWM_PCT = 1u << 2;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_OUTPUT_LEVEL = 1u << 3;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_MODE = 1u << 4;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_SMOOTHING_MODE = 1u << 5;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_MIN_PWM = 1u << 6;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_MAX_PWM = 1u << 7;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_SLEW_PCT_PER_SEC = 1u << 8;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_MANUAL_PWM = 1u << 9;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_LAST_UPDATE_MS = 1u << 10;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_TEMP_SOURCE = 1u << 11;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_TEMP_SOURCE_ACTIVE = 1u << 12;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_LOAD_PCT = 1u << 13;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_FF_PWM_PCT = 1u << 14;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_RACK_TEMP_C = 1u << 15;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_RACK_PEERS = 1u << 16;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_POWER_STATE = 1u << 17;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_ASLEEP_S = 1u << 18;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_ENERGY_J = 1u << 19;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_HAS_PWM_REVERSALS_PER_HOUR = 1u << 20;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_REQUIRED = FT_API_STATUS_RESPONSE_HAS_TEMP_C |
+    FT_API_STATUS_RESPONSE_HAS_PWM_PCT | FT_API_STATUS_RESPONSE_HAS_MODE | FT_API_STATUS_RESPONSE_HAS_SMOOTHING_MODE;
+static constexpr uint32_t FT_API_STATUS_RESPONSE_ALL = 0x1fffffu;
+static constexpr const char *FT_API_STATUS_RESPONSE_FIELDS[] = {"temp_c", "pwm_pct", "target_pwm_pct", "output_level",
+    "mode", "smoothing_mode", "min_pwm", "max_pwm", "slew_pct_per_sec", "manual_pwm", "last_update_ms", "temp_source",
+    "temp_source_active", "load_pct", "ff_pwm_pct", "rack_temp_c", "rack_peers", "power_state", "asleep_s", "energy_j",
+    "pwm_reversals_per_hour"};
+
+static constexpr FtApiRange FT_API_STATUS_RESPONSE_PWM_PCT_RANGE = {0.0f, 100.0f};
+
+struct FtApiStatusResponse {
+  uint32_t present = 0;  // FT_API_STATUS_RESPONSE_HAS_* bits
+  float temp_c = 0.0f;  // NAN for null
+  float pwm_pct = 0.0f;
+  float target_pwm_pct = 0.0f;
+  float output_level = 0.0f;
+  FtApiMode mode = static_cast<FtApiMode>(0);
+  FtApiSmoothingMode smoothing_mode = static_cast<FtApiSmoothingMode>(0);
+  float min_pwm = 0.0f;
+  float max_pwm = 0.0f;
+  float slew_pct_per_sec = 0.0f;
+  float manual_pwm = 0.0f;
+  int64_t last_update_ms = 0;
+  int32_t temp_source = 0;
+  FtApiStatusResponseTempSourceActive temp_source_active = static_cast<FtApiStatusResponseTempSourceActive>(0);
+  float load_pct = 0.0f;  // NAN for null
+  float ff_pwm_pct = 0.0f;
+  float rack_temp_c = 0.0f;  // NAN for null
+  int32_t rack_peers = 0;
+  FtApiStatusResponsePowerState power_state = static_cast<FtApiStatusResponsePowerState>(0);
+  float asleep_s = 0.0f;
+  float energy_j = 0.0f;
+  float pwm_reversals_per_hour = 0.0f;
+};
+
+// Writes the fields in v.present, in schema order.
+template<typename W> static inline void ft_api_write_status_response(W &w, const FtApiStatusResponse &v) {
+  w.begin_object();
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_TEMP_C) {
+    w.key("temp_c");
+    w.value(v.temp_c);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_PWM_PCT) {
+    w.key("pwm_pct");
+    w.value(v.pwm_pct);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_TARGET_PWM_PCT) {
+    w.key("target_pwm_pct");
+    w.value(v.target_pwm_pct);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_OUTPUT_LEVEL) {
+    w.key("output_level");
+    w.value(v.output_level);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_MODE) {
+    w.key("mode");
+    w.value(ft_api_mode_name(v.mode));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_SMOOTHING_MODE) {
+    w.key("smoothing_mode");
+    w.value(ft_api_smoothing_mode_name(v.smoothing_mode));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_MIN_PWM) {
+    w.key("min_pwm");
+    w.value(v.min_pwm);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_MAX_PWM) {
+    w.key("max_pwm");
+    w.value(v.max_pwm);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_SLEW_PCT_PER_SEC) {
+    w.key("slew_pct_per_sec");
+    w.value(v.slew_pct_per_sec);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_MANUAL_PWM) {
+    w.key("manual_pwm");
+    w.value(v.manual_pwm);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_LAST_UPDATE_MS) {
+    w.key("last_update_ms");
+    w.value(static_cast<int64_t>(v.last_update_ms));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_TEMP_SOURCE) {
+    w.key("temp_source");
+    w.value(static_cast<int64_t>(v.temp_source));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_TEMP_SOURCE_ACTIVE) {
+    w.key("temp_source_active");
+    w.value(ft_api_status_response_temp_source_active_name(v.temp_source_active));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_LOAD_PCT) {
+    w.key("load_pct");
+    w.value(v.load_pct);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_FF_PWM_PCT) {
+    w.key("ff_pwm_pct");
+    w.value(v.ff_pwm_pct);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_RACK_TEMP_C) {
+    w.key("rack_temp_c");
+    w.value(v.rack_temp_c);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_RACK_PEERS) {
+    w.key("rack_peers");
+    w.value(static_cast<int64_t>(v.rack_peers));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_POWER_STATE) {
+    w.key("power_state");
+    w.value(ft_api_status_response_power_state_name(v.power_state));
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_ASLEEP_S) {
+    w.key("asleep_s");
+    w.value(v.asleep_s);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_ENERGY_J) {
+    w.key("energy_j");
+    w.value(v.energy_j);
+  }
+  if (v.present & FT_API_STATUS_RESPONSE_HAS_PWM_REVERSALS_PER_HOUR) {
+    w.key("pwm_reversals_per_hour");
+    w.value(v.pwm_reversals_per_hour);
+  }
+  w.end_object();
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+// Asynchronous responses: large or long-running bodies leave their httpd
+// handler and go out one chunk at a time, so a history export or a trace
+// download no longer holds httpd's single worker task for its whole duration.
+// Portable (no ESPHome or ESP-IDF calls); fanforge_api.h detaches the request
+// from its handler and sends one chunk per httpd work item, so requests that
+// arrive meanwhile are served between two chunks.
+//
+// Memory is fixed: FT_ASYNC_SLOTS slots of FT_ASYNC_CHUNK_BYTES each, a
+// compressor per slot and the sources' cursors, all static. httpd's copy of
+// a detached request (the request, its header scratch and response header
+// table, ~1 KB of heap on default sdkconfig) lives until the response
+// completes.
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "fanforge_deflate.h"
+
+// Concurrent async responses; more are refused with 503 (each one also holds an admission slot).
+static constexpr int FT_ASYNC_SLOTS = 2;
+// Small enough to fit lwIP's TCP send buffer, so sending a chunk does not wait for ACKs.
+static constexpr size_t FT_ASYNC_CHUNK_BYTES = 1024;
+// Source bytes per compressed fill, so that even incompressible input still fits one chunk.
+static constexpr size_t FT_ASYNC_DEFLATE_INPUT = 896;
+static_assert(ft_deflate_bound(FT_ASYNC_DEFLATE_INPUT) <= FT_ASYNC_CHUNK_BYTES, "compressed fill overflows a chunk");
+
+/**
+ * Produces a response body piecewise. A source is set up by its route; once
+ * the response has started, fill() is called once per chunk until it returns
+ * 0, and end() follows exactly once, whether the body completed or the client
+ * left. A source with work to do before its first byte (a full pass over the
+ * history log) does a bounded step per fill() and reports pending() until
+ * then; its 0s do not end the body, and the pump yields between steps.
+ */
+class FtAsyncSource {
+ public:
+  virtual ~FtAsyncSource() = default;
+  // Writes the next part of the body to buf (at most cap bytes, see FtChunkWriter) and returns its
+  // length; 0 ends the body unless pending().
+  virtual size_t fill(char *buf, size_t cap) = 0;
+  virtual bool pending() const { return false; }
+  virtual void end() {}
+};
+
+// Formats into a chunk buffer of cap bytes plus one for printf's terminator.
+// Sources check room() before each row, so output is never cut short.
+class FtChunkWriter {
+ public:
+  FtChunkWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(this->buf_ + this->len_, this->room() + 1, fmt, args);
+    va_end(args);
+    if (n > 0) this->len_ += static_cast<size_t>(n) < this->room() ? static_cast<size_t>(n) : this->room();
+  }
+  void print(const char *s) { this->write(s, strlen(s)); }
+  void write(const void *data, size_t len) {
+    if (len > this->room()) len = this->room();
+    memcpy(this->buf_ + this->len_, data, len);
+    this->len_ += len;
+  }
+
+  size_t room() const { return this->cap_ - this->len_; }
+  size_t size() const { return this->len_; }
+
+ private:
+  char *buf_;
+  size_t cap_;
+  size_t len_ = 0;
+};
+
+struct FtAsyncStats {
+  uint32_t started = 0;
+  uint32_t completed = 0;
+  uint32_t aborted = 0;  // a chunk could not be sent (client gone, or stalled past httpd's send timeout)
+  uint32_t refused = 0;  // every slot busy
+  uint32_t chunks = 0;
+  uint64_t bytes = 0;  // as sent, after compression
+  uint32_t max_ms = 0;  // longest response, detach to last chunk
+  uint8_t max_active = 0;
+};
+
+struct FtAsyncSlot {
+  void *req = nullptr;  // the detached request; nullptr while the slot is free
+  FtAsyncSource *source = nullptr;
+  uint32_t start_ms = 0;
+  uint32_t bytes = 0;
+  bool ended = false;  // the source returned 0 (and, compressed, the stream was finished)
+  FtDeflate deflate;   // used when the response has a Content-Encoding
+  char buf[FT_ASYNC_CHUNK_BYTES + 1];
+};
+
+class FtAsyncPool {
+ public:
+  // Index of a free slot, or -1 (counted as refused) when all are busy.
+  int reserve() {
+    for (int i = 0; i < FT_ASYNC_SLOTS; i++) {
+      if (this->slots_[i].req == nullptr) return i;
+    }
+    this->stats_.refused++;
+    return -1;
+  }
+
+  // encoding other than identity compresses the body; clock, when set, times that work.
+  FtAsyncSlot &start(int i, void *req, FtAsyncSource *source, uint32_t now_ms,
+                     FtContentEncoding encoding = FT_ENCODING_IDENTITY, uint32_t (*clock)() = nullptr) {
+    FtAsyncSlot &s = this->slots_[i];
+    s.req = req;
+    s.source = source;
+    s.start_ms = now_ms;
+    s.bytes = 0;
+    s.ended = false;
+    s.deflate.begin(encoding, clock);
+    this->stats_.started++;
+    const uint8_t active = static_cast<uint8_t>(this->active());
+    if (active > this->stats_.max_active) this->stats_.max_active = active;
+    return s;
+  }
+
+  // Fills the slot's buffer with the next chunk and returns its length; 0 is the end of the body,
+  // or, with s.ended still false, a source step that produced nothing yet.
+  size_t next(FtAsyncSlot &s) {
+    const size_t n = s.deflate.encoding() == FT_ENCODING_IDENTITY ? this->fill_(s) : this->fill_deflate_(s);
+    s.bytes += n;
+    this->stats_.bytes += n;
+    if (n > 0) this->stats_.chunks++;
+    return n;
+  }
+
+  void finish(FtAsyncSlot &s, bool complete, uint32_t now_ms) {
+    s.source->end();
+    if (complete)
+      this->stats_.completed++;
+    else
+      this->stats_.aborted++;
+    const uint32_t ms = now_ms - s.start_ms;
+    if (ms > this->stats_.max_ms) this->stats_.max_ms = ms;
+    s.req = nullptr;
+    s.source = nullptr;
+  }
+
+  int active() const {
+    int n = 0;
+    for (const FtAsyncSlot &s : this->slots_) n += s.req != nullptr;
+    return n;
+  }
+  const FtAsyncStats &stats() const { return this->stats_; }
+
+ private:
+  size_t fill_(FtAsyncSlot &s) {
+    if (s.ended) return 0;
+    const size_t n = s.source->fill(s.buf, FT_ASYNC_CHUNK_BYTES);
+    s.ended = n == 0 && !s.source->pending();
+    return n;
+  }
+
+  // Source output goes straight into the compressor's window. A fill may
+  // compress to nothing while bits are pending, so keep feeding until there
+  // is output or the stream is finished.
+  size_t fill_deflate_(FtAsyncSlot &s) {
+    uint8_t *out = reinterpret_cast<uint8_t *>(s.buf);
+    size_t len = 0;
+    while (len == 0 && !s.ended) {
+      char *in = reinterpret_cast<char *>(s.deflate.reserve(FT_ASYNC_DEFLATE_INPUT));
+      const size_t n = s.source->fill(in, FT_ASYNC_DEFLATE_INPUT);
+      if (n == 0 && s.source->pending()) break;
+      if (n == 0) {
+        s.ended = true;
+        len = s.deflate.finish(out);
+      } else {
+        len = s.deflate.commit(n, out);
+      }
+    }
+    return len;
+  }
+
+  FtAsyncSlot slots_[FT_ASYNC_SLOTS];
+  FtAsyncStats stats_;
+};
@@ -0,0 +1,424 @@
+#pragma once
+
+// Minimal CBOR (RFC 8949) reader and writer with the same interface as the
+// JSON pair in fanforge_json.h, so the generated API parsers and writers
+// (fanforge_api_gen.h) handle both wire formats from one schema.
+//
+// FtCborReader pulls from a caller-owned buffer: no allocation, no tree.
+// Definite and indefinite-length maps and arrays are accepted; strings must be
+// definite-length text (the API's strings are keys and enum names). Numbers
+// may arrive as integers or half/single/double floats.
+//
+// FtCborWriter fills a caller-owned fixed buffer with preferred serialization:
+// definite lengths (patched in when a map or array closes), the shortest
+// integer heads, and half floats where the value survives the round trip,
+// single floats otherwise. Overflow is sticky and reported by overflow().
+//
+// No ESPHome dependencies.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+static constexpr int FT_CBOR_MAX_DEPTH = 16;
+
+// Half-precision bits for f, or false if f is not exactly representable.
+static inline bool ft_cbor_half_bits(float f, uint16_t &h) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+  const int32_t exp = static_cast<int32_t>((x >> 23) & 0xff) - 127;
+  const uint32_t mant = x & 0x7fffff;
+  if ((x & 0x7fffffff) == 0) {
+    h = sign;
+    return true;
+  }
+  if (exp < -24 || exp > 15) return false;
+  if (exp >= -14) {
+    if (mant & 0x1fff) return false;
+    h = static_cast<uint16_t>(sign | ((exp + 15) << 10) | (mant >> 13));
+    return true;
+  }
+  // Subnormal half: the implicit bit moves into the 10-bit mantissa.
+  const uint32_t full = mant | 0x800000;
+  const int shift = 13 + (-14 - exp);
+  if (full & ((1u << shift) - 1)) return false;
+  h = static_cast<uint16_t>(sign | (full >> shift));
+  return true;
+}
+
+static inline float ft_cbor_half_value(uint16_t h) {
+  const int exp = (h >> 10) & 0x1f;
+  const int mant = h & 0x3ff;
+  float v;
+  if (exp == 0)
+    v = ldexpf(static_cast<float>(mant), -24);
+  else if (exp != 31)
+    v = ldexpf(static_cast<float>(mant + 1024), exp - 25);
+  else
+    v = mant == 0 ? INFINITY : NAN;
+  return (h & 0x8000) ? -v : v;
+}
+
+class FtCborReader {
+ public:
+  FtCborReader(const uint8_t *data, size_t len) : p_(data), begin_(data), end_(data + len) {}
+  explicit FtCborReader(const std::string &s)
+      : FtCborReader(reinterpret_cast<const uint8_t *>(s.data()), s.size()) {}
+
+  bool ok() const { return this->error_ == nullptr; }
+  const char *error() const { return this->error_; }
+  size_t offset() const { return static_cast<size_t>(this->p_ - this->begin_); }
+
+  bool begin_object() { return this->open_(5); }
+  bool begin_array() { return this->open_(4); }
+
+  // Next pair of the current map: sets key/len to the text key. Returns false
+  // after the last pair or on a malformed item (ok() tells which).
+  bool next_key(const char *&key, size_t &len) {
+    if (!this->next_()) return false;
+    if (!this->read_string(key, len)) return this->fail_("expected a text key");
+    return true;
+  }
+
+  // True while the current array has another item to read.
+  bool next_item() { return this->next_(); }
+
+  bool read_number(float &out) {
+    Head h;
+    if (!this->peek_(h)) return false;
+    if (h.major == 0) {
+      out = static_cast<float>(h.arg);
+    } else if (h.major == 1) {
+      out = -1.0f - static_cast<float>(h.arg);
+    } else if (h.major == 7 && h.info == 25) {
+      out = ft_cbor_half_value(static_cast<uint16_t>(h.arg));
+    } else if (h.major == 7 && h.info == 26) {
+      const uint32_t bits = static_cast<uint32_t>(h.arg);
+      memcpy(&out, &bits, sizeof(out));
+    } else if (h.major == 7 && h.info == 27) {
+      double d;
+      memcpy(&d, &h.arg, sizeof(d));
+      out = static_cast<float>(d);
+    } else {
+      return false;
+    }
+    this->p_ = h.next;
+    return std::isfinite(out);
+  }
+
+  bool read_int(int64_t &out) {
+    Head h;
+    if (!this->peek_(h) || h.major > 1 || h.arg > static_cast<uint64_t>(INT64_MAX)) return false;
+    out = h.major == 0 ? static_cast<int64_t>(h.arg) : -1 - static_cast<int64_t>(h.arg);
+    this->p_ = h.next;
+    return true;
+  }
+
+  bool read_bool(bool &out) {
+    if (this->p_ >= this->end_ || (*this->p_ != 0xf4 && *this->p_ != 0xf5)) return false;
+    out = *this->p_++ == 0xf5;
+    return true;
+  }
+
+  bool read_null() {
+    if (this->p_ >= this->end_ || *this->p_ != 0xf6) return false;
+    this->p_++;
+    return true;
+  }
+
+  // Definite-length text string, returned in place (not NUL terminated).
+  bool read_string(const char *&s, size_t &len) {
+    Head h;
+    if (!this->peek_(h) || h.major != 3) return false;
+    if (h.indefinite) return this->fail_("indefinite-length text not supported");
+    if (h.arg > static_cast<uint64_t>(this->end_ - h.next)) return this->fail_("unexpected end of input");
+    s = reinterpret_cast<const char *>(h.next);
+    len = static_cast<size_t>(h.arg);
+    this->p_ = h.next + len;
+    return true;
+  }
+
+  // Definite-length text copied into dst and NUL terminated. False if it is not
+  // text, holds U+0000 or needs cap bytes or more.
+  bool read_text(char *dst, size_t cap) {
+    const char *s;
+    size_t n;
+    if (cap == 0 || !this->read_string(s, n)) return false;
+    if (n >= cap || memchr(s, 0, n) != nullptr) return false;
+    memcpy(dst, s, n);
+    dst[n] = '\0';
+    return true;
+  }
+
+  // Skips one data item of any type (unknown keys are ignored).
+  bool skip_value() {
+    Head h;
+    // Tags only annotate the item that follows; loop rather than recurse.
+    for (;;) {
+      if (!this->peek_(h)) return false;
+      if (h.major != 6) break;
+      this->p_ = h.next;
+    }
+    switch (h.major) {
+      case 2:
+      case 3:
+        if (!h.indefinite) {
+          if (h.arg > static_cast<uint64_t>(this->end_ - h.next)) return this->fail_("unexpected end of input");
+          this->p_ = h.next + h.arg;
+          return true;
+        }
+        this->p_ = h.next;
+        // Chunks of the same major type until the break byte.
+        for (;;) {
+          if (this->p_ < this->end_ && *this->p_ == 0xff) {
+            this->p_++;
+            return true;
+          }
+          Head c;
+          if (!this->peek_(c)) return false;
+          if (c.major != h.major || c.indefinite) return this->fail_("malformed string chunk");
+          if (c.arg > static_cast<uint64_t>(this->end_ - c.next)) return this->fail_("unexpected end of input");
+          this->p_ = c.next + c.arg;
+        }
+      case 4:
+        if (!this->begin_array()) return false;
+        while (this->next_item()) {
+          if (!this->skip_value()) return false;
+        }
+        return this->ok();
+      case 5:
+        if (!this->begin_object()) return false;
+        while (this->next_()) {
+          if (!this->skip_value() || !this->skip_value()) return false;
+        }
+        return this->ok();
+      case 7:
+        if (h.indefinite) return this->fail_("unexpected break");
+        this->p_ = h.next;
+        return true;
+      default:
+        this->p_ = h.next;
+        return true;
+    }
+  }
+
+  // Nothing may follow the top-level item.
+  bool finish() { return this->p_ == this->end_ || this->fail_("trailing bytes"); }
+
+ protected:
+  struct Head {
+    uint8_t major;
+    uint8_t info;
+    bool indefinite;
+    uint64_t arg;
+    const uint8_t *next;
+  };
+  struct Level {
+    int64_t remaining;  // -1: indefinite, ends at a break byte
+  };
+
+  bool fail_(const char *msg) {
+    if (this->error_ == nullptr) this->error_ = msg;
+    return false;
+  }
+
+  // Decodes the head at p_ without consuming it. Truncated or reserved heads
+  // are syntax errors; the caller only checks the major type.
+  bool peek_(Head &h) {
+    if (!this->ok()) return false;
+    if (this->p_ >= this->end_) return this->fail_("unexpected end of input");
+    const uint8_t ib = *this->p_;
+    h.major = ib >> 5;
+    h.info = ib & 0x1f;
+    h.indefinite = false;
+    h.arg = h.info;
+    h.next = this->p_ + 1;
+    if (h.info < 24) return true;
+    if (h.info == 31) {
+      // Indefinite length (2-5) or the break byte (7); invalid elsewhere.
+      h.indefinite = true;
+      return (h.major >= 2 && h.major != 6) || this->fail_("malformed item");
+    }
+    if (h.info > 27) return this->fail_("malformed item");
+    const size_t n = static_cast<size_t>(1) << (h.info - 24);
+    if (n > static_cast<size_t>(this->end_ - h.next)) return this->fail_("unexpected end of input");
+    h.arg = 0;
+    for (size_t i = 0; i < n; i++) h.arg = (h.arg << 8) | h.next[i];
+    h.next += n;
+    return true;
+  }
+
+  bool open_(uint8_t major) {
+    Head h;
+    if (!this->peek_(h) || h.major != major) return false;
+    if (this->depth_ >= FT_CBOR_MAX_DEPTH) return this->fail_("nesting too deep");
+    if (!h.indefinite && h.arg > static_cast<uint64_t>(this->end_ - h.next)) return this->fail_("length exceeds input");
+    this->p_ = h.next;
+    this->stack_[this->depth_++].remaining = h.indefinite ? -1 : static_cast<int64_t>(h.arg);
+    return true;
+  }
+
+  // Consumes the end of the current container or accounts for one more item.
+  bool next_() {
+    if (!this->ok() || this->depth_ == 0) return false;
+    Level &l = this->stack_[this->depth_ - 1];
+    if (l.remaining == 0) {
+      this->depth_--;
+      return false;
+    }
+    if (this->p_ >= this->end_) return this->fail_("unexpected end of input");
+    if (l.remaining < 0) {
+      if (*this->p_ == 0xff) {
+        this->p_++;
+        this->depth_--;
+        return false;
+      }
+    } else {
+      l.remaining--;
+    }
+    return true;
+  }
+
+  const uint8_t *p_;
+  const uint8_t *begin_;
+  const uint8_t *end_;
+  const char *error_ = nullptr;
+  int depth_ = 0;
+  Level stack_[FT_CBOR_MAX_DEPTH];
+};
+
+class FtCborWriter {
+ public:
+  FtCborWriter(uint8_t *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  const uint8_t *data() const { return this->buf_; }
+  size_t size() const { return this->len_; }
+  bool overflow() const { return this->overflow_; }
+
+  void begin_object() { this->open_(5); }
+  void end_object() { this->close_(); }
+  void begin_array() { this->open_(4); }
+  void end_array() { this->close_(); }
+
+  void key(const char *k) {
+    // Maps count pairs: the key counts, its value does not.
+    if (this->depth_ > 0) this->stack_[this->depth_ - 1].count++;
+    this->text_(k);
+  }
+
+  // Non-finite numbers are written as null, as in JSON.
+  void value(float v) {
+    this->item_();
+    uint16_t half;
+    if (!std::isfinite(v)) {
+      this->byte_(0xf6);
+    } else if (ft_cbor_half_bits(v, half)) {
+      this->byte_(0xf9);
+      this->byte_(static_cast<uint8_t>(half >> 8));
+      this->byte_(static_cast<uint8_t>(half));
+    } else {
+      uint32_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      this->byte_(0xfa);
+      for (int s = 24; s >= 0; s -= 8) this->byte_(static_cast<uint8_t>(bits >> s));
+    }
+  }
+  void value(int64_t v) {
+    this->item_();
+    if (v >= 0)
+      this->head_(0, static_cast<uint64_t>(v));
+    else
+      this->head_(1, static_cast<uint64_t>(-1 - v));
+  }
+  void value(bool v) {
+    this->item_();
+    this->byte_(v ? 0xf5 : 0xf4);
+  }
+  void value(const char *s) {
+    this->item_();
+    this->text_(s);
+  }
+  void null() {
+    this->item_();
+    this->byte_(0xf6);
+  }
+
+ protected:
+  struct Level {
+    size_t start;  // offset of the one-byte placeholder head
+    uint8_t major;
+    uint32_t count;
+  };
+
+  void byte_(uint8_t b) {
+    if (this->len_ < this->cap_)
+      this->buf_[this->len_++] = b;
+    else
+      this->overflow_ = true;
+  }
+
+  static size_t head_len_(uint64_t arg) {
+    return arg < 24 ? 1 : arg <= 0xff ? 2 : arg <= 0xffff ? 3 : arg <= 0xffffffffu ? 5 : 9;
+  }
+
+  // Writes a head in its shortest form at dst (head_len_(arg) bytes).
+  static void put_head_(uint8_t *dst, uint8_t major, uint64_t arg) {
+    const size_t n = head_len_(arg);
+    const uint8_t info = n == 1 ? static_cast<uint8_t>(arg) : n == 2 ? 24 : n == 3 ? 25 : n == 5 ? 26 : 27;
+    dst[0] = static_cast<uint8_t>(major << 5 | info);
+    for (size_t i = 1; i < n; i++) dst[i] = static_cast<uint8_t>(arg >> (8 * (n - 1 - i)));
+  }
+
+  void head_(uint8_t major, uint64_t arg) {
+    uint8_t tmp[9];
+    put_head_(tmp, major, arg);
+    for (size_t i = 0; i < head_len_(arg); i++) this->byte_(tmp[i]);
+  }
+
+  void text_(const char *s) {
+    const size_t n = strlen(s);
+    this->head_(3, n);
+    for (size_t i = 0; i < n; i++) this->byte_(static_cast<uint8_t>(s[i]));
+  }
+
+  // Array elements count toward their array; map values are counted by key().
+  void item_() {
+    if (this->depth_ > 0 && this->stack_[this->depth_ - 1].major == 4) this->stack_[this->depth_ - 1].count++;
+  }
+
+  void open_(uint8_t major) {
+    this->item_();
+    if (this->depth_ >= FT_CBOR_MAX_DEPTH) {
+      this->overflow_ = true;
+      return;
+    }
+    this->stack_[this->depth_++] = Level{this->len_, major, 0};
+    this->byte_(0);
+  }
+
+  // Patches the definite length into the placeholder, widening it if needed.
+  void close_() {
+    if (this->depth_ == 0) return;
+    const Level l = this->stack_[--this->depth_];
+    if (this->overflow_) return;
+    const size_t extra = head_len_(l.count) - 1;
+    if (extra > 0) {
+      if (this->len_ + extra > this->cap_) {
+        this->overflow_ = true;
+        return;
+      }
+      memmove(this->buf_ + l.start + 1 + extra, this->buf_ + l.start + 1, this->len_ - l.start - 1);
+      this->len_ += extra;
+    }
+    put_head_(this->buf_ + l.start, l.major, l.count);
+  }
+
+  uint8_t *buf_;
+  size_t cap_;
+  size_t len_ = 0;
+  bool overflow_ = false;
+  int depth_ = 0;
+  Level stack_[FT_CBOR_MAX_DEPTH];
+};
@@ -0,0 +1,532 @@
+#pragma once
+
+// Portable FanForge control loop: curve evaluation, temperature deadband,
+// rising/falling curve hysteresis, slew limiting, failsafe latch, load feed-forward and compiled rules
+// (fanforge_rules.h), held per instance in
+// FtController so the firmware, the host twin, the fleet simulator and replay
+// tools all run the same code. No ESPHome or ArduinoJson dependencies.
+
+#include <cmath>
+#include <cstdint>
+
+#include "fanforge_rules.h"
+
+static constexpr int FT_MAX_POINTS = 16;
+
+// Ignore only DS18B20 half-degree chatter around a stable point.
+// Any movement >= ~0.5 C should be considered "real" for control.
+static constexpr float FT_TEMP_CONTROL_DEADBAND_C = 0.51f;
+
+// External sources (UDP ingest) report with finer resolution than the DS18B20.
+static constexpr float FT_EXT_TEMP_CONTROL_DEADBAND_C = 0.1f;
+
+// No additional PWM deadband: temperature gating above is the only ignore rule.
+static constexpr float FT_PWM_DEADBAND_PCT = 0.0f;
+
+// Failsafe hysteresis.
+static constexpr float FT_FAILSAFE_HYST_C = 1.0f;
+
+// Output steps smaller than this neither start nor reverse a direction (float noise of a settled slew).
+static constexpr float FT_REVERSAL_MIN_STEP_PCT = 0.01f;
+
+// The rules' "rise" input is the raw temperature slope over windows this long;
+// shorter windows mostly measure DS18B20 quantization.
+static constexpr uint32_t FT_RISE_WINDOW_MS = 10000;
+
+struct FtPoint {
+  float t;
+  float p;
+};
+
+static inline float ft_clampf(float v, float lo, float hi) {
+  if (v < lo) return lo;
+  if (v > hi) return hi;
+  return v;
+}
+
+static inline float ft_curve_linear(float temp, const FtPoint *pts, int n) {
+  if (n <= 0) return 0.0f;
+  if (temp <= pts[0].t) return pts[0].p;
+  if (temp >= pts[n - 1].t) return pts[n - 1].p;
+
+  for (int i = 0; i < n - 1; i++) {
+    const FtPoint &a = pts[i];
+    const FtPoint &b = pts[i + 1];
+    if (temp >= a.t && temp <= b.t) {
+      float u = (temp - a.t) / fmaxf(1e-6f, (b.t - a.t));
+      return a.p + (b.p - a.p) * u;
+    }
+  }
+  return pts[n - 1].p;
+}
+
+// Monotone (Fritsch-Carlson) PCHIP tangents for n >= 2 points.
+static inline void ft_curve_smooth_tangents(const FtPoint *pts, int n, float *tg) {
+  float m[FT_MAX_POINTS] = {0};
+
+  for (int i = 0; i < n - 1; i++) {
+    float dx = pts[i + 1].t - pts[i].t;
+    float dy = pts[i + 1].p - pts[i].p;
+    m[i] = dy / fmaxf(1e-6f, dx);
+  }
+
+  tg[0] = m[0];
+  tg[n - 1] = m[n - 2];
+  for (int i = 1; i < n - 1; i++) {
+    if (m[i - 1] * m[i] <= 0.0f)
+      tg[i] = 0.0f;
+    else
+      tg[i] = (m[i - 1] + m[i]) * 0.5f;
+  }
+
+  for (int i = 0; i < n - 1; i++) {
+    if (fabsf(m[i]) < 1e-6f) {
+      tg[i] = 0.0f;
+      tg[i + 1] = 0.0f;
+      continue;
+    }
+    float a = tg[i] / m[i];
+    float b = tg[i + 1] / m[i];
+    float s = a * a + b * b;
+    if (s > 9.0f) {
+      float k = 3.0f / sqrtf(s);
+      tg[i] = k * a * m[i];
+      tg[i + 1] = k * b * m[i];
+    }
+  }
+}
+
+// Cubic Hermite evaluation inside [pts[0].t, pts[n-1].t] with precomputed tangents.
+static inline float ft_curve_hermite(float temp, const FtPoint *pts, int n, const float *tg) {
+  int seg = 0;
+  for (; seg < n - 1; seg++) {
+    if (temp >= pts[seg].t && temp <= pts[seg + 1].t) break;
+  }
+
+  float x0 = pts[seg].t;
+  float x1 = pts[seg + 1].t;
+  float y0 = pts[seg].p;
+  float y1 = pts[seg + 1].p;
+  float h = x1 - x0;
+  float u = (temp - x0) / fmaxf(1e-6f, h);
+
+  float h00 = 2.0f * u * u * u - 3.0f * u * u + 1.0f;
+  float h10 = u * u * u - 2.0f * u * u + u;
+  float h01 = -2.0f * u * u * u + 3.0f * u * u;
+  float h11 = u * u * u - u * u;
+
+  return h00 * y0 + h10 * h * tg[seg] + h01 * y1 + h11 * h * tg[seg + 1];
+}
+
+static inline float ft_curve_smooth(float temp, const FtPoint *pts, int n) {
+  if (n <= 0) return 0.0f;
+  if (n == 1) return pts[0].p;
+
+  if (temp <= pts[0].t) return pts[0].p;
+  if (temp >= pts[n - 1].t) return pts[n - 1].p;
+
+  float tg[FT_MAX_POINTS] = {0};
+  ft_curve_smooth_tangents(pts, n, tg);
+  return ft_curve_hermite(temp, pts, n, tg);
+}
+
+/**
+ * A curve with its PCHIP tangents computed once when the points change, so
+ * evaluating it per tick costs a segment search and one Hermite polynomial.
+ * Evaluation matches ft_curve_linear / ft_curve_smooth exactly.
+ */
+struct FtCurve {
+  FtPoint pts[FT_MAX_POINTS];
+  float tg[FT_MAX_POINTS];
+  int n = 0;
+  bool smooth = false;
+
+  void set(const FtPoint *points, int count) {
+    this->n = count < 0 ? 0 : (count > FT_MAX_POINTS ? FT_MAX_POINTS : count);
+    for (int i = 0; i < this->n; i++) {
+      this->pts[i] = points[i];
+      this->tg[i] = 0.0f;
+    }
+    if (this->n >= 2) ft_curve_smooth_tangents(this->pts, this->n, this->tg);
+  }
+
+  float eval(float temp) const {
+    if (!this->smooth) return ft_curve_linear(temp, this->pts, this->n);
+    if (this->n <= 0) return 0.0f;
+    if (this->n == 1) return this->pts[0].p;
+    if (temp <= this->pts[0].t) return this->pts[0].p;
+    if (temp >= this->pts[this->n - 1].t) return this->pts[this->n - 1].p;
+    return ft_curve_hermite(temp, this->pts, this->n, this->tg);
+  }
+};
+
+enum FtControlMode : int {
+  FT_MODE_AUTO = 0,
+  FT_MODE_MANUAL = 1,
+  FT_MODE_OFF = 2,
+};
+
+// Settings the loop runs on; the firmware mirrors these from its persisted globals.
+struct FtControlConfig {
+  int mode = FT_MODE_AUTO;
+  FtCurve curve;  // temperature (C) -> PWM %; the rising curve when falling_curve is set
+  // Optional (n == 0 disables): while the temperature falls, PWM comes down
+  // only as far as this curve, which lies at or above `curve`. A point h C to
+  // the left of its rising twin gives that breakpoint h C of hysteresis.
+  FtCurve falling_curve;
+  float min_pwm = 22.0f;
+  float max_pwm = 100.0f;
+  float slew_pct_per_sec = 10.0f;
+  float failsafe_temp = 80.0f;
+  float failsafe_pwm = 100.0f;
+  float manual_pwm = 50.0f;
+  bool ff_enabled = false;  // a feed-forward load source is configured
+  int ff_blend = 0;         // 0 = max, 1 = add
+  float ff_decay_s = 10.0f;
+  FtCurve ff_curve;  // load % -> PWM %, always linear
+  bool output_inverted = false;
+  FtRuleProgram rules;  // compiled when the config changes; empty runs nothing
+};
+
+// Everything the loop carries from one tick to the next.
+struct FtControlState {
+  float current_pwm_pct = 0.0f;
+  float last_target_pwm_pct = 0.0f;
+  float output_level = 0.0f;
+  uint32_t last_update_ms = 0;
+  bool control_temp_initialized = false;
+  float control_temp_c = NAN;
+  bool control_temp_valid = false;
+  bool temp_external = false;
+  bool failsafe_latched = false;
+  float ff_load_pct = NAN;
+  float ff_pwm_pct = 0.0f;
+  uint32_t ff_last_input_ms = 0;
+  float curve_held_pwm = NAN;  // curve output of the last AUTO tick, the state of the rising/falling band
+  int8_t output_dir = 0;        // direction of the last output step that moved: 1 up, -1 down
+  uint32_t reversals = 0;       // output steps against output_dir since construction
+  float temp_rise_c_per_min = NAN;
+  float rise_ref_temp_c = NAN;
+  uint32_t rise_ref_ms = 0;
+  // Rule cost and outcome: last tick, then running totals.
+  uint16_t rules_steps = 0;
+  uint32_t rules_cycles = 0;
+  int rules_mode = -1;  // mode the last tick ran in when a rule overrode it, else -1
+  uint64_t rules_cycles_total = 0;
+  uint32_t rules_runs = 0;
+  uint32_t rules_fired = 0;
+  uint32_t rules_overruns = 0;
+};
+
+// Pipeline stages of one tick, in order, for the stage trace.
+enum FtControlStage : uint8_t {
+  FT_STAGE_DEADBAND = 0,  // source temperature -> control temperature
+  FT_STAGE_RULES,         // compiled rules -> mode override and PWM effects
+  FT_STAGE_CURVE,         // control temperature -> curve PWM (or manual/off)
+  FT_STAGE_FEEDFORWARD,   // load feed-forward blend
+  FT_STAGE_WINDOW,        // rule effects, then the min/max running window
+  FT_STAGE_FAILSAFE,      // failsafe latch
+  FT_STAGE_SLEW,          // slew limiting and output level
+  FT_STAGE_COUNT,
+};
+
+enum FtStageFlag : uint8_t {
+  FT_STAGE_F_EXTERNAL = 1 << 0,        // temperature came from a UDP source
+  FT_STAGE_F_DEADBAND_HELD = 1 << 1,   // control temperature held against a different raw reading
+  FT_STAGE_F_FAILSAFE = 1 << 2,        // failsafe latched after this tick
+  FT_STAGE_F_NO_TEMP = 1 << 3,         // AUTO without a valid temperature; output untouched
+  FT_STAGE_F_WINDOW_CLAMPED = 1 << 4,  // min/max window changed the target
+  FT_STAGE_F_SLEW_LIMITED = 1 << 5,    // output did not reach the target this tick
+  FT_STAGE_F_LATE = 1 << 6,            // tick started late (set by the caller)
+  FT_STAGE_F_TRIGGER = 1 << 7,         // this tick fired the trace trigger (set by the trace buffer)
+};
+
+/**
+ * Intermediate values and per-stage cost of one tick, captured when tick() is
+ * given a record. Stage costs are in cycles of FtController::stage_clock and
+ * saturate at 65535. interval_ms and tick_us are filled in by the caller.
+ */
+struct FtStageRecord {
+  uint32_t t_ms;
+  float raw_temp_c;
+  float control_temp_c;
+  float curve_pwm;   // curve (AUTO), manual PWM or 0 (OFF)
+  float ff_pwm;      // feed-forward contribution, NAN when not evaluated
+  float window_pwm;  // after the min/max window
+  float target_pwm;  // after failsafe
+  float output_pwm;  // after slew limiting
+  uint16_t stage_cycles[FT_STAGE_COUNT];
+  uint16_t interval_ms;
+  uint16_t tick_us;
+  uint8_t mode;  // the mode the tick ran in, after rule overrides
+  uint8_t flags;
+};
+static_assert(sizeof(FtStageRecord) == 52, "FtStageRecord is a wire format");
+
+struct FtControlInput {
+  uint32_t now_ms;
+  float temp_c;        // raw reading from the selected source, NAN if none
+  bool temp_external;  // temp_c came from a UDP virtual source
+  float load_pct;      // fresh load sample for feed-forward, NAN if none
+};
+
+class FtController {
+ public:
+  FtControlConfig config;
+  FtControlState state;
+  // Cycle counter for stage timing; stage costs are recorded as 0 without one.
+  uint32_t (*stage_clock)() = nullptr;
+
+  // Runs one control interval. Returns false when AUTO has no valid temperature,
+  // in which case the output is left untouched. When rec is given, the tick's
+  // intermediate values and stage costs are written to it.
+  bool tick(const FtControlInput &in, FtStageRecord *rec = nullptr) {
+    const FtControlConfig &c = this->config;
+    FtControlState &s = this->state;
+    uint32_t stamp = 0;
+    if (rec != nullptr) {
+      *rec = FtStageRecord{};
+      rec->t_ms = in.now_ms;
+      rec->raw_temp_c = in.temp_c;
+      rec->curve_pwm = rec->ff_pwm = rec->window_pwm = rec->target_pwm = NAN;
+      if (in.temp_external) rec->flags |= FT_STAGE_F_EXTERNAL;
+      stamp = this->stage_clock ? this->stage_clock() : 0;
+    }
+
+    float target_pwm = 0.0f;
+    float temp = NAN;
+    bool is_auto_mode = false;
+    bool use_output_shaping = false;
+
+    s.temp_external = in.temp_external;
+    const float raw_temp = in.temp_c;
+    this->update_rise_(raw_temp, in.now_ms);
+    if (std::isfinite(raw_temp)) {
+      // Temperature deadband before curve evaluation: ignore 0.5 C chatter,
+      // but accept larger movement immediately.
+      const float deadband = in.temp_external ? FT_EXT_TEMP_CONTROL_DEADBAND_C : FT_TEMP_CONTROL_DEADBAND_C;
+      if (!s.control_temp_initialized || !std::isfinite(s.control_temp_c)) {
+        s.control_temp_c = raw_temp;
+        s.control_temp_initialized = true;
+      } else if (fabsf(raw_temp - s.control_temp_c) >= deadband) {
+        s.control_temp_c = raw_temp;
+      }
+      s.control_temp_valid = true;
+    } else {
+      s.control_temp_valid = false;
+    }
+    if (rec != nullptr) {
+      rec->control_temp_c = s.control_temp_c;
+      if (s.control_temp_valid && raw_temp != s.control_temp_c) rec->flags |= FT_STAGE_F_DEADBAND_HELD;
+      this->stage_done_(rec, FT_STAGE_DEADBAND, stamp);
+    }
+
+    FtRuleEffect eff;
+    const int mode = this->run_rules_(in, eff);
+    if (rec != nullptr) {
+      rec->mode = static_cast<uint8_t>(mode);
+      this->stage_done_(rec, FT_STAGE_RULES, stamp);
+    }
+
+    if (mode == FT_MODE_OFF) {
+      // OFF: force to 0 immediately.
+      target_pwm = 0.0f;
+    } else if (mode == FT_MODE_MANUAL) {
+      // MANUAL: direct operator control for validation/tuning.
+      target_pwm = ft_clampf(c.manual_pwm, 0.0f, 100.0f);
+    } else {
+      // AUTO depends on temperature validity. MANUAL/OFF should still operate without a sensor reading.
+      if (!std::isfinite(raw_temp) || !s.control_temp_initialized || !std::isfinite(s.control_temp_c)) {
+        s.last_update_ms = in.now_ms;
+        if (rec != nullptr) {
+          rec->flags |= FT_STAGE_F_NO_TEMP;
+          rec->output_pwm = s.current_pwm_pct;
+          if (s.failsafe_latched) rec->flags |= FT_STAGE_F_FAILSAFE;
+        }
+        return false;
+      }
+      temp = s.control_temp_c;
+
+      is_auto_mode = true;
+      use_output_shaping = true;
+      target_pwm = c.curve.eval(temp);
+      if (c.falling_curve.n >= 2 && std::isfinite(s.curve_held_pwm)) {
+        // Rising: follow the rising curve up. Falling: hold, and come down
+        // only along the falling curve.
+        target_pwm = fmaxf(target_pwm, fminf(c.falling_curve.eval(temp), s.curve_held_pwm));
+      }
+      s.curve_held_pwm = target_pwm;
+      if (rec != nullptr) {
+        rec->curve_pwm = target_pwm;
+        this->stage_done_(rec, FT_STAGE_CURVE, stamp);
+      }
+
+      // Load feed-forward: ramp on work starting rather than on heat arriving.
+      if (c.ff_enabled || std::isfinite(in.load_pct) || s.ff_pwm_pct > 0.0f) {
+        float ff_dt = 0.2f;
+        if (s.last_update_ms > 0 && in.now_ms >= s.last_update_ms) ff_dt = (in.now_ms - s.last_update_ms) / 1000.0f;
+        const float ff = this->feedforward_(in.load_pct, in.now_ms, ff_dt);
+        target_pwm = c.ff_blend == 1 ? target_pwm + ff : fmaxf(target_pwm, ff);
+        if (rec != nullptr) rec->ff_pwm = ff;
+      }
+      target_pwm = ft_clampf(target_pwm, 0.0f, 100.0f);
+      if (rec != nullptr) this->stage_done_(rec, FT_STAGE_FEEDFORWARD, stamp);
+    }
+    if (!is_auto_mode) s.curve_held_pwm = NAN;
+    if (rec != nullptr && !is_auto_mode) {
+      rec->curve_pwm = target_pwm;
+      this->stage_done_(rec, FT_STAGE_CURVE, stamp);
+    }
+
+    if (mode != FT_MODE_OFF && eff.fired > 0)
+      target_pwm = ft_clampf(fminf(fmaxf(target_pwm + eff.add, eff.floor), eff.cap), 0.0f, 100.0f);
+
+    const float pre_window_pwm = target_pwm;
+    if (is_auto_mode) {
+      // In AUTO, enforce a practical running window once we're above 0.
+      if (target_pwm > 0.0f) {
+        target_pwm = ft_clampf(target_pwm, c.min_pwm, c.max_pwm);
+      } else {
+        target_pwm = 0.0f;
+      }
+    }
+    if (rec != nullptr) {
+      rec->window_pwm = target_pwm;
+      if (target_pwm != pre_window_pwm) rec->flags |= FT_STAGE_F_WINDOW_CLAMPED;
+      this->stage_done_(rec, FT_STAGE_WINDOW, stamp);
+    }
+
+    // Failsafe applies during AUTO control, and whenever AUTO is the configured
+    // mode: a rule that switches to OFF or MANUAL must not stop the fan at the
+    // temperatures failsafe exists for.
+    if (is_auto_mode || c.mode == FT_MODE_AUTO) {
+      const float fs_temp = s.control_temp_valid ? s.control_temp_c : NAN;
+      if (fs_temp >= c.failsafe_temp) {
+        s.failsafe_latched = true;
+      } else if (fs_temp <= (c.failsafe_temp - FT_FAILSAFE_HYST_C)) {
+        s.failsafe_latched = false;
+      }
+      if (s.failsafe_latched) target_pwm = fmaxf(target_pwm, c.failsafe_pwm);
+    } else {
+      s.failsafe_latched = false;
+    }
+    target_pwm = ft_clampf(target_pwm, 0.0f, 100.0f);
+    if (rec != nullptr) {
+      rec->target_pwm = target_pwm;
+      if (s.failsafe_latched) rec->flags |= FT_STAGE_F_FAILSAFE;
+      this->stage_done_(rec, FT_STAGE_FAILSAFE, stamp);
+    }
+
+    float next_pwm = target_pwm;
+    const uint32_t now = in.now_ms;
+    if (use_output_shaping) {
+      // Deadband: avoid micro-hunting due to quantization/noise
+      if (fabsf(target_pwm - s.current_pwm_pct) < FT_PWM_DEADBAND_PCT) {
+        target_pwm = s.current_pwm_pct;
+      }
+
+      // Slew limiting
+      float dt = 0.2f;
+      if (s.last_update_ms > 0 && now >= s.last_update_ms) {
+        dt = fmaxf(0.02f, (now - s.last_update_ms) / 1000.0f);
+      }
+
+      float max_step = ft_clampf(c.slew_pct_per_sec, 0.0f, 100.0f) * dt;
+      float delta = target_pwm - s.current_pwm_pct;
+      float step = ft_clampf(delta, -max_step, max_step);
+      next_pwm = ft_clampf(s.current_pwm_pct + step, 0.0f, 100.0f);
+    }
+
+    const float moved = next_pwm - s.current_pwm_pct;
+    if (fabsf(moved) > FT_REVERSAL_MIN_STEP_PCT) {
+      const int8_t dir = moved > 0.0f ? 1 : -1;
+      if (s.output_dir != 0 && dir != s.output_dir) s.reversals++;
+      s.output_dir = dir;
+    }
+    s.current_pwm_pct = next_pwm;
+    s.last_target_pwm_pct = target_pwm;
+    s.last_update_ms = now;
+
+    // pwm_pct is the "user meaning": 0..100, where 0 should truly be off/min.
+    float level = ft_clampf(next_pwm, 0.0f, 100.0f) / 100.0f;
+    if (c.output_inverted) level = 1.0f - level;
+    s.output_level = ft_clampf(level, 0.0f, 1.0f);
+    if (rec != nullptr) {
+      rec->output_pwm = next_pwm;
+      if (next_pwm != target_pwm) rec->flags |= FT_STAGE_F_SLEW_LIMITED;
+      this->stage_done_(rec, FT_STAGE_SLEW, stamp);
+    }
+    return true;
+  }
+
+ protected:
+  // Raw temperature slope in C/min, refreshed once per FT_RISE_WINDOW_MS.
+  void update_rise_(float raw_temp, uint32_t now) {
+    FtControlState &s = this->state;
+    if (!std::isfinite(raw_temp)) {
+      s.rise_ref_temp_c = NAN;
+      s.temp_rise_c_per_min = NAN;
+    } else if (!std::isfinite(s.rise_ref_temp_c)) {
+      s.rise_ref_temp_c = raw_temp;
+      s.rise_ref_ms = now;
+    } else if (now - s.rise_ref_ms >= FT_RISE_WINDOW_MS) {
+      s.temp_rise_c_per_min = (raw_temp - s.rise_ref_temp_c) * 60000.0f / static_cast<float>(now - s.rise_ref_ms);
+      s.rise_ref_temp_c = raw_temp;
+      s.rise_ref_ms = now;
+    }
+  }
+
+  // Runs the compiled rules once and returns the mode this tick runs in.
+  int run_rules_(const FtControlInput &in, FtRuleEffect &eff) {
+    const FtControlConfig &c = this->config;
+    FtControlState &s = this->state;
+    s.rules_mode = -1;
+    if (c.rules.empty()) return c.mode;
+    float vars[FT_RULE_VAR_COUNT];
+    vars[FT_RULE_VAR_TEMP] = s.control_temp_valid ? s.control_temp_c : NAN;
+    vars[FT_RULE_VAR_RAW] = in.temp_c;
+    vars[FT_RULE_VAR_RISE] = s.temp_rise_c_per_min;
+    vars[FT_RULE_VAR_LOAD] = std::isfinite(in.load_pct) ? in.load_pct : s.ff_load_pct;
+    vars[FT_RULE_VAR_PWM] = s.current_pwm_pct;
+    vars[FT_RULE_VAR_MODE] = static_cast<float>(c.mode);
+    vars[FT_RULE_VAR_FAILSAFE] = s.failsafe_latched ? 1.0f : 0.0f;
+    vars[FT_RULE_VAR_EXTERNAL] = in.temp_external ? 1.0f : 0.0f;
+    const uint32_t start = this->stage_clock ? this->stage_clock() : 0;
+    ft_rules_run(c.rules, vars, eff);
+    s.rules_cycles = this->stage_clock ? this->stage_clock() - start : 0;
+    s.rules_cycles_total += s.rules_cycles;
+    s.rules_steps = eff.steps;
+    s.rules_runs++;
+    s.rules_fired += eff.fired;
+    if (eff.overrun) s.rules_overruns++;
+    if (eff.mode < 0 || eff.mode == c.mode) return c.mode;
+    s.rules_mode = eff.mode;
+    return eff.mode;
+  }
+
+  void stage_done_(FtStageRecord *rec, FtControlStage stage, uint32_t &stamp) {
+    if (this->stage_clock == nullptr) return;
+    const uint32_t now = this->stage_clock();
+    const uint32_t cycles = now - stamp;
+    rec->stage_cycles[stage] = cycles > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(cycles);
+    stamp = now;
+  }
+
+  // Feed-forward PWM from a normalized load input (0..100 %). A finite load_pct is a
+  // fresh sample; once the input goes stale the contribution decays exponentially
+  // with time constant ff_decay_s.
+  float feedforward_(float load_pct, uint32_t now, float dt) {
+    FtControlState &s = this->state;
+    if (std::isfinite(load_pct)) {
+      s.ff_load_pct = ft_clampf(load_pct, 0.0f, 100.0f);
+      s.ff_pwm_pct =
+          this->config.ff_curve.n >= 2 ? ft_clampf(this->config.ff_curve.eval(s.ff_load_pct), 0.0f, 100.0f) : 0.0f;
+      s.ff_last_input_ms = now;
+    } else {
+      const float tau = this->config.ff_decay_s;
+      s.ff_pwm_pct = tau > 0.0f ? s.ff_pwm_pct * expf(-dt / tau) : 0.0f;
+      if (s.ff_pwm_pct < 0.05f) s.ff_pwm_pct = 0.0f;
+    }
+    return s.ff_pwm_pct;
+  }
+};
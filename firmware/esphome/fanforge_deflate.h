@@ -0,0 +1,346 @@
+#pragma once
+
+// Streaming deflate (RFC 1951) for large responses, wrapped as gzip (RFC 1952)
+// or zlib (RFC 1950, HTTP's "deflate" coding). Portable, no allocation.
+//
+// Sized for the ESP32-C3 rather than for ratio: a 1 KiB window, a hash table
+// with one candidate per bucket (no chains), greedy matching and the fixed
+// Huffman code, so the whole stream is one final fixed block that can be
+// emitted a byte at a time. Responses are long runs of near-identical JSON
+// rows, trace records and metric lines; LZ77 over the last kilobyte catches
+// most of that, and dynamic trees would cost RAM, a second pass and latency
+// for the last few percent.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+static constexpr size_t FT_DEFLATE_WINDOW = 1024;  // max match distance, and the most one write() may take
+static constexpr int FT_DEFLATE_HASH_BITS = 9;
+static constexpr size_t FT_DEFLATE_HEADER_MAX = 10;   // gzip header; zlib's is 2
+static constexpr size_t FT_DEFLATE_TRAILER_MAX = 16;  // end-of-block, padding and the 8-byte gzip trailer
+
+// Worst-case output for n input bytes: every literal takes 9 bits, a match
+// never more than the literals it replaces, plus header and pending bits.
+static constexpr size_t ft_deflate_bound(size_t n) { return n + n / 8 + 16; }
+
+enum FtContentEncoding : uint8_t {
+  FT_ENCODING_IDENTITY = 0,
+  FT_ENCODING_GZIP,
+  FT_ENCODING_DEFLATE,
+  FT_ENCODING_COUNT,
+};
+
+static constexpr const char *FT_ENCODING_NAMES[FT_ENCODING_COUNT] = {"identity", "gzip", "deflate"};
+
+// Picks the response coding for an Accept-Encoding value: gzip, else deflate,
+// when listed (or covered by "*") without q=0; identity otherwise.
+static inline FtContentEncoding ft_accept_encoding(const char *value) {
+  bool gzip = false, deflate = false, any = false;
+  bool gzip_listed = false, deflate_listed = false;
+  const char *p = value;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == ',') p++;
+    const char *name = p;
+    while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ') p++;
+    const size_t len = static_cast<size_t>(p - name);
+    bool ok = true;
+    while (*p != '\0' && *p != ',') {
+      // Parameters: only q matters; "q=0", "q=0.0" and so on refuse the coding.
+      if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+        const char *q = p + 2;
+        ok = false;
+        for (; *q != '\0' && *q != ',' && *q != ';' && *q != ' '; q++) {
+          if (*q >= '1' && *q <= '9') ok = true;
+        }
+        p = q;
+        continue;
+      }
+      p++;
+    }
+    if (len == 4 && strncasecmp(name, "gzip", 4) == 0) {
+      gzip = ok;
+      gzip_listed = true;
+    } else if (len == 7 && strncasecmp(name, "deflate", 7) == 0) {
+      deflate = ok;
+      deflate_listed = true;
+    } else if (len == 1 && *name == '*') {
+      any = ok;
+    }
+  }
+  if (gzip || (any && !gzip_listed)) return FT_ENCODING_GZIP;
+  if (deflate || (any && !deflate_listed)) return FT_ENCODING_DEFLATE;
+  return FT_ENCODING_IDENTITY;
+}
+
+static constexpr uint32_t FT_CRC32_NIBBLE[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static constexpr uint16_t FT_DEFLATE_LEN_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                     31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr uint8_t FT_DEFLATE_LEN_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                     2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr uint16_t FT_DEFLATE_DIST_BASE[30] = {1,   2,   3,   4,    5,    7,    9,    13,    17,    25,
+                                                      33,  49,  65,  97,   129,  193,  257,  385,   513,   769,
+                                                      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static constexpr uint8_t FT_DEFLATE_DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                                      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/**
+ * One compressed response. begin(), then any number of write() calls (or
+ * reserve()/commit() to produce input in place), then finish(). Output is
+ * written to a caller buffer of at least ft_deflate_bound(n) bytes and may be
+ * empty while bits are pending.
+ *
+ * RAM: the window (twice FT_DEFLATE_WINDOW, so a full window of history
+ * always precedes new input) plus the hash table, about 3 KB.
+ */
+class FtDeflate {
+ public:
+  // clock, when set, times the compression work (cycles() reports the sum).
+  void begin(FtContentEncoding encoding, uint32_t (*clock)() = nullptr) {
+    this->encoding_ = encoding;
+    this->clock_ = clock;
+    this->pos_ = 0;
+    this->bits_ = 0;
+    this->nbits_ = 0;
+    this->crc_ = 0xFFFFFFFFu;
+    this->adler_a_ = 1;
+    this->adler_b_ = 0;
+    this->in_bytes_ = 0;
+    this->out_bytes_ = 0;
+    this->cycles_ = 0;
+    this->header_pending_ = true;
+    for (uint16_t &h : this->head_) h = NONE;
+  }
+
+  // Room for n (<= FT_DEFLATE_WINDOW) input bytes, plus one for a printf
+  // terminator; fill it and pass the count to commit().
+  uint8_t *reserve(size_t n) {
+    if (this->pos_ + n > 2 * FT_DEFLATE_WINDOW) this->slide_();
+    return this->win_ + this->pos_;
+  }
+
+  // Compresses the n bytes written at reserve(); returns the bytes put in out.
+  size_t commit(size_t n, uint8_t *out) {
+    const uint32_t t0 = this->clock_ != nullptr ? this->clock_() : 0;
+    this->out_ = out;
+    this->out_len_ = 0;
+    this->start_();
+    this->checksum_(this->win_ + this->pos_, n);
+    this->compress_(this->pos_, this->pos_ + n);
+    this->pos_ += n;
+    this->in_bytes_ += n;
+    return this->done_(t0);
+  }
+
+  size_t write(const void *in, size_t n, uint8_t *out) {
+    memcpy(this->reserve(n), in, n);
+    return this->commit(n, out);
+  }
+
+  // Ends the stream; out needs FT_DEFLATE_TRAILER_MAX bytes, plus FT_DEFLATE_HEADER_MAX if nothing was written.
+  size_t finish(uint8_t *out) {
+    const uint32_t t0 = this->clock_ != nullptr ? this->clock_() : 0;
+    this->out_ = out;
+    this->out_len_ = 0;
+    this->start_();
+    this->put_bits_(0, 7);  // end of block: code 256
+    if (this->nbits_ > 0) this->put_bits_(0, 8 - this->nbits_);
+    if (this->encoding_ == FT_ENCODING_GZIP) {
+      this->put_le32_(this->crc_ ^ 0xFFFFFFFFu);
+      this->put_le32_(static_cast<uint32_t>(this->in_bytes_));
+    } else {
+      const uint32_t adler = (this->adler_b_ % 65521) << 16 | (this->adler_a_ % 65521);
+      for (int s = 24; s >= 0; s -= 8) this->put_byte_(static_cast<uint8_t>(adler >> s));
+    }
+    return this->done_(t0);
+  }
+
+  // Appends the compressed form of n bytes (any length) to out.
+  void append(std::string &out, const void *in, size_t n) {
+    const uint8_t *p = static_cast<const uint8_t *>(in);
+    while (n > 0) {
+      const size_t take = n < FT_DEFLATE_WINDOW ? n : FT_DEFLATE_WINDOW;
+      const size_t at = out.size();
+      out.resize(at + ft_deflate_bound(take));
+      out.resize(at + this->write(p, take, reinterpret_cast<uint8_t *>(&out[at])));
+      p += take;
+      n -= take;
+    }
+  }
+  void append_finish(std::string &out) {
+    const size_t at = out.size();
+    out.resize(at + FT_DEFLATE_HEADER_MAX + FT_DEFLATE_TRAILER_MAX);  // the header too, for an empty body
+    out.resize(at + this->finish(reinterpret_cast<uint8_t *>(&out[at])));
+  }
+
+  FtContentEncoding encoding() const { return this->encoding_; }
+  uint64_t in_bytes() const { return this->in_bytes_; }
+  uint64_t out_bytes() const { return this->out_bytes_; }
+  uint64_t cycles() const { return this->cycles_; }
+
+ private:
+  static constexpr uint16_t NONE = 0xFFFF;
+  static constexpr uint16_t MIN_MATCH = 3;
+  static constexpr uint16_t MAX_MATCH = 258;
+
+  // Stream header and the block header (BFINAL=1, BTYPE=01 fixed Huffman) before the first output.
+  void start_() {
+    if (!this->header_pending_) return;
+    this->header_pending_ = false;
+    if (this->encoding_ == FT_ENCODING_GZIP) {
+      static const uint8_t GZIP_HEADER[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};  // no mtime, OS unknown
+      for (uint8_t b : GZIP_HEADER) this->put_byte_(b);
+    } else {
+      this->put_byte_(0x78);  // CM 8, 32K window (ours is smaller, which any inflater accepts)
+      this->put_byte_(0x01);
+    }
+    this->put_bits_(1, 1);
+    this->put_bits_(1, 2);
+  }
+
+  size_t done_(uint32_t t0) {
+    if (this->clock_ != nullptr) this->cycles_ += this->clock_() - t0;
+    this->out_bytes_ += this->out_len_;
+    return this->out_len_;
+  }
+
+  // Drops all but the last window of history and rebases the hash table.
+  void slide_() {
+    const uint16_t shift = static_cast<uint16_t>(this->pos_ - FT_DEFLATE_WINDOW);
+    memmove(this->win_, this->win_ + shift, FT_DEFLATE_WINDOW);
+    this->pos_ = FT_DEFLATE_WINDOW;
+    for (uint16_t &h : this->head_) h = h != NONE && h >= shift ? static_cast<uint16_t>(h - shift) : NONE;
+  }
+
+  void checksum_(const uint8_t *p, size_t n) {
+    if (this->encoding_ == FT_ENCODING_GZIP) {
+      uint32_t crc = this->crc_;
+      for (size_t i = 0; i < n; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ FT_CRC32_NIBBLE[crc & 15];
+        crc = (crc >> 4) ^ FT_CRC32_NIBBLE[crc & 15];
+      }
+      this->crc_ = crc;
+    } else {
+      // n <= FT_DEFLATE_WINDOW keeps the sums far from overflow between reductions.
+      for (size_t i = 0; i < n; i++) {
+        this->adler_a_ += p[i];
+        this->adler_b_ += this->adler_a_;
+      }
+      this->adler_a_ %= 65521;
+      this->adler_b_ %= 65521;
+    }
+  }
+
+  static uint32_t hash_(const uint8_t *p) {
+    const uint32_t v = p[0] | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16;
+    return (v * 2654435761u) >> (32 - FT_DEFLATE_HASH_BITS);
+  }
+
+  // Greedy LZ77 over win_[from, to), matching back into the window but not past `to`.
+  void compress_(size_t from, size_t to) {
+    size_t i = from;
+    while (i < to) {
+      if (to - i >= MIN_MATCH) {
+        const uint32_t h = hash_(this->win_ + i);
+        const uint16_t cand = this->head_[h];
+        this->head_[h] = static_cast<uint16_t>(i);
+        if (cand != NONE && i - cand <= FT_DEFLATE_WINDOW &&
+            memcmp(this->win_ + cand, this->win_ + i, MIN_MATCH) == 0) {
+          size_t len = MIN_MATCH;
+          const size_t max = to - i < MAX_MATCH ? to - i : MAX_MATCH;
+          while (len < max && this->win_[cand + len] == this->win_[i + len]) len++;
+          this->put_match_(static_cast<uint16_t>(len), static_cast<uint16_t>(i - cand));
+          for (size_t k = i + 1; k < i + len && k + MIN_MATCH <= to; k++)
+            this->head_[hash_(this->win_ + k)] = static_cast<uint16_t>(k);
+          i += len;
+          continue;
+        }
+      }
+      this->put_literal_(this->win_[i]);
+      i++;
+    }
+  }
+
+  // Huffman codes are sent most significant bit first, inside an LSB-first bit stream.
+  void put_code_(uint32_t code, int len) {
+    uint32_t rev = 0;
+    for (int k = 0; k < len; k++) rev |= ((code >> k) & 1u) << (len - 1 - k);
+    this->put_bits_(rev, len);
+  }
+
+  void put_literal_(uint8_t c) {
+    if (c < 144)
+      this->put_code_(0x30 + c, 8);
+    else
+      this->put_code_(0x190 + (c - 144), 9);
+  }
+
+  void put_match_(uint16_t len, uint16_t dist) {
+    int lc = 28;
+    while (FT_DEFLATE_LEN_BASE[lc] > len) lc--;
+    const uint32_t sym = 257 + lc;
+    if (sym < 280)
+      this->put_code_(sym - 256, 7);
+    else
+      this->put_code_(0xC0 + (sym - 280), 8);
+    this->put_bits_(len - FT_DEFLATE_LEN_BASE[lc], FT_DEFLATE_LEN_EXTRA[lc]);
+    int dc = 29;
+    while (FT_DEFLATE_DIST_BASE[dc] > dist) dc--;
+    this->put_code_(static_cast<uint32_t>(dc), 5);
+    this->put_bits_(dist - FT_DEFLATE_DIST_BASE[dc], FT_DEFLATE_DIST_EXTRA[dc]);
+  }
+
+  void put_bits_(uint32_t value, int n) {
+    this->bits_ |= value << this->nbits_;
+    this->nbits_ += n;
+    while (this->nbits_ >= 8) {
+      this->out_[this->out_len_++] = static_cast<uint8_t>(this->bits_);
+      this->bits_ >>= 8;
+      this->nbits_ -= 8;
+    }
+  }
+
+  void put_byte_(uint8_t b) { this->out_[this->out_len_++] = b; }
+  void put_le32_(uint32_t v) {
+    for (int s = 0; s < 32; s += 8) this->put_byte_(static_cast<uint8_t>(v >> s));
+  }
+
+  uint8_t win_[2 * FT_DEFLATE_WINDOW + 1];
+  uint16_t head_[1 << FT_DEFLATE_HASH_BITS];
+  size_t pos_ = 0;
+  uint32_t bits_ = 0;
+  int nbits_ = 0;
+  uint8_t *out_ = nullptr;
+  size_t out_len_ = 0;
+  FtContentEncoding encoding_ = FT_ENCODING_IDENTITY;
+  uint32_t (*clock_)() = nullptr;
+  bool header_pending_ = true;
+  uint32_t crc_ = 0xFFFFFFFFu;
+  uint32_t adler_a_ = 1;
+  uint32_t adler_b_ = 0;
+  uint64_t in_bytes_ = 0;
+  uint64_t out_bytes_ = 0;
+  uint64_t cycles_ = 0;
+};
+
+// Totals over finished compressed responses, for /metrics.
+struct FtDeflateStats {
+  uint32_t responses[FT_ENCODING_COUNT] = {0};  // FT_ENCODING_IDENTITY unused
+  uint64_t in_bytes = 0;
+  uint64_t out_bytes = 0;
+  uint64_t cycles = 0;
+
+  void add(const FtDeflate &d) {
+    this->responses[d.encoding()]++;
+    this->in_bytes += d.in_bytes();
+    this->out_bytes += d.out_bytes();
+    this->cycles += d.cycles();
+  }
+};
@@ -0,0 +1,478 @@
+#pragma once
+
+// Persistent telemetry history: an append-only log of 1 s samples (control
+// temperature, output PWM, flags) on a raw flash partition, kept for days and
+// across reboots.
+//
+// Layout: the partition is a ring of 4 KB segments (one erase sector each).
+// A segment starts with {magic, seq} and holds chunks appended in place; a
+// chunk is a 20-byte header carrying its first sample verbatim plus the rest
+// delta/zigzag/varint coded (about 2 bytes per sample). Samples are staged in
+// RAM and written as one chunk every FT_HISTORY_FLUSH_S, so flash is touched a
+// few times per hour. When the ring is full the oldest segment is erased and
+// reused, so wear spreads evenly over the partition.
+//
+// Time is the history clock: seconds since the log was created, continued
+// across reboots from the newest sample on flash (downtime is not counted).
+// The first-sample time of every segment is kept in RAM as a sparse index, so
+// a range query reads chunk headers only from the segment holding `from` on.
+//
+// The control loop appends while httpd queries. Appends and flushes hold
+// lock_; a query holds it only to take the write position and a copy of the
+// staged samples, then reads flash unlocked. In a segment recycled under the
+// reader, torn chunks fail their checksum and newer ones are skipped.
+//
+// No ESPHome dependencies; the flash is reached through FtHistoryFlash.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+static constexpr uint32_t FT_HISTORY_SECTOR = 4096;
+static constexpr uint32_t FT_HISTORY_MAX_SEGMENTS = 512;  // 2 MB; the index costs 4 bytes per segment
+static constexpr uint32_t FT_HISTORY_FLUSH_S = 300;
+static constexpr uint16_t FT_HISTORY_STAGE_BYTES = 1024;
+static constexpr uint32_t FT_HISTORY_SEGMENT_MAGIC = 0x31484646;  // "FFH1"
+static constexpr uint16_t FT_HISTORY_CHUNK_MAGIC = 0xC4A7;
+static constexpr uint32_t FT_HISTORY_NONE = UINT32_MAX;
+static constexpr int16_t FT_HISTORY_TEMP_NONE = INT16_MIN;
+static constexpr int FT_HISTORY_MAX_SAMPLE_BYTES = 7;  // 3 + 3 varint bytes + flags
+
+enum FtHistoryFlag : uint8_t {
+  FT_HISTORY_F_FAILSAFE = 1 << 0,
+  FT_HISTORY_F_EXTERNAL = 1 << 1,  // temperature from a UDP source
+  FT_HISTORY_F_MODE = 3 << 2,      // FtControlMode << FT_HISTORY_MODE_SHIFT
+  FT_HISTORY_F_BOOT = 1 << 4,      // first sample after a boot
+};
+static constexpr int FT_HISTORY_MODE_SHIFT = 2;
+
+struct FtHistorySample {
+  uint32_t t;      // history clock, s
+  float temp_c;    // NAN when no temperature
+  float pwm_pct;
+  uint8_t flags;   // FtHistoryFlag
+};
+
+// Sector-erasable NOR flash: erase sets 0xFF, writes can only clear bits.
+class FtHistoryFlash {
+ public:
+  virtual ~FtHistoryFlash() = default;
+  virtual uint32_t size() const = 0;
+  virtual bool read(uint32_t offset, void *dst, uint32_t len) = 0;
+  virtual bool write(uint32_t offset, const void *src, uint32_t len) = 0;
+  virtual bool erase_sector(uint32_t offset) = 0;
+};
+
+struct FtHistorySegmentHeader {
+  uint32_t magic;
+  uint32_t seq;
+};
+
+struct FtHistoryChunkHeader {
+  uint16_t magic;
+  uint16_t len;      // payload bytes after the header
+  uint32_t t_first;  // history clock of the first sample; samples are 1 s apart
+  uint16_t count;
+  uint16_t boot;     // boot number the chunk was written in
+  int16_t temp_dd;   // first sample, 0.1 C (FT_HISTORY_TEMP_NONE if absent)
+  uint16_t pwm_pm;   // first sample, 0.1 %
+  uint8_t flags;
+  uint8_t reserved;
+  uint16_t sum;      // Fletcher-16 over the payload, mixed with t_first and count
+};
+static_assert(sizeof(FtHistoryChunkHeader) == 20, "FtHistoryChunkHeader is a flash format");
+
+static inline int16_t ft_history_temp_code(float temp_c) {
+  if (!std::isfinite(temp_c)) return FT_HISTORY_TEMP_NONE;
+  const float dd = roundf(temp_c * 10.0f);
+  return static_cast<int16_t>(dd < -32767.0f ? -32767.0f : (dd > 32767.0f ? 32767.0f : dd));
+}
+
+static inline uint16_t ft_history_pwm_code(float pwm_pct) {
+  const float pm = roundf(pwm_pct * 10.0f);
+  return static_cast<uint16_t>(pm < 0.0f ? 0.0f : (pm > 1000.0f ? 1000.0f : pm));
+}
+
+static inline float ft_history_temp_value(int16_t code) {
+  return code == FT_HISTORY_TEMP_NONE ? NAN : code / 10.0f;
+}
+
+static inline uint16_t ft_history_checksum(const uint8_t *data, uint32_t len, uint32_t t_first, uint16_t count) {
+  uint16_t a = 0, b = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    a = (a + data[i]) % 255;
+    b = (b + a) % 255;
+  }
+  return static_cast<uint16_t>((b << 8) | a) ^ static_cast<uint16_t>(t_first) ^ count;
+}
+
+class FtHistoryStore {
+ public:
+  // Scans the segment headers, finds the write position and continues the
+  // history clock and boot counter from the newest chunk. Returns false (and
+  // stays unmounted) when the flash is too small or unreadable.
+  bool mount(FtHistoryFlash *flash) {
+    this->flash_ = nullptr;
+    const uint32_t segs = flash->size() / FT_HISTORY_SECTOR;
+    this->segments_ = segs > FT_HISTORY_MAX_SEGMENTS ? FT_HISTORY_MAX_SEGMENTS : segs;
+    if (this->segments_ < 2) return false;
+    this->flash_ = flash;
+
+    bool any = false;
+    uint32_t head_seq = 0;
+    for (uint32_t s = 0; s < this->segments_; s++) {
+      FtHistorySegmentHeader sh;
+      FtHistoryChunkHeader ch;
+      this->index_[s] = FT_HISTORY_NONE;
+      if (!flash->read(s * FT_HISTORY_SECTOR, &sh, sizeof(sh))) {
+        this->flash_ = nullptr;
+        return false;
+      }
+      if (sh.magic != FT_HISTORY_SEGMENT_MAGIC) continue;
+      if (!any || static_cast<int32_t>(sh.seq - head_seq) > 0) {
+        head_seq = sh.seq;
+        this->head_ = s;
+      }
+      any = true;
+      if (flash->read(s * FT_HISTORY_SECTOR + sizeof(sh), &ch, sizeof(ch)) && ch.magic == FT_HISTORY_CHUNK_MAGIC)
+        this->index_[s] = ch.t_first;
+    }
+    this->seq_ = head_seq;
+    this->write_off_ = FT_HISTORY_SECTOR;  // nothing to append to: the first flush opens a segment
+    this->clock_base_ = 0;
+    this->boot_ = 0;
+    this->last_t_ = FT_HISTORY_NONE;
+    if (!any) {
+      this->head_ = this->segments_ - 1;
+      return true;
+    }
+
+    // Walk the head segment to its end; a torn chunk ends it.
+    const uint32_t base = this->head_ * FT_HISTORY_SECTOR;
+    uint32_t off = sizeof(FtHistorySegmentHeader);
+    FtHistoryChunkHeader last{};
+    bool have_last = false;
+    while (off + sizeof(FtHistoryChunkHeader) <= FT_HISTORY_SECTOR) {
+      FtHistoryChunkHeader ch;
+      if (!flash->read(base + off, &ch, sizeof(ch)) || ch.magic != FT_HISTORY_CHUNK_MAGIC) break;
+      if (!chunk_fits_(off, ch) || !this->chunk_valid_(base + off, ch)) {
+        off = FT_HISTORY_SECTOR;
+        break;
+      }
+      last = ch;
+      have_last = true;
+      off += sizeof(ch) + ch.len;
+    }
+    // Append only onto erased flash; anything else is the remains of an interrupted write.
+    if (off < FT_HISTORY_SECTOR && !this->erased_(base + off, FT_HISTORY_SECTOR - off)) off = FT_HISTORY_SECTOR;
+    this->write_off_ = off;
+
+    if (!have_last) {
+      // The head was opened but never written; the newest chunk is in the segment before it.
+      const uint32_t prev = (this->head_ + this->segments_ - 1) % this->segments_;
+      have_last = this->last_chunk_(prev, last);
+    }
+    if (have_last) {
+      this->clock_base_ = last.t_first + last.count;
+      this->last_t_ = this->clock_base_ - 1;
+      this->boot_ = static_cast<uint16_t>(last.boot + 1);
+    }
+    return true;
+  }
+
+  bool mounted() const { return this->flash_ != nullptr; }
+
+  // History clock for a given uptime.
+  uint32_t now_s(uint32_t uptime_s) const { return this->clock_base_ + uptime_s; }
+
+  // Appends one sample at history time t (normally once per second). Samples
+  // at or before the previous one are dropped; a gap starts a new chunk.
+  void append(uint32_t t, float temp_c, float pwm_pct, uint8_t flags) {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    if (!this->mounted() || (this->last_t_ != FT_HISTORY_NONE && t <= this->last_t_)) return;
+    if (this->stage_count_ > 0 && (t != this->last_t_ + 1 || this->stage_count_ == UINT16_MAX)) this->flush_();
+    if (!this->booted_) {
+      flags |= FT_HISTORY_F_BOOT;
+      this->booted_ = true;
+    }
+    const int16_t temp = ft_history_temp_code(temp_c);
+    const uint16_t pwm = ft_history_pwm_code(pwm_pct);
+    if (this->stage_count_ == 0) {
+      this->stage_ = FtHistoryChunkHeader{};
+      this->stage_.magic = FT_HISTORY_CHUNK_MAGIC;
+      this->stage_.t_first = t;
+      this->stage_.boot = this->boot_;
+      this->stage_.temp_dd = temp;
+      this->stage_.pwm_pm = pwm;
+      this->stage_.flags = flags;
+      this->stage_len_ = 0;
+    } else {
+      const int32_t dt = static_cast<int32_t>(temp) - this->last_temp_;
+      const int32_t dp = static_cast<int32_t>(pwm) - this->last_pwm_;
+      const bool flags_changed = flags != this->last_flags_;
+      this->put_varint_((zigzag_(dt) << 1) | (flags_changed ? 1u : 0u));
+      this->put_varint_(zigzag_(dp));
+      if (flags_changed) this->stage_buf_[this->stage_len_++] = flags;
+    }
+    this->stage_count_++;
+    this->last_t_ = t;
+    this->last_temp_ = temp;
+    this->last_pwm_ = pwm;
+    this->last_flags_ = flags;
+    if (this->stage_len_ + FT_HISTORY_MAX_SAMPLE_BYTES > FT_HISTORY_STAGE_BYTES) this->flush_();
+  }
+
+  // Writes the staged chunk once it is FT_HISTORY_FLUSH_S old.
+  void poll(uint32_t t) {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    if (this->stage_count_ > 0 && t - this->stage_.t_first >= FT_HISTORY_FLUSH_S) this->flush_();
+  }
+
+  // Writes the staged samples as one chunk, opening (and if needed recycling)
+  // the next segment when the head is full.
+  bool flush() {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    return this->flush_();
+  }
+
+  // Calls visit(const FtHistorySample &) for every stored sample with
+  // from <= t <= to, oldest first, including samples not yet flushed. visit
+  // returns false to stop. Returns the number of samples visited.
+  template<typename F> uint32_t query(uint32_t from, uint32_t to, F &&visit) {
+    if (!this->mounted() || from > to) return 0;
+    uint32_t visited = 0;
+    bool stop = false;
+
+    // Chunks flushed after the snapshot start at or past flashed_end; they
+    // only show up in a segment recycled under the reader and are skipped
+    // (an erased one ends at its first header).
+    uint32_t head, head_end, flashed_end;
+    FtHistoryChunkHeader staged;
+    // Sparse index: start at the newest segment whose first sample is at or before `from`.
+    uint32_t start = FT_HISTORY_NONE;
+    {
+      std::lock_guard<std::mutex> lock(this->lock_);
+      head = this->head_;
+      head_end = this->write_off_;
+      staged = this->stage_;
+      staged.len = this->stage_len_;
+      staged.count = this->stage_count_;
+      memcpy(this->query_stage_, this->stage_buf_, this->stage_len_);
+      flashed_end = staged.count > 0 ? staged.t_first : this->last_t_ == FT_HISTORY_NONE ? 0 : this->last_t_ + 1;
+      for (uint32_t i = 0; i < this->segments_; i++) {
+        const uint32_t s = (head + 1 + i) % this->segments_;
+        const uint32_t t0 = this->index_[s];
+        if (t0 == FT_HISTORY_NONE) continue;
+        if (start == FT_HISTORY_NONE || t0 <= from) start = i;
+        if (t0 > from) break;
+      }
+    }
+    for (uint32_t i = start; start != FT_HISTORY_NONE && i < this->segments_ && !stop; i++) {
+      // index_ may change under the reader; the chunk headers decide from here.
+      const uint32_t s = (head + 1 + i) % this->segments_;
+      const uint32_t base = s * FT_HISTORY_SECTOR;
+      const uint32_t end = s == head ? head_end : FT_HISTORY_SECTOR;
+      uint32_t off = sizeof(FtHistorySegmentHeader);
+      while (off + sizeof(FtHistoryChunkHeader) <= end && !stop) {
+        FtHistoryChunkHeader ch;
+        if (!this->flash_->read(base + off, &ch, sizeof(ch)) || ch.magic != FT_HISTORY_CHUNK_MAGIC ||
+            !chunk_fits_(off, ch))
+          break;
+        const uint32_t payload = base + off + sizeof(ch);
+        off += sizeof(ch) + ch.len;
+        if (ch.t_first >= flashed_end) continue;
+        if (ch.t_first > to) {
+          stop = true;
+          break;
+        }
+        if (ch.t_first + ch.count <= from) continue;  // header only: skip without reading the payload
+        if (!this->flash_->read(payload, this->read_buf_, ch.len) ||
+            ft_history_checksum(this->read_buf_, ch.len, ch.t_first, ch.count) != ch.sum)
+          continue;
+        stop = !decode_(ch, this->read_buf_, from, to, visit, visited);
+      }
+    }
+    if (!stop && staged.count > 0) decode_(staged, this->query_stage_, from, to, visit, visited);
+    return visited;
+  }
+
+  // Oldest sample time still on flash (or staged), FT_HISTORY_NONE if empty.
+  uint32_t oldest_t() const {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    for (uint32_t i = 0; i < this->segments_; i++) {
+      const uint32_t t0 = this->index_[(this->head_ + 1 + i) % this->segments_];
+      if (t0 != FT_HISTORY_NONE) return t0;
+    }
+    return this->stage_count_ > 0 ? this->stage_.t_first : FT_HISTORY_NONE;
+  }
+
+  uint16_t boot() const { return this->boot_; }
+  uint32_t segments() const { return this->segments_; }
+  uint32_t segments_used() const {
+    uint32_t n = 0;
+    for (uint32_t s = 0; s < this->segments_; s++) n += this->index_[s] != FT_HISTORY_NONE ? 1 : 0;
+    return n;
+  }
+  uint32_t staged() const { return this->stage_count_; }
+  uint32_t flash_writes() const { return this->flash_writes_; }
+  uint32_t bytes_written() const { return this->bytes_written_; }
+  uint32_t segments_recycled() const { return this->segments_recycled_; }
+  uint32_t write_errors() const { return this->write_errors_; }
+
+ protected:
+  bool flush_() {
+    if (!this->mounted() || this->stage_count_ == 0) return true;
+    FtHistoryChunkHeader ch = this->stage_;
+    ch.len = this->stage_len_;
+    ch.count = this->stage_count_;
+    ch.sum = ft_history_checksum(this->stage_buf_, ch.len, ch.t_first, ch.count);
+    this->stage_count_ = 0;
+    this->stage_len_ = 0;
+
+    if (this->write_off_ + sizeof(ch) + ch.len > FT_HISTORY_SECTOR && !this->open_next_segment_()) {
+      this->write_errors_++;
+      return false;
+    }
+    const uint32_t off = this->head_ * FT_HISTORY_SECTOR + this->write_off_;
+    // Payload first, header last: a write cut short leaves no valid-looking chunk.
+    const bool ok = (ch.len == 0 || this->flash_->write(off + sizeof(ch), this->stage_buf_, ch.len)) &&
+                    this->flash_->write(off, &ch, sizeof(ch));
+    this->write_off_ += sizeof(ch) + ch.len;
+    if (!ok) {
+      this->write_errors_++;
+      return false;
+    }
+    if (this->index_[this->head_] == FT_HISTORY_NONE) this->index_[this->head_] = ch.t_first;
+    this->flash_writes_++;
+    this->bytes_written_ += sizeof(ch) + ch.len;
+    return true;
+  }
+
+  static uint32_t zigzag_(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+  static int32_t unzigzag_(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+  void put_varint_(uint32_t v) {
+    while (v >= 0x80) {
+      this->stage_buf_[this->stage_len_++] = static_cast<uint8_t>(v | 0x80);
+      v >>= 7;
+    }
+    this->stage_buf_[this->stage_len_++] = static_cast<uint8_t>(v);
+  }
+
+  static bool get_varint_(const uint8_t *buf, uint32_t len, uint32_t &pos, uint32_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 32 && pos < len; shift += 7) {
+      const uint8_t b = buf[pos++];
+      v |= static_cast<uint32_t>(b & 0x7F) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  template<typename F>
+  static bool decode_(const FtHistoryChunkHeader &ch, const uint8_t *buf, uint32_t from, uint32_t to, F &visit,
+                      uint32_t &visited) {
+    int32_t temp = ch.temp_dd;
+    int32_t pwm = ch.pwm_pm;
+    uint8_t flags = ch.flags;
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < ch.count; i++) {
+      if (i > 0) {
+        uint32_t a, b;
+        if (!get_varint_(buf, ch.len, pos, a) || !get_varint_(buf, ch.len, pos, b)) return true;
+        temp += unzigzag_(a >> 1);
+        pwm += unzigzag_(b);
+        if (a & 1) {
+          if (pos >= ch.len) return true;
+          flags = buf[pos++];
+        }
+      }
+      const uint32_t t = ch.t_first + i;
+      if (t < from) continue;
+      if (t > to) return false;
+      const FtHistorySample sample{t, ft_history_temp_value(static_cast<int16_t>(temp)), pwm / 10.0f, flags};
+      visited++;
+      if (!visit(sample)) return false;
+    }
+    return true;
+  }
+
+  // A chunk header that cannot be real (torn or garbage) ends the segment.
+  static bool chunk_fits_(uint32_t off, const FtHistoryChunkHeader &ch) {
+    return ch.len <= FT_HISTORY_STAGE_BYTES && off + sizeof(ch) + ch.len <= FT_HISTORY_SECTOR;
+  }
+
+  bool chunk_valid_(uint32_t offset, const FtHistoryChunkHeader &ch) {
+    return this->flash_->read(offset + sizeof(ch), this->read_buf_, ch.len) &&
+           ft_history_checksum(this->read_buf_, ch.len, ch.t_first, ch.count) == ch.sum;
+  }
+
+  bool erased_(uint32_t offset, uint32_t len) {
+    while (len > 0) {
+      const uint32_t n = len > FT_HISTORY_STAGE_BYTES ? FT_HISTORY_STAGE_BYTES : len;
+      if (!this->flash_->read(offset, this->read_buf_, n)) return false;
+      for (uint32_t i = 0; i < n; i++)
+        if (this->read_buf_[i] != 0xFF) return false;
+      offset += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool last_chunk_(uint32_t seg, FtHistoryChunkHeader &last) {
+    if (this->index_[seg] == FT_HISTORY_NONE) return false;
+    const uint32_t base = seg * FT_HISTORY_SECTOR;
+    uint32_t off = sizeof(FtHistorySegmentHeader);
+    bool found = false;
+    FtHistoryChunkHeader ch;
+    while (off + sizeof(ch) <= FT_HISTORY_SECTOR && this->flash_->read(base + off, &ch, sizeof(ch)) &&
+           ch.magic == FT_HISTORY_CHUNK_MAGIC && chunk_fits_(off, ch)) {
+      last = ch;
+      found = true;
+      off += sizeof(ch) + ch.len;
+    }
+    return found;
+  }
+
+  bool open_next_segment_() {
+    const uint32_t next = (this->head_ + 1) % this->segments_;
+    const uint32_t base = next * FT_HISTORY_SECTOR;
+    if (this->index_[next] != FT_HISTORY_NONE) this->segments_recycled_++;
+    this->index_[next] = FT_HISTORY_NONE;
+    this->head_ = next;
+    this->write_off_ = FT_HISTORY_SECTOR;
+    if (!this->flash_->erase_sector(base)) return false;
+    const FtHistorySegmentHeader sh{FT_HISTORY_SEGMENT_MAGIC, ++this->seq_};
+    if (!this->flash_->write(base, &sh, sizeof(sh))) return false;
+    this->write_off_ = sizeof(sh);
+    return true;
+  }
+
+  FtHistoryFlash *flash_ = nullptr;
+  uint32_t index_[FT_HISTORY_MAX_SEGMENTS];
+  uint32_t segments_ = 0;
+  uint32_t head_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t write_off_ = FT_HISTORY_SECTOR;
+  uint32_t clock_base_ = 0;
+  uint16_t boot_ = 0;
+  bool booted_ = false;
+
+  FtHistoryChunkHeader stage_{};
+  uint8_t stage_buf_[FT_HISTORY_STAGE_BYTES];
+  uint16_t stage_len_ = 0;
+  uint16_t stage_count_ = 0;
+  uint32_t last_t_ = FT_HISTORY_NONE;
+  int32_t last_temp_ = 0;
+  int32_t last_pwm_ = 0;
+  uint8_t last_flags_ = 0;
+  uint8_t read_buf_[FT_HISTORY_STAGE_BYTES];     // query and mount only
+  uint8_t query_stage_[FT_HISTORY_STAGE_BYTES];  // query's copy of stage_buf_
+  mutable std::mutex lock_;
+
+  uint32_t flash_writes_ = 0;
+  uint32_t bytes_written_ = 0;
+  uint32_t segments_recycled_ = 0;
+  uint32_t write_errors_ = 0;
+};
@@ -0,0 +1,330 @@
+#pragma once
+
+// Authenticated UDP ingest of externally supplied readings ("virtual sources").
+// Portable: shared by the firmware, the Linux host agent and the test receiver.
+//
+// Datagram layout (little endian):
+//   header  : magic "FFU1" | sender_id:u16 | count:u8 | reserved:u8 | epoch:u32 | seq:u32
+//   record  : sensor_id:u8 | kind:u8 | reserved:u16 | value:f32          (count times)
+//   tag     : SipHash-2-4(key, header || records), 8 bytes
+//
+// Replay protection is per sender: (epoch, seq), compared as one 64-bit counter,
+// must strictly increase, stale or not. Senders must not reuse a value after
+// restarting (the host agent starts from the realtime clock in microseconds).
+
+#include <cstdint>
+#include <cstring>
+
+static constexpr uint8_t FT_INGEST_MAGIC[4] = {'F', 'F', 'U', '1'};
+static constexpr size_t FT_INGEST_HEADER_BYTES = 16;
+static constexpr size_t FT_INGEST_RECORD_BYTES = 8;
+static constexpr size_t FT_INGEST_TAG_BYTES = 8;
+static constexpr int FT_INGEST_MAX_RECORDS = 16;
+static constexpr size_t FT_INGEST_MAX_DATAGRAM =
+    FT_INGEST_HEADER_BYTES + FT_INGEST_MAX_RECORDS * FT_INGEST_RECORD_BYTES + FT_INGEST_TAG_BYTES;
+static constexpr uint16_t FT_INGEST_DEFAULT_PORT = 47808;
+
+static constexpr int FT_VSRC_MAX = 8;
+static constexpr int FT_INGEST_MAX_SENDERS = 4;
+static constexpr uint32_t FT_VSRC_DEFAULT_STALE_MS = 2000;
+
+enum FtSourceKind : uint8_t {
+  FT_SOURCE_TEMP_C = 0,
+  FT_SOURCE_LOAD_PCT = 1,
+  FT_SOURCE_POWER_W = 2,
+};
+
+struct FtIngestRecord {
+  uint8_t sensor_id;
+  uint8_t kind;
+  float value;
+};
+
+// ---------- SipHash-2-4 ----------
+
+static inline uint64_t ft_rotl64(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+static inline uint64_t ft_load_le64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+static inline uint64_t ft_siphash24(const uint8_t key[16], const uint8_t *data, size_t len) {
+  const uint64_t k0 = ft_load_le64(key);
+  const uint64_t k1 = ft_load_le64(key + 8);
+  uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+  uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+  uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+  auto round = [&]() {
+    v0 += v1;
+    v1 = ft_rotl64(v1, 13);
+    v1 ^= v0;
+    v0 = ft_rotl64(v0, 32);
+    v2 += v3;
+    v3 = ft_rotl64(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = ft_rotl64(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = ft_rotl64(v1, 17);
+    v1 ^= v2;
+    v2 = ft_rotl64(v2, 32);
+  };
+
+  const size_t full = len & ~static_cast<size_t>(7);
+  for (size_t i = 0; i < full; i += 8) {
+    uint64_t m = ft_load_le64(data + i);
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  }
+  uint64_t b = static_cast<uint64_t>(len) << 56;
+  for (size_t i = 0; i < (len & 7); i++) b |= static_cast<uint64_t>(data[full + i]) << (8 * i);
+  v3 ^= b;
+  round();
+  round();
+  v0 ^= b;
+  v2 ^= 0xff;
+  round();
+  round();
+  round();
+  round();
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// Parses 32 hex characters into a 128-bit key.
+static inline bool ft_parse_key_hex(const char *hex, uint8_t key[16]) {
+  if (hex == nullptr || strlen(hex) != 32) return false;
+  for (int i = 0; i < 16; i++) {
+    uint8_t byte = 0;
+    for (int j = 0; j < 2; j++) {
+      char c = hex[i * 2 + j];
+      uint8_t nib;
+      if (c >= '0' && c <= '9')
+        nib = c - '0';
+      else if (c >= 'a' && c <= 'f')
+        nib = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        nib = c - 'A' + 10;
+      else
+        return false;
+      byte = static_cast<uint8_t>((byte << 4) | nib);
+    }
+    key[i] = byte;
+  }
+  return true;
+}
+
+// ---------- encode / decode ----------
+
+static inline void ft_put_le32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static inline uint32_t ft_get_le32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Returns datagram length, or 0 if the records do not fit.
+static inline size_t ft_ingest_encode(const uint8_t key[16], uint16_t sender_id, uint32_t epoch, uint32_t seq,
+                                      const FtIngestRecord *records, int count, uint8_t *out, size_t cap) {
+  if (count < 1 || count > FT_INGEST_MAX_RECORDS) return 0;
+  const size_t body = FT_INGEST_HEADER_BYTES + count * FT_INGEST_RECORD_BYTES;
+  if (cap < body + FT_INGEST_TAG_BYTES) return 0;
+
+  memcpy(out, FT_INGEST_MAGIC, 4);
+  out[4] = static_cast<uint8_t>(sender_id);
+  out[5] = static_cast<uint8_t>(sender_id >> 8);
+  out[6] = static_cast<uint8_t>(count);
+  out[7] = 0;
+  ft_put_le32(out + 8, epoch);
+  ft_put_le32(out + 12, seq);
+  uint8_t *p = out + FT_INGEST_HEADER_BYTES;
+  for (int i = 0; i < count; i++) {
+    uint32_t bits;
+    memcpy(&bits, &records[i].value, 4);
+    p[0] = records[i].sensor_id;
+    p[1] = records[i].kind;
+    p[2] = 0;
+    p[3] = 0;
+    ft_put_le32(p + 4, bits);
+    p += FT_INGEST_RECORD_BYTES;
+  }
+  const uint64_t tag = ft_siphash24(key, out, body);
+  for (size_t i = 0; i < FT_INGEST_TAG_BYTES; i++) out[body + i] = static_cast<uint8_t>(tag >> (8 * i));
+  return body + FT_INGEST_TAG_BYTES;
+}
+
+enum FtIngestResult : uint8_t {
+  FT_INGEST_OK = 0,
+  FT_INGEST_BAD_FORMAT,
+  FT_INGEST_BAD_TAG,
+  FT_INGEST_REPLAYED,
+  FT_INGEST_NO_SLOT,
+};
+
+struct FtVirtualSource {
+  uint8_t sensor_id;
+  uint8_t kind;
+  bool used;
+  float value;
+  uint32_t last_rx_ms;
+};
+
+struct FtIngestSender {
+  uint16_t sender_id;
+  bool used;
+  uint32_t epoch;
+  uint32_t seq;
+  uint32_t last_rx_ms;
+};
+
+struct FtIngestStats {
+  uint32_t accepted = 0;
+  uint32_t bad_format = 0;
+  uint32_t bad_tag = 0;
+  uint32_t replayed = 0;
+  uint32_t no_slot = 0;
+};
+
+/**
+ * Fixed-size table of virtual sources fed by authenticated datagrams.
+ *
+ * Everything is preallocated: handling a datagram is parse, one SipHash pass and
+ * a few table writes. A full sender table refuses new senders; a full source
+ * table only reuses slots that have gone stale.
+ */
+class FtIngestTable {
+ public:
+  void set_key(const uint8_t key[16]) {
+    memcpy(this->key_, key, 16);
+    this->has_key_ = true;
+  }
+  bool has_key() const { return this->has_key_; }
+  void set_stale_ms(uint32_t stale_ms) { this->stale_ms_ = stale_ms; }
+  uint32_t stale_ms() const { return this->stale_ms_; }
+  const FtIngestStats &stats() const { return this->stats_; }
+
+  FtIngestResult handle_datagram(const uint8_t *data, size_t len, uint32_t now_ms) {
+    FtIngestResult r = this->handle_(data, len, now_ms);
+    switch (r) {
+      case FT_INGEST_OK:
+        this->stats_.accepted++;
+        break;
+      case FT_INGEST_BAD_FORMAT:
+        this->stats_.bad_format++;
+        break;
+      case FT_INGEST_BAD_TAG:
+        this->stats_.bad_tag++;
+        break;
+      case FT_INGEST_REPLAYED:
+        this->stats_.replayed++;
+        break;
+      case FT_INGEST_NO_SLOT:
+        this->stats_.no_slot++;
+        break;
+    }
+    return r;
+  }
+
+  // Returns true and the value if `sensor_id` of `kind` was heard within the staleness timeout.
+  bool get(uint8_t sensor_id, uint8_t kind, uint32_t now_ms, float &value, uint32_t *age_ms = nullptr) const {
+    for (const FtVirtualSource &s : this->sources_) {
+      if (!s.used || s.sensor_id != sensor_id || s.kind != kind) continue;
+      const uint32_t age = now_ms - s.last_rx_ms;
+      if (age_ms) *age_ms = age;
+      if (age > this->stale_ms_) return false;
+      value = s.value;
+      return true;
+    }
+    return false;
+  }
+
+  const FtVirtualSource *sources() const { return this->sources_; }
+
+ private:
+  FtIngestResult handle_(const uint8_t *data, size_t len, uint32_t now_ms) {
+    if (!this->has_key_) return FT_INGEST_BAD_TAG;
+    if (len < FT_INGEST_HEADER_BYTES + FT_INGEST_RECORD_BYTES + FT_INGEST_TAG_BYTES) return FT_INGEST_BAD_FORMAT;
+    if (memcmp(data, FT_INGEST_MAGIC, 4) != 0) return FT_INGEST_BAD_FORMAT;
+    const int count = data[6];
+    const size_t body = FT_INGEST_HEADER_BYTES + count * FT_INGEST_RECORD_BYTES;
+    if (count < 1 || count > FT_INGEST_MAX_RECORDS || len != body + FT_INGEST_TAG_BYTES) return FT_INGEST_BAD_FORMAT;
+
+    // Constant-time tag compare.
+    const uint64_t tag = ft_siphash24(this->key_, data, body);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < FT_INGEST_TAG_BYTES; i++) diff |= data[body + i] ^ static_cast<uint8_t>(tag >> (8 * i));
+    if (diff != 0) return FT_INGEST_BAD_TAG;
+
+    const uint16_t sender_id = static_cast<uint16_t>(data[4] | (data[5] << 8));
+    const uint32_t epoch = ft_get_le32(data + 8);
+    const uint32_t seq = ft_get_le32(data + 12);
+    FtIngestSender *sender = this->sender_slot_(sender_id);
+    if (sender == nullptr) return FT_INGEST_NO_SLOT;
+    if (sender->used && (epoch < sender->epoch || (epoch == sender->epoch && seq <= sender->seq)))
+      return FT_INGEST_REPLAYED;
+    sender->sender_id = sender_id;
+    sender->used = true;
+    sender->epoch = epoch;
+    sender->seq = seq;
+    sender->last_rx_ms = now_ms;
+
+    const uint8_t *p = data + FT_INGEST_HEADER_BYTES;
+    bool stored = true;
+    for (int i = 0; i < count; i++, p += FT_INGEST_RECORD_BYTES) {
+      uint32_t bits = ft_get_le32(p + 4);
+      float value;
+      memcpy(&value, &bits, 4);
+      if (!(value == value)) continue;  // drop NaN readings
+      FtVirtualSource *src = this->source_slot_(p[0], p[1], now_ms);
+      if (src == nullptr) {
+        stored = false;
+        continue;
+      }
+      src->value = value;
+      src->last_rx_ms = now_ms;
+    }
+    return stored ? FT_INGEST_OK : FT_INGEST_NO_SLOT;
+  }
+
+  // A sender keeps its slot (and replay window) until reboot: evicting one would
+  // let its captured datagrams be replayed, so a full table refuses new senders.
+  FtIngestSender *sender_slot_(uint16_t sender_id) {
+    FtIngestSender *free_slot = nullptr;
+    for (FtIngestSender &s : this->senders_) {
+      if (s.used && s.sender_id == sender_id) return &s;
+      if (!s.used && free_slot == nullptr) free_slot = &s;
+    }
+    return free_slot;
+  }
+
+  FtVirtualSource *source_slot_(uint8_t sensor_id, uint8_t kind, uint32_t now_ms) {
+    FtVirtualSource *free_slot = nullptr;
+    FtVirtualSource *stale_slot = nullptr;
+    for (FtVirtualSource &s : this->sources_) {
+      if (s.used && s.sensor_id == sensor_id && s.kind == kind) return &s;
+      if (!s.used && free_slot == nullptr) free_slot = &s;
+      if (s.used && (now_ms - s.last_rx_ms) > this->stale_ms_ && stale_slot == nullptr) stale_slot = &s;
+    }
+    FtVirtualSource *slot = free_slot ? free_slot : stale_slot;
+    if (slot == nullptr) return nullptr;
+    slot->used = true;
+    slot->sensor_id = sensor_id;
+    slot->kind = kind;
+    return slot;
+  }
+
+  uint8_t key_[16] = {0};
+  bool has_key_ = false;
+  uint32_t stale_ms_ = FT_VSRC_DEFAULT_STALE_MS;
+  FtVirtualSource sources_[FT_VSRC_MAX] = {};
+  FtIngestSender senders_[FT_INGEST_MAX_SENDERS] = {};
+  FtIngestStats stats_;
+};
@@ -0,0 +1,410 @@
+#pragma once
+
+// Minimal JSON reader and writer for the generated API code (fanforge_api_gen.h).
+//
+// FtJsonReader is a pull parser over a caller-owned buffer: no allocation, no
+// DOM, one pass. The generated parsers drive it key by key and validate values
+// as they are read. Strings come back as raw spans (escapes left in place) for
+// enums and keys, or decoded into a fixed buffer by read_text(). FtJsonWriter
+// appends compact JSON to a std::string.
+//
+// No ESPHome dependencies.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <string>
+
+static constexpr int FT_JSON_MAX_DEPTH = 16;
+
+class FtJsonReader {
+ public:
+  FtJsonReader(const char *data, size_t len) : p_(data), begin_(data), end_(data + len) {}
+  explicit FtJsonReader(const std::string &s) : FtJsonReader(s.data(), s.size()) {}
+
+  bool ok() const { return this->error_ == nullptr; }
+  const char *error() const { return this->error_; }
+  size_t offset() const { return static_cast<size_t>(this->p_ - this->begin_); }
+
+  bool begin_object() { return this->open_('{'); }
+  bool begin_array() { return this->open_('['); }
+
+  // Next member of the current object: sets key/len and consumes the ':'.
+  // Returns false at the closing '}' or on a syntax error (ok() tells which).
+  bool next_key(const char *&key, size_t &len) {
+    if (!this->next_('}')) return false;
+    if (!this->read_string(key, len)) return this->fail_("expected a string key");
+    this->skip_ws_();
+    if (this->p_ >= this->end_ || *this->p_ != ':') return this->fail_("expected ':'");
+    this->p_++;
+    return true;
+  }
+
+  // True while the current array has another element to read.
+  bool next_item() { return this->next_(']'); }
+
+  bool read_number(float &out) {
+    this->skip_ws_();
+    const char *start = this->p_;
+    bool integral = true;
+    if (!this->scan_number_(integral)) return false;
+    char buf[32];
+    const size_t n = static_cast<size_t>(this->p_ - start);
+    if (n >= sizeof(buf)) return this->fail_("number too long");
+    memcpy(buf, start, n);
+    buf[n] = '\0';
+    out = strtof(buf, nullptr);
+    return std::isfinite(out);
+  }
+
+  // A JSON number without fraction or exponent that fits in int64.
+  bool read_int(int64_t &out) {
+    this->skip_ws_();
+    const char *start = this->p_;
+    bool integral = true;
+    if (!this->scan_number_(integral)) return false;
+    if (!integral) {
+      this->p_ = start;
+      return false;
+    }
+    const bool neg = *start == '-';
+    uint64_t v = 0;
+    for (const char *c = start + (neg ? 1 : 0); c < this->p_; c++) {
+      if (v > (UINT64_MAX - 9) / 10) return false;
+      v = v * 10 + static_cast<uint64_t>(*c - '0');
+    }
+    if (v > static_cast<uint64_t>(INT64_MAX)) return false;
+    out = neg ? -static_cast<int64_t>(v) : static_cast<int64_t>(v);
+    return true;
+  }
+
+  bool read_bool(bool &out) {
+    if (this->literal_("true")) {
+      out = true;
+      return true;
+    }
+    if (this->literal_("false")) {
+      out = false;
+      return true;
+    }
+    return false;
+  }
+
+  bool read_null() { return this->literal_("null"); }
+
+  // Raw string contents between the quotes; escape sequences are validated but not decoded.
+  bool read_string(const char *&s, size_t &len) {
+    this->skip_ws_();
+    if (this->p_ >= this->end_ || *this->p_ != '"') return false;
+    const char *c = this->p_ + 1;
+    while (c < this->end_ && *c != '"') {
+      const unsigned char ch = static_cast<unsigned char>(*c);
+      if (ch < 0x20) return this->fail_("control character in string");
+      if (ch == '\\') {
+        if (++c >= this->end_) break;
+        if (*c == 'u') {
+          for (int i = 0; i < 4; i++) {
+            if (++c >= this->end_ || !isxdigit(static_cast<unsigned char>(*c))) return this->fail_("bad \\u escape");
+          }
+        } else if (strchr("\"\\/bfnrt", *c) == nullptr) {
+          return this->fail_("bad escape");
+        }
+      }
+      c++;
+    }
+    if (c >= this->end_) return this->fail_("unterminated string");
+    s = this->p_ + 1;
+    len = static_cast<size_t>(c - s);
+    this->p_ = c + 1;
+    return true;
+  }
+
+  // String value with its escapes decoded into dst as NUL-terminated UTF-8.
+  // False if the value is not a string, holds U+0000 or needs cap bytes or more.
+  bool read_text(char *dst, size_t cap) {
+    const char *s;
+    size_t n;
+    if (cap == 0 || !this->read_string(s, n)) return false;
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+      uint32_t cp = static_cast<unsigned char>(s[i]);
+      if (cp == '\\') {
+        const char e = s[++i];
+        if (e == 'u') {
+          cp = hex4_(s + i + 1);
+          i += 4;
+          // A surrogate pair spells one code point; a lone half becomes U+FFFD.
+          if (cp >= 0xd800 && cp < 0xdc00 && i + 6 < n && s[i + 1] == '\\' && s[i + 2] == 'u') {
+            const uint32_t lo = hex4_(s + i + 3);
+            if (lo >= 0xdc00 && lo < 0xe000) {
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+              i += 6;
+            }
+          }
+          if (cp >= 0xd800 && cp < 0xe000) cp = 0xfffd;
+        } else {
+          static const char FROM[] = "\"\\/bfnrt";
+          static const char TO[] = "\"\\/\b\f\n\r\t";
+          cp = static_cast<unsigned char>(TO[strchr(FROM, e) - FROM]);
+        }
+      }
+      if (cp == 0 || !put_utf8_(cp, dst, cap, len)) return false;
+    }
+    dst[len] = '\0';
+    return true;
+  }
+
+  // Skips one value of any type (unknown keys are ignored, as before).
+  bool skip_value() {
+    this->skip_ws_();
+    if (this->p_ >= this->end_) return this->fail_("unexpected end of input");
+    const char *s;
+    size_t len;
+    bool b;
+    switch (*this->p_) {
+      case '"':
+        return this->read_string(s, len);
+      case '{':
+        if (!this->begin_object()) return false;
+        while (this->next_key(s, len)) {
+          if (!this->skip_value()) return false;
+        }
+        return this->ok();
+      case '[':
+        if (!this->begin_array()) return false;
+        while (this->next_item()) {
+          if (!this->skip_value()) return false;
+        }
+        return this->ok();
+      case 't':
+      case 'f':
+        return this->read_bool(b) || this->fail_("bad literal");
+      case 'n':
+        return this->read_null() || this->fail_("bad literal");
+      default: {
+        bool integral;
+        return this->scan_number_(integral) || this->fail_("unexpected character");
+      }
+    }
+  }
+
+  // Only whitespace may follow the top-level value.
+  bool finish() {
+    this->skip_ws_();
+    return this->p_ == this->end_ || this->fail_("trailing characters");
+  }
+
+ protected:
+  static uint32_t hex4_(const char *h) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+      const char c = h[i];
+      v = v * 16 + static_cast<uint32_t>(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return v;
+  }
+
+  // Appends cp as UTF-8, keeping room for the terminator.
+  static bool put_utf8_(uint32_t cp, char *dst, size_t cap, size_t &len) {
+    uint8_t b[4];
+    size_t n;
+    if (cp < 0x80) {
+      b[0] = static_cast<uint8_t>(cp);
+      n = 1;
+    } else if (cp < 0x800) {
+      b[0] = static_cast<uint8_t>(0xc0 | (cp >> 6));
+      b[1] = static_cast<uint8_t>(0x80 | (cp & 0x3f));
+      n = 2;
+    } else if (cp < 0x10000) {
+      b[0] = static_cast<uint8_t>(0xe0 | (cp >> 12));
+      b[1] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3f));
+      b[2] = static_cast<uint8_t>(0x80 | (cp & 0x3f));
+      n = 3;
+    } else {
+      b[0] = static_cast<uint8_t>(0xf0 | (cp >> 18));
+      b[1] = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3f));
+      b[2] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3f));
+      b[3] = static_cast<uint8_t>(0x80 | (cp & 0x3f));
+      n = 4;
+    }
+    if (len + n >= cap) return false;
+    memcpy(dst + len, b, n);
+    len += n;
+    return true;
+  }
+
+  void skip_ws_() {
+    while (this->p_ < this->end_ && (*this->p_ == ' ' || *this->p_ == '\t' || *this->p_ == '\n' || *this->p_ == '\r'))
+      this->p_++;
+  }
+
+  bool fail_(const char *msg) {
+    if (this->error_ == nullptr) this->error_ = msg;
+    return false;
+  }
+
+  bool open_(char bracket) {
+    this->skip_ws_();
+    if (this->p_ >= this->end_ || *this->p_ != bracket) return false;
+    if (this->depth_ >= FT_JSON_MAX_DEPTH) return this->fail_("nesting too deep");
+    this->p_++;
+    this->first_[this->depth_++] = true;
+    return true;
+  }
+
+  // Handles the ',' between elements and the closing bracket.
+  bool next_(char close) {
+    if (!this->ok() || this->depth_ == 0) return false;
+    this->skip_ws_();
+    if (this->p_ < this->end_ && *this->p_ == close) {
+      this->p_++;
+      this->depth_--;
+      return false;
+    }
+    bool &first = this->first_[this->depth_ - 1];
+    if (!first) {
+      if (this->p_ >= this->end_ || *this->p_ != ',') return this->fail_(close == '}' ? "expected ',' or '}'" : "expected ',' or ']'");
+      this->p_++;
+      this->skip_ws_();
+    }
+    first = false;
+    return true;
+  }
+
+  bool literal_(const char *word) {
+    this->skip_ws_();
+    const size_t n = strlen(word);
+    if (static_cast<size_t>(this->end_ - this->p_) < n || memcmp(this->p_, word, n) != 0) return false;
+    this->p_ += n;
+    return true;
+  }
+
+  // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool scan_number_(bool &integral) {
+    const char *c = this->p_;
+    auto digit = [&]() { return c < this->end_ && *c >= '0' && *c <= '9'; };
+    integral = true;
+    if (c < this->end_ && *c == '-') c++;
+    if (!digit()) return false;
+    if (*c == '0') {
+      c++;
+    } else {
+      while (digit()) c++;
+    }
+    if (c < this->end_ && *c == '.') {
+      integral = false;
+      c++;
+      if (!digit()) return false;
+      while (digit()) c++;
+    }
+    if (c < this->end_ && (*c == 'e' || *c == 'E')) {
+      integral = false;
+      c++;
+      if (c < this->end_ && (*c == '+' || *c == '-')) c++;
+      if (!digit()) return false;
+      while (digit()) c++;
+    }
+    this->p_ = c;
+    return true;
+  }
+
+  const char *p_;
+  const char *begin_;
+  const char *end_;
+  const char *error_ = nullptr;
+  int depth_ = 0;
+  bool first_[FT_JSON_MAX_DEPTH] = {false};
+};
+
+class FtJsonWriter {
+ public:
+  explicit FtJsonWriter(std::string &out) : out_(out) {}
+
+  void begin_object() { this->open_('{'); }
+  void end_object() { this->close_('}'); }
+  void begin_array() { this->open_('['); }
+  void end_array() { this->close_(']'); }
+
+  void key(const char *k) {
+    this->sep_();
+    this->quoted_(k);
+    this->out_ += ':';
+    this->comma_ = false;
+  }
+
+  // Non-finite numbers are written as null.
+  void value(float v) {
+    this->sep_();
+    if (!std::isfinite(v)) {
+      this->out_ += "null";
+    } else {
+      char buf[24];
+      snprintf(buf, sizeof(buf), "%.7g", v);
+      this->out_ += buf;
+    }
+    this->comma_ = true;
+  }
+  void value(int64_t v) {
+    this->sep_();
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+    this->out_ += buf;
+    this->comma_ = true;
+  }
+  void value(bool v) {
+    this->sep_();
+    this->out_ += v ? "true" : "false";
+    this->comma_ = true;
+  }
+  void value(const char *s) {
+    this->sep_();
+    this->quoted_(s);
+    this->comma_ = true;
+  }
+  void null() {
+    this->sep_();
+    this->out_ += "null";
+    this->comma_ = true;
+  }
+
+ protected:
+  void sep_() {
+    if (this->comma_) this->out_ += ',';
+  }
+  void open_(char c) {
+    this->sep_();
+    this->out_ += c;
+    this->comma_ = false;
+  }
+  void close_(char c) {
+    this->out_ += c;
+    this->comma_ = true;
+  }
+  void quoted_(const char *s) {
+    this->out_ += '"';
+    for (; *s != '\0'; s++) {
+      const unsigned char c = static_cast<unsigned char>(*s);
+      if (c == '"' || c == '\\') {
+        this->out_ += '\\';
+        this->out_ += static_cast<char>(c);
+      } else if (c == '\n') {
+        this->out_ += "\\n";
+      } else if (c == '\t') {
+        this->out_ += "\\t";
+      } else if (c < 0x20) {
+        char esc[8];
+        snprintf(esc, sizeof(esc), "\\u%04x", c);
+        this->out_ += esc;
+      } else {
+        this->out_ += static_cast<char>(c);
+      }
+    }
+    this->out_ += '"';
+  }
+
+  std::string &out_;
+  bool comma_ = false;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+// Single-pass Largest-Triangle-Three-Buckets downsampling of history samples.
+//
+// Plain LTTB needs the neighbouring buckets' points before it can pick one in
+// the current bucket, which means buffering the whole range. This is the
+// MinMaxLTTB variant instead: while the query streams samples past (from the
+// flash chunks, oldest first), each of the N-2 time buckets keeps only its
+// min and max sample of the chosen metric plus running sums for the bucket
+// mean. LTTB then runs over those two candidates per bucket, so memory is
+// O(N) whatever the range and the flash is read once. The first and last
+// samples are always kept, and every output row is a real sample.
+//
+// No ESPHome dependencies.
+
+#include <cmath>
+#include <cstdint>
+
+#include "fanforge_history.h"
+
+static constexpr uint16_t FT_LTTB_MAX_POINTS = 500;  // 18 KB of bucket state
+
+enum FtLttbMetric : uint8_t {
+  FT_LTTB_TEMP = 0,
+  FT_LTTB_PWM = 1,
+};
+
+class FtLttb {
+ public:
+  // Starts a pass over [from, to] that will yield at most points (>= 3) samples.
+  void begin(uint32_t from, uint32_t to, uint16_t points, FtLttbMetric metric) {
+    if (points > FT_LTTB_MAX_POINTS) points = FT_LTTB_MAX_POINTS;
+    if (points < 3) points = 3;
+    this->from_ = from;
+    this->span_ = static_cast<uint64_t>(to) - from + 1;
+    this->buckets_ = static_cast<uint16_t>(points - 2);
+    this->metric_ = metric;
+    this->seen_ = 0;
+    for (uint16_t i = 0; i < this->buckets_; i++) this->bucket_[i].n = 0;
+  }
+
+  // Feeds the next sample (times ascending). Samples without a value for the
+  // metric (no temperature) are skipped.
+  void add(const FtHistorySample &s) {
+    const float y = this->value_(s);
+    if (!std::isfinite(y) || s.t < this->from_) return;
+    if (this->seen_ == 0) this->first_ = pack_(s);
+    this->last_ = pack_(s);
+    this->seen_++;
+
+    const uint32_t dt = s.t - this->from_;
+    const uint32_t i = static_cast<uint32_t>(static_cast<uint64_t>(dt) * this->buckets_ / this->span_);
+    if (i >= this->buckets_) return;
+    Bucket &b = this->bucket_[i];
+    if (b.n == 0 || y < this->value_(b.lo)) b.lo = pack_(s);
+    if (b.n == 0 || y > this->value_(b.hi)) b.hi = pack_(s);
+    if (b.n == 0) {
+      b.sum_y = 0.0f;
+      b.sum_dt = 0.0f;
+    }
+    b.sum_y += y;
+    b.sum_dt += static_cast<float>(dt);
+    b.n++;
+  }
+
+  // Samples fed so far (with a value for the metric).
+  uint32_t seen() const { return this->seen_; }
+
+  // Calls emit(const FtHistorySample &) for the selected samples, oldest first,
+  // until it returns false. Selection is deterministic, so a caller sending the
+  // output in pieces can run it again and skip what it already sent.
+  template<typename F> void finish(F &&emit) const {
+    if (this->seen_ == 0) return;
+    if (!emit(unpack_(this->first_)) || this->seen_ == 1) return;
+
+    Packed a = this->first_;
+    for (uint16_t i = 0; i < this->buckets_; i++) {
+      const Bucket &b = this->bucket_[i];
+      if (b.n == 0) continue;
+      // The third triangle corner: mean of the next non-empty bucket, or the last sample.
+      float cx = static_cast<float>(this->last_.t - this->from_);
+      float cy = this->value_(this->last_);
+      for (uint16_t j = static_cast<uint16_t>(i + 1); j < this->buckets_; j++) {
+        if (this->bucket_[j].n == 0) continue;
+        cx = this->bucket_[j].sum_dt / this->bucket_[j].n;
+        cy = this->bucket_[j].sum_y / this->bucket_[j].n;
+        break;
+      }
+      const float ax = static_cast<float>(a.t - this->from_);
+      const float ay = this->value_(a);
+      const Packed *pick = &b.lo;
+      if (b.hi.t != b.lo.t && this->area_(ax, ay, b.hi, cx, cy) > this->area_(ax, ay, b.lo, cx, cy)) pick = &b.hi;
+      if (pick->t == this->first_.t || pick->t == this->last_.t) continue;
+      if (!emit(unpack_(*pick))) return;
+      a = *pick;
+    }
+    emit(unpack_(this->last_));
+  }
+
+ protected:
+  // A sample in history codes (0.1 °C, 0.1 %); lossless for query output.
+  struct Packed {
+    uint32_t t;
+    int16_t temp;
+    uint16_t pwm;
+    uint8_t flags;
+  };
+  struct Bucket {
+    Packed lo, hi;
+    float sum_y, sum_dt;
+    uint32_t n;
+  };
+
+  static Packed pack_(const FtHistorySample &s) {
+    return Packed{s.t, ft_history_temp_code(s.temp_c), ft_history_pwm_code(s.pwm_pct), s.flags};
+  }
+  static FtHistorySample unpack_(const Packed &p) {
+    return FtHistorySample{p.t, ft_history_temp_value(p.temp), p.pwm / 10.0f, p.flags};
+  }
+  float value_(const FtHistorySample &s) const { return this->metric_ == FT_LTTB_PWM ? s.pwm_pct : s.temp_c; }
+  float value_(const Packed &p) const {
+    return this->metric_ == FT_LTTB_PWM ? p.pwm / 10.0f : ft_history_temp_value(p.temp);
+  }
+  float area_(float ax, float ay, const Packed &b, float cx, float cy) const {
+    const float bx = static_cast<float>(b.t - this->from_);
+    return fabsf((ax - cx) * (this->value_(b) - ay) - (ax - bx) * (cy - ay));
+  }
+
+  uint32_t from_ = 0;
+  uint64_t span_ = 1;
+  uint16_t buckets_ = 0;
+  FtLttbMetric metric_ = FT_LTTB_TEMP;
+  uint32_t seen_ = 0;
+  Packed first_{}, last_{};
+  Bucket bucket_[FT_LTTB_MAX_POINTS - 2];
+};
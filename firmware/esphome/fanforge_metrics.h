@@ -0,0 +1,419 @@
+#pragma once
+
+#include "esphome.h"
+
+#ifdef USE_ESP32
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <esp_heap_caps.h>
+
+#if __has_include("esphome/components/web_server_idf/web_server_idf.h")
+#include "esphome/components/web_server_idf/web_server_idf.h"
+#endif
+
+#include "fanforge_deflate.h"
+
+using esphome::web_server_idf::AsyncResponseStream;
+
+// Histogram bucket upper bounds in microseconds. The last implicit bucket is +Inf.
+// Duration buckets cover a normal tick (tens of us) up to a badly stalled one.
+static constexpr int FT_HIST_BUCKETS = 8;
+static constexpr uint32_t FT_TICK_DURATION_BUCKETS_US[FT_HIST_BUCKETS] = {50,   100,  250,   500,
+                                                                          1000, 2500, 10000, 50000};
+// Interval buckets are centered on the nominal 200 ms tick period. Intervals
+// from other periods (1 s in low power) are scaled to it before they are
+// observed, so the buckets measure how far off schedule a tick started.
+static constexpr uint32_t FT_TICK_INTERVAL_NOMINAL_MS = 200;
+static constexpr uint32_t FT_TICK_INTERVAL_BUCKETS_US[FT_HIST_BUCKETS] = {150000, 190000, 195000, 200000,
+                                                                          205000, 210000, 250000, 500000};
+
+// Sensor-to-output latency buckets: a sensor conversion (~94 ms) through a 1 s
+// sampling period, and deadband holds well past that.
+static constexpr uint32_t FT_LATENCY_BUCKETS_US[FT_HIST_BUCKETS] = {10000,   50000,   100000,  200000,
+                                                                    500000, 1000000, 1500000, 5000000};
+
+struct FtHistogram {
+  const uint32_t *bounds_us;
+  uint32_t buckets[FT_HIST_BUCKETS + 1];
+  uint32_t count;
+  uint64_t sum_us;
+  uint32_t max_us;
+};
+
+static inline void ft_hist_observe(FtHistogram &h, uint32_t value_us) {
+  int i = 0;
+  while (i < FT_HIST_BUCKETS && value_us > h.bounds_us[i]) i++;
+  h.buckets[i]++;
+  h.count++;
+  h.sum_us += value_us;
+  if (value_us > h.max_us) h.max_us = value_us;
+}
+
+enum FtHttpRoute : uint8_t {
+  FT_ROUTE_STATUS = 0,
+  FT_ROUTE_CONFIG_GET,
+  FT_ROUTE_CONFIG_POST,
+  FT_ROUTE_OPTIONS,
+  FT_ROUTE_METRICS,
+  FT_ROUTE_TRACE,
+  FT_ROUTE_HISTORY,
+  FT_ROUTE_UI,
+  FT_ROUTE_OTHER,
+  FT_ROUTE_COUNT,
+};
+
+static const char *const FT_ROUTE_LABELS[FT_ROUTE_COUNT] = {
+    "route=\"status\"",  "route=\"config\",method=\"GET\"", "route=\"config\",method=\"POST\"",
+    "route=\"options\"", "route=\"metrics\"",               "route=\"trace\"",
+    "route=\"history\"", "route=\"ui\"",                    "route=\"other\"",
+};
+
+struct FtMetrics {
+  FtHistogram tick_duration{FT_TICK_DURATION_BUCKETS_US, {0}, 0, 0, 0};
+  FtHistogram tick_interval{FT_TICK_INTERVAL_BUCKETS_US, {0}, 0, 0, 0};
+  uint32_t last_tick_start_us = 0;
+  uint32_t tick_interval_max_us = 0;  // unscaled
+  uint32_t http_requests[FT_ROUTE_COUNT] = {0};
+  uint32_t http_responses_2xx = 0;
+  uint32_t http_responses_4xx = 0;
+  uint32_t http_responses_5xx = 0;
+  // Persisted globals whose value changed; each one costs a preferences (NVS) write on the next flush.
+  uint32_t nvs_writes = 0;
+  uint32_t config_applies = 0;
+};
+
+static FtMetrics ft_metrics;
+
+static inline void ft_metrics_http_request(FtHttpRoute route) { ft_metrics.http_requests[route]++; }
+
+static inline void ft_metrics_http_response(int status) {
+  if (status >= 500)
+    ft_metrics.http_responses_5xx++;
+  else if (status >= 400)
+    ft_metrics.http_responses_4xx++;
+  else
+    ft_metrics.http_responses_2xx++;
+}
+
+static inline void ft_metrics_note_persist(uint32_t changed_fields) { ft_metrics.nvs_writes += changed_fields; }
+
+// Records tick duration on scope exit (the tick has early returns) and the
+// start-to-start interval, scaled from expected_ms to the nominal period.
+class FtTickTimer {
+ public:
+  explicit FtTickTimer(uint32_t expected_ms) : start_us_(micros()) {
+    if (ft_metrics.last_tick_start_us != 0) {
+      const uint32_t interval_us = start_us_ - ft_metrics.last_tick_start_us;
+      const uint64_t scaled = static_cast<uint64_t>(interval_us) * FT_TICK_INTERVAL_NOMINAL_MS / expected_ms;
+      ft_hist_observe(ft_metrics.tick_interval, scaled > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(scaled));
+      if (interval_us > ft_metrics.tick_interval_max_us) ft_metrics.tick_interval_max_us = interval_us;
+    }
+    ft_metrics.last_tick_start_us = start_us_;
+  }
+  ~FtTickTimer() { ft_hist_observe(ft_metrics.tick_duration, micros() - start_us_); }
+
+ private:
+  uint32_t start_us_;
+};
+
+// DS18B20 conversion time at the configured resolution (resolution: in
+// fanforge-controller.yaml), as ESPHome's dallas_temp waits for it.
+static constexpr uint32_t FT_DS18B20_RESOLUTION_BITS = 9;
+static constexpr uint32_t ft_ds18b20_conversion_ms(uint32_t bits) {
+  return bits <= 9 ? 94 : bits == 10 ? 188 : bits == 11 ? 375 : 750;
+}
+
+enum FtLatencyStage : uint8_t {
+  FT_LAT_SAMPLING = 0,  // reading to reading: how long a change can wait for the next conversion to start
+  FT_LAT_CONVERSION,    // conversion start -> reading published (nominal for the resolution)
+  FT_LAT_DEADBAND,      // first reading off the control temperature -> the reading the deadband accepted
+  FT_LAT_TICK_WAIT,     // reading published -> the control tick that consumed it
+  FT_LAT_TICK,          // tick start -> LEDC write (deadband, rules, curve, slew and the write)
+  FT_LAT_END_TO_END,    // conversion start of the first off reading -> first output change
+  FT_LAT_SLEW,          // first output change -> output settled on the target
+  FT_LAT_STAGE_COUNT,
+};
+
+static const char *const FT_LAT_STAGE_LABELS[FT_LAT_STAGE_COUNT] = {
+    "stage=\"sampling\"", "stage=\"conversion\"", "stage=\"deadband\"", "stage=\"tick_wait\"",
+    "stage=\"tick\"",     "stage=\"end_to_end\"", "stage=\"slew\"",
+};
+
+// What became of each sensor reading.
+enum FtLatencyOutcome : uint8_t {
+  FT_LAT_OUT_CHANGED = 0,  // accepted and moved the output
+  FT_LAT_OUT_NO_CHANGE,    // accepted, output unchanged (flat curve, PWM deadband, MANUAL/OFF)
+  FT_LAT_OUT_HELD,         // held by the temperature deadband
+  FT_LAT_OUT_STEADY,       // equal to the control temperature
+  FT_LAT_OUT_UNTRACED,     // the tick ran on a UDP or rack temperature, or had none
+  FT_LAT_OUT_COUNT,
+};
+
+static const char *const FT_LAT_OUTCOME_LABELS[FT_LAT_OUT_COUNT] = {
+    "outcome=\"output_changed\"", "outcome=\"no_change\"", "outcome=\"held\"",
+    "outcome=\"steady\"",         "outcome=\"untraced\"",
+};
+
+// What one control tick did with its temperature, for FtLatencyTracker.
+struct FtLatencyTick {
+  uint32_t start_us;    // tick start
+  uint32_t write_us;    // after the LEDC write (or where it would have been)
+  bool traced;          // the tick ran on the DS18B20 reading
+  bool accepted;        // the control temperature moved to the raw reading
+  bool held;            // the raw reading differs from the control temperature
+  bool output_changed;  // a new duty was written
+  bool settled;         // output equals the target after slew limiting
+};
+
+/**
+ * Follows each DS18B20 reading to the output change it causes.
+ *
+ * A reading is stamped when it is published; its conversion started a fixed
+ * conversion time earlier (dallas_temp gives no hook at the start). The first
+ * tick after it decides its fate. A drift the deadband holds back is traced
+ * from the first reading that differed, so end_to_end = deadband + conversion
+ * + tick_wait + tick. Sampling is the reading-to-reading period: a physical
+ * change waits up to that long (half on average) before any of this starts.
+ * Timestamps are micros(), extended to 64 bits so long holds survive the wrap.
+ */
+class FtLatencyTracker {
+ public:
+  FtHistogram stages[FT_LAT_STAGE_COUNT] = {
+      {FT_LATENCY_BUCKETS_US, {0}, 0, 0, 0},       {FT_LATENCY_BUCKETS_US, {0}, 0, 0, 0},
+      {FT_LATENCY_BUCKETS_US, {0}, 0, 0, 0},       {FT_LATENCY_BUCKETS_US, {0}, 0, 0, 0},
+      {FT_TICK_DURATION_BUCKETS_US, {0}, 0, 0, 0}, {FT_LATENCY_BUCKETS_US, {0}, 0, 0, 0},
+      {FT_LATENCY_BUCKETS_US, {0}, 0, 0, 0},
+  };
+  uint32_t outcomes[FT_LAT_OUT_COUNT] = {0};
+
+  void on_reading(uint32_t now_us) {
+    const uint64_t t = this->extend_(now_us);
+    if (this->have_reading_) this->observe_(FT_LAT_SAMPLING, t - this->reading_us_);
+    this->have_reading_ = true;
+    this->reading_us_ = t;
+    this->pending_ = true;
+  }
+
+  void on_tick(const FtLatencyTick &k) {
+    const uint64_t start = this->extend_(k.start_us);
+    const uint64_t write = this->extend_(k.write_us);
+    if (this->pending_) {
+      this->pending_ = false;
+      this->on_reading_tick_(k, start, write);
+    }
+    // A change that started on an earlier tick finishes slewing.
+    if (this->slewing_ && k.settled) {
+      this->observe_(FT_LAT_SLEW, write - this->slew_start_us_);
+      this->slewing_ = false;
+    }
+  }
+
+ private:
+  void on_reading_tick_(const FtLatencyTick &k, uint64_t start, uint64_t write) {
+    if (!k.traced) {
+      this->held_ = false;
+      this->outcomes[FT_LAT_OUT_UNTRACED]++;
+      return;
+    }
+    const uint64_t conv_us = ft_ds18b20_conversion_ms(FT_DS18B20_RESOLUTION_BITS) * 1000ULL;
+    const uint64_t conv_start = this->reading_us_ - conv_us;
+    this->observe_(FT_LAT_CONVERSION, conv_us);
+    this->observe_(FT_LAT_TICK_WAIT, start - this->reading_us_);
+    if (!k.accepted) {
+      if (k.held && !this->held_) {
+        this->held_ = true;
+        this->origin_us_ = conv_start;
+      }
+      if (!k.held) this->held_ = false;
+      this->outcomes[k.held ? FT_LAT_OUT_HELD : FT_LAT_OUT_STEADY]++;
+      return;
+    }
+    const uint64_t origin = this->held_ ? this->origin_us_ : conv_start;
+    this->held_ = false;
+    this->observe_(FT_LAT_DEADBAND, conv_start - origin);
+    if (!k.output_changed) {
+      this->outcomes[FT_LAT_OUT_NO_CHANGE]++;
+      return;
+    }
+    this->outcomes[FT_LAT_OUT_CHANGED]++;
+    this->observe_(FT_LAT_TICK, write - start);
+    this->observe_(FT_LAT_END_TO_END, write - origin);
+    // A newer change restarts the slew measurement.
+    this->slewing_ = !k.settled;
+    this->slew_start_us_ = write;
+    if (k.settled) this->observe_(FT_LAT_SLEW, 0);
+  }
+
+  void observe_(FtLatencyStage stage, uint64_t us) {
+    ft_hist_observe(this->stages[stage], us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us));
+  }
+
+  // Stamps arrive at most a tick apart, so the signed 32-bit delta is exact.
+  uint64_t extend_(uint32_t us) {
+    if (!this->clock_started_) {
+      this->clock_started_ = true;
+      this->last_us_ = us;
+    }
+    const int32_t delta = static_cast<int32_t>(us - this->last_us_);
+    const uint64_t t = this->last_ext_us_ + delta;
+    if (delta > 0) {
+      this->last_us_ = us;
+      this->last_ext_us_ = t;
+    }
+    return t;
+  }
+
+  bool clock_started_ = false;
+  uint32_t last_us_ = 0;
+  uint64_t last_ext_us_ = 1ULL << 32;  // headroom for stamps just before the first one
+  bool have_reading_ = false;
+  uint64_t reading_us_ = 0;
+  bool pending_ = false;
+  bool held_ = false;
+  uint64_t origin_us_ = 0;
+  bool slewing_ = false;
+  uint64_t slew_start_us_ = 0;
+};
+
+static FtLatencyTracker ft_latency;
+
+// A counter's rate over the last hour, from marks taken every 5 minutes.
+static constexpr int FT_RATE_MARKS = 13;  // 12 intervals span the hour
+static constexpr uint32_t FT_RATE_MARK_MS = 300000;
+
+class FtHourlyRate {
+ public:
+  void update(uint32_t count, uint32_t now_ms) {
+    this->count_ = count;
+    this->now_ms_ = now_ms;
+    if (this->marks_ > 0 && now_ms - this->ring_[this->head_].ms < FT_RATE_MARK_MS) return;
+    this->head_ = (this->head_ + 1) % FT_RATE_MARKS;
+    this->ring_[this->head_] = {count, now_ms};
+    if (this->marks_ < FT_RATE_MARKS) this->marks_++;
+  }
+
+  // Events per hour since the oldest mark: the last hour, or since the first
+  // update while younger (counted over at least a minute).
+  float per_hour() const {
+    if (this->marks_ == 0) return 0.0f;
+    const Mark &oldest = this->ring_[(this->head_ + FT_RATE_MARKS + 1 - this->marks_) % FT_RATE_MARKS];
+    const uint32_t ms = this->now_ms_ - oldest.ms;
+    return (this->count_ - oldest.count) * 3600000.0f / (ms > 60000 ? ms : 60000);
+  }
+
+ private:
+  struct Mark {
+    uint32_t count;
+    uint32_t ms;
+  };
+  Mark ring_[FT_RATE_MARKS] = {};
+  int head_ = 0;
+  int marks_ = 0;
+  uint32_t count_ = 0;
+  uint32_t now_ms_ = 0;
+};
+
+// Output direction changes of the control loop (FtControlState::reversals).
+static FtHourlyRate ft_reversal_rate;
+
+/**
+ * Prometheus text exposition (format 0.0.4) writer.
+ *
+ * Every line is formatted into a fixed stack buffer and appended straight to the
+ * response stream, so a scrape builds no JSON document and no temporary strings.
+ * A compressed scrape appends each line to the encoder instead, and only the
+ * compressed body is held.
+ */
+class FtPromWriter {
+ public:
+  explicit FtPromWriter(AsyncResponseStream *out) : out_(out) {}
+  FtPromWriter(FtDeflate *deflate, std::string *body) : deflate_(deflate), body_(body) {}
+
+  void family(const char *name, const char *type, const char *help) {
+    this->emit_("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  }
+
+  void sample(const char *name, const char *labels, float value) {
+    if (!std::isfinite(value)) {
+      this->emit_("%s%s%s%s NaN\n", name, labels ? "{" : "", labels ? labels : "", labels ? "}" : "");
+      return;
+    }
+    // %.9g round-trips a float: sub-millisecond seconds stay visible and large counts stay exact.
+    this->emit_("%s%s%s%s %.9g\n", name, labels ? "{" : "", labels ? labels : "", labels ? "}" : "", value);
+  }
+
+  void sample_u64(const char *name, const char *labels, uint64_t value) {
+    this->emit_("%s%s%s%s %llu\n", name, labels ? "{" : "", labels ? labels : "", labels ? "}" : "",
+                static_cast<unsigned long long>(value));
+  }
+
+  void gauge(const char *name, const char *help, float value) {
+    this->family(name, "gauge", help);
+    this->sample(name, nullptr, value);
+  }
+
+  void counter(const char *name, const char *help, uint64_t value) {
+    this->family(name, "counter", help);
+    this->sample_u64(name, nullptr, value);
+  }
+
+  void histogram_seconds(const char *name, const char *help, const FtHistogram &h) {
+    this->family(name, "histogram", help);
+    this->histogram_samples(name, nullptr, h);
+  }
+
+  // One labelled series of a histogram family already opened with family().
+  void histogram_samples(const char *name, const char *labels, const FtHistogram &h) {
+    const char *sep = labels ? "," : "";
+    if (!labels) labels = "";
+    uint32_t cumulative = 0;
+    for (int i = 0; i < FT_HIST_BUCKETS; i++) {
+      cumulative += h.buckets[i];
+      this->emit_("%s_bucket{%s%sle=\"%g\"} %u\n", name, labels, sep, h.bounds_us[i] / 1e6,
+                  static_cast<unsigned>(cumulative));
+    }
+    cumulative += h.buckets[FT_HIST_BUCKETS];
+    this->emit_("%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, sep, static_cast<unsigned>(cumulative));
+    const char *open = labels[0] ? "{" : "";
+    const char *close = labels[0] ? "}" : "";
+    this->emit_("%s_sum%s%s%s %.6f\n", name, open, labels, close, h.sum_us / 1e6);
+    this->emit_("%s_count%s%s%s %u\n", name, open, labels, close, static_cast<unsigned>(h.count));
+  }
+
+ private:
+  // Lines that do not fit line_ are formatted again on the heap rather than
+  // cut short, which would also lose the newline and corrupt the next sample.
+  __attribute__((format(printf, 2, 3))) void emit_(const char *fmt, ...) {
+    va_list args, again;
+    va_start(args, fmt);
+    va_copy(again, args);
+    const int len = vsnprintf(this->line_, sizeof(this->line_), fmt, args);
+    va_end(args);
+    const char *line = this->line_;
+    std::string long_line;
+    if (len > 0 && static_cast<size_t>(len) >= sizeof(this->line_)) {
+      long_line.resize(static_cast<size_t>(len) + 1);
+      vsnprintf(&long_line[0], long_line.size(), fmt, again);
+      long_line.resize(static_cast<size_t>(len));
+      line = long_line.c_str();
+    }
+    va_end(again);
+    if (len <= 0) return;
+    if (this->deflate_ == nullptr) {
+      this->out_->print(line);
+      return;
+    }
+    this->deflate_->append(*this->body_, line, static_cast<size_t>(len));
+  }
+
+  AsyncResponseStream *out_ = nullptr;
+  FtDeflate *deflate_ = nullptr;
+  std::string *body_ = nullptr;
+  char line_[160];
+};
+
+#endif  // USE_ESP32
@@ -0,0 +1,161 @@
+#pragma once
+
+// Low-power operating mode: when to drop to it, how often the control loop then
+// runs, and an estimate of the energy it saves. Portable (no ESPHome or
+// ESP-IDF calls); fanforge_api.h applies the decisions to the radio, the power
+// manager and the main loop.
+//
+// Full power is the stock behaviour: radio always listening, control tick every
+// 200 ms. Low power puts the radio into modem sleep (it wakes for DTIM beacons)
+// and, in LIGHT mode, lets the power manager light-sleep the CPU whenever the
+// loop is idle. The control tick then runs once a second, or as soon as the
+// sensor delivers a new reading. Any UI request restores full power for the
+// hold time so interactive use stays responsive.
+
+#include <cstdint>
+
+// cfg_power_mode values.
+enum FtPowerMode : uint8_t {
+  FT_POWER_MODE_FULL = 0,
+  FT_POWER_MODE_MODEM = 1,
+  FT_POWER_MODE_LIGHT = 2,
+};
+
+enum FtPowerState : uint8_t {
+  FT_POWER_STATE_FULL = 0,
+  FT_POWER_STATE_LOW = 1,
+};
+
+static constexpr uint32_t FT_POWER_FULL_TICK_MS = 200;  // interval: in fanforge-controller.yaml
+static constexpr uint32_t FT_POWER_LOW_TICK_MS = 1000;
+static constexpr uint32_t FT_POWER_FULL_LOOP_MS = 16;  // ESPHome's default main loop interval
+static constexpr uint32_t FT_POWER_LOW_LOOP_MS = 200;  // the 200 ms interval wakes the loop anyway
+// ESPHome re-applies its own power-save setting on Wi-Fi reconnects; low power is re-asserted this often.
+static constexpr uint32_t FT_POWER_REAPPLY_MS = 30000;
+
+// Power model for the energy estimate: ESP32-C3 module at 3.3 V, datasheet-level
+// averages. The board's regulator, LEDs and the fan itself are not included.
+static constexpr uint32_t FT_POWER_ACTIVE_MW = 280;       // CPU running, radio listening
+static constexpr uint32_t FT_POWER_MODEM_SLEEP_MW = 80;   // CPU running, radio dozing between beacons
+static constexpr uint32_t FT_POWER_LIGHT_SLEEP_MW = 10;   // light sleep, waking for beacons
+static constexpr uint32_t FT_POWER_WAKE_US = 2000;        // awake time per main-loop wake besides our own work
+
+struct FtPowerStats {
+  uint64_t full_ms = 0;         // at full power
+  uint64_t modem_ms = 0;        // low power, CPU awake (radio in modem sleep)
+  uint64_t light_sleep_ms = 0;  // low power, CPU in light sleep (estimated)
+  uint64_t energy_uj = 0;       // estimated module energy
+  uint32_t transitions = 0;     // full <-> low switches
+  uint32_t skipped_ticks = 0;   // intervals that did not run the control tick
+  uint32_t sensor_wakes = 0;    // low-power ticks started by a new sensor reading
+  float power_mw = 0.0f;        // estimated average over the last accounted interval
+};
+
+/**
+ * Power policy and energy accounting, driven once per 200 ms interval.
+ *
+ * update() picks the state, tick_due() says whether this interval runs the
+ * control tick, and account() books the elapsed time. Time in light sleep is
+ * not measured (the power manager keeps no such counter without profiling):
+ * it is the interval minus the work we timed and a fixed cost per loop wake.
+ */
+class FtPowerGovernor {
+ public:
+  void note_ui(uint32_t now_ms) {
+    this->last_ui_ms_ = now_ms;
+    this->ui_seen_ = true;
+  }
+  void note_sensor() { this->sensor_pending_ = true; }
+
+  // Returns true when the state changed.
+  bool update(FtPowerMode mode, uint32_t ui_hold_ms, uint32_t now_ms) {
+    this->mode_ = mode;
+    const bool ui_active = this->ui_active(ui_hold_ms, now_ms);
+    const FtPowerState next = mode != FT_POWER_MODE_FULL && !ui_active ? FT_POWER_STATE_LOW : FT_POWER_STATE_FULL;
+    if (next == this->state_) return false;
+    this->state_ = next;
+    this->stats_.transitions++;
+    return true;
+  }
+
+  bool ui_active(uint32_t ui_hold_ms, uint32_t now_ms) const {
+    return this->ui_seen_ && now_ms - this->last_ui_ms_ < ui_hold_ms;
+  }
+
+  bool tick_due(uint32_t now_ms) {
+    if (this->state_ == FT_POWER_STATE_FULL || !this->ticked_) return true;
+    if (this->sensor_pending_) {
+      this->stats_.sensor_wakes++;
+      return true;
+    }
+    if (now_ms - this->last_tick_ms_ >= FT_POWER_LOW_TICK_MS) return true;
+    this->stats_.skipped_ticks++;
+    return false;
+  }
+
+  void ran_tick(uint32_t now_ms) {
+    this->last_period_ms_ = this->tick_period_ms();
+    this->last_tick_ms_ = now_ms;
+    this->ticked_ = true;
+    this->sensor_pending_ = false;
+  }
+
+  // Nominal spacing of control ticks in the current state.
+  uint32_t tick_period_ms() const {
+    return this->state_ == FT_POWER_STATE_LOW ? FT_POWER_LOW_TICK_MS : FT_POWER_FULL_TICK_MS;
+  }
+  // Nominal spacing that applies to the interval ending now (either side of a switch).
+  uint32_t expected_interval_ms() const {
+    const uint32_t now = this->tick_period_ms();
+    return this->last_period_ms_ > now ? this->last_period_ms_ : now;
+  }
+
+  // Books the time since the last call. busy_us is the work done in this
+  // interval; light_sleep says whether the power manager accepted light sleep.
+  void account(uint32_t now_ms, uint32_t busy_us, bool light_sleep) {
+    if (!this->accounted_) {
+      this->accounted_ = true;
+      this->last_account_ms_ = now_ms;
+      return;
+    }
+    const uint32_t dt_ms = now_ms - this->last_account_ms_;
+    this->last_account_ms_ = now_ms;
+    if (dt_ms == 0) return;
+    uint64_t uj;
+    if (this->state_ == FT_POWER_STATE_FULL) {
+      this->stats_.full_ms += dt_ms;
+      uj = static_cast<uint64_t>(FT_POWER_ACTIVE_MW) * dt_ms;
+    } else if (!light_sleep) {
+      this->stats_.modem_ms += dt_ms;
+      uj = static_cast<uint64_t>(FT_POWER_MODEM_SLEEP_MW) * dt_ms;
+    } else {
+      const uint32_t wakes = dt_ms / FT_POWER_LOW_LOOP_MS + 1;
+      uint32_t awake_ms = (busy_us + wakes * FT_POWER_WAKE_US + 999) / 1000;
+      if (awake_ms > dt_ms) awake_ms = dt_ms;
+      this->stats_.modem_ms += awake_ms;
+      this->stats_.light_sleep_ms += dt_ms - awake_ms;
+      uj = static_cast<uint64_t>(FT_POWER_MODEM_SLEEP_MW) * awake_ms +
+           static_cast<uint64_t>(FT_POWER_LIGHT_SLEEP_MW) * (dt_ms - awake_ms);
+    }
+    this->stats_.energy_uj += uj;
+    this->stats_.power_mw = static_cast<float>(uj) / dt_ms;
+  }
+
+  FtPowerState state() const { return this->state_; }
+  FtPowerMode mode() const { return this->mode_; }
+  bool low() const { return this->state_ == FT_POWER_STATE_LOW; }
+  const FtPowerStats &stats() const { return this->stats_; }
+
+ private:
+  FtPowerMode mode_ = FT_POWER_MODE_FULL;
+  FtPowerState state_ = FT_POWER_STATE_FULL;
+  bool ui_seen_ = false;
+  uint32_t last_ui_ms_ = 0;
+  bool sensor_pending_ = false;
+  bool ticked_ = false;
+  uint32_t last_tick_ms_ = 0;
+  uint32_t last_period_ms_ = FT_POWER_FULL_TICK_MS;
+  bool accounted_ = false;
+  uint32_t last_account_ms_ = 0;
+  FtPowerStats stats_;
+};
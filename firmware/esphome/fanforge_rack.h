@@ -0,0 +1,236 @@
+#pragma once
+
+// Rack coordination: controllers cooling the same cabinet share compact
+// temperature/PWM summaries over UDP multicast and can run their curves on a
+// group aggregate instead of their own sensor. Portable (no ESPHome types).
+//
+// Summary datagram (little endian, 32 bytes):
+//   magic "FFR1" | unit_id:u16 | flags:u8 | weight:u8 | epoch:u32 | seq:u32 |
+//   temp_c:f32 | pwm_pct:f32 | tag: SipHash-2-4(key, preceding 24 bytes), 8 bytes
+//
+// Each unit publishes its own source temperature, never the aggregate, so a hot
+// reading leaves the group as soon as its unit cools or goes quiet.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "fanforge_ingest.h"
+
+static constexpr uint8_t FT_RACK_MAGIC[4] = {'F', 'F', 'R', '1'};
+static constexpr size_t FT_RACK_BODY_BYTES = 24;
+static constexpr size_t FT_RACK_DATAGRAM_BYTES = FT_RACK_BODY_BYTES + FT_INGEST_TAG_BYTES;
+static constexpr uint16_t FT_RACK_DEFAULT_PORT = 47809;
+static constexpr int FT_RACK_MAX_PEERS = 8;
+static constexpr uint32_t FT_RACK_TX_PERIOD_MS = 1000;
+static constexpr uint32_t FT_RACK_DEFAULT_STALE_MS = 5000;
+
+static constexpr uint8_t FT_RACK_F_TEMP_VALID = 1 << 0;
+static constexpr uint8_t FT_RACK_F_FAILSAFE = 1 << 1;
+
+// cfg_rack_aggregate values.
+enum FtRackAggregateMode : uint8_t {
+  FT_RACK_AGG_OFF = 0,
+  FT_RACK_AGG_MAX = 1,
+  FT_RACK_AGG_MEAN = 2,
+};
+
+struct FtRackSummary {
+  uint16_t unit_id;
+  uint8_t flags;
+  uint8_t weight;
+  uint32_t epoch;
+  uint32_t seq;
+  float temp_c;
+  float pwm_pct;
+};
+
+// Returns the datagram length, or 0 if `cap` is too small.
+static inline size_t ft_rack_encode(const uint8_t key[16], const FtRackSummary &s, uint8_t *out, size_t cap) {
+  if (cap < FT_RACK_DATAGRAM_BYTES) return 0;
+  uint32_t temp_bits, pwm_bits;
+  memcpy(&temp_bits, &s.temp_c, 4);
+  memcpy(&pwm_bits, &s.pwm_pct, 4);
+  memcpy(out, FT_RACK_MAGIC, 4);
+  out[4] = static_cast<uint8_t>(s.unit_id);
+  out[5] = static_cast<uint8_t>(s.unit_id >> 8);
+  out[6] = s.flags;
+  out[7] = s.weight;
+  ft_put_le32(out + 8, s.epoch);
+  ft_put_le32(out + 12, s.seq);
+  ft_put_le32(out + 16, temp_bits);
+  ft_put_le32(out + 20, pwm_bits);
+  const uint64_t tag = ft_siphash24(key, out, FT_RACK_BODY_BYTES);
+  for (size_t i = 0; i < FT_INGEST_TAG_BYTES; i++) out[FT_RACK_BODY_BYTES + i] = static_cast<uint8_t>(tag >> (8 * i));
+  return FT_RACK_DATAGRAM_BYTES;
+}
+
+enum FtRackResult : uint8_t {
+  FT_RACK_OK = 0,
+  FT_RACK_BAD_FORMAT,
+  FT_RACK_BAD_TAG,
+  FT_RACK_REPLAYED,
+  FT_RACK_NO_SLOT,
+  FT_RACK_SELF,
+};
+
+struct FtRackPeer {
+  FtRackSummary last;
+  bool used;
+  uint32_t last_rx_ms;
+};
+
+struct FtRackStats {
+  uint32_t accepted = 0;
+  uint32_t bad_format = 0;
+  uint32_t bad_tag = 0;
+  uint32_t replayed = 0;
+  uint32_t no_slot = 0;
+  uint32_t self = 0;
+  uint32_t sent = 0;
+  uint32_t send_errors = 0;
+};
+
+// What the last tick's control temperature was built from.
+struct FtRackAggregate {
+  float temp_c = NAN;  // NAN when nothing fresh contributed
+  uint8_t peers = 0;   // fresh peers that contributed (not counting this unit)
+  bool local = false;  // this unit's own reading contributed
+};
+
+/**
+ * Fixed-size table of rack peers fed by authenticated summaries.
+ *
+ * A peer counts while it was heard within the staleness timeout. (epoch, seq)
+ * must strictly increase, stale or not: each unit persists its epoch before
+ * joining, so a rebooted unit comes back above its old summaries. A peer keeps
+ * its slot until reboot and a full table refuses new units, since recycling a
+ * slot would forget that peer's replay window.
+ */
+class FtRackTable {
+ public:
+  void set_key(const uint8_t key[16]) {
+    memcpy(this->key_, key, 16);
+    this->has_key_ = true;
+  }
+  bool has_key() const { return this->has_key_; }
+  const uint8_t *key() const { return this->key_; }
+  void set_unit_id(uint16_t unit_id) { this->unit_id_ = unit_id; }
+  uint16_t unit_id() const { return this->unit_id_; }
+  void set_stale_ms(uint32_t stale_ms) { this->stale_ms_ = stale_ms; }
+  uint32_t stale_ms() const { return this->stale_ms_; }
+  const FtRackStats &stats() const { return this->stats_; }
+  FtRackStats &stats() { return this->stats_; }
+  const FtRackPeer *peers() const { return this->peers_; }
+
+  bool fresh(const FtRackPeer &p, uint32_t now_ms) const {
+    return p.used && now_ms - p.last_rx_ms <= this->stale_ms_;
+  }
+
+  FtRackResult handle_datagram(const uint8_t *data, size_t len, uint32_t now_ms) {
+    FtRackResult r = this->handle_(data, len, now_ms);
+    switch (r) {
+      case FT_RACK_OK:
+        this->stats_.accepted++;
+        break;
+      case FT_RACK_BAD_FORMAT:
+        this->stats_.bad_format++;
+        break;
+      case FT_RACK_BAD_TAG:
+        this->stats_.bad_tag++;
+        break;
+      case FT_RACK_REPLAYED:
+        this->stats_.replayed++;
+        break;
+      case FT_RACK_NO_SLOT:
+        this->stats_.no_slot++;
+        break;
+      case FT_RACK_SELF:
+        this->stats_.self++;
+        break;
+    }
+    return r;
+  }
+
+  /**
+   * Combines this unit's reading with every fresh peer that has a valid
+   * temperature and a non-zero weight: the hottest one (MAX) or the
+   * weight-averaged one (MEAN). local_temp may be NAN (no reading); with no
+   * contributor at all the result is NAN.
+   */
+  FtRackAggregate aggregate(FtRackAggregateMode mode, float local_temp, uint8_t local_weight, uint32_t now_ms) const {
+    FtRackAggregate out;
+    float best = -INFINITY;
+    float sum = 0.0f;
+    float weights = 0.0f;
+    auto add = [&](float t, uint8_t w) {
+      best = fmaxf(best, t);
+      sum += t * w;
+      weights += w;
+    };
+    if (isfinite(local_temp) && local_weight > 0) {
+      add(local_temp, local_weight);
+      out.local = true;
+    }
+    for (const FtRackPeer &p : this->peers_) {
+      if (!this->fresh(p, now_ms) || !(p.last.flags & FT_RACK_F_TEMP_VALID) || p.last.weight == 0) continue;
+      add(p.last.temp_c, p.last.weight);
+      out.peers++;
+    }
+    if (weights <= 0.0f) return out;
+    out.temp_c = mode == FT_RACK_AGG_MEAN ? sum / weights : best;
+    return out;
+  }
+
+ private:
+  FtRackResult handle_(const uint8_t *data, size_t len, uint32_t now_ms) {
+    if (!this->has_key_) return FT_RACK_BAD_TAG;
+    if (len != FT_RACK_DATAGRAM_BYTES || memcmp(data, FT_RACK_MAGIC, 4) != 0) return FT_RACK_BAD_FORMAT;
+
+    // Constant-time tag compare.
+    const uint64_t tag = ft_siphash24(this->key_, data, FT_RACK_BODY_BYTES);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < FT_INGEST_TAG_BYTES; i++)
+      diff |= data[FT_RACK_BODY_BYTES + i] ^ static_cast<uint8_t>(tag >> (8 * i));
+    if (diff != 0) return FT_RACK_BAD_TAG;
+
+    FtRackSummary s;
+    s.unit_id = static_cast<uint16_t>(data[4] | (data[5] << 8));
+    s.flags = data[6];
+    s.weight = data[7];
+    s.epoch = ft_get_le32(data + 8);
+    s.seq = ft_get_le32(data + 12);
+    const uint32_t temp_bits = ft_get_le32(data + 16);
+    const uint32_t pwm_bits = ft_get_le32(data + 20);
+    memcpy(&s.temp_c, &temp_bits, 4);
+    memcpy(&s.pwm_pct, &pwm_bits, 4);
+    // Multicast loops our own summaries back to us.
+    if (s.unit_id == this->unit_id_) return FT_RACK_SELF;
+    if (!isfinite(s.temp_c)) s.flags &= ~FT_RACK_F_TEMP_VALID;
+
+    FtRackPeer *peer = this->peer_slot_(s.unit_id);
+    if (peer == nullptr) return FT_RACK_NO_SLOT;
+    if (peer->used && (s.epoch < peer->last.epoch || (s.epoch == peer->last.epoch && s.seq <= peer->last.seq)))
+      return FT_RACK_REPLAYED;
+    peer->last = s;
+    peer->used = true;
+    peer->last_rx_ms = now_ms;
+    return FT_RACK_OK;
+  }
+
+  FtRackPeer *peer_slot_(uint16_t unit_id) {
+    FtRackPeer *free_slot = nullptr;
+    for (FtRackPeer &p : this->peers_) {
+      if (p.used && p.last.unit_id == unit_id) return &p;
+      if (!p.used && free_slot == nullptr) free_slot = &p;
+    }
+    return free_slot;
+  }
+
+  uint8_t key_[16] = {0};
+  bool has_key_ = false;
+  uint16_t unit_id_ = 0;
+  uint32_t stale_ms_ = FT_RACK_DEFAULT_STALE_MS;
+  FtRackPeer peers_[FT_RACK_MAX_PEERS] = {};
+  FtRackStats stats_;
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+// Multi-resolution telemetry rollups: count, min, max, mean and p95 of the
+// control temperature and output PWM per 1 s, 1 min and 1 h bucket, each tier
+// in its own RAM ring. Every control tick feeds all three open buckets
+// directly (p95 cannot be merged from finer buckets), so the cost per tick is
+// constant and nothing is rescanned. p95 comes from a P-square sketch: five
+// markers per quantile, updated in O(1) per sample.
+//
+// Bucket times are on the history clock (fanforge_history.h), so rollups line
+// up with /api/history samples. The rings are not persisted; after a reboot
+// they refill from the live tick.
+//
+// The control loop adds while httpd queries: each tier takes its lock_ per
+// tick, and a query copies one bucket at a time under it.
+//
+// No ESPHome dependencies.
+
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+// P-square streaming quantile estimator (Jain & Chlamtac, 1985). The first
+// FT_P2_EXACT samples are kept sorted and answered exactly (the 1 s tier never
+// gets past that); beyond them the five markers are seeded from the sorted
+// samples and updated in O(1).
+static constexpr uint8_t FT_P2_EXACT = 16;
+
+class FtP2Quantile {
+ public:
+  explicit FtP2Quantile(float p) : p_(p) {}
+
+  void reset() { this->n_ = 0; }
+  uint32_t count() const { return this->n_; }
+
+  void add(float x) {
+    if (this->n_ < FT_P2_EXACT) {
+      int i = static_cast<int>(this->n_++);
+      while (i > 0 && this->exact_[i - 1] > x) {
+        this->exact_[i] = this->exact_[i - 1];
+        i--;
+      }
+      this->exact_[i] = x;
+      return;
+    }
+    if (this->n_ == FT_P2_EXACT) this->seed_();
+    this->n_++;
+
+    int k;
+    if (x < this->q_[0]) {
+      this->q_[0] = x;
+      k = 0;
+    } else if (x >= this->q_[4]) {
+      if (x > this->q_[4]) this->q_[4] = x;
+      k = 3;
+    } else {
+      k = 0;
+      while (k < 3 && x >= this->q_[k + 1]) k++;
+    }
+    for (int i = k + 1; i < 5; i++) this->pos_[i]++;
+    for (int i = 1; i < 5; i++) this->want_[i] += this->step_[i];
+
+    for (int i = 1; i <= 3; i++) {
+      const float d = this->want_[i] - static_cast<float>(this->pos_[i]);
+      if ((d >= 1.0f && this->pos_[i + 1] - this->pos_[i] > 1) || (d <= -1.0f && this->pos_[i - 1] - this->pos_[i] < -1)) {
+        const int s = d > 0.0f ? 1 : -1;
+        const float qp = this->parabolic_(i, s);
+        if (this->q_[i - 1] < qp && qp < this->q_[i + 1]) {
+          this->q_[i] = qp;
+        } else {
+          this->q_[i] += s * (this->q_[i + s] - this->q_[i]) / static_cast<float>(this->pos_[i + s] - this->pos_[i]);
+        }
+        this->pos_[i] += s;
+      }
+    }
+  }
+
+  // Estimated quantile; exact (nearest rank) up to FT_P2_EXACT samples, NAN when empty.
+  float value() const {
+    if (this->n_ == 0) return NAN;
+    if (this->n_ > FT_P2_EXACT) return this->q_[2];
+    const int rank = static_cast<int>(ceilf(this->p_ * this->n_)) - 1;
+    return this->exact_[rank < 0 ? 0 : rank];
+  }
+
+ protected:
+  // Places the markers at the min, p/2, p, (1+p)/2 and max ranks of the sorted
+  // exact samples, keeping the positions strictly increasing.
+  void seed_() {
+    const float last = FT_P2_EXACT - 1;
+    const float p = this->p_;
+    const float frac[5] = {0.0f, p / 2.0f, p, (1.0f + p) / 2.0f, 1.0f};
+    int32_t upper = FT_P2_EXACT;
+    for (int j = 4; j >= 0; j--) {
+      int32_t r = static_cast<int32_t>(lroundf(frac[j] * last));
+      if (r > upper - 1) r = upper - 1;
+      if (r < j) r = j;
+      this->pos_[j] = upper = r;
+      this->want_[j] = frac[j] * last;
+      this->step_[j] = frac[j];
+      this->q_[j] = this->exact_[r];
+    }
+  }
+
+  float parabolic_(int i, int s) const {
+    const float n0 = this->pos_[i - 1], n1 = this->pos_[i], n2 = this->pos_[i + 1];
+    return this->q_[i] + s / (n2 - n0) *
+                             ((n1 - n0 + s) * (this->q_[i + 1] - this->q_[i]) / (n2 - n1) +
+                              (n2 - n1 - s) * (this->q_[i] - this->q_[i - 1]) / (n1 - n0));
+  }
+
+  float p_;
+  uint32_t n_ = 0;
+  float exact_[FT_P2_EXACT] = {0};
+  float q_[5] = {0};      // marker heights
+  int32_t pos_[5] = {0};  // marker positions (0-based ranks)
+  float want_[5] = {0};   // desired marker positions
+  float step_[5] = {0};   // desired position increment per sample
+};
+
+static constexpr float FT_ROLLUP_QUANTILE = 0.95f;
+static constexpr int16_t FT_ROLLUP_TEMP_NONE = INT16_MIN;
+
+// One closed bucket. Temperatures in 0.1 °C (FT_ROLLUP_TEMP_NONE without a
+// valid reading), PWM in 0.1 %. 24 bytes.
+struct FtRollupBucket {
+  uint32_t t;      // history time of the bucket start, a multiple of the tier width
+  uint16_t count;  // control ticks in the bucket
+  int16_t temp_min, temp_max, temp_mean, temp_p95;
+  uint16_t pwm_min, pwm_max, pwm_mean, pwm_p95;
+};
+
+// Running count/min/max/sum/p95 of one metric in the open bucket.
+struct FtRollupStat {
+  uint32_t n = 0;
+  float min = 0.0f, max = 0.0f, sum = 0.0f;
+  FtP2Quantile p95{FT_ROLLUP_QUANTILE};
+
+  void reset() {
+    this->n = 0;
+    this->sum = 0.0f;
+    this->p95.reset();
+  }
+  void add(float x) {
+    if (this->n == 0 || x < this->min) this->min = x;
+    if (this->n == 0 || x > this->max) this->max = x;
+    this->sum += x;
+    this->n++;
+    this->p95.add(x);
+  }
+};
+
+static inline int16_t ft_rollup_temp_code(float temp_c) {
+  return static_cast<int16_t>(lroundf(fminf(fmaxf(temp_c, -3000.0f), 3000.0f) * 10.0f));
+}
+static inline uint16_t ft_rollup_pwm_code(float pwm_pct) {
+  return static_cast<uint16_t>(lroundf(fminf(fmaxf(pwm_pct, 0.0f), 100.0f) * 10.0f));
+}
+
+// A ring of closed buckets of one width, plus the bucket being filled.
+template<uint16_t N> class FtRollupTier {
+ public:
+  explicit FtRollupTier(uint32_t width_s) : width_s_(width_s) {}
+
+  uint32_t width_s() const { return this->width_s_; }
+  uint16_t capacity() const { return N; }
+  uint16_t count() const { return this->count_; }
+
+  // Adds one tick at history time t; closes the open bucket when t leaves it.
+  void add(uint32_t t, float temp_c, float pwm_pct) {
+    std::lock_guard<std::mutex> lock(this->lock_);
+    const uint32_t start = t - t % this->width_s_;
+    if (this->open_ticks_ > 0 && start != this->open_t_) this->close_();
+    if (this->open_ticks_ == 0) {
+      this->open_t_ = start;
+      this->temp_.reset();
+      this->pwm_.reset();
+    }
+    if (this->open_ticks_ < UINT16_MAX) this->open_ticks_++;
+    if (std::isfinite(temp_c)) this->temp_.add(temp_c);
+    this->pwm_.add(pwm_pct);
+  }
+
+  // Calls visit(const FtRollupBucket &) for buckets starting in [from, to],
+  // oldest first, ending with the open bucket. visit returns false to stop.
+  template<typename F> void query(uint32_t from, uint32_t to, F &&visit) const {
+    // Buckets are in time order: binary search for the first one at or after
+    // `from`. k counts closed buckets since boot, so a bucket overwritten
+    // between copies is noticed and skipped rather than read torn.
+    uint32_t k;
+    {
+      std::lock_guard<std::mutex> lock(this->lock_);
+      uint16_t lo = 0, hi = this->count_;
+      while (lo < hi) {
+        const uint16_t mid = static_cast<uint16_t>((lo + hi) / 2);
+        if (this->at_(mid).t < from)
+          lo = static_cast<uint16_t>(mid + 1);
+        else
+          hi = mid;
+      }
+      k = this->closed_ - this->count_ + lo;
+    }
+    for (;;) {
+      FtRollupBucket b;
+      bool open = false;
+      {
+        std::lock_guard<std::mutex> lock(this->lock_);
+        const uint32_t oldest = this->closed_ - this->count_;
+        if (k < oldest) k = oldest;
+        if (k < this->closed_) {
+          b = this->buf_[k++ % N];
+        } else if (this->open_ticks_ > 0) {
+          b = this->snapshot_();
+          open = true;
+        } else {
+          return;
+        }
+      }
+      if (open) {
+        if (b.t >= from && b.t <= to) visit(b);
+        return;
+      }
+      if (b.t > to || !visit(b)) return;
+    }
+  }
+
+ protected:
+  const FtRollupBucket &at_(uint16_t i) const { return this->buf_[(this->closed_ - this->count_ + i) % N]; }
+
+  FtRollupBucket snapshot_() const {
+    FtRollupBucket b;
+    b.t = this->open_t_;
+    b.count = this->open_ticks_;
+    if (this->temp_.n > 0) {
+      b.temp_min = ft_rollup_temp_code(this->temp_.min);
+      b.temp_max = ft_rollup_temp_code(this->temp_.max);
+      b.temp_mean = ft_rollup_temp_code(this->temp_.sum / this->temp_.n);
+      b.temp_p95 = ft_rollup_temp_code(this->temp_.p95.value());
+    } else {
+      b.temp_min = b.temp_max = b.temp_mean = b.temp_p95 = FT_ROLLUP_TEMP_NONE;
+    }
+    b.pwm_min = ft_rollup_pwm_code(this->pwm_.min);
+    b.pwm_max = ft_rollup_pwm_code(this->pwm_.max);
+    b.pwm_mean = ft_rollup_pwm_code(this->pwm_.sum / this->pwm_.n);
+    b.pwm_p95 = ft_rollup_pwm_code(this->pwm_.p95.value());
+    return b;
+  }
+
+  void close_() {
+    this->buf_[this->closed_++ % N] = this->snapshot_();
+    if (this->count_ < N) this->count_++;
+    this->open_ticks_ = 0;
+  }
+
+  uint32_t width_s_;
+  FtRollupBucket buf_[N];
+  uint32_t closed_ = 0;  // buckets closed since boot; the next one goes to buf_[closed_ % N]
+  uint16_t count_ = 0;
+  uint32_t open_t_ = 0;
+  uint16_t open_ticks_ = 0;
+  FtRollupStat temp_;
+  FtRollupStat pwm_;
+  mutable std::mutex lock_;
+};
+
+// The three tiers: 5 min of 1 s, 12 h of 1 min and 14 days of 1 h buckets (~32 KB).
+struct FtRollups {
+  FtRollupTier<300> sec{1};
+  FtRollupTier<720> min{60};
+  FtRollupTier<336> hour{3600};
+
+  void add(uint32_t t, float temp_c, float pwm_pct) {
+    this->sec.add(t, temp_c, pwm_pct);
+    this->min.add(t, temp_c, pwm_pct);
+    this->hour.add(t, temp_c, pwm_pct);
+  }
+
+  // Coarsest tier no wider than resolution_s (the 1 s tier below that).
+  int tier_for(uint32_t resolution_s) const {
+    if (resolution_s >= this->hour.width_s()) return 2;
+    if (resolution_s >= this->min.width_s()) return 1;
+    return 0;
+  }
+
+  uint32_t width_s(int tier) const {
+    return tier == 2 ? this->hour.width_s() : tier == 1 ? this->min.width_s() : this->sec.width_s();
+  }
+
+  template<typename F> void query(int tier, uint32_t from, uint32_t to, F &&visit) const {
+    if (tier == 2)
+      this->hour.query(from, to, visit);
+    else if (tier == 1)
+      this->min.query(from, to, visit);
+    else
+      this->sec.query(from, to, visit);
+  }
+};
@@ -0,0 +1,507 @@
+#pragma once
+
+// Conditional overrides for the control loop ("rules"), compiled once when the
+// config is applied and run every tick by a small stack VM:
+//
+//   when rise > 2 then add 15
+//   when mode == manual and temp > 70 then mode auto
+//   when temp >= 40 and temp < 55 then cap 60%
+//
+// Rules are separated by ';' or newlines; '#' starts a comment.
+//
+//   rule   := 'when' expr 'then' action
+//   action := ('add' | 'floor' | 'cap') expr | 'mode' ('auto' | 'manual' | 'off')
+//   expr   := 'or' / 'and' / 'not' over at most one comparison (< <= > >= == !=)
+//             per operand, of + - * / arithmetic, parentheses and numbers
+//             (a trailing % is allowed and ignored)
+//
+// Inputs: temp (control temperature, C), raw (raw reading, C), rise (C/min),
+// load (%), pwm (output before this tick, %), mode, failsafe, external; and
+// the constants auto, manual, off, true and false. A missing input is NaN and
+// every comparison involving NaN is false.
+//
+// All rules see the same inputs, and their effects combine rather than chain:
+// adds sum, the highest floor and the lowest cap win, and the last firing mode
+// wins. The controller applies PWM effects to the AUTO or MANUAL target before
+// the min/max window; failsafe still overrides them, and stays armed under a
+// rule-driven MANUAL or OFF while the configured mode is AUTO.
+//
+// The bytecode has no backward jumps, so a program runs at most once through
+// its code; FT_RULES_STEP_BUDGET bounds it anyway, and a tick that exceeds
+// the budget drops every effect. No ESPHome dependencies.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static constexpr size_t FT_RULES_SOURCE_MAX = 254;  // bytes; matches the schema's maxLength
+static constexpr uint16_t FT_RULES_CODE_MAX = 256;
+static constexpr uint8_t FT_RULES_CONST_MAX = 32;
+static constexpr int FT_RULES_STACK = 8;
+static constexpr int FT_RULES_NEST_MAX = 12;
+static constexpr uint16_t FT_RULES_STEP_BUDGET = 256;
+
+enum FtRuleVar : uint8_t {
+  FT_RULE_VAR_TEMP = 0,
+  FT_RULE_VAR_RAW,
+  FT_RULE_VAR_RISE,
+  FT_RULE_VAR_LOAD,
+  FT_RULE_VAR_PWM,
+  FT_RULE_VAR_MODE,
+  FT_RULE_VAR_FAILSAFE,
+  FT_RULE_VAR_EXTERNAL,
+  FT_RULE_VAR_COUNT,
+};
+static constexpr const char *FT_RULE_VAR_NAMES[FT_RULE_VAR_COUNT] = {"temp", "raw",  "rise",     "load",
+                                                                     "pwm",  "mode", "failsafe", "external"};
+
+// One byte per opcode; CONST, VAR, SKIP and MODE take a one-byte operand.
+enum FtRuleOp : uint8_t {
+  FT_RULE_OP_CONST = 0,  // push consts[operand]
+  FT_RULE_OP_VAR,        // push vars[operand]
+  FT_RULE_OP_ADD,
+  FT_RULE_OP_SUB,
+  FT_RULE_OP_MUL,
+  FT_RULE_OP_DIV,  // x / 0 is NaN
+  FT_RULE_OP_NEG,
+  FT_RULE_OP_LT,
+  FT_RULE_OP_LE,
+  FT_RULE_OP_GT,
+  FT_RULE_OP_GE,
+  FT_RULE_OP_EQ,
+  FT_RULE_OP_NE,
+  FT_RULE_OP_AND,
+  FT_RULE_OP_OR,
+  FT_RULE_OP_NOT,
+  FT_RULE_OP_SKIP,       // pop; when false, jump forward by operand bytes
+  FT_RULE_OP_PWM_ADD,    // pop into the effect
+  FT_RULE_OP_PWM_FLOOR,  // pop into the effect
+  FT_RULE_OP_PWM_CAP,    // pop into the effect
+  FT_RULE_OP_MODE,       // effect mode = operand
+};
+
+struct FtRuleProgram {
+  uint8_t code[FT_RULES_CODE_MAX];
+  float consts[FT_RULES_CONST_MAX];
+  uint16_t len = 0;
+  uint8_t n_consts = 0;
+  uint8_t n_rules = 0;
+
+  bool empty() const { return this->len == 0; }
+  void clear() { this->len = this->n_consts = this->n_rules = 0; }
+};
+
+// What the rules asked for in one tick. The neutral values leave the target alone.
+struct FtRuleEffect {
+  float add = 0.0f;
+  float floor = 0.0f;
+  float cap = 100.0f;
+  int mode = -1;  // -1: keep the configured mode
+  uint8_t fired = 0;
+  uint16_t steps = 0;
+  bool overrun = false;
+};
+
+// True for any non-zero number; NaN is false.
+static inline bool ft_rule_truth(float v) { return v > 0.0f || v < 0.0f; }
+
+// Runs a compiled program over vars[FT_RULE_VAR_COUNT].
+static inline void ft_rules_run(const FtRuleProgram &prog, const float *vars, FtRuleEffect &eff) {
+  eff = FtRuleEffect{};
+  float st[FT_RULES_STACK];
+  int sp = 0;
+  uint16_t pc = 0;
+  uint16_t steps = 0;
+  float v;
+  while (pc < prog.len) {
+    if (steps == FT_RULES_STEP_BUDGET) {
+      eff = FtRuleEffect{};
+      eff.steps = steps;
+      eff.overrun = true;
+      return;
+    }
+    steps++;
+    switch (prog.code[pc++]) {
+      case FT_RULE_OP_CONST:
+        st[sp++] = prog.consts[prog.code[pc++]];
+        break;
+      case FT_RULE_OP_VAR:
+        st[sp++] = vars[prog.code[pc++]];
+        break;
+      case FT_RULE_OP_ADD:
+        sp--;
+        st[sp - 1] += st[sp];
+        break;
+      case FT_RULE_OP_SUB:
+        sp--;
+        st[sp - 1] -= st[sp];
+        break;
+      case FT_RULE_OP_MUL:
+        sp--;
+        st[sp - 1] *= st[sp];
+        break;
+      case FT_RULE_OP_DIV:
+        sp--;
+        st[sp - 1] = st[sp] != 0.0f ? st[sp - 1] / st[sp] : NAN;
+        break;
+      case FT_RULE_OP_NEG:
+        st[sp - 1] = -st[sp - 1];
+        break;
+      case FT_RULE_OP_LT:
+        sp--;
+        st[sp - 1] = st[sp - 1] < st[sp] ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_LE:
+        sp--;
+        st[sp - 1] = st[sp - 1] <= st[sp] ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_GT:
+        sp--;
+        st[sp - 1] = st[sp - 1] > st[sp] ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_GE:
+        sp--;
+        st[sp - 1] = st[sp - 1] >= st[sp] ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_EQ:
+        sp--;
+        st[sp - 1] = st[sp - 1] == st[sp] ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_NE:
+        // Spelled as < or > so that NaN compares false here too.
+        sp--;
+        st[sp - 1] = (st[sp - 1] < st[sp] || st[sp - 1] > st[sp]) ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_AND:
+        sp--;
+        st[sp - 1] = ft_rule_truth(st[sp - 1]) && ft_rule_truth(st[sp]) ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_OR:
+        sp--;
+        st[sp - 1] = ft_rule_truth(st[sp - 1]) || ft_rule_truth(st[sp]) ? 1.0f : 0.0f;
+        break;
+      case FT_RULE_OP_NOT:
+        st[sp - 1] = ft_rule_truth(st[sp - 1]) ? 0.0f : 1.0f;
+        break;
+      case FT_RULE_OP_SKIP: {
+        const uint8_t offset = prog.code[pc++];
+        if (!ft_rule_truth(st[--sp])) pc += offset;
+        break;
+      }
+      case FT_RULE_OP_PWM_ADD:
+        v = st[--sp];
+        if (std::isfinite(v)) eff.add += v;
+        eff.fired++;
+        break;
+      case FT_RULE_OP_PWM_FLOOR:
+        v = st[--sp];
+        if (v > eff.floor) eff.floor = v;
+        eff.fired++;
+        break;
+      case FT_RULE_OP_PWM_CAP:
+        v = st[--sp];
+        if (v < eff.cap) eff.cap = v;
+        eff.fired++;
+        break;
+      case FT_RULE_OP_MODE:
+        eff.mode = prog.code[pc++];
+        eff.fired++;
+        break;
+      default:
+        // Not produced by the compiler; treat like an overrun.
+        eff = FtRuleEffect{};
+        eff.steps = steps;
+        eff.overrun = true;
+        return;
+    }
+  }
+  eff.steps = steps;
+}
+
+/**
+ * Single-pass compiler: a tokenizer and a recursive-descent parser that emits
+ * bytecode as it goes, tracking the VM stack depth so the program can run
+ * without bounds checks.
+ */
+class FtRuleCompiler {
+ public:
+  FtRuleCompiler(const char *src, size_t len, FtRuleProgram &out) : p_(src), end_(src + len), out_(out) {}
+
+  // On failure err reads like "rules: rule 2: expected 'then' near 'add'".
+  bool compile(char *err, size_t cap) {
+    this->out_.clear();
+    this->next_();
+    while (this->ok_ && this->tok_ != TOK_END) {
+      if (this->tok_ == TOK_SEP) {
+        this->next_();
+        continue;
+      }
+      this->rule_();
+      if (this->ok_ && this->tok_ != TOK_SEP && this->tok_ != TOK_END) this->fail_("expected ';' or a new line");
+    }
+    if (this->ok_) return true;
+    this->out_.clear();
+    if (this->tok_ == TOK_END)
+      snprintf(err, cap, "rules: rule %d: %s at the end", this->rule_no_, this->error_);
+    else
+      snprintf(err, cap, "rules: rule %d: %s near '%.*s'", this->rule_no_, this->error_,
+               static_cast<int>(this->tok_len_ > 16 ? 16 : this->tok_len_), this->tok_start_);
+    return false;
+  }
+
+ protected:
+  enum Tok : uint8_t { TOK_END, TOK_SEP, TOK_NUM, TOK_NAME, TOK_SYM };
+
+  bool fail_(const char *msg) {
+    if (this->ok_) this->error_ = msg;
+    this->ok_ = false;
+    return false;
+  }
+
+  // --- tokenizer ------------------------------------------------------------
+
+  static bool is_name_char_(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+  }
+
+  void next_() {
+    while (this->p_ < this->end_) {
+      const char c = *this->p_;
+      if (c == ' ' || c == '\t' || c == '\r') {
+        this->p_++;
+      } else if (c == '#') {
+        while (this->p_ < this->end_ && *this->p_ != '\n') this->p_++;
+      } else {
+        break;
+      }
+    }
+    this->tok_start_ = this->p_;
+    this->tok_len_ = 0;
+    if (this->p_ >= this->end_) {
+      this->tok_ = TOK_END;
+      return;
+    }
+    const char c = *this->p_;
+    if (c == ';' || c == '\n') {
+      this->tok_ = TOK_SEP;
+      this->p_++;
+    } else if ((c >= '0' && c <= '9') || c == '.') {
+      char buf[24];
+      size_t n = 0;
+      while (this->p_ < this->end_ && ((*this->p_ >= '0' && *this->p_ <= '9') || *this->p_ == '.') &&
+             n < sizeof(buf) - 1)
+        buf[n++] = *this->p_++;
+      buf[n] = '\0';
+      char *stop;
+      this->num_ = strtof(buf, &stop);
+      this->tok_ = TOK_NUM;
+      if (*stop != '\0' || !std::isfinite(this->num_)) this->fail_("bad number");
+      if (this->p_ < this->end_ && *this->p_ == '%') this->p_++;
+    } else if (is_name_char_(c) && !(c >= '0' && c <= '9')) {
+      while (this->p_ < this->end_ && is_name_char_(*this->p_)) this->p_++;
+      this->tok_ = TOK_NAME;
+    } else {
+      this->tok_ = TOK_SYM;
+      this->p_++;
+      if (this->p_ < this->end_ && *this->p_ == '=' && strchr("<>=!", c) != nullptr) this->p_++;
+      if (strchr("<>+-*/()", c) == nullptr && this->p_ - this->tok_start_ == 1) {
+        this->tok_len_ = 1;
+        this->fail_("unexpected character");
+        return;
+      }
+    }
+    this->tok_len_ = static_cast<size_t>(this->p_ - this->tok_start_);
+  }
+
+  bool is_(const char *word) const {
+    return (this->tok_ == TOK_NAME || this->tok_ == TOK_SYM) && strlen(word) == this->tok_len_ &&
+           memcmp(word, this->tok_start_, this->tok_len_) == 0;
+  }
+
+  bool accept_(const char *word) {
+    if (!this->ok_ || !this->is_(word)) return false;
+    this->next_();
+    return true;
+  }
+
+  // --- emitter --------------------------------------------------------------
+
+  bool emit_(uint8_t byte) {
+    if (this->out_.len >= FT_RULES_CODE_MAX) return this->fail_("rules too long for the code buffer");
+    this->out_.code[this->out_.len++] = byte;
+    return true;
+  }
+
+  // Emits op and tracks the stack: push ops add one, binary ops remove one, actions and SKIP pop.
+  bool op_(FtRuleOp op, int stack_delta) {
+    this->depth_ += stack_delta;
+    if (this->depth_ > FT_RULES_STACK) return this->fail_("expression too complex");
+    return this->emit_(op);
+  }
+
+  bool push_const_(float v) {
+    uint8_t i = 0;
+    while (i < this->out_.n_consts && memcmp(&this->out_.consts[i], &v, sizeof(v)) != 0) i++;
+    if (i == this->out_.n_consts) {
+      if (i >= FT_RULES_CONST_MAX) return this->fail_("too many constants");
+      this->out_.consts[this->out_.n_consts++] = v;
+    }
+    return this->op_(FT_RULE_OP_CONST, 1) && this->emit_(i);
+  }
+
+  // --- grammar --------------------------------------------------------------
+
+  void rule_() {
+    this->rule_no_++;
+    if (!this->accept_("when")) {
+      this->fail_("expected 'when'");
+      return;
+    }
+    if (!this->expr_()) return;
+    if (!this->op_(FT_RULE_OP_SKIP, -1) || !this->emit_(0)) return;
+    const uint16_t patch = this->out_.len - 1;
+    if (!this->accept_("then")) {
+      this->fail_("expected 'then'");
+      return;
+    }
+    if (!this->action_()) return;
+    this->out_.code[patch] = static_cast<uint8_t>(this->out_.len - patch - 1);
+    this->out_.n_rules++;
+  }
+
+  bool action_() {
+    FtRuleOp op;
+    if (this->accept_("add")) {
+      op = FT_RULE_OP_PWM_ADD;
+    } else if (this->accept_("floor")) {
+      op = FT_RULE_OP_PWM_FLOOR;
+    } else if (this->accept_("cap")) {
+      op = FT_RULE_OP_PWM_CAP;
+    } else if (this->accept_("mode")) {
+      for (uint8_t m = 0; m < 3; m++) {
+        if (this->accept_(m == 0 ? "auto" : m == 1 ? "manual" : "off"))
+          return this->op_(FT_RULE_OP_MODE, 0) && this->emit_(m);
+      }
+      return this->fail_("expected auto, manual or off");
+    } else {
+      return this->fail_("expected add, floor, cap or mode");
+    }
+    return this->expr_() && this->op_(op, -1);
+  }
+
+  bool expr_() {
+    if (++this->nest_ > FT_RULES_NEST_MAX) return this->fail_("expression too deep");
+    bool ok = this->and_();
+    while (ok && this->accept_("or")) ok = this->and_() && this->op_(FT_RULE_OP_OR, -1);
+    this->nest_--;
+    return ok && this->ok_;
+  }
+
+  bool and_() {
+    bool ok = this->not_();
+    while (ok && this->accept_("and")) ok = this->not_() && this->op_(FT_RULE_OP_AND, -1);
+    return ok;
+  }
+
+  bool not_() {
+    if (!this->accept_("not")) return this->compare_();
+    if (++this->nest_ > FT_RULES_NEST_MAX) return this->fail_("expression too deep");
+    const bool ok = this->not_() && this->op_(FT_RULE_OP_NOT, 0);
+    this->nest_--;
+    return ok;
+  }
+
+  bool compare_() {
+    if (!this->sum_()) return false;
+    static constexpr const char *SYMS[] = {"<", "<=", ">", ">=", "==", "!="};
+    static constexpr FtRuleOp OPS[] = {FT_RULE_OP_LT, FT_RULE_OP_LE, FT_RULE_OP_GT,
+                                       FT_RULE_OP_GE, FT_RULE_OP_EQ, FT_RULE_OP_NE};
+    for (int i = 0; i < 6; i++) {
+      if (this->accept_(SYMS[i])) return this->sum_() && this->op_(OPS[i], -1);
+    }
+    return true;
+  }
+
+  bool sum_() {
+    bool ok = this->product_();
+    while (ok) {
+      if (this->accept_("+"))
+        ok = this->product_() && this->op_(FT_RULE_OP_ADD, -1);
+      else if (this->accept_("-"))
+        ok = this->product_() && this->op_(FT_RULE_OP_SUB, -1);
+      else
+        break;
+    }
+    return ok;
+  }
+
+  bool product_() {
+    bool ok = this->unary_();
+    while (ok) {
+      if (this->accept_("*"))
+        ok = this->unary_() && this->op_(FT_RULE_OP_MUL, -1);
+      else if (this->accept_("/"))
+        ok = this->unary_() && this->op_(FT_RULE_OP_DIV, -1);
+      else
+        break;
+    }
+    return ok;
+  }
+
+  bool unary_() {
+    if (!this->accept_("-")) return this->atom_();
+    if (++this->nest_ > FT_RULES_NEST_MAX) return this->fail_("expression too deep");
+    const bool ok = this->unary_() && this->op_(FT_RULE_OP_NEG, 0);
+    this->nest_--;
+    return ok;
+  }
+
+  bool atom_() {
+    if (!this->ok_) return false;
+    if (this->tok_ == TOK_NUM) {
+      const float v = this->num_;
+      this->next_();
+      return this->push_const_(v);
+    }
+    if (this->accept_("(")) return this->expr_() && (this->accept_(")") || this->fail_("expected ')'"));
+    if (this->tok_ == TOK_NAME) {
+      for (uint8_t i = 0; i < FT_RULE_VAR_COUNT; i++) {
+        if (this->accept_(FT_RULE_VAR_NAMES[i])) return this->op_(FT_RULE_OP_VAR, 1) && this->emit_(i);
+      }
+      static constexpr const char *NAMES[] = {"auto", "manual", "off", "true", "false"};
+      static constexpr float VALUES[] = {0.0f, 1.0f, 2.0f, 1.0f, 0.0f};
+      for (int i = 0; i < 5; i++) {
+        if (this->accept_(NAMES[i])) return this->push_const_(VALUES[i]);
+      }
+      return this->fail_("unknown name");
+    }
+    return this->fail_("expected a value");
+  }
+
+  const char *p_;
+  const char *end_;
+  FtRuleProgram &out_;
+  Tok tok_ = TOK_END;
+  const char *tok_start_ = nullptr;
+  size_t tok_len_ = 0;
+  float num_ = 0.0f;
+  bool ok_ = true;
+  const char *error_ = nullptr;
+  int rule_no_ = 0;
+  int depth_ = 0;
+  int nest_ = 0;
+};
+
+// Compiles src into out; an empty or comment-only source gives an empty program.
+static inline bool ft_rules_compile(const char *src, FtRuleProgram &out, char *err, size_t cap) {
+  const size_t len = strlen(src);
+  if (len > FT_RULES_SOURCE_MAX) {
+    out.clear();
+    snprintf(err, cap, "rules: longer than %u bytes", static_cast<unsigned>(FT_RULES_SOURCE_MAX));
+    return false;
+  }
+  FtRuleCompiler compiler(src, len, out);
+  return compiler.compile(err, cap);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+// Always-on stage trace: a fixed ring of FtStageRecord, one per control tick,
+// holding the intermediate value and cost of every pipeline stage for the last
+// FT_STAGE_TRACE_LEN ticks. A trigger (failsafe latching, a late tick, or an
+// explicit freeze) lets the buffer run on for a post-trigger window and then
+// freezes it until re-armed, so the ticks around an incident survive until
+// someone downloads them. No ESPHome dependencies; the host converter reads the
+// same dump format.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "fanforge_control.h"
+
+static constexpr uint16_t FT_STAGE_TRACE_LEN = 256;  // ~51 s at the 200 ms tick, 13 KB
+static constexpr uint16_t FT_STAGE_TRACE_POST_TRIGGER = FT_STAGE_TRACE_LEN / 4;
+static constexpr uint8_t FT_STAGE_TRACE_VERSION = 2;  // 2: rules stage added
+
+enum FtStageTrigger : uint8_t {
+  FT_STAGE_TRIGGER_FAILSAFE = 1 << 0,  // failsafe latched
+  FT_STAGE_TRIGGER_LATE = 1 << 1,      // control tick started late (loop stall)
+  FT_STAGE_TRIGGER_MANUAL = 1 << 2,    // freeze requested over the API
+};
+
+// Dump layout: this header, then `count` FtStageRecord oldest first. Little-endian.
+struct FtStageTraceHeader {
+  char magic[4];  // "FFST"
+  uint8_t version;
+  uint8_t record_size;
+  uint16_t count;
+  uint16_t capacity;
+  uint8_t frozen;
+  uint8_t trigger;          // FtStageTrigger that fired, 0 if none
+  uint16_t trigger_index;   // record index of the triggering tick, 0xFFFF if not in the dump
+  uint16_t cycles_per_us;   // unit of FtStageRecord::stage_cycles
+  uint32_t now_ms;          // device time at download
+  uint32_t total;           // ticks recorded since boot
+};
+static_assert(sizeof(FtStageTraceHeader) == 24, "FtStageTraceHeader is a wire format");
+
+class FtStageTrace {
+ public:
+  void set_trigger_mask(uint8_t mask) { this->trigger_mask_ = mask; }
+  uint8_t trigger_mask() const { return this->trigger_mask_; }
+  bool frozen() const { return this->frozen_; }
+  uint8_t trigger() const { return this->trigger_; }
+  uint16_t count() const { return this->count_; }
+
+  // Slot for the next tick, or nullptr while frozen or held (the tick then runs untraced).
+  FtStageRecord *begin() { return this->frozen_ || this->holds_ > 0 ? nullptr : &this->buf_[this->head_]; }
+
+  // Keeps the ring still while a download reads it record by record; ticks in
+  // between run untraced, as when frozen. Calls nest.
+  void hold() { this->holds_++; }
+  void release() {
+    if (this->holds_ > 0) this->holds_--;
+  }
+
+  // Commits the slot handed out by begin() and evaluates the triggers.
+  void commit() {
+    FtStageRecord &rec = this->buf_[this->head_];
+    this->head_ = (this->head_ + 1) % FT_STAGE_TRACE_LEN;
+    if (this->count_ < FT_STAGE_TRACE_LEN) this->count_++;
+    this->total_++;
+
+    uint8_t fired = 0;
+    if ((rec.flags & FT_STAGE_F_FAILSAFE) && !(this->prev_flags_ & FT_STAGE_F_FAILSAFE))
+      fired |= FT_STAGE_TRIGGER_FAILSAFE;
+    if (rec.flags & FT_STAGE_F_LATE) fired |= FT_STAGE_TRIGGER_LATE;
+    this->prev_flags_ = rec.flags;
+    fired &= this->trigger_mask_;
+
+    if (this->trigger_ != 0) {
+      if (this->post_left_ > 0 && --this->post_left_ == 0) this->frozen_ = true;
+    } else if (fired != 0) {
+      rec.flags |= FT_STAGE_F_TRIGGER;
+      this->fire_(fired, FT_STAGE_TRACE_POST_TRIGGER);
+    }
+  }
+
+  // Freezes immediately, keeping the ticks up to now.
+  void freeze() {
+    if (this->frozen_) return;
+    this->fire_(FT_STAGE_TRIGGER_MANUAL, 0);
+  }
+
+  void rearm() {
+    this->frozen_ = false;
+    this->trigger_ = 0;
+    this->trigger_seq_ = 0;
+    this->post_left_ = 0;
+  }
+
+  // Dump header for the records as they stand.
+  FtStageTraceHeader header(uint32_t now_ms, uint16_t cycles_per_us) const {
+    FtStageTraceHeader h{};
+    memcpy(h.magic, "FFST", 4);
+    h.version = FT_STAGE_TRACE_VERSION;
+    h.record_size = sizeof(FtStageRecord);
+    h.count = this->count_;
+    h.capacity = FT_STAGE_TRACE_LEN;
+    h.frozen = this->frozen_ ? 1 : 0;
+    h.trigger = this->trigger_;
+    h.trigger_index = 0xFFFF;
+    const uint32_t oldest_seq = this->total_ - this->count_ + 1;
+    if (this->trigger_seq_ >= oldest_seq && this->trigger_seq_ <= this->total_)
+      h.trigger_index = static_cast<uint16_t>(this->trigger_seq_ - oldest_seq);
+    h.cycles_per_us = cycles_per_us;
+    h.now_ms = now_ms;
+    h.total = this->total_;
+    return h;
+  }
+
+  // The i-th record of the dump, oldest first; i < count().
+  const FtStageRecord &record(uint16_t i) const {
+    const uint16_t start = (this->head_ + FT_STAGE_TRACE_LEN - this->count_) % FT_STAGE_TRACE_LEN;
+    return this->buf_[(start + i) % FT_STAGE_TRACE_LEN];
+  }
+
+  // Appends the dump (header + records, oldest first) to out.
+  void dump(std::string &out, uint32_t now_ms, uint16_t cycles_per_us) const {
+    const FtStageTraceHeader h = this->header(now_ms, cycles_per_us);
+    out.reserve(out.size() + sizeof(h) + this->count_ * sizeof(FtStageRecord));
+    out.append(reinterpret_cast<const char *>(&h), sizeof(h));
+    for (uint16_t i = 0; i < this->count_; i++) {
+      const FtStageRecord &rec = this->record(i);
+      out.append(reinterpret_cast<const char *>(&rec), sizeof(rec));
+    }
+  }
+
+ protected:
+  void fire_(uint8_t trigger, uint16_t post) {
+    this->trigger_ = trigger;
+    // A manual freeze points at the newest tick; a tick trigger at the one just committed.
+    this->trigger_seq_ = this->total_;
+    this->post_left_ = post;
+    if (post == 0) this->frozen_ = true;
+  }
+
+  FtStageRecord buf_[FT_STAGE_TRACE_LEN];
+  uint16_t head_ = 0;
+  uint16_t count_ = 0;
+  uint32_t total_ = 0;
+  uint8_t prev_flags_ = 0;
+  uint8_t trigger_mask_ = FT_STAGE_TRIGGER_FAILSAFE | FT_STAGE_TRIGGER_LATE;
+  uint8_t trigger_ = 0;
+  uint32_t trigger_seq_ = 0;
+  uint16_t post_left_ = 0;
+  bool frozen_ = false;
+  uint8_t holds_ = 0;
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+// Portable telemetry batching/encoding shared by the firmware MQTT publisher and
+// the host build in host/mqtt. No ESPHome or Arduino dependencies.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static constexpr int FT_TELEMETRY_MAX_BATCH = 16;
+static constexpr int FT_TELEMETRY_QUEUE_SLOTS = 4;
+static constexpr int FT_TELEMETRY_RING_SLOTS = FT_TELEMETRY_QUEUE_SLOTS + 1;  // one spare to encode into
+static constexpr size_t FT_TELEMETRY_MSG_BYTES = 640;
+
+// Binary record layout (little endian):
+//   header  : 'F' 'T' version:u8 count:u8 base_ts_ms:u32
+//   sample  : dt_ms:u16 temp_centi_c:i16 pwm_half_pct:u8 target_half_pct:u8 flags:u8
+// flags: bits 0-1 mode (0 auto, 1 manual, 2 off), bit 2 failsafe latched, bit 3 temperature valid.
+static constexpr uint8_t FT_TELEMETRY_BINARY_VERSION = 1;
+static constexpr size_t FT_TELEMETRY_BINARY_HEADER = 8;
+static constexpr size_t FT_TELEMETRY_BINARY_SAMPLE = 7;
+
+enum FtTelemetryFormat : uint8_t {
+  FT_TELEMETRY_JSON = 0,
+  FT_TELEMETRY_BINARY = 1,
+};
+
+struct FtTelemetrySample {
+  uint32_t ts_ms;
+  float temp_c;  // NAN when no valid reading
+  float pwm_pct;
+  float target_pwm_pct;
+  uint8_t mode;
+  bool failsafe;
+};
+
+struct FtTelemetryOptions {
+  FtTelemetryFormat format = FT_TELEMETRY_JSON;
+  // A sample is recorded on change, or at least once per heartbeat.
+  uint32_t heartbeat_ms = 30000;
+  float temp_change_c = 0.25f;
+  float pwm_change_pct = 1.0f;
+  // A batch is published when full or when its first sample is this old.
+  uint8_t max_batch_samples = 10;
+  uint32_t max_batch_age_ms = 2000;
+};
+
+struct FtTelemetryMessage {
+  uint16_t len;
+  uint8_t data[FT_TELEMETRY_MSG_BYTES];
+};
+
+struct FtTelemetryStats {
+  uint32_t samples_recorded = 0;
+  uint32_t messages_encoded = 0;
+  uint32_t messages_published = 0;
+  uint32_t messages_dropped = 0;  // evicted from a full queue or rejected by the transport
+};
+
+static inline uint8_t ft_telemetry_flags(const FtTelemetrySample &s) {
+  uint8_t flags = static_cast<uint8_t>(s.mode & 0x03);
+  if (s.failsafe) flags |= 0x04;
+  if (std::isfinite(s.temp_c)) flags |= 0x08;
+  return flags;
+}
+
+static inline uint8_t ft_telemetry_half_pct(float pct) {
+  if (!(pct > 0.0f)) return 0;
+  if (pct >= 100.0f) return 200;
+  return static_cast<uint8_t>(lroundf(pct * 2.0f));
+}
+
+static inline size_t ft_telemetry_encode_binary(const FtTelemetrySample *samples, int n, uint8_t *out, size_t cap) {
+  if (n <= 0 || cap < FT_TELEMETRY_BINARY_HEADER + n * FT_TELEMETRY_BINARY_SAMPLE) return 0;
+  const uint32_t base = samples[0].ts_ms;
+  out[0] = 'F';
+  out[1] = 'T';
+  out[2] = FT_TELEMETRY_BINARY_VERSION;
+  out[3] = static_cast<uint8_t>(n);
+  for (int b = 0; b < 4; b++) out[4 + b] = static_cast<uint8_t>(base >> (8 * b));
+
+  uint8_t *p = out + FT_TELEMETRY_BINARY_HEADER;
+  for (int i = 0; i < n; i++) {
+    const FtTelemetrySample &s = samples[i];
+    uint32_t dt = s.ts_ms - base;
+    if (dt > 0xFFFF) dt = 0xFFFF;
+    int16_t temp = INT16_MIN;
+    if (std::isfinite(s.temp_c)) temp = static_cast<int16_t>(lroundf(fmaxf(-300.0f, fminf(300.0f, s.temp_c)) * 100.0f));
+    p[0] = static_cast<uint8_t>(dt);
+    p[1] = static_cast<uint8_t>(dt >> 8);
+    p[2] = static_cast<uint8_t>(static_cast<uint16_t>(temp));
+    p[3] = static_cast<uint8_t>(static_cast<uint16_t>(temp) >> 8);
+    p[4] = ft_telemetry_half_pct(s.pwm_pct);
+    p[5] = ft_telemetry_half_pct(s.target_pwm_pct);
+    p[6] = ft_telemetry_flags(s);
+    p += FT_TELEMETRY_BINARY_SAMPLE;
+  }
+  return static_cast<size_t>(p - out);
+}
+
+// Short JSON: {"v":1,"t0":<ms>,"s":[[dt_ms,temp|null,pwm,target,flags],...]}
+static inline size_t ft_telemetry_encode_json(const FtTelemetrySample *samples, int n, uint8_t *out, size_t cap) {
+  if (n <= 0) return 0;
+  char *buf = reinterpret_cast<char *>(out);
+  const uint32_t base = samples[0].ts_ms;
+  int len = snprintf(buf, cap, "{\"v\":1,\"t0\":%u,\"s\":[", static_cast<unsigned>(base));
+  if (len < 0 || static_cast<size_t>(len) >= cap) return 0;
+  for (int i = 0; i < n; i++) {
+    const FtTelemetrySample &s = samples[i];
+    char temp[12];
+    if (std::isfinite(s.temp_c))
+      snprintf(temp, sizeof(temp), "%.2f", s.temp_c);
+    else
+      memcpy(temp, "null", 5);
+    int w = snprintf(buf + len, cap - len, "%s[%u,%s,%.1f,%.1f,%u]", i ? "," : "",
+                     static_cast<unsigned>(s.ts_ms - base), temp, s.pwm_pct, s.target_pwm_pct,
+                     static_cast<unsigned>(ft_telemetry_flags(s)));
+    if (w < 0 || static_cast<size_t>(len + w) >= cap) return 0;
+    len += w;
+  }
+  if (static_cast<size_t>(len + 2) >= cap) return 0;
+  buf[len++] = ']';
+  buf[len++] = '}';
+  buf[len] = '\0';
+  return static_cast<size_t>(len);
+}
+
+/**
+ * Change/heartbeat sampler with per-message batching and a bounded outbound queue.
+ *
+ * on_tick() runs inside the control tick: it only compares and copies, and encodes
+ * into a preallocated queue slot when a batch closes. drain() hands queued messages
+ * to the transport (QoS 0, fire-and-forget). A full queue evicts the oldest message.
+ */
+class FtTelemetryPublisher {
+ public:
+  void configure(const FtTelemetryOptions &opts) {
+    this->opts_ = opts;
+    if (this->opts_.max_batch_samples < 1) this->opts_.max_batch_samples = 1;
+    if (this->opts_.max_batch_samples > FT_TELEMETRY_MAX_BATCH) this->opts_.max_batch_samples = FT_TELEMETRY_MAX_BATCH;
+  }
+
+  const FtTelemetryOptions &options() const { return this->opts_; }
+  const FtTelemetryStats &stats() const { return this->stats_; }
+  int queued() const { return this->q_count_; }
+
+  void on_tick(const FtTelemetrySample &s) {
+    if (this->should_record_(s)) {
+      this->batch_[this->batch_n_++] = s;
+      this->last_ = s;
+      this->has_last_ = true;
+      this->stats_.samples_recorded++;
+    }
+    if (this->batch_n_ == 0) return;
+    const bool full = this->batch_n_ >= this->opts_.max_batch_samples;
+    const bool aged = (s.ts_ms - this->batch_[0].ts_ms) >= this->opts_.max_batch_age_ms;
+    if (full || aged) this->flush();
+  }
+
+  // Closes the open batch (if any) into the outbound queue.
+  // The batch is encoded into the spare slot first; only once it fits does a
+  // full queue evict its oldest message, so each lost message is one drop.
+  void flush() {
+    if (this->batch_n_ == 0) return;
+    FtTelemetryMessage &msg = this->queue_[(this->q_head_ + this->q_count_) % FT_TELEMETRY_RING_SLOTS];
+    size_t len = this->opts_.format == FT_TELEMETRY_BINARY
+                     ? ft_telemetry_encode_binary(this->batch_, this->batch_n_, msg.data, sizeof(msg.data))
+                     : ft_telemetry_encode_json(this->batch_, this->batch_n_, msg.data, sizeof(msg.data));
+    this->batch_n_ = 0;
+    if (len == 0) {
+      this->stats_.messages_dropped++;
+      return;
+    }
+    msg.len = static_cast<uint16_t>(len);
+    if (this->q_count_ == FT_TELEMETRY_QUEUE_SLOTS) {
+      this->q_head_ = (this->q_head_ + 1) % FT_TELEMETRY_RING_SLOTS;
+      this->q_count_--;
+      this->stats_.messages_dropped++;
+    }
+    this->q_count_++;
+    this->stats_.messages_encoded++;
+  }
+
+  // publish(const uint8_t *data, size_t len) -> bool. Stops at the first refusal
+  // (transport down) and keeps the rest queued; returns messages sent.
+  template<typename Publish> int drain(Publish &&publish, int max_messages = FT_TELEMETRY_QUEUE_SLOTS) {
+    int sent = 0;
+    while (this->q_count_ > 0 && sent < max_messages) {
+      const FtTelemetryMessage &msg = this->queue_[this->q_head_];
+      if (!publish(msg.data, static_cast<size_t>(msg.len))) break;
+      this->q_head_ = (this->q_head_ + 1) % FT_TELEMETRY_RING_SLOTS;
+      this->q_count_--;
+      this->stats_.messages_published++;
+      sent++;
+    }
+    return sent;
+  }
+
+ private:
+  bool should_record_(const FtTelemetrySample &s) const {
+    if (!this->has_last_) return true;
+    if ((s.ts_ms - this->last_.ts_ms) >= this->opts_.heartbeat_ms) return true;
+    if (s.mode != this->last_.mode || s.failsafe != this->last_.failsafe) return true;
+    if (std::isfinite(s.temp_c) != std::isfinite(this->last_.temp_c)) return true;
+    if (std::isfinite(s.temp_c) && fabsf(s.temp_c - this->last_.temp_c) >= this->opts_.temp_change_c) return true;
+    if (fabsf(s.pwm_pct - this->last_.pwm_pct) >= this->opts_.pwm_change_pct) return true;
+    if (fabsf(s.target_pwm_pct - this->last_.target_pwm_pct) >= this->opts_.pwm_change_pct) return true;
+    return false;
+  }
+
+  FtTelemetryOptions opts_;
+  FtTelemetryStats stats_;
+  FtTelemetrySample batch_[FT_TELEMETRY_MAX_BATCH];
+  int batch_n_ = 0;
+  FtTelemetrySample last_{};
+  bool has_last_ = false;
+  FtTelemetryMessage queue_[FT_TELEMETRY_RING_SLOTS];
+  int q_head_ = 0;
+  int q_count_ = 0;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+// The web UI served from flash, same-origin with the API. Portable: the asset
+// table comes from fanforge_ui_assets.h, generated by host/codegen/gen_ui_assets.py
+// from the Vite build (`npm run build:device`), and holds every file already
+// gzip-compressed so serving one is a single copy out of flash.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+struct FtUiAsset {
+  const char *path;  // request path, "/ui/..."
+  const char *content_type;
+  const uint8_t *data;
+  uint32_t size;
+  const char *etag;  // quoted strong validator (hash of the uncompressed file)
+  bool gzip;         // data is gzip; sent with Content-Encoding: gzip
+  bool immutable;    // content-hashed name: cacheable for a year
+};
+
+static constexpr const char *FT_UI_ROOT = "/ui/";
+static constexpr const char *FT_UI_CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+// index.html and the unhashed files are revalidated with If-None-Match every time.
+static constexpr const char *FT_UI_CACHE_REVALIDATE = "no-cache";
+
+// Finds the asset for a request path; the UI root maps to its index.html.
+static inline const FtUiAsset *ft_ui_find(const FtUiAsset *assets, size_t count, const char *path) {
+  const size_t root_len = strlen(FT_UI_ROOT);
+  const bool root = strcmp(path, FT_UI_ROOT) == 0;
+  for (size_t i = 0; i < count; i++) {
+    const char *p = assets[i].path;
+    if (root ? strcmp(p + root_len, "index.html") == 0 : strcmp(p, path) == 0) return &assets[i];
+  }
+  return nullptr;
+}
+
+// True when an If-None-Match header value lists `etag` (weak or strong) or is "*".
+static inline bool ft_ui_etag_matches(const char *if_none_match, const char *etag) {
+  const size_t etag_len = strlen(etag);
+  const char *p = if_none_match;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == ',') p++;
+    const char *start = p;
+    while (*p != '\0' && *p != ',') p++;
+    const char *end = p;
+    while (end > start && end[-1] == ' ') end--;
+    if (end - start >= 2 && start[0] == 'W' && start[1] == '/') start += 2;
+    const size_t len = static_cast<size_t>(end - start);
+    if ((len == 1 && *start == '*') || (len == etag_len && memcmp(start, etag, len) == 0)) return true;
+  }
+  return false;
+}
@@ -0,0 +1,376 @@
+// FanForge Linux host agent.
+//
+// Samples hwmon / thermal_zone temperatures and /proc/stat CPU utilization on a
+// timerfd cadence and streams them to one or more controllers as authenticated
+// UDP ingest datagrams (fanforge_ingest.h). Sensor files stay open and are
+// re-read with pread(), so a sample costs a handful of syscalls.
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "fanforge_ingest.h"
+#include "ft_net.h"
+
+namespace {
+
+struct SysfsSensor {
+  std::string spec;  // "hwmon:<chip>/<label>" or "thermal:<type>"
+  std::string path;
+  int fd = -1;
+};
+
+struct Mapping {
+  uint8_t sensor_id;
+  uint8_t kind;
+  std::string spec;  // sensor spec, "max-temp" or "cpu-load"
+  int sensor_index = -1;
+};
+
+struct Target {
+  std::string name;
+  sockaddr_storage addr{};
+  socklen_t addr_len = 0;
+};
+
+std::string read_trimmed(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == nullptr) return "";
+  char buf[128] = {0};
+  if (fgets(buf, sizeof(buf), f) == nullptr) buf[0] = '\0';
+  fclose(f);
+  std::string s(buf);
+  while (!s.empty() && (s.back() == '\n' || s.back() == ' ')) s.pop_back();
+  return s;
+}
+
+std::vector<std::string> list_dir(const std::string &path, const char *prefix) {
+  std::vector<std::string> out;
+  DIR *d = opendir(path.c_str());
+  if (d == nullptr) return out;
+  while (dirent *e = readdir(d)) {
+    if (strncmp(e->d_name, prefix, strlen(prefix)) == 0) out.emplace_back(e->d_name);
+  }
+  closedir(d);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+std::vector<SysfsSensor> discover_sensors(const std::string &root) {
+  std::vector<SysfsSensor> sensors;
+  const std::string hwmon = root + "/sys/class/hwmon";
+  for (const std::string &dev : list_dir(hwmon, "hwmon")) {
+    const std::string base = hwmon + "/" + dev;
+    const std::string chip = read_trimmed(base + "/name");
+    for (const std::string &file : list_dir(base, "temp")) {
+      const size_t suffix = file.rfind("_input");
+      if (suffix == std::string::npos || suffix + 6 != file.size()) continue;
+      const std::string stem = file.substr(0, suffix);
+      std::string label = read_trimmed(base + "/" + stem + "_label");
+      if (label.empty()) label = stem;
+      SysfsSensor s;
+      s.spec = "hwmon:" + (chip.empty() ? dev : chip) + "/" + label;
+      s.path = base + "/" + file;
+      sensors.push_back(s);
+    }
+  }
+  const std::string thermal = root + "/sys/class/thermal";
+  for (const std::string &zone : list_dir(thermal, "thermal_zone")) {
+    SysfsSensor s;
+    s.spec = "thermal:" + read_trimmed(thermal + "/" + zone + "/type");
+    s.path = thermal + "/" + zone + "/temp";
+    sensors.push_back(s);
+  }
+  return sensors;
+}
+
+// Millidegree sysfs value via pread on a kept-open fd; NAN when unreadable.
+float read_millideg(int fd) {
+  char buf[32];
+  ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+  if (n <= 0) return NAN;
+  buf[n] = '\0';
+  char *end = nullptr;
+  long v = strtol(buf, &end, 10);
+  if (end == buf) return NAN;
+  return static_cast<float>(v) / 1000.0f;
+}
+
+class CpuLoad {
+ public:
+  bool open_stat(const std::string &root) {
+    this->fd_ = open((root + "/proc/stat").c_str(), O_RDONLY | O_CLOEXEC);
+    return this->fd_ >= 0;
+  }
+
+  // Busy percentage since the previous call (NAN on the first call).
+  float sample() {
+    char buf[512];
+    ssize_t n = pread(this->fd_, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return NAN;
+    buf[n] = '\0';
+    unsigned long long v[8] = {0};
+    if (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+               &v[7]) < 4)
+      return NAN;
+    const unsigned long long idle = v[3] + v[4];
+    unsigned long long total = 0;
+    for (unsigned long long x : v) total += x;
+    float pct = NAN;
+    if (this->have_prev_ && total > this->prev_total_) {
+      const double dt = static_cast<double>(total - this->prev_total_);
+      const double di = static_cast<double>(idle - this->prev_idle_);
+      pct = static_cast<float>(100.0 * (1.0 - di / dt));
+    }
+    this->prev_total_ = total;
+    this->prev_idle_ = idle;
+    this->have_prev_ = true;
+    return pct;
+  }
+
+ private:
+  int fd_ = -1;
+  bool have_prev_ = false;
+  unsigned long long prev_total_ = 0;
+  unsigned long long prev_idle_ = 0;
+};
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-agent --target host[:port] [--target ...] --key <32 hex> [options]\n"
+          "  --rate-hz N          send rate (default 10)\n"
+          "  --sender-id N        sender id carried in each datagram (default 1)\n"
+          "  --sensor ID=SPEC     map a virtual sensor id to SPEC (repeatable)\n"
+          "                       SPEC: hwmon:<chip>/<label> | thermal:<type> | max-temp | cpu-load\n"
+          "                       default: 1=max-temp 2=cpu-load\n"
+          "  --sysfs-root DIR     prefix for /sys and /proc (testing)\n"
+          "  --list               print discovered sensors and exit\n"
+          "  --verbose            print every sample\n"
+          "The key may also come from FANFORGE_UDP_KEY.\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> target_specs;
+  std::vector<Mapping> mappings;
+  const char *key_hex = getenv("FANFORGE_UDP_KEY");
+  std::string root;
+  double rate_hz = 10.0;
+  uint16_t sender_id = 1;
+  bool list_only = false;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        usage();
+        exit(2);
+      }
+      return argv[++i];
+    };
+    if (a == "--target") {
+      target_specs.emplace_back(next());
+    } else if (a == "--key") {
+      key_hex = next();
+    } else if (a == "--rate-hz") {
+      rate_hz = atof(next());
+    } else if (a == "--sender-id") {
+      sender_id = static_cast<uint16_t>(atoi(next()));
+    } else if (a == "--sensor") {
+      std::string m = next();
+      size_t eq = m.find('=');
+      int id = eq == std::string::npos ? 0 : atoi(m.substr(0, eq).c_str());
+      if (id < 1 || id > 255) {
+        usage();
+        return 2;
+      }
+      Mapping map;
+      map.sensor_id = static_cast<uint8_t>(id);
+      map.spec = m.substr(eq + 1);
+      map.kind = map.spec == "cpu-load" ? FT_SOURCE_LOAD_PCT : FT_SOURCE_TEMP_C;
+      mappings.push_back(map);
+    } else if (a == "--sysfs-root") {
+      root = next();
+    } else if (a == "--list") {
+      list_only = true;
+    } else if (a == "--verbose") {
+      verbose = true;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  std::vector<SysfsSensor> sensors = discover_sensors(root);
+  if (list_only) {
+    for (const SysfsSensor &s : sensors) {
+      int fd = open(s.path.c_str(), O_RDONLY | O_CLOEXEC);
+      float v = fd >= 0 ? read_millideg(fd) : NAN;
+      if (fd >= 0) close(fd);
+      printf("%-48s %7.2f C  (%s)\n", s.spec.c_str(), v, s.path.c_str());
+    }
+    return 0;
+  }
+
+  uint8_t key[16];
+  if (target_specs.empty() || !ft_parse_key_hex(key_hex, key) || rate_hz <= 0.0 || rate_hz > 1000.0) {
+    usage();
+    return 2;
+  }
+  if (mappings.empty()) {
+    mappings.push_back({1, FT_SOURCE_TEMP_C, "max-temp"});
+    mappings.push_back({2, FT_SOURCE_LOAD_PCT, "cpu-load"});
+  }
+  if (mappings.size() > static_cast<size_t>(FT_INGEST_MAX_RECORDS)) {
+    fprintf(stderr, "at most %d sensors per datagram\n", FT_INGEST_MAX_RECORDS);
+    return 2;
+  }
+
+  bool need_all_temps = false;
+  for (Mapping &m : mappings) {
+    if (m.spec == "max-temp") {
+      need_all_temps = true;
+      continue;
+    }
+    if (m.spec == "cpu-load") continue;
+    for (size_t s = 0; s < sensors.size(); s++) {
+      if (sensors[s].spec == m.spec) m.sensor_index = static_cast<int>(s);
+    }
+    if (m.sensor_index < 0) {
+      fprintf(stderr, "unknown sensor '%s' (see --list)\n", m.spec.c_str());
+      return 2;
+    }
+  }
+  for (size_t s = 0; s < sensors.size(); s++) {
+    bool used = need_all_temps;
+    for (const Mapping &m : mappings) used = used || m.sensor_index == static_cast<int>(s);
+    if (used) sensors[s].fd = open(sensors[s].path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+
+  CpuLoad cpu;
+  if (!cpu.open_stat(root)) fprintf(stderr, "warning: cannot open %s/proc/stat; cpu-load disabled\n", root.c_str());
+
+  std::vector<Target> targets;
+  for (const std::string &spec : target_specs) {
+    Target t;
+    std::string host;
+    int port = 0;
+    if (!ft_split_host_port(spec, host, port, FT_INGEST_DEFAULT_PORT) ||
+        !ft_resolve(host, port, SOCK_DGRAM, t.addr, t.addr_len)) {
+      fprintf(stderr, "cannot resolve target '%s'\n", spec.c_str());
+      return 1;
+    }
+    t.name = spec;
+    targets.push_back(t);
+  }
+  int udp = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+  // timerfd drives the cadence; signalfd turns SIGINT/SIGTERM into a clean exit.
+  int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  const long period_ns = static_cast<long>(1e9 / rate_hz);
+  itimerspec its{};
+  its.it_interval.tv_sec = period_ns / 1000000000L;
+  its.it_interval.tv_nsec = period_ns % 1000000000L;
+  its.it_value = its.it_interval;
+  timerfd_settime(tfd, 0, &its, nullptr);
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = tfd;
+  epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev);
+  ev.data.fd = sfd;
+  epoll_ctl(ep, EPOLL_CTL_ADD, sfd, &ev);
+
+  // (epoch, seq) is one 64-bit counter, started at the realtime clock in
+  // microseconds: a restart resumes above anything sent before, even within
+  // the same second, since the agent never sends faster than 1 MHz.
+  timespec rt{};
+  clock_gettime(CLOCK_REALTIME, &rt);
+  uint64_t counter = static_cast<uint64_t>(rt.tv_sec) * 1000000u + static_cast<uint64_t>(rt.tv_nsec) / 1000u;
+  const uint32_t epoch = static_cast<uint32_t>(counter >> 32);
+  uint64_t sent = 0, send_errors = 0, missed_ticks = 0;
+  cpu.sample();  // prime the utilization delta
+
+  fprintf(stderr, "ff-agent: %zu sensor(s) -> %zu target(s) at %.1f Hz (sender %u, epoch %u)\n", mappings.size(),
+          targets.size(), rate_hz, sender_id, epoch);
+
+  bool running = true;
+  while (running) {
+    epoll_event events[2];
+    int n = epoll_wait(ep, events, 2, -1);
+    if (n < 0 && errno == EINTR) continue;
+    for (int e = 0; e < n; e++) {
+      if (events[e].data.fd == sfd) {
+        running = false;
+        continue;
+      }
+      uint64_t expirations = 0;
+      if (read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+      if (expirations > 1) missed_ticks += expirations - 1;
+
+      float max_temp = NAN;
+      if (need_all_temps) {
+        for (const SysfsSensor &s : sensors) {
+          if (s.fd < 0) continue;
+          float v = read_millideg(s.fd);
+          if (std::isfinite(v) && !(v <= max_temp)) max_temp = v;
+        }
+      }
+      const float load = cpu.sample();
+
+      FtIngestRecord records[FT_INGEST_MAX_RECORDS];
+      int count = 0;
+      for (const Mapping &m : mappings) {
+        float v;
+        if (m.spec == "max-temp")
+          v = max_temp;
+        else if (m.spec == "cpu-load")
+          v = load;
+        else
+          v = read_millideg(sensors[m.sensor_index].fd);
+        if (!std::isfinite(v)) continue;
+        records[count++] = {m.sensor_id, m.kind, v};
+        if (verbose) printf("sensor %u kind %u = %.2f\n", m.sensor_id, m.kind, v);
+      }
+      if (count == 0) continue;
+
+      uint8_t pkt[FT_INGEST_MAX_DATAGRAM];
+      counter++;
+      const size_t len = ft_ingest_encode(key, sender_id, static_cast<uint32_t>(counter >> 32),
+                                          static_cast<uint32_t>(counter), records, count, pkt, sizeof(pkt));
+      for (const Target &t : targets) {
+        if (sendto(udp, pkt, len, 0, reinterpret_cast<const sockaddr *>(&t.addr), t.addr_len) ==
+            static_cast<ssize_t>(len))
+          sent++;
+        else
+          send_errors++;
+      }
+    }
+  }
+
+  fprintf(stderr, "ff-agent: sent=%llu errors=%llu missed_ticks=%llu\n", static_cast<unsigned long long>(sent),
+          static_cast<unsigned long long>(send_errors), static_cast<unsigned long long>(missed_ticks));
+  return 0;
+}
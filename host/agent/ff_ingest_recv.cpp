@@ -0,0 +1,127 @@
+// Stand-in for the controller's UDP ingest endpoint.
+//
+// Feeds received datagrams through the same FtIngestTable the firmware uses and
+// prints accepted readings plus rejection counters, so ff-agent (or any other
+// sender) can be checked without hardware.
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "fanforge_ingest.h"
+#include "ft_net.h"
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void on_signal(int) { g_stop = 1; }
+
+uint32_t now_ms() {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+const char *result_name(FtIngestResult r) {
+  switch (r) {
+    case FT_INGEST_OK:
+      return "ok";
+    case FT_INGEST_BAD_FORMAT:
+      return "bad_format";
+    case FT_INGEST_BAD_TAG:
+      return "bad_tag";
+    case FT_INGEST_REPLAYED:
+      return "replayed";
+    default:
+      return "no_slot";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int port = FT_INGEST_DEFAULT_PORT;
+  const char *key_hex = getenv("FANFORGE_UDP_KEY");
+  bool quiet = false;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--port" && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (a == "--key" && i + 1 < argc) {
+      key_hex = argv[++i];
+    } else if (a == "--quiet") {
+      quiet = true;
+    } else {
+      fprintf(stderr, "usage: ff-ingest-recv [--port 47808] --key <32 hex> [--quiet]\n");
+      return 2;
+    }
+  }
+  uint8_t key[16];
+  if (!ft_parse_key_hex(key_hex, key)) {
+    fprintf(stderr, "a 32 hex character --key (or FANFORGE_UDP_KEY) is required\n");
+    return 2;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    fprintf(stderr, "cannot bind UDP port %d\n", port);
+    return 1;
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  FtIngestTable table;
+  table.set_key(key);
+  uint8_t buf[FT_INGEST_MAX_DATAGRAM + 1];
+  uint32_t last_rx = 0;
+  double gap_sum = 0.0;
+  uint32_t gap_max = 0, gaps = 0;
+  fprintf(stderr, "ff-ingest-recv: listening on UDP %d\n", port);
+
+  while (!g_stop) {
+    pollfd p{fd, POLLIN, 0};
+    if (poll(&p, 1, 500) <= 0) continue;
+    sockaddr_in from{};
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr *>(&from), &from_len);
+    if (n <= 0) continue;
+    const uint32_t now = now_ms();
+    const FtIngestResult r = table.handle_datagram(buf, static_cast<size_t>(n), now);
+    if (r == FT_INGEST_OK && last_rx != 0) {
+      const uint32_t gap = now - last_rx;
+      gap_sum += gap;
+      gaps++;
+      if (gap > gap_max) gap_max = gap;
+    }
+    if (r == FT_INGEST_OK) last_rx = now;
+    if (quiet) continue;
+
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+    printf("%s:%u %zd bytes seq=%u -> %s", ip, ntohs(from.sin_port), n,
+           n >= 16 ? ft_get_le32(buf + 12) : 0, result_name(r));
+    if (r == FT_INGEST_OK) {
+      for (int i = 0; i < FT_VSRC_MAX; i++) {
+        const FtVirtualSource &s = table.sources()[i];
+        if (s.used && s.last_rx_ms == now) printf("  [%u/%u]=%.2f", s.sensor_id, s.kind, s.value);
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  const FtIngestStats &st = table.stats();
+  fprintf(stderr, "accepted=%u bad_format=%u bad_tag=%u replayed=%u no_slot=%u mean_gap_ms=%.1f max_gap_ms=%u\n",
+          st.accepted, st.bad_format, st.bad_tag, st.replayed, st.no_slot, gaps ? gap_sum / gaps : 0.0, gap_max);
+  return 0;
+}
@@ -0,0 +1,532 @@
+#!/usr/bin/env python3
+"""Generate the firmware's API types, parsers and writers from the OpenAPI schema.
+
+Every schema in components.schemas tagged `x-ft-codegen: [parse, write]`
+becomes a plain struct with a presence bitmask, constexpr range tables, a
+single-pass parser that dispatches on the key and enforces the schema's
+required / minimum / maximum / enum / minItems / maxItems / maxLength as it
+reads, and a
+writer that serializes straight from the struct. Named string enums become
+C++ enums with name tables. Parsers and writers are templates over the
+reader/writer pair, so the same code speaks JSON (fanforge_json.h) and CBOR
+(fanforge_cbor.h). The output is committed
+(firmware/esphome/fanforge_api_gen.h) so the ESPHome build needs no Python.
+
+usage: gen_api.py <esp32-api.yaml> <out.h> [--check]
+
+With --check nothing is written; the exit status is 1 when <out.h> is stale.
+"""
+
+import re
+import sys
+
+import yaml
+
+PREFIX = "ft_api_"
+TYPE_PREFIX = "FtApi"
+CONST_PREFIX = "FT_API_"
+
+
+class _Loader(yaml.SafeLoader):
+    pass
+
+
+# YAML 1.2 booleans: the Mode enum's unquoted `off` must stay a string.
+_Loader.yaml_implicit_resolvers = {
+    k: [(tag, rx) for tag, rx in v if tag != "tag:yaml.org,2002:bool"]
+    for k, v in yaml.SafeLoader.yaml_implicit_resolvers.items()
+}
+_Loader.add_implicit_resolver("tag:yaml.org,2002:bool", re.compile(r"^(?:true|false)$"), list("tf"))
+
+
+def snake(name):
+    return re.sub(r"(?<!^)(?=[A-Z])", "_", name).lower()
+
+
+def camel(name):
+    return "".join(part[:1].upper() + part[1:] for part in re.split(r"[_\W]+", name) if part)
+
+
+def cfloat(v):
+    return repr(float(v)) + "f"
+
+
+def human(v):
+    return ("%g" % v) if isinstance(v, float) else str(v)
+
+
+def wrapped(head, items, sep, tail, indent="    ", width=120):
+    """head + items joined by sep + tail, broken greedily at width."""
+    lines = []
+    line = head
+    for i, item in enumerate(items):
+        piece = item + (sep.rstrip() if i + 1 < len(items) else tail)
+        if len(line) + len(piece) + (1 if line != head else 0) > width and line.strip():
+            lines.append(line.rstrip())
+            line = indent
+        elif line != head and line != indent:
+            line += " "
+        line += piece
+    lines.append(line)
+    return lines
+
+
+def c_string(s):
+    return '"%s"' % s.replace("\\", "\\\\").replace('"', '\\"')
+
+
+class Enum:
+    def __init__(self, type_name, const_name, func, values):
+        self.type_name = type_name
+        self.const_name = const_name
+        self.func = func
+        self.values = values
+
+    def message(self):
+        return "must be one of " + ", ".join(self.values)
+
+
+class Field:
+    def __init__(self, name, kind, spec, enum=None, item=None):
+        self.name = name
+        self.kind = kind  # number, integer, boolean, enum, string, array
+        self.spec = spec
+        self.enum = enum
+        self.item = item  # Struct for arrays
+        self.nullable = bool(spec.get("nullable"))
+        self.minimum = spec.get("minimum")
+        self.maximum = spec.get("maximum")
+        self.min_items = spec.get("minItems", 0)
+        self.max_items = spec.get("maxItems")
+        self.max_length = spec.get("maxLength")
+        self.int64 = spec.get("format") == "int64"
+
+    def ctype(self):
+        if self.kind == "number":
+            return "float"
+        if self.kind == "integer":
+            return "int64_t" if self.int64 else "int32_t"
+        if self.kind == "boolean":
+            return "bool"
+        if self.kind == "enum":
+            return self.enum.type_name
+        raise AssertionError(self.kind)
+
+    def has_range(self):
+        return self.minimum is not None or self.maximum is not None
+
+    def message(self):
+        if self.kind == "enum":
+            return self.enum.message()
+        if self.kind == "boolean":
+            return "must be a boolean"
+        if self.kind == "string":
+            return "must be a string of at most %d bytes" % self.max_length
+        if self.kind == "array":
+            hi = self.max_items
+            return "must be an array of %s..%s items" % (self.min_items, hi)
+        what = "a number" if self.kind == "number" else "an integer"
+        if self.nullable:
+            what += " or null"
+        if self.minimum is not None and self.maximum is not None:
+            return "must be %s within %s..%s" % (what, human(self.minimum), human(self.maximum))
+        if self.minimum is not None:
+            return "must be %s >= %s" % (what, human(self.minimum))
+        if self.maximum is not None:
+            return "must be %s <= %s" % (what, human(self.maximum))
+        return "must be " + what
+
+
+class Struct:
+    def __init__(self, name, spec):
+        self.name = name
+        self.type_name = TYPE_PREFIX + name
+        self.const = CONST_PREFIX + snake(name).upper()
+        self.func = snake(name)
+        self.modes = spec["x-ft-codegen"]
+        self.required = spec.get("required") or []
+        self.fields = []
+
+
+class Generator:
+    def __init__(self, schemas):
+        self.schemas = schemas
+        self.enums = {}
+        self.inline_enums = []
+        self.structs = {}
+        self.order = []
+
+    def enum_for(self, owner, fname, spec):
+        if "$ref" in spec:
+            ref = spec["$ref"].split("/")[-1]
+            if ref not in self.enums:
+                raise SystemExit("%s.%s: $ref %s is not a string enum" % (owner.name, fname, ref))
+            return self.enums[ref]
+        name = owner.name + camel(fname)
+        e = Enum(TYPE_PREFIX + name, CONST_PREFIX + snake(name).upper(), PREFIX + snake(name), spec["enum"])
+        self.inline_enums.append(e)
+        return e
+
+    def field(self, owner, fname, spec):
+        if "$ref" in spec:
+            return Field(fname, "enum", spec, enum=self.enum_for(owner, fname, spec))
+        t = spec.get("type")
+        if t == "string" and "enum" in spec:
+            return Field(fname, "enum", spec, enum=self.enum_for(owner, fname, spec))
+        if t == "string":
+            if spec.get("maxLength") is None:
+                raise SystemExit("%s.%s: strings need maxLength (storage is fixed)" % (owner.name, fname))
+            return Field(fname, "string", spec)
+        if t in ("number", "integer", "boolean"):
+            f = Field(fname, t, spec)
+            if f.nullable and t != "number":
+                raise SystemExit("%s.%s: only numbers may be nullable" % (owner.name, fname))
+            return f
+        if t == "array":
+            ref = (spec.get("items") or {}).get("$ref", "").split("/")[-1]
+            if ref not in self.structs:
+                raise SystemExit("%s.%s: array items must $ref an earlier x-ft-codegen schema" % (owner.name, fname))
+            if spec.get("maxItems") is None:
+                raise SystemExit("%s.%s: arrays need maxItems (storage is fixed)" % (owner.name, fname))
+            return Field(fname, "array", spec, item=self.structs[ref])
+        raise SystemExit("%s.%s: unsupported schema %r" % (owner.name, fname, spec))
+
+    def load(self):
+        for name, spec in self.schemas.items():
+            if spec.get("type") == "string" and "enum" in spec:
+                self.enums[name] = Enum(TYPE_PREFIX + name, CONST_PREFIX + snake(name).upper(),
+                                        PREFIX + snake(name), spec["enum"])
+            elif "x-ft-codegen" in spec:
+                s = Struct(name, spec)
+                for fname, fspec in spec.get("properties", {}).items():
+                    s.fields.append(self.field(s, fname, fspec))
+                if len(s.fields) > 32:
+                    raise SystemExit("%s: more than 32 properties" % name)
+                self.structs[name] = s
+                self.order.append(s)
+
+    # --- emitters ---------------------------------------------------------
+
+    def emit_enum(self, e, out):
+        out.append("enum %s : uint8_t {" % e.type_name)
+        for i, v in enumerate(e.values):
+            out.append("  %s_%s = %d," % (e.const_name, snake(camel(v)).upper(), i))
+        out.append("};")
+        out.append("static constexpr uint8_t %s_COUNT = %d;" % (e.const_name, len(e.values)))
+        out.extend(wrapped("static constexpr const char *%s_NAMES[] = {" % e.const_name,
+                           [c_string(v) for v in e.values], ", ", "};"))
+        out.append("")
+        out.append("static inline const char *%s_name(%s v) {" % (e.func, e.type_name))
+        out.append("  return %s_NAMES[v < %s_COUNT ? v : 0];" % (e.const_name, e.const_name))
+        out.append("}")
+        out.append("static inline int %s_parse(const char *s, size_t n) {" % e.func)
+        out.append("  return ft_api_enum_parse_(%s_NAMES, %s_COUNT, s, n);" % (e.const_name, e.const_name))
+        out.append("}")
+        out.append("")
+
+    def emit_struct(self, s, out):
+        k = s.const + "_K_"
+        out.append("// --- %s %s" % (s.name, "-" * (72 - len(s.name))))
+        out.append("")
+        out.append("enum %sKey : uint8_t {" % s.type_name)
+        for i, f in enumerate(s.fields):
+            out.append("  %s%s = %d," % (k, f.name.upper(), i))
+        out.append("  %sUNKNOWN = %d," % (k, len(s.fields)))
+        out.append("};")
+        for i, f in enumerate(s.fields):
+            out.append("static constexpr uint32_t %s_HAS_%s = 1u << %d;" % (s.const, f.name.upper(), i))
+        req = ["%s_HAS_%s" % (s.const, r.upper()) for r in s.required] or ["0"]
+        out.extend(wrapped("static constexpr uint32_t %s_REQUIRED = " % s.const, req, " | ", ";"))
+        out.append("static constexpr uint32_t %s_ALL = 0x%xu;" % (s.const, (1 << len(s.fields)) - 1))
+        out.extend(wrapped("static constexpr const char *%s_FIELDS[] = {" % s.const,
+                           [c_string(f.name) for f in s.fields], ", ", "};"))
+        out.append("")
+        for f in s.fields:
+            if f.kind in ("number", "integer") and f.has_range():
+                lo = f.minimum if f.minimum is not None else -3.4e38
+                hi = f.maximum if f.maximum is not None else 3.4e38
+                out.append("static constexpr FtApiRange %s_%s_RANGE = {%s, %s};" %
+                           (s.const, f.name.upper(), cfloat(lo), cfloat(hi)))
+            elif f.kind == "string":
+                out.append("static constexpr size_t %s_%s_MAX_LENGTH = %d;" % (s.const, f.name.upper(), f.max_length))
+            elif f.kind == "array":
+                out.append("static constexpr uint8_t %s_%s_MIN_ITEMS = %d;" % (s.const, f.name.upper(), f.min_items))
+                out.append("static constexpr uint8_t %s_%s_MAX_ITEMS = %d;" % (s.const, f.name.upper(), f.max_items))
+        out.append("")
+        out.append("struct %s {" % s.type_name)
+        out.append("  uint32_t present = 0;  // %s_HAS_* bits" % s.const)
+        for f in s.fields:
+            if f.kind == "array":
+                out.append("  %s %s[%s_%s_MAX_ITEMS];" % (f.item.type_name, f.name, s.const, f.name.upper()))
+                out.append("  uint8_t %s_count = 0;" % f.name)
+            elif f.kind == "number":
+                out.append("  float %s = 0.0f;%s" % (f.name, "  // NAN for null" if f.nullable else ""))
+            elif f.kind == "enum":
+                out.append("  %s %s = static_cast<%s>(0);" % (f.ctype(), f.name, f.ctype()))
+            elif f.kind == "boolean":
+                out.append("  bool %s = false;" % f.name)
+            elif f.kind == "string":
+                out.append("  char %s[%s_%s_MAX_LENGTH + 1] = {};  // NUL terminated" % (f.name, s.const, f.name.upper()))
+            else:
+                out.append("  %s %s = 0;" % (f.ctype(), f.name))
+        out.append("};")
+        out.append("")
+        if "parse" in s.modes:
+            self.emit_key_dispatch(s, out)
+            self.emit_parser(s, out)
+        if "write" in s.modes:
+            self.emit_writer(s, out)
+
+    def emit_key_dispatch(self, s, out):
+        k = s.const + "_K_"
+        by_len = {}
+        for f in s.fields:
+            by_len.setdefault(len(f.name), []).append(f)
+        out.append("static inline %sKey %s%s_key(const char *k, size_t n) {" % (s.type_name, PREFIX, s.func))
+        out.append("  switch (n) {")
+        for n in sorted(by_len):
+            out.append("    case %d:" % n)
+            for f in by_len[n]:
+                out.append("      if (memcmp(k, %s, %d) == 0) return %s%s;" % (c_string(f.name), n, k, f.name.upper()))
+            out.append("      break;")
+        out.append("  }")
+        out.append("  return %sUNKNOWN;" % k)
+        out.append("}")
+        out.append("")
+
+    def emit_parser(self, s, out):
+        k = s.const + "_K_"
+        out.append("// Reads one %s object. Unknown keys are skipped; out.present records what was" % s.name)
+        out.append("// given. On failure err names the first offending field.")
+        out.append("template<typename R> static inline bool %sparse_%s(R &r, %s &out, FtApiError &err) {" %
+                   (PREFIX, s.func, s.type_name))
+        out.append("  out.present = 0;")
+        out.append('  if (!r.begin_object()) return ft_api_fail_(r, err, nullptr, "must be an object");')
+        out.append("  const char *key;")
+        out.append("  size_t key_len;")
+        out.append("  while (r.next_key(key, key_len)) {")
+        out.append("    switch (%s%s_key(key, key_len)) {" % (PREFIX, s.func))
+        for f in s.fields:
+            name = f.name
+            msg = c_string(f.message())
+            fail = "return ft_api_fail_(r, err, %s, %s);" % (c_string(name), msg)
+            out.append("      case %s%s: {" % (k, name.upper()))
+            if f.kind == "number":
+                rng = "%s_%s_RANGE" % (s.const, name.upper())
+                check = "!r.read_number(out.%s)" % name
+                if f.has_range():
+                    check += " || !%s.contains(out.%s)" % (rng, name)
+                if f.nullable:
+                    out.append("        if (r.read_null()) {")
+                    out.append("          out.%s = NAN;" % name)
+                    out.append("        } else if (%s) {" % check)
+                    out.append("          " + fail)
+                    out.append("        }")
+                else:
+                    out.append("        if (%s)" % check)
+                    out.append("          " + fail)
+            elif f.kind == "integer":
+                out.append("        int64_t v;")
+                if f.has_range():
+                    cond = "!r.read_int(v) || !%s_%s_RANGE.contains(static_cast<float>(v))" % (s.const, name.upper())
+                elif f.int64:
+                    cond = "!r.read_int(v)"
+                else:
+                    cond = "!r.read_int(v) || v < INT32_MIN || v > INT32_MAX"
+                out.append("        if (%s)" % cond)
+                out.append("          " + fail)
+                out.append("        out.%s = static_cast<%s>(v);" % (name, f.ctype()))
+            elif f.kind == "boolean":
+                out.append("        if (!r.read_bool(out.%s)) %s" % (name, fail))
+            elif f.kind == "string":
+                out.append("        if (!r.read_text(out.%s, sizeof(out.%s)))" % (name, name))
+                out.append("          " + fail)
+            elif f.kind == "enum":
+                out.append("        const char *s;")
+                out.append("        size_t len;")
+                out.append("        const int v = r.read_string(s, len) ? %s_parse(s, len) : -1;" % f.enum.func)
+                out.append("        if (v < 0) %s" % fail)
+                out.append("        out.%s = static_cast<%s>(v);" % (name, f.enum.type_name))
+            elif f.kind == "array":
+                item = f.item
+                out.append("        if (!r.begin_array()) %s" % fail)
+                out.append("        out.%s_count = 0;" % name)
+                out.append("        while (r.next_item()) {")
+                out.append("          if (out.%s_count >= %s_%s_MAX_ITEMS)" % (name, s.const, name.upper()))
+                out.append("            " + fail)
+                out.append("          if (!%sparse_%s(r, out.%s[out.%s_count], err))" % (PREFIX, item.func, name, name))
+                out.append("            return ft_api_nest_(err, %s, out.%s_count);" % (c_string(name), name))
+                out.append("          out.%s_count++;" % name)
+                out.append("        }")
+                out.append("        if (!r.ok() || out.%s_count < %s_%s_MIN_ITEMS)" % (name, s.const, name.upper()))
+                out.append("          " + fail)
+            out.append("        out.present |= %s_HAS_%s;" % (s.const, name.upper()))
+            out.append("        break;")
+            out.append("      }")
+        out.append("      default:")
+        out.append("        if (!r.skip_value()) return ft_api_fail_(r, err, nullptr, \"is malformed\");")
+        out.append("        break;")
+        out.append("    }")
+        out.append("  }")
+        out.append("  if (!r.ok()) return ft_api_fail_(r, err, nullptr, nullptr);")
+        out.append("  return ft_api_require_(err, out.present, %s_REQUIRED, %s_FIELDS);" % (s.const, s.const))
+        out.append("}")
+        out.append("")
+
+    def emit_writer(self, s, out):
+        out.append("// Writes the fields in v.present, in schema order.")
+        out.append("template<typename W> static inline void %swrite_%s(W &w, const %s &v) {" % (PREFIX, s.func, s.type_name))
+        out.append("  w.begin_object();")
+        for f in s.fields:
+            name = f.name
+            out.append("  if (v.present & %s_HAS_%s) {" % (s.const, name.upper()))
+            out.append("    w.key(%s);" % c_string(name))
+            if f.kind == "array":
+                out.append("    w.begin_array();")
+                out.append("    for (uint8_t i = 0; i < v.%s_count; i++) %swrite_%s(w, v.%s[i]);" %
+                           (name, PREFIX, f.item.func, name))
+                out.append("    w.end_array();")
+            elif f.kind == "enum":
+                out.append("    w.value(%s_name(v.%s));" % (f.enum.func, name))
+            elif f.kind == "integer":
+                out.append("    w.value(static_cast<int64_t>(v.%s));" % name)
+            else:
+                out.append("    w.value(v.%s);" % name)
+            out.append("  }")
+        out.append("  w.end_object();")
+        out.append("}")
+        out.append("")
+
+    def render(self, source):
+        out = [
+            "#pragma once",
+            "",
+            "// Generated by host/codegen/gen_api.py from %s; do not edit." % source,
+            "//",
+            "// API structs with presence bits, schema range tables, single-pass parsers",
+            "// and direct writers. Parsers and writers are templates over the reader and",
+            "// writer classes of fanforge_json.h (JSON) and fanforge_cbor.h (CBOR).",
+            "// No ESPHome dependencies.",
+            "",
+            "#include <cmath>",
+            "#include <cstdint>",
+            "#include <cstdio>",
+            "#include <cstring>",
+            "",
+            RUNTIME,
+        ]
+        for e in self.enums.values():
+            self.emit_enum(e, out)
+        # Inline enums are collected while loading the structs that own them.
+        for e in self.inline_enums:
+            self.emit_enum(e, out)
+        for s in self.order:
+            self.emit_struct(s, out)
+        while out[-1] == "":
+            out.pop()
+        return "\n".join(out) + "\n"
+
+
+RUNTIME = r"""struct FtApiRange {
+  float min;
+  float max;
+  constexpr bool contains(float v) const { return v >= this->min && v <= this->max; }
+};
+
+// Where a parse failed. Syntax errors carry the byte offset; schema errors the
+// field (and, inside arrays, the parent field and item index).
+struct FtApiError {
+  const char *message = nullptr;
+  const char *field = nullptr;
+  const char *parent = nullptr;
+  int index = -1;
+  int offset = -1;
+};
+
+// Index of the name s[0..n) in names, or -1.
+static inline int ft_api_enum_parse_(const char *const *names, uint8_t count, const char *s, size_t n) {
+  for (int i = 0; i < count; i++) {
+    if (strlen(names[i]) == n && memcmp(names[i], s, n) == 0) return i;
+  }
+  return -1;
+}
+
+template<typename R>
+static inline bool ft_api_fail_(const R &r, FtApiError &err, const char *field, const char *message) {
+  err = FtApiError{};
+  if (!r.ok()) {
+    // A syntax error wins over the type check that tripped on it.
+    err.message = r.error();
+    err.offset = static_cast<int>(r.offset());
+  } else {
+    err.field = field;
+    err.message = message;
+  }
+  return false;
+}
+
+static inline bool ft_api_nest_(FtApiError &err, const char *parent, int index) {
+  if (err.offset < 0) {
+    err.parent = parent;
+    err.index = index;
+  }
+  return false;
+}
+
+static inline bool ft_api_require_(FtApiError &err, uint32_t present, uint32_t required, const char *const *fields) {
+  const uint32_t missing = required & ~present;
+  if (missing == 0) return true;
+  int i = 0;
+  while (!(missing & (1u << i))) i++;
+  err = FtApiError{};
+  err.field = fields[i];
+  err.message = "is required";
+  return false;
+}
+
+// "points[2].p must be a number within 0..100", "mode is required", ...
+// syntax names the wire format in syntax errors ("JSON", "CBOR").
+static inline void ft_api_format_error(const FtApiError &e, char *buf, size_t cap, const char *syntax = "JSON") {
+  const char *msg = e.message != nullptr ? e.message : "is invalid";
+  if (e.offset >= 0)
+    snprintf(buf, cap, "invalid %s at offset %d: %s", syntax, e.offset, msg);
+  else if (e.parent != nullptr && e.field != nullptr)
+    snprintf(buf, cap, "%s[%d].%s %s", e.parent, e.index, e.field, msg);
+  else if (e.parent != nullptr)
+    snprintf(buf, cap, "%s[%d] %s", e.parent, e.index, msg);
+  else if (e.field != nullptr)
+    snprintf(buf, cap, "%s %s", e.field, msg);
+  else
+    snprintf(buf, cap, "body %s", msg);
+}
+"""
+
+
+def main(argv):
+    args = [a for a in argv[1:] if a != "--check"]
+    check = "--check" in argv[1:]
+    if len(args) != 2:
+        sys.stderr.write(__doc__)
+        return 2
+    with open(args[0], encoding="utf-8") as f:
+        spec = yaml.load(f, Loader=_Loader)
+    gen = Generator(spec["components"]["schemas"])
+    gen.load()
+    text = gen.render("openapi/" + args[0].split("/")[-1])
+    if check:
+        try:
+            with open(args[1], encoding="utf-8") as f:
+                current = f.read()
+        except FileNotFoundError:
+            current = None
+        if current != text:
+            sys.stderr.write("%s is stale; run host/codegen/gen_api.py %s %s\n" % (args[1], args[0], args[1]))
+            return 1
+        return 0
+    with open(args[1], "w", encoding="utf-8") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
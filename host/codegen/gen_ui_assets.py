@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Embed the Vite build of the UI into the firmware as pre-compressed flash data.
+
+Walks the build output (`npm run build:device` writes dist-device/ with
+base /ui/), gzips every file once at build time and emits
+firmware/esphome/fanforge_ui_assets.h: one const byte array per file plus an
+FtUiAsset table (fanforge_ui.h) with the request path, content type, a strong
+ETag and whether the file name is content-hashed. The device then serves the
+stored bytes as they are; it never compresses anything itself.
+
+Files that gzip does not shrink by at least 10% (PNG, ICO) are stored raw.
+The header is a build artifact and is not committed; fanforge_api.h picks it
+up when it exists.
+
+usage: gen_ui_assets.py <dist-dir> <out.h> [--budget BYTES] [--exclude GLOB]...
+
+--budget fails the run when the embedded data exceeds BYTES (default 256 KiB,
+what the 1.44 MB app slot has left after the firmware). --exclude skips
+matching paths relative to <dist-dir> (default: *.map).
+"""
+
+import fnmatch
+import gzip
+import hashlib
+import os
+import sys
+
+URL_PREFIX = "/ui/"
+DEFAULT_BUDGET = 256 * 1024
+DEFAULT_EXCLUDES = ["*.map"]
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".js": "text/javascript; charset=utf-8",
+    ".css": "text/css; charset=utf-8",
+    ".json": "application/json",
+    ".webmanifest": "application/manifest+json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".wasm": "application/wasm",
+    ".woff2": "font/woff2",
+    ".txt": "text/plain; charset=utf-8",
+}
+
+
+def c_string(s):
+    return '"%s"' % s.replace("\\", "\\\\").replace('"', '\\"')
+
+
+def byte_rows(data, per_row=20):
+    rows = []
+    for i in range(0, len(data), per_row):
+        rows.append("    " + ", ".join("0x%02x" % b for b in data[i : i + per_row]) + ",")
+    return rows
+
+
+def collect(dist, excludes):
+    files = []
+    for root, dirs, names in os.walk(dist):
+        dirs.sort()
+        for name in sorted(names):
+            full = os.path.join(root, name)
+            rel = os.path.relpath(full, dist).replace(os.sep, "/")
+            if any(fnmatch.fnmatch(rel, pat) for pat in excludes):
+                continue
+            files.append((rel, full))
+    return files
+
+
+def render(dist, files):
+    out = [
+        "#pragma once",
+        "",
+        "// Generated by host/codegen/gen_ui_assets.py from %s; do not edit." % os.path.basename(dist.rstrip("/")),
+        "",
+        '#include "fanforge_ui.h"',
+        "",
+    ]
+    table = []
+    total = 0
+    for i, (rel, full) in enumerate(files):
+        with open(full, "rb") as f:
+            raw = f.read()
+        ext = os.path.splitext(rel)[1].lower()
+        ctype = CONTENT_TYPES.get(ext, "application/octet-stream")
+        # mtime=0 keeps the output byte-identical across rebuilds of the same UI.
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        use_gzip = len(packed) <= len(raw) * 0.9
+        data = packed if use_gzip else raw
+        etag = '"%s"' % hashlib.sha256(raw).hexdigest()[:16]
+        # Vite content-hashes everything it emits under assets/.
+        immutable = rel.startswith("assets/")
+        out.append("// %s: %d bytes%s" % (rel, len(raw), ", gzip %d" % len(packed) if use_gzip else ""))
+        out.append("static const uint8_t FT_UI_DATA_%d[] = {" % i)
+        out.extend(byte_rows(data))
+        out.append("};")
+        table.append(
+            "    {%s, %s, FT_UI_DATA_%d, %d, %s, %s, %s},"
+            % (
+                c_string(URL_PREFIX + rel),
+                c_string(ctype),
+                i,
+                len(data),
+                c_string(etag),
+                "true" if use_gzip else "false",
+                "true" if immutable else "false",
+            )
+        )
+        total += len(data)
+        sys.stderr.write("  %-48s %8d -> %8d%s\n" % (rel, len(raw), len(data), "" if use_gzip else " (raw)"))
+    out.append("")
+    out.append("static const FtUiAsset FT_UI_ASSETS[] = {")
+    out.extend(table)
+    out.append("};")
+    out.append("static constexpr size_t FT_UI_ASSET_COUNT = %d;" % len(files))
+    out.append("static constexpr uint32_t FT_UI_TOTAL_BYTES = %d;" % total)
+    out.append("")
+    return "\n".join(out), total
+
+
+def main(argv):
+    args = []
+    budget = DEFAULT_BUDGET
+    excludes = []
+    i = 1
+    while i < len(argv):
+        a = argv[i]
+        if a in ("--budget", "--exclude") and i + 1 < len(argv):
+            if a == "--budget":
+                budget = int(argv[i + 1])
+            else:
+                excludes.append(argv[i + 1])
+            i += 2
+            continue
+        args.append(a)
+        i += 1
+    if len(args) != 2:
+        sys.stderr.write(__doc__)
+        return 2
+    dist, out_path = args
+    files = collect(dist, excludes or DEFAULT_EXCLUDES)
+    if not any(rel == "index.html" for rel, _ in files):
+        sys.stderr.write("%s has no index.html; run `npm run build:device` first\n" % dist)
+        return 1
+    text, total = render(dist, files)
+    sys.stderr.write("%d files, %d bytes embedded (budget %d)\n" % (len(files), total, budget))
+    if total > budget:
+        sys.stderr.write("UI exceeds the flash budget; drop assets with --exclude or raise --budget\n")
+        return 1
+    with open(out_path, "w", encoding="utf-8") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,119 @@
+#pragma once
+
+// Small POSIX socket helpers shared by the host tools.
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Splits "host:port" (port optional) into its parts.
+static inline bool ft_split_host_port(const std::string &spec, std::string &host, int &port, int default_port) {
+  port = default_port;
+  host = spec;
+  size_t colon = spec.rfind(':');
+  if (colon != std::string::npos) {
+    host = spec.substr(0, colon);
+    port = atoi(spec.c_str() + colon + 1);
+  }
+  return !host.empty() && port > 0 && port < 65536;
+}
+
+static inline bool ft_resolve(const std::string &host, int port, int socktype, sockaddr_storage &out, socklen_t &out_len) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = socktype;
+  addrinfo *res = nullptr;
+  char port_str[8];
+  snprintf(port_str, sizeof(port_str), "%d", port);
+  if (getaddrinfo(host.c_str(), port_str, &hints, &res) != 0 || res == nullptr) return false;
+  memcpy(&out, res->ai_addr, res->ai_addrlen);
+  out_len = res->ai_addrlen;
+  freeaddrinfo(res);
+  return true;
+}
+
+// Blocking TCP connect with TCP_NODELAY; returns fd or -1.
+static inline int ft_tcp_connect(const std::string &host, int port) {
+  sockaddr_storage addr{};
+  socklen_t len = 0;
+  if (!ft_resolve(host, port, SOCK_STREAM, addr, len)) return -1;
+  int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0) {
+    close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+static inline bool ft_set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static inline bool ft_write_all(int fd, const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  while (len > 0) {
+    ssize_t w = send(fd, p, len, MSG_NOSIGNAL);
+    if (w <= 0) return false;
+    p += w;
+    len -= static_cast<size_t>(w);
+  }
+  return true;
+}
+
+// Blocking HTTP/1.1 GET with Connection: close. Decodes chunked bodies (ESP-IDF
+// httpd streams /metrics that way). Returns false on transport or framing errors.
+static inline bool ft_http_get(const std::string &host, int port, const std::string &path, std::string &body,
+                               int &status, int timeout_s = 5) {
+  int fd = ft_tcp_connect(host, port);
+  if (fd < 0) return false;
+  timeval tv{timeout_s, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  const std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+  if (!ft_write_all(fd, req.data(), req.size())) {
+    close(fd);
+    return false;
+  }
+  std::string in;
+  char buf[4096];
+  ssize_t r;
+  while ((r = recv(fd, buf, sizeof(buf), 0)) > 0) in.append(buf, static_cast<size_t>(r));
+  close(fd);
+  if (r < 0) return false;
+
+  const size_t hdr_end = in.find("\r\n\r\n");
+  if (hdr_end == std::string::npos || in.compare(0, 5, "HTTP/") != 0) return false;
+  const size_t sp = in.find(' ');
+  status = sp < hdr_end ? atoi(in.c_str() + sp + 1) : 0;
+  std::string head = in.substr(0, hdr_end);
+  for (char &c : head) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  const bool chunked = head.find("transfer-encoding: chunked") != std::string::npos;
+  body.clear();
+  if (!chunked) {
+    body = in.substr(hdr_end + 4);
+    return true;
+  }
+  size_t pos = hdr_end + 4;
+  for (;;) {
+    const size_t eol = in.find("\r\n", pos);
+    if (eol == std::string::npos) return false;
+    const size_t len = strtoul(in.c_str() + pos, nullptr, 16);
+    if (len == 0) return true;
+    if (eol + 2 + len > in.size()) return false;
+    body.append(in, eol + 2, len);
+    pos = eol + 2 + len + 2;
+  }
+}
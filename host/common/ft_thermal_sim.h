@@ -0,0 +1,121 @@
+#pragma once
+
+// Lumped thermal model of a fan-cooled enclosure for the host tools.
+//
+// One heat capacity is heated by heat_w and cooled through an idle conductance
+// plus a fan conductance that scales with PWM above the stall point. The
+// DS18B20 is modelled as a first-order lag on that temperature, quantized to
+// its 9-bit resolution (0.5 C) with a little read noise.
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+
+struct FtThermalParams {
+  float ambient_c = 25.0f;
+  float heat_w = 30.0f;
+  float heat_capacity_j_per_c = 400.0f;
+  float idle_w_per_c = 0.8f;   // natural convection with the fan stopped
+  float fan_w_per_c = 4.0f;    // added conductance at 100% PWM
+  float stall_pwm_pct = 15.0f;  // fan does not spin below this
+  float sensor_tau_s = 8.0f;
+  float sensor_step_c = 0.5f;
+  float sensor_noise_c = 0.1f;
+};
+
+enum FtHeatProfile {
+  FT_HEAT_STEADY = 0,
+  FT_HEAT_BURSTY,
+  FT_HEAT_SINE,
+};
+
+static inline bool ft_parse_heat_profile(const std::string &name, FtHeatProfile &out) {
+  if (name == "steady") out = FT_HEAT_STEADY;
+  else if (name == "bursty") out = FT_HEAT_BURSTY;
+  else if (name == "sine") out = FT_HEAT_SINE;
+  else return false;
+  return true;
+}
+
+class FtThermalSim {
+ public:
+  explicit FtThermalSim(const FtThermalParams &params = FtThermalParams(), uint32_t seed = 1)
+      : params_(params), rng_(seed), noise_(0.0f, params.sensor_noise_c > 0 ? params.sensor_noise_c : 1e-6f) {
+    this->temp_c_ = params.ambient_c;
+    this->sensor_c_ = params.ambient_c;
+    this->heat_w_ = params.heat_w;
+  }
+
+  // Heat source over time; t_s is simulated seconds since start.
+  void set_profile(FtHeatProfile profile) { this->profile_ = profile; }
+  // Pins the heat input (W) regardless of profile; NAN returns to the profile.
+  void set_heat_override(float heat_w) { this->heat_override_w_ = heat_w; }
+
+  void step(float dt_s, float pwm_pct) {
+    if (dt_s <= 0.0f) return;
+    this->t_s_ += dt_s;
+    this->pwm_pct_ = pwm_pct;
+    this->heat_w_ = std::isfinite(this->heat_override_w_) ? this->heat_override_w_ : this->profile_heat_();
+
+    const FtThermalParams &p = this->params_;
+    float fan = 0.0f;
+    if (pwm_pct > p.stall_pwm_pct) fan = (pwm_pct - p.stall_pwm_pct) / (100.0f - p.stall_pwm_pct);
+    const float g = p.idle_w_per_c + p.fan_w_per_c * fminf(fan, 1.0f);
+    // Exact solution of C dT/dt = Q - g (T - Ta) over dt, stable for any step size.
+    const float t_eq = p.ambient_c + this->heat_w_ / g;
+    this->temp_c_ = t_eq + (this->temp_c_ - t_eq) * expf(-g * dt_s / p.heat_capacity_j_per_c);
+
+    const float a = p.sensor_tau_s > 0.0f ? expf(-dt_s / p.sensor_tau_s) : 0.0f;
+    this->sensor_c_ = this->temp_c_ + (this->sensor_c_ - this->temp_c_) * a;
+  }
+
+  // What the DS18B20 would report right now.
+  float read_sensor() {
+    const FtThermalParams &p = this->params_;
+    float v = this->sensor_c_ + (p.sensor_noise_c > 0.0f ? this->noise_(this->rng_) : 0.0f);
+    if (p.sensor_step_c > 0.0f) v = roundf(v / p.sensor_step_c) * p.sensor_step_c;
+    return v;
+  }
+
+  float temp_c() const { return this->temp_c_; }
+  float heat_w() const { return this->heat_w_; }
+  float pwm_pct() const { return this->pwm_pct_; }
+  float time_s() const { return static_cast<float>(this->t_s_); }
+  const FtThermalParams &params() const { return this->params_; }
+
+ protected:
+  float profile_heat_() {
+    const float base = this->params_.heat_w;
+    switch (this->profile_) {
+      case FT_HEAT_BURSTY: {
+        // Random bursts of 2x load lasting 20-90 s, separated by 30-180 s.
+        if (this->t_s_ >= this->burst_next_s_) {
+          this->burst_on_ = !this->burst_on_;
+          std::uniform_real_distribution<float> span(this->burst_on_ ? 20.0f : 30.0f,
+                                                     this->burst_on_ ? 90.0f : 180.0f);
+          this->burst_next_s_ = this->t_s_ + span(this->rng_);
+        }
+        return this->burst_on_ ? base * 2.0f : base;
+      }
+      case FT_HEAT_SINE:
+        return base * (1.0f + 0.5f * static_cast<float>(sin(this->t_s_ * 2.0 * M_PI / 600.0)));
+      case FT_HEAT_STEADY:
+      default:
+        return base;
+    }
+  }
+
+  FtThermalParams params_;
+  std::minstd_rand rng_;  // small state: the fleet simulator holds thousands of these
+  std::normal_distribution<float> noise_;
+  FtHeatProfile profile_ = FT_HEAT_STEADY;
+  double t_s_ = 0.0;
+  float temp_c_;
+  float sensor_c_;
+  float heat_w_;
+  float heat_override_w_ = NAN;
+  float pwm_pct_ = 0.0f;
+  bool burst_on_ = false;
+  double burst_next_s_ = 0.0;
+};
@@ -0,0 +1,348 @@
+// FanForge fleet simulator.
+//
+// Runs thousands of independent controllers in one process, each an
+// FtController (fanforge_control.h, the same loop the firmware ticks) driving
+// its own FtThermalSim plant. Instances are sharded across a thread pool and
+// stepped in simulated time, so an hour of a 10,000-device fleet takes seconds.
+//
+// A config rollout can be staged mid-run: a fraction of the fleet switches to
+// new settings in waves, and the report compares the rolled-out cohort with the
+// rest (temperatures, fan duty, fan power, failsafe time, PWM reversals). The
+// run also reports the per-instance cost of one control tick.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fanforge_control.h"
+#include "ft_thermal_sim.h"
+
+namespace {
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Options {
+  int instances = 10000;
+  int threads = 0;
+  double sim_s = 3600.0;
+  double measure_from_s = 600.0;
+  uint32_t tick_ms = 200;
+  uint32_t sensor_ms = 1000;
+  float ambient_c = 25.0f;
+  float heat_w = 30.0f;
+  float spread = 0.2f;
+  FtHeatProfile profile = FT_HEAT_STEADY;
+  uint32_t seed = 1;
+
+  FtControlConfig base;
+  FtControlConfig next;
+  double rollout_at_s = -1.0;
+  double rollout_fraction = 1.0;
+  int rollout_waves = 1;
+  double rollout_wave_s = 60.0;
+};
+
+struct UnitStats {
+  double temp_sum = 0.0;
+  float temp_max = -INFINITY;
+  double pwm_sum = 0.0;
+  double fan_power_sum = 0.0;
+  uint32_t samples = 0;
+  uint32_t failsafe_ticks = 0;
+  uint32_t reversals = 0;
+};
+
+struct Unit {
+  FtController ctl;
+  FtThermalSim sim;
+  float sensor_c = NAN;
+  int64_t rollout_step = -1;  // step at which this unit takes the new config, -1 never
+  uint32_t reversals_from = 0;  // the controller's reversal count when measuring started
+  UnitStats stats;
+};
+
+struct ShardResult {
+  uint64_t ctl_ns = 0;
+  uint64_t total_ns = 0;
+  uint64_t ticks = 0;
+};
+
+// Runs one shard through the whole simulation. Instances never interact, so
+// shards need no synchronization.
+void run_shard(const Options &opt, std::vector<Unit> &units, ShardResult &out) {
+  const float dt_s = opt.tick_ms / 1000.0f;
+  const int64_t steps = static_cast<int64_t>(opt.sim_s * 1000.0 / opt.tick_ms);
+  const int64_t measure_from = static_cast<int64_t>(opt.measure_from_s * 1000.0 / opt.tick_ms);
+  const uint32_t sensor_every = std::max<uint32_t>(1, opt.sensor_ms / opt.tick_ms);
+  const uint64_t start = now_ns();
+
+  for (int64_t step = 0; step < steps; step++) {
+    // Plant: advance with the PWM from the previous tick, refresh the sensor at its cadence.
+    const bool sample = step % sensor_every == 0;
+    for (Unit &u : units) {
+      u.sim.step(dt_s, u.ctl.state.current_pwm_pct);
+      if (sample) u.sensor_c = u.sim.read_sensor();
+    }
+
+    // Controllers, timed as a batch so clock reads do not dominate the cost.
+    FtControlInput in;
+    in.now_ms = static_cast<uint32_t>(1000 + step * opt.tick_ms);
+    in.temp_external = false;
+    in.load_pct = NAN;
+    const uint64_t t0 = now_ns();
+    for (Unit &u : units) {
+      if (step == u.rollout_step) u.ctl.config = opt.next;
+      in.temp_c = u.sensor_c;
+      u.ctl.tick(in);
+    }
+    out.ctl_ns += now_ns() - t0;
+    out.ticks += units.size();
+
+    if (step < measure_from) continue;
+    for (Unit &u : units) {
+      const FtControlState &s = u.ctl.state;
+      UnitStats &st = u.stats;
+      const float temp = u.sim.temp_c();
+      const float pwm = s.current_pwm_pct;
+      st.temp_sum += temp;
+      st.temp_max = fmaxf(st.temp_max, temp);
+      st.pwm_sum += pwm;
+      st.fan_power_sum += pwm * pwm * pwm / 1e4f;  // fan power ~ speed^3, % of full
+      st.samples++;
+      if (s.failsafe_latched) st.failsafe_ticks++;
+      if (step == measure_from) u.reversals_from = s.reversals;
+      st.reversals = s.reversals - u.reversals_from;
+    }
+  }
+  out.total_ns = now_ns() - start;
+}
+
+double percentile(std::vector<double> &v, double p) {
+  if (v.empty()) return NAN;
+  std::sort(v.begin(), v.end());
+  size_t idx = static_cast<size_t>(std::ceil(p * v.size()));
+  if (idx > 0) idx--;
+  return v[std::min(idx, v.size() - 1)];
+}
+
+void print_cohort(const char *name, const std::vector<const Unit *> &units, double measured_s) {
+  if (units.empty()) return;
+  std::vector<double> mean_temps, max_temps;
+  double pwm = 0.0, power = 0.0, failsafe = 0.0, reversals = 0.0;
+  for (const Unit *u : units) {
+    const UnitStats &st = u->stats;
+    const double n = std::max<uint32_t>(1, st.samples);
+    mean_temps.push_back(st.temp_sum / n);
+    max_temps.push_back(st.temp_max);
+    pwm += st.pwm_sum / n;
+    power += st.fan_power_sum / n;
+    failsafe += st.failsafe_ticks / n;
+    reversals += st.reversals;
+  }
+  const double count = static_cast<double>(units.size());
+  double temp_mean = 0.0;
+  for (double t : mean_temps) temp_mean += t;
+  printf("%-10s %7zu %9.2f %9.2f %9.2f %8.1f %8.2f %9.3f %9.1f\n", name, units.size(), temp_mean / count,
+         percentile(mean_temps, 0.95), percentile(max_temps, 1.0), pwm / count, power / count,
+         100.0 * failsafe / count, reversals / count / (measured_s / 3600.0));
+}
+
+bool parse_curve(const std::string &spec, FtCurve &curve) {
+  FtPoint pts[FT_MAX_POINTS];
+  int n = 0;
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    size_t comma = spec.find(',', pos);
+    if (comma == std::string::npos) comma = spec.size();
+    const std::string item = spec.substr(pos, comma - pos);
+    pos = comma + 1;
+    const size_t colon = item.find(':');
+    if (colon == std::string::npos || n >= FT_MAX_POINTS) return false;
+    pts[n].t = static_cast<float>(atof(item.c_str()));
+    pts[n].p = static_cast<float>(atof(item.c_str() + colon + 1));
+    if (n > 0 && pts[n].t <= pts[n - 1].t) return false;
+    n++;
+  }
+  if (n < 2) return false;
+  curve.set(pts, n);
+  return true;
+}
+
+// Applies one --<prefix>-setting flag to cfg; false if the flag is not a config setting.
+bool parse_config_flag(const std::string &name, const char *value, FtControlConfig &cfg, bool &ok) {
+  ok = true;
+  if (name == "curve") ok = parse_curve(value, cfg.curve);
+  else if (name == "falling-curve" && std::string(value) == "none") cfg.falling_curve.n = 0;
+  else if (name == "falling-curve") ok = parse_curve(value, cfg.falling_curve);
+  else if (name == "smoothing") cfg.curve.smooth = cfg.falling_curve.smooth = std::string(value) != "linear";
+  else if (name == "min-pwm") cfg.min_pwm = static_cast<float>(atof(value));
+  else if (name == "max-pwm") cfg.max_pwm = static_cast<float>(atof(value));
+  else if (name == "slew") cfg.slew_pct_per_sec = static_cast<float>(atof(value));
+  else if (name == "failsafe-temp") cfg.failsafe_temp = static_cast<float>(atof(value));
+  else if (name == "failsafe-pwm") cfg.failsafe_pwm = static_cast<float>(atof(value));
+  else return false;
+  return ok;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-fleet [options]\n"
+          "  --instances N          controllers to simulate (default 10000)\n"
+          "  --threads N            worker threads, at most --instances (default: hardware concurrency, capped)\n"
+          "  --sim-s S              simulated seconds (default 3600)\n"
+          "  --measure-from-s S     start of the measured window (default 600, or the last rollout wave)\n"
+          "  --tick-ms MS           control tick period (default 200)\n"
+          "  --sensor-ms MS         DS18B20 update period (default 1000)\n"
+          "  --ambient C            ambient temperature (default 25)\n"
+          "  --heat-w W             mean heat load per enclosure (default 30)\n"
+          "  --spread F             per-instance variation of heat (+-F) and ambient (+-15*F C) (default 0.2)\n"
+          "  --profile steady|bursty|sine  heat profile (default steady)\n"
+          "  --seed N               RNG seed (default 1)\n"
+          "baseline settings (firmware defaults unless given):\n"
+          "  --curve T:P,...  --smoothing linear|smooth  --min-pwm P  --max-pwm P  --slew P\n"
+          "  --failsafe-temp C  --failsafe-pwm P\n"
+          "  --falling-curve T:P,...|none  curve PWM comes down along while the temperature falls\n"
+          "rollout:\n"
+          "  --rollout-at-s S       when the first wave lands (default: no rollout)\n"
+          "  --rollout-fraction F   share of the fleet that takes the new config (default 1)\n"
+          "  --rollout-waves N      waves the fraction is split into (default 1)\n"
+          "  --rollout-wave-s S     time between waves (default 60)\n"
+          "  --new-curve ... --new-failsafe-pwm P  settings deployed by the rollout (same names as above)\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  const FtPoint default_curve[] = {{20.0f, 20.0f}, {30.0f, 30.0f}, {40.0f, 55.0f}, {50.0f, 100.0f}};
+  opt.base.curve.set(default_curve, 4);
+  opt.base.curve.smooth = opt.base.falling_curve.smooth = true;
+  bool measure_from_set = false;
+  std::vector<std::pair<std::string, std::string>> new_flags;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        usage();
+        exit(2);
+      }
+      return argv[++i];
+    };
+    bool ok = true;
+    if (a == "--instances") opt.instances = atoi(next());
+    else if (a == "--threads") opt.threads = atoi(next());
+    else if (a == "--sim-s") opt.sim_s = atof(next());
+    else if (a == "--measure-from-s") {
+      opt.measure_from_s = atof(next());
+      measure_from_set = true;
+    } else if (a == "--tick-ms") opt.tick_ms = static_cast<uint32_t>(atoi(next()));
+    else if (a == "--sensor-ms") opt.sensor_ms = static_cast<uint32_t>(atoi(next()));
+    else if (a == "--ambient") opt.ambient_c = static_cast<float>(atof(next()));
+    else if (a == "--heat-w") opt.heat_w = static_cast<float>(atof(next()));
+    else if (a == "--spread") opt.spread = static_cast<float>(atof(next()));
+    else if (a == "--profile") ok = ft_parse_heat_profile(next(), opt.profile);
+    else if (a == "--seed") opt.seed = static_cast<uint32_t>(strtoul(next(), nullptr, 10));
+    else if (a == "--rollout-at-s") opt.rollout_at_s = atof(next());
+    else if (a == "--rollout-fraction") opt.rollout_fraction = atof(next());
+    else if (a == "--rollout-waves") opt.rollout_waves = atoi(next());
+    else if (a == "--rollout-wave-s") opt.rollout_wave_s = atof(next());
+    else if (a.rfind("--new-", 0) == 0) new_flags.emplace_back(a.substr(6), next());
+    else if (a.rfind("--", 0) == 0 && i + 1 < argc && parse_config_flag(a.substr(2), argv[i + 1], opt.base, ok)) i++;
+    else ok = false;
+    if (!ok) {
+      fprintf(stderr, "bad argument: %s\n", a.c_str());
+      usage();
+      return 2;
+    }
+  }
+  // Rollout settings start from the (possibly overridden) baseline.
+  opt.next = opt.base;
+  for (const auto &f : new_flags) {
+    bool ok = true;
+    if (!parse_config_flag(f.first, f.second.c_str(), opt.next, ok) || !ok) {
+      fprintf(stderr, "bad argument: --new-%s\n", f.first.c_str());
+      return 2;
+    }
+  }
+  // The default never asks for more threads than instances; an explicit --threads must fit.
+  if (opt.threads <= 0)
+    opt.threads = static_cast<int>(std::min<unsigned>(std::max(1u, std::thread::hardware_concurrency()),
+                                                      static_cast<unsigned>(std::max(1, opt.instances))));
+  const bool rollout = opt.rollout_at_s >= 0.0;
+  const double last_wave_s = opt.rollout_at_s + (opt.rollout_waves - 1) * opt.rollout_wave_s;
+  if (rollout && !measure_from_set) opt.measure_from_s = last_wave_s;
+  if (opt.instances < 1 || opt.threads > opt.instances || opt.sim_s <= 0.0 || opt.tick_ms == 0 ||
+      opt.rollout_fraction < 0.0 || opt.rollout_fraction > 1.0 || opt.rollout_waves < 1 ||
+      opt.measure_from_s >= opt.sim_s) {
+    usage();
+    return 2;
+  }
+
+  // Build the fleet: each instance gets its own plant with jittered heat and ambient
+  // and a deterministic rank that decides whether and in which wave it rolls out.
+  std::mt19937 rng(opt.seed);
+  std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+  std::uniform_real_distribution<double> rank(0.0, 1.0);
+  std::vector<std::vector<Unit>> shards(opt.threads);
+  for (int t = 0; t < opt.threads; t++) shards[t].reserve(opt.instances / opt.threads + 1);
+  for (int i = 0; i < opt.instances; i++) {
+    FtThermalParams params;
+    params.ambient_c = opt.ambient_c + 15.0f * opt.spread * jitter(rng);
+    params.heat_w = std::max(0.0f, opt.heat_w * (1.0f + opt.spread * jitter(rng)));
+    Unit u;
+    u.sim = FtThermalSim(params, opt.seed * 7919u + static_cast<uint32_t>(i));
+    u.sim.set_profile(opt.profile);
+    u.ctl.config = opt.base;
+    const double r = rank(rng);
+    if (rollout && r < opt.rollout_fraction) {
+      const int wave = std::min(opt.rollout_waves - 1, static_cast<int>(r / opt.rollout_fraction * opt.rollout_waves));
+      u.rollout_step = static_cast<int64_t>((opt.rollout_at_s + wave * opt.rollout_wave_s) * 1000.0 / opt.tick_ms);
+    }
+    shards[i % opt.threads].push_back(u);
+  }
+
+  std::vector<ShardResult> results(opt.threads);
+  const uint64_t start = now_ns();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < opt.threads; t++)
+    threads.emplace_back([&opt, &shards, &results, t]() { run_shard(opt, shards[t], results[t]); });
+  for (auto &t : threads) t.join();
+  const double wall_s = (now_ns() - start) / 1e9;
+
+  uint64_t ticks = 0, ctl_ns = 0, total_ns = 0;
+  for (const ShardResult &r : results) {
+    ticks += r.ticks;
+    ctl_ns += r.ctl_ns;
+    total_ns += r.total_ns;
+  }
+  printf("%d instance(s) on %d thread(s), %.0f s simulated at %u ms ticks in %.2f s wall (%.0fx real time)\n",
+         opt.instances, opt.threads, opt.sim_s, opt.tick_ms, wall_s, opt.sim_s / wall_s);
+  printf("control tick: %.1f ns/instance (plant included: %.1f ns), %.2f M ticks/s, %zu B controller state\n",
+         static_cast<double>(ctl_ns) / ticks, static_cast<double>(total_ns) / ticks, ticks / wall_s / 1e6,
+         sizeof(FtController));
+
+  std::vector<const Unit *> base, rolled;
+  for (const auto &shard : shards)
+    for (const Unit &u : shard) (u.rollout_step >= 0 ? rolled : base).push_back(&u);
+  const double measured_s = opt.sim_s - opt.measure_from_s;
+  printf("measured %.0f s from t=%.0f s", measured_s, opt.measure_from_s);
+  if (rollout)
+    printf(", rollout to %.0f%% in %d wave(s) from t=%.0f s", 100.0 * opt.rollout_fraction, opt.rollout_waves,
+           opt.rollout_at_s);
+  printf("\n%-10s %7s %9s %9s %9s %8s %8s %9s %9s\n", "cohort", "units", "temp C", "p95 C", "max C", "pwm %",
+         "fan pwr%", "failsafe%", "rev/h");
+  print_cohort("baseline", base, measured_s);
+  print_cohort("rollout", rolled, measured_s);
+  return 0;
+}
@@ -0,0 +1,859 @@
+// FanForge HTTP load generator.
+//
+// Drives the device API (/api/status, /api/config GET/POST, /metrics or any
+// path) over keep-alive connections with a weighted route mix, either
+// closed-loop (each connection sends its next request as soon as the previous
+// one completes) or open-loop at a fixed arrival rate. In open-loop mode
+// latency is measured from the scheduled arrival time, so time spent queued
+// behind a slow device is counted instead of hidden.
+//
+// With --tick-jitter the tool scrapes /metrics before and after the run and
+// reports how the control tick interval histogram moved under load: the point
+// where late ticks appear is the number of clients one controller can serve.
+//
+// With --cbor every request asks for application/cbor and config_post sends
+// the device's CBOR config, to compare encode/parse cost against JSON.
+//
+// With --encoding every request sends Accept-Encoding, and the device's
+// compressor counters are scraped before and after to report the compression
+// ratio and its CPU cost per KiB of response body.
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ft_net.h"
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void on_signal(int) { g_stop = true; }
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Route {
+  std::string name;
+  std::string method;  // GET | POST
+  std::string path;
+  bool config_post = false;  // body is the target's current config, re-posted unchanged
+  double weight = 1.0;
+};
+
+struct Target {
+  std::string spec;
+  std::string host_header;
+  sockaddr_storage addr{};
+  socklen_t addr_len = 0;
+  std::string config_body;  // current config: payload=<urlencoded JSON>, or raw CBOR with --cbor
+  std::string config_type;  // Content-Type of config_body
+};
+
+// Per-request failures; connect failures are per connection and counted separately.
+// refused: 429/503 from the device's admission control (rate limit, busy, load shedding).
+enum ErrorKind { ERR_HTTP_4XX = 0, ERR_HTTP_5XX, ERR_REFUSED, ERR_IO, ERR_TIMEOUT, ERR_DROPPED, ERR_COUNT };
+const char *const ERROR_LABELS[ERR_COUNT] = {"http_4xx", "http_5xx", "refused", "io", "timeout", "dropped"};
+
+struct RouteResult {
+  std::vector<uint32_t> latency_us;
+  uint64_t errors[ERR_COUNT] = {0};
+  uint64_t bytes = 0;
+};
+
+struct Options {
+  std::vector<Target> targets;
+  std::vector<Route> routes;
+  int connections = 4;
+  int threads = 1;
+  double rate = 0.0;  // 0 = closed loop
+  bool poisson = true;
+  double duration_s = 10.0;
+  double warmup_s = 1.0;
+  uint32_t timeout_ms = 5000;
+  size_t max_queue = 100000;
+  bool tick_jitter = false;
+  bool cbor = false;
+  std::string encoding;  // Accept-Encoding value; empty sends none
+};
+
+// --- HTTP/1.1 response framing --------------------------------------------
+
+// Returns 1 with the response complete, 0 if more bytes are needed, -1 on garbage.
+int parse_response(const std::string &in, bool eof, size_t &consumed, int &status, bool &close_after,
+                   std::string *body) {
+  const size_t hdr_end = in.find("\r\n\r\n");
+  if (hdr_end == std::string::npos) return in.size() > 16384 ? -1 : 0;
+  if (in.compare(0, 5, "HTTP/") != 0) return -1;
+  const size_t sp = in.find(' ');
+  if (sp == std::string::npos || sp > hdr_end) return -1;
+  status = atoi(in.c_str() + sp + 1);
+
+  long content_length = -1;
+  bool chunked = false;
+  close_after = in.compare(0, 8, "HTTP/1.0") == 0;
+  size_t pos = in.find("\r\n") + 2;
+  while (pos < hdr_end) {
+    size_t eol = in.find("\r\n", pos);
+    std::string line = in.substr(pos, eol - pos);
+    pos = eol + 2;
+    std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    if (line.rfind("content-length:", 0) == 0) content_length = strtol(line.c_str() + 15, nullptr, 10);
+    else if (line.rfind("transfer-encoding:", 0) == 0) chunked = line.find("chunked") != std::string::npos;
+    else if (line.rfind("connection:", 0) == 0) {
+      if (line.find("close") != std::string::npos) close_after = true;
+      else if (line.find("keep-alive") != std::string::npos) close_after = false;
+    }
+  }
+
+  size_t p = hdr_end + 4;
+  if (chunked) {
+    for (;;) {
+      const size_t eol = in.find("\r\n", p);
+      if (eol == std::string::npos) return 0;
+      const size_t n = strtoul(in.c_str() + p, nullptr, 16);
+      if (in.size() < eol + 2 + n + 2) return 0;
+      if (body) body->append(in, eol + 2, n);
+      p = eol + 2 + n + 2;
+      if (n == 0) break;
+    }
+    consumed = p;
+    return 1;
+  }
+  if (content_length < 0) {
+    // Body runs to EOF.
+    if (!eof) return 0;
+    if (body) body->assign(in, p, std::string::npos);
+    consumed = in.size();
+    close_after = true;
+    return 1;
+  }
+  if (in.size() < p + static_cast<size_t>(content_length)) return 0;
+  if (body) body->assign(in, p, static_cast<size_t>(content_length));
+  consumed = p + static_cast<size_t>(content_length);
+  return 1;
+}
+
+std::string build_request(const Target &t, const Route &r, bool cbor, const std::string &encoding) {
+  std::string req = r.method + " " + r.path + " HTTP/1.1\r\nHost: " + t.host_header + "\r\nConnection: keep-alive\r\n";
+  if (cbor) req += "Accept: application/cbor\r\n";
+  if (!encoding.empty()) req += "Accept-Encoding: " + encoding + "\r\n";
+  if (r.method == "POST") {
+    const std::string &body = r.config_post ? t.config_body : std::string();
+    const std::string &type = r.config_post ? t.config_type : std::string("application/x-www-form-urlencoded");
+    req += "Content-Type: " + type + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  } else {
+    req += "\r\n";
+  }
+  return req;
+}
+
+// Blocking one-shot request for setup and metrics scrapes.
+bool http_fetch_once(const Target &t, const std::string &path, std::string &body, int &status, const char *accept) {
+  int fd = socket(t.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return false;
+  timeval tv{5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&t.addr), t.addr_len) != 0) {
+    close(fd);
+    return false;
+  }
+  std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + t.host_header + "\r\nConnection: close\r\n";
+  if (accept != nullptr) req += std::string("Accept: ") + accept + "\r\n";
+  req += "\r\n";
+  if (!ft_write_all(fd, req.data(), req.size())) {
+    close(fd);
+    return false;
+  }
+  std::string in;
+  char buf[4096];
+  for (;;) {
+    ssize_t r = recv(fd, buf, sizeof(buf), 0);
+    if (r > 0) in.append(buf, static_cast<size_t>(r));
+    size_t consumed = 0;
+    bool close_after = false;
+    body.clear();
+    int res = parse_response(in, r <= 0, consumed, status, close_after, &body);
+    if (res != 0 || r <= 0) {
+      close(fd);
+      return res == 1;
+    }
+  }
+}
+
+// As http_fetch_once, waiting out admission-control refusals (a run leaves this
+// client's rate-limit bucket empty and may leave the device shedding load).
+bool http_fetch(const Target &t, const std::string &path, std::string &body, int &status,
+                const char *accept = nullptr) {
+  for (int attempt = 0;; attempt++) {
+    if (!http_fetch_once(t, path, body, status, accept)) return false;
+    if ((status != 429 && status != 503) || attempt == 5) return true;
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+}
+
+std::string url_encode(const std::string &s) {
+  static const char *hex = "0123456789ABCDEF";
+  std::string out;
+  for (unsigned char c : s) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      out.push_back(static_cast<char>(c));
+    } else {
+      out.push_back('%');
+      out.push_back(hex[c >> 4]);
+      out.push_back(hex[c & 15]);
+    }
+  }
+  return out;
+}
+
+// --- worker ----------------------------------------------------------------
+
+struct Pending {
+  int route;
+  uint64_t sched_ns;
+};
+
+class Worker {
+ public:
+  // Connections conn_offset.. of the global pool, assigned to targets round-robin.
+  Worker(const Options &opt, int index, int conn_offset, int connections, double rate)
+      : opt_(opt), rate_(rate), rng_(0x5EED + index), results_(opt.routes.size()) {
+    for (const Route &r : opt.routes) this->weights_.push_back(r.weight);
+    this->pick_ = std::discrete_distribution<int>(this->weights_.begin(), this->weights_.end());
+    this->conns_.resize(connections);
+    this->pending_.resize(opt.targets.size());
+    for (int i = 0; i < connections; i++) {
+      const int target = (conn_offset + i) % static_cast<int>(opt.targets.size());
+      this->conns_[i].target = target;
+      if (std::find(this->served_.begin(), this->served_.end(), target) == this->served_.end())
+        this->served_.push_back(target);
+    }
+  }
+
+  void run(uint64_t start_ns, uint64_t record_from_ns, uint64_t end_ns) {
+    this->record_from_ns_ = record_from_ns;
+    this->ep_ = epoll_create1(EPOLL_CLOEXEC);
+    this->tfd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = UINT64_MAX;
+    epoll_ctl(this->ep_, EPOLL_CTL_ADD, this->tfd_, &ev);
+
+    this->next_arrival_ns_ = start_ns;
+    for (size_t i = 0; i < this->conns_.size(); i++) this->open_(static_cast<int>(i));
+    if (this->rate_ > 0.0) this->arm_timer_();
+
+    epoll_event events[64];
+    while (!g_stop) {
+      const uint64_t now = now_ns();
+      if (now >= end_ns) break;
+      int n = epoll_wait(this->ep_, events, 64, 10);
+      for (int i = 0; i < n; i++) {
+        if (events[i].data.u64 == UINT64_MAX) {
+          uint64_t expirations;
+          ssize_t r = read(this->tfd_, &expirations, sizeof(expirations));
+          (void) r;
+          this->arrivals_(std::min(now_ns(), end_ns));
+          this->arm_timer_();
+          continue;
+        }
+        this->on_event_(static_cast<int>(events[i].data.u64), events[i].events);
+      }
+      this->check_timeouts_(now_ns());
+    }
+    for (Conn &c : this->conns_)
+      if (c.fd >= 0) close(c.fd);
+    close(this->tfd_);
+    close(this->ep_);
+  }
+
+  std::vector<RouteResult> &results() { return this->results_; }
+
+ private:
+  enum State { CLOSED, CONNECTING, IDLE, BUSY };
+  struct Conn {
+    int fd = -1;
+    int target = 0;
+    State state = CLOSED;
+    std::string out;
+    size_t out_off = 0;
+    std::string in;
+    int route = -1;
+    uint64_t sched_ns = 0;
+    uint64_t sent_ns = 0;
+    uint64_t retry_ns = 0;  // earliest reconnect after a failed connect
+  };
+
+  void arm_timer_() {
+    itimerspec its{};
+    its.it_value.tv_sec = static_cast<time_t>(this->next_arrival_ns_ / 1000000000ULL);
+    its.it_value.tv_nsec = static_cast<long>(this->next_arrival_ns_ % 1000000000ULL);
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+    timerfd_settime(this->tfd_, TFD_TIMER_ABSTIME, &its, nullptr);
+  }
+
+  // Open loop: enqueue every arrival due by now, then hand them to idle connections.
+  void arrivals_(uint64_t now) {
+    std::exponential_distribution<double> gap(this->rate_);
+    while (this->next_arrival_ns_ <= now) {
+      const int target = this->served_[this->next_target_++ % this->served_.size()];
+      auto &q = this->pending_[target];
+      const int route = this->pick_(this->rng_);
+      if (q.size() >= this->opt_.max_queue) {
+        this->record_error_(route, ERR_DROPPED, this->next_arrival_ns_);
+      } else {
+        q.push_back({route, this->next_arrival_ns_});
+      }
+      const double dt = this->opt_.poisson ? gap(this->rng_) : 1.0 / this->rate_;
+      this->next_arrival_ns_ += static_cast<uint64_t>(dt * 1e9);
+    }
+    for (size_t i = 0; i < this->conns_.size(); i++) {
+      if (this->conns_[i].state == IDLE) this->dispatch_(static_cast<int>(i));
+    }
+  }
+
+  void open_(int ci) {
+    Conn &c = this->conns_[ci];
+    const Target &t = this->opt_.targets[c.target];
+    c.fd = socket(t.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd < 0) {
+      c.state = CLOSED;
+      return;
+    }
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c.in.clear();
+    c.out.clear();
+    c.out_off = 0;
+    int r = connect(c.fd, reinterpret_cast<const sockaddr *>(&t.addr), t.addr_len);
+    if (r != 0 && errno != EINPROGRESS) {
+      close(c.fd);
+      c.fd = -1;
+      c.state = CLOSED;
+      this->connect_errors_++;
+      return;
+    }
+    c.state = CONNECTING;
+    c.sent_ns = now_ns();
+    epoll_event ev{};
+    ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = static_cast<uint64_t>(ci);
+    epoll_ctl(this->ep_, EPOLL_CTL_ADD, c.fd, &ev);
+  }
+
+  void drop_(int ci, ErrorKind why) {
+    Conn &c = this->conns_[ci];
+    if (c.state == BUSY && c.route >= 0) this->record_error_(c.route, why, c.sched_ns);
+    if (c.state == CONNECTING) {
+      this->connect_errors_++;
+      c.retry_ns = now_ns() + 100000000ULL;
+    }
+    if (c.fd >= 0) {
+      epoll_ctl(this->ep_, EPOLL_CTL_DEL, c.fd, nullptr);
+      close(c.fd);
+    }
+    c.fd = -1;
+    c.state = CLOSED;
+    c.route = -1;
+    this->reconnects_++;
+    if (now_ns() >= c.retry_ns) this->open_(ci);
+  }
+
+  void dispatch_(int ci) {
+    Conn &c = this->conns_[ci];
+    int route;
+    uint64_t sched;
+    if (this->rate_ > 0.0) {
+      auto &q = this->pending_[c.target];
+      if (q.empty()) return;
+      route = q.front().route;
+      sched = q.front().sched_ns;
+      q.pop_front();
+    } else {
+      route = this->pick_(this->rng_);
+      sched = now_ns();
+    }
+    c.route = route;
+    c.sched_ns = sched;
+    c.sent_ns = now_ns();
+    c.out = build_request(this->opt_.targets[c.target], this->opt_.routes[route], this->opt_.cbor,
+                          this->opt_.encoding);
+    c.out_off = 0;
+    c.state = BUSY;
+    this->flush_(ci);
+  }
+
+  void flush_(int ci) {
+    Conn &c = this->conns_[ci];
+    while (c.out_off < c.out.size()) {
+      ssize_t w = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+      if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (w <= 0) {
+        this->drop_(ci, ERR_IO);
+        return;
+      }
+      c.out_off += static_cast<size_t>(w);
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (c.out_off < c.out.size() ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.u64 = static_cast<uint64_t>(ci);
+    epoll_ctl(this->ep_, EPOLL_CTL_MOD, c.fd, &ev);
+  }
+
+  void on_event_(int ci, uint32_t events) {
+    Conn &c = this->conns_[ci];
+    if (c.fd < 0) return;
+    if (c.state == CONNECTING) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+        this->drop_(ci, ERR_IO);
+        return;
+      }
+      c.state = IDLE;
+      this->dispatch_(ci);
+      if (c.state == IDLE) this->flush_(ci);  // drop EPOLLOUT interest
+      return;
+    }
+    if ((events & EPOLLOUT) && c.state == BUSY) this->flush_(ci);
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))) return;
+
+    char buf[8192];
+    bool eof = false;
+    for (;;) {
+      ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+      if (r > 0) {
+        c.in.append(buf, static_cast<size_t>(r));
+        continue;
+      }
+      if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) eof = true;
+      break;
+    }
+    if (c.state != BUSY) {
+      if (eof) this->drop_(ci, ERR_IO);  // server closed an idle keep-alive connection
+      return;
+    }
+
+    size_t consumed = 0;
+    int status = 0;
+    bool close_after = false;
+    int res = parse_response(c.in, eof, consumed, status, close_after, nullptr);
+    if (res == 0) {
+      if (eof) this->drop_(ci, ERR_IO);
+      return;
+    }
+    if (res < 0) {
+      this->drop_(ci, ERR_IO);
+      return;
+    }
+
+    const uint64_t done = now_ns();
+    if (c.sched_ns >= this->record_from_ns_) {
+      RouteResult &rr = this->results_[c.route];
+      rr.bytes += consumed;
+      // Every response counts toward latency; non-2xx are also counted as errors.
+      if (status == 429 || status == 503) rr.errors[ERR_REFUSED]++;
+      else if (status >= 500) rr.errors[ERR_HTTP_5XX]++;
+      else if (status >= 400) rr.errors[ERR_HTTP_4XX]++;
+      rr.latency_us.push_back(static_cast<uint32_t>(std::min<uint64_t>((done - c.sched_ns) / 1000, UINT32_MAX)));
+    }
+    c.in.erase(0, consumed);
+    c.route = -1;
+    c.state = IDLE;
+    if (close_after || eof) {
+      this->drop_(ci, ERR_IO);
+      return;
+    }
+    this->dispatch_(ci);
+  }
+
+  void check_timeouts_(uint64_t now) {
+    const uint64_t limit = static_cast<uint64_t>(this->opt_.timeout_ms) * 1000000ULL;
+    for (size_t i = 0; i < this->conns_.size(); i++) {
+      Conn &c = this->conns_[i];
+      if ((c.state == BUSY || c.state == CONNECTING) && now - c.sent_ns > limit) {
+        this->drop_(static_cast<int>(i), ERR_TIMEOUT);
+      } else if (c.state == CLOSED && now >= c.retry_ns) {
+        this->open_(static_cast<int>(i));
+      }
+    }
+  }
+
+  void record_error_(int route, ErrorKind kind, uint64_t sched_ns) {
+    if (sched_ns >= this->record_from_ns_) this->results_[route].errors[kind]++;
+  }
+
+  const Options &opt_;
+  double rate_;
+  std::mt19937_64 rng_;
+  std::vector<double> weights_;
+  std::discrete_distribution<int> pick_;
+  std::vector<Conn> conns_;
+  std::vector<std::deque<Pending>> pending_;
+  std::vector<RouteResult> results_;
+  int ep_ = -1;
+  int tfd_ = -1;
+  uint64_t next_arrival_ns_ = 0;
+  uint64_t record_from_ns_ = 0;
+  std::vector<int> served_;
+  size_t next_target_ = 0;
+
+ public:
+  uint64_t connect_errors_ = 0;
+  uint64_t reconnects_ = 0;
+};
+
+// --- tick jitter from /metrics ---------------------------------------------
+
+struct TickHistogram {
+  std::vector<std::pair<double, double>> buckets;  // (le seconds, cumulative count); +Inf as INFINITY
+  double count = 0, sum = 0;
+  double duration_count = 0, duration_sum = 0;
+  bool ok = false;
+};
+
+TickHistogram scrape_ticks(const Target &t) {
+  TickHistogram h;
+  std::string body;
+  int status = 0;
+  if (!http_fetch(t, "/metrics", body, status) || status != 200) return h;
+  size_t pos = 0;
+  while (pos < body.size()) {
+    size_t eol = body.find('\n', pos);
+    if (eol == std::string::npos) eol = body.size();
+    const std::string line = body.substr(pos, eol - pos);
+    pos = eol + 1;
+    const size_t sp = line.rfind(' ');
+    if (line.empty() || line[0] == '#' || sp == std::string::npos) continue;
+    const double value = atof(line.c_str() + sp + 1);
+    const std::string name = line.substr(0, sp);
+    if (name.rfind("fanforge_tick_interval_seconds_bucket{le=\"", 0) == 0) {
+      const std::string le = name.substr(42, name.size() - 44);
+      h.buckets.emplace_back(le == "+Inf" ? INFINITY : atof(le.c_str()), value);
+    } else if (name == "fanforge_tick_interval_seconds_count") {
+      h.count = value;
+    } else if (name == "fanforge_tick_interval_seconds_sum") {
+      h.sum = value;
+    } else if (name == "fanforge_tick_duration_seconds_count") {
+      h.duration_count = value;
+    } else if (name == "fanforge_tick_duration_seconds_sum") {
+      h.duration_sum = value;
+    }
+  }
+  h.ok = !h.buckets.empty();
+  return h;
+}
+
+void report_ticks(const Target &t, const TickHistogram &a, const TickHistogram &b) {
+  if (!a.ok || !b.ok || a.buckets.size() != b.buckets.size()) {
+    printf("  %-24s tick histogram unavailable\n", t.spec.c_str());
+    return;
+  }
+  const double n = b.count - a.count;
+  if (n <= 0) {
+    printf("  %-24s no ticks observed\n", t.spec.c_str());
+    return;
+  }
+  auto above = [&](double le) {
+    for (size_t i = 0; i < b.buckets.size(); i++) {
+      if (b.buckets[i].first >= le) return n - ((b.buckets[i].second - a.buckets[i].second));
+    }
+    return 0.0;
+  };
+  const double dn = b.duration_count - a.duration_count;
+  printf("  %-24s ticks=%.0f mean_interval=%.1fms >210ms=%.2f%% >250ms=%.2f%% >500ms=%.2f%% mean_tick=%.0fus\n",
+         t.spec.c_str(), n, (b.sum - a.sum) / n * 1e3, 100.0 * above(0.21) / n, 100.0 * above(0.25) / n,
+         100.0 * above(0.5) / n, dn > 0 ? (b.duration_sum - a.duration_sum) / dn * 1e6 : 0.0);
+}
+
+struct CompressCounters {
+  double responses = 0, in_bytes = 0, out_bytes = 0, cpu_us = 0;
+  bool ok = false;
+};
+
+CompressCounters scrape_compress(const Target &t) {
+  CompressCounters c;
+  std::string body;
+  int status = 0;
+  if (!http_fetch(t, "/metrics", body, status) || status != 200) return c;
+  size_t pos = 0;
+  while (pos < body.size()) {
+    size_t eol = body.find('\n', pos);
+    if (eol == std::string::npos) eol = body.size();
+    const std::string line = body.substr(pos, eol - pos);
+    pos = eol + 1;
+    const size_t sp = line.rfind(' ');
+    if (line.empty() || line[0] == '#' || sp == std::string::npos) continue;
+    const double value = atof(line.c_str() + sp + 1);
+    const std::string name = line.substr(0, sp);
+    if (name.rfind("fanforge_http_compressed_responses_total{", 0) == 0) {
+      c.responses += value;
+    } else if (name == "fanforge_http_compress_in_bytes_total") {
+      c.in_bytes = value;
+      c.ok = true;
+    } else if (name == "fanforge_http_compress_out_bytes_total") {
+      c.out_bytes = value;
+    } else if (name == "fanforge_http_compress_cpu_microseconds_total") {
+      c.cpu_us = value;
+    }
+  }
+  return c;
+}
+
+void report_compress(const Target &t, const CompressCounters &a, const CompressCounters &b) {
+  if (!a.ok || !b.ok) {
+    printf("  %-24s compression counters unavailable\n", t.spec.c_str());
+    return;
+  }
+  const double in = b.in_bytes - a.in_bytes, out = b.out_bytes - a.out_bytes;
+  if (in <= 0) {
+    printf("  %-24s no compressed responses\n", t.spec.c_str());
+    return;
+  }
+  printf("  %-24s responses=%.0f in=%.1fKiB out=%.1fKiB ratio=%.3f (%.1fx) cpu=%.1fus/KiB\n", t.spec.c_str(),
+         b.responses - a.responses, in / 1024.0, out / 1024.0, out / in, in / std::max(out, 1.0),
+         (b.cpu_us - a.cpu_us) / (in / 1024.0));
+}
+
+// --- reporting ---------------------------------------------------------------
+
+double percentile(const std::vector<uint32_t> &sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  size_t idx = static_cast<size_t>(std::ceil(p * sorted.size()));
+  if (idx > 0) idx--;
+  return sorted[std::min(idx, sorted.size() - 1)] / 1000.0;
+}
+
+void print_row(const char *name, std::vector<uint32_t> &lat, const uint64_t *errors, double seconds) {
+  std::sort(lat.begin(), lat.end());
+  uint64_t err = 0;
+  for (int e = 0; e < ERR_COUNT; e++) err += errors[e];
+  // HTTP errors are responses (already in lat); transport errors are not.
+  const double total =
+      static_cast<double>(lat.size() + err - errors[ERR_HTTP_4XX] - errors[ERR_HTTP_5XX] - errors[ERR_REFUSED]);
+  printf("%-16s %9zu %8llu %6.2f%% %9.1f %8.2f %8.2f %8.2f %8.2f\n", name, lat.size(),
+         static_cast<unsigned long long>(err), total > 0 ? 100.0 * err / total : 0.0, lat.size() / seconds,
+         percentile(lat, 0.50), percentile(lat, 0.95), percentile(lat, 0.99), lat.empty() ? 0.0 : lat.back() / 1000.0);
+}
+
+bool parse_mix(const std::string &spec, std::vector<Route> &routes) {
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    size_t comma = spec.find(',', pos);
+    if (comma == std::string::npos) comma = spec.size();
+    const std::string item = spec.substr(pos, comma - pos);
+    pos = comma + 1;
+    const size_t eq = item.rfind('=');
+    Route r;
+    r.name = item.substr(0, eq);
+    r.weight = eq == std::string::npos ? 1.0 : atof(item.c_str() + eq + 1);
+    if (r.weight <= 0.0) return false;
+    if (r.name == "status") {
+      r.method = "GET";
+      r.path = "/api/status";
+    } else if (r.name == "config_get") {
+      r.method = "GET";
+      r.path = "/api/config";
+    } else if (r.name == "config_post") {
+      r.method = "POST";
+      r.path = "/api/config";
+      r.config_post = true;
+    } else if (r.name == "metrics") {
+      r.method = "GET";
+      r.path = "/metrics";
+    } else if (r.name.rfind("GET:", 0) == 0 || r.name.rfind("POST:", 0) == 0) {
+      const size_t colon = r.name.find(':');
+      r.method = r.name.substr(0, colon);
+      r.path = r.name.substr(colon + 1);
+      if (r.path.empty() || r.path[0] != '/') return false;
+    } else {
+      return false;
+    }
+    routes.push_back(r);
+  }
+  return !routes.empty();
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-loadgen --target host[:port] [--target ...] [options]\n"
+          "  --mix SPEC           weighted routes, e.g. status=8,config_get=1,config_post=1\n"
+          "                       names: status config_get config_post metrics, or GET:/path / POST:/path\n"
+          "                       (default status=1; config_post re-posts the device's current config)\n"
+          "  --connections N      keep-alive connections, spread over targets (default 4)\n"
+          "  --rate R             open-loop arrivals per second over all targets; 0 = closed loop (default 0)\n"
+          "  --arrival poisson|uniform  open-loop inter-arrival distribution (default poisson)\n"
+          "  --duration-s S       measured run length (default 10)\n"
+          "  --warmup-s S         unrecorded lead-in (default 1)\n"
+          "  --timeout-ms MS      per-request timeout (default 5000)\n"
+          "  --threads N          client event loops (default 1)\n"
+          "  --tick-jitter        scrape /metrics before/after and report control tick interval drift\n"
+          "  --cbor               request application/cbor and post the config as CBOR\n"
+          "  --encoding E         send Accept-Encoding: E (gzip, deflate) and report the device's compression\n"
+          "                       ratio and CPU cost per KiB\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  std::vector<std::string> target_specs;
+  std::string mix = "status=1";
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        usage();
+        exit(2);
+      }
+      return argv[++i];
+    };
+    if (a == "--target") target_specs.emplace_back(next());
+    else if (a == "--mix") mix = next();
+    else if (a == "--connections") opt.connections = atoi(next());
+    else if (a == "--rate") opt.rate = atof(next());
+    else if (a == "--arrival") opt.poisson = std::string(next()) != "uniform";
+    else if (a == "--duration-s") opt.duration_s = atof(next());
+    else if (a == "--warmup-s") opt.warmup_s = atof(next());
+    else if (a == "--timeout-ms") opt.timeout_ms = static_cast<uint32_t>(atoi(next()));
+    else if (a == "--threads") opt.threads = atoi(next());
+    else if (a == "--tick-jitter") opt.tick_jitter = true;
+    else if (a == "--cbor") opt.cbor = true;
+    else if (a == "--encoding") opt.encoding = next();
+    else {
+      usage();
+      return 2;
+    }
+  }
+  if (target_specs.empty() || !parse_mix(mix, opt.routes) || opt.connections < 1 || opt.threads < 1 ||
+      opt.threads > opt.connections || opt.rate < 0.0 || opt.duration_s <= 0.0 || opt.warmup_s < 0.0) {
+    usage();
+    return 2;
+  }
+
+  bool need_config = false;
+  for (const Route &r : opt.routes) need_config = need_config || r.config_post;
+  for (const std::string &spec : target_specs) {
+    Target t;
+    std::string host;
+    int port = 0;
+    if (!ft_split_host_port(spec, host, port, 80) || !ft_resolve(host, port, SOCK_STREAM, t.addr, t.addr_len)) {
+      fprintf(stderr, "cannot resolve target '%s'\n", spec.c_str());
+      return 1;
+    }
+    t.spec = spec;
+    t.host_header = port == 80 ? host : host + ":" + std::to_string(port);
+    if (need_config) {
+      std::string body;
+      int status = 0;
+      const char *type = opt.cbor ? "application/cbor" : "application/json";
+      if (!http_fetch(t, "/api/config", body, status, type) || status != 200) {
+        fprintf(stderr, "cannot read /api/config from %s for config_post\n", spec.c_str());
+        return 1;
+      }
+      if (opt.cbor) {
+        t.config_body = body;
+        t.config_type = type;
+      } else {
+        t.config_body = "payload=" + url_encode(body);
+        t.config_type = "application/x-www-form-urlencoded";
+      }
+    }
+    opt.targets.push_back(t);
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  std::vector<TickHistogram> before;
+  if (opt.tick_jitter)
+    for (const Target &t : opt.targets) before.push_back(scrape_ticks(t));
+  std::vector<CompressCounters> compress_before;
+  if (!opt.encoding.empty())
+    for (const Target &t : opt.targets) compress_before.push_back(scrape_compress(t));
+
+  if (opt.connections < static_cast<int>(opt.targets.size())) {
+    fprintf(stderr, "need at least one connection per target (--connections %zu)\n", opt.targets.size());
+    return 2;
+  }
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int w = 0, offset = 0; w < opt.threads; w++) {
+    const int conns = opt.connections / opt.threads + (w < opt.connections % opt.threads ? 1 : 0);
+    workers.emplace_back(new Worker(opt, w, offset, conns, opt.rate / opt.threads));
+    offset += conns;
+  }
+  const uint64_t start = now_ns();
+  const uint64_t record_from = start + static_cast<uint64_t>(opt.warmup_s * 1e9);
+  const uint64_t end = record_from + static_cast<uint64_t>(opt.duration_s * 1e9);
+  std::vector<std::thread> threads;
+  for (auto &w : workers) threads.emplace_back([&w, start, record_from, end]() { w->run(start, record_from, end); });
+  for (auto &t : threads) t.join();
+  const double measured_s = std::max(1e-3, (std::min(now_ns(), end) - record_from) / 1e9);
+
+  printf("%s, %d connection(s) over %zu target(s), %.1fs measured%s\n",
+         opt.rate > 0.0 ? "open loop" : "closed loop", opt.connections, opt.targets.size(), measured_s,
+         opt.rate > 0.0 ? " (latency from scheduled arrival)" : "");
+  if (opt.rate > 0.0) printf("offered %.1f req/s (%s)\n", opt.rate, opt.poisson ? "poisson" : "uniform");
+  printf("%-16s %9s %8s %7s %9s %8s %8s %8s %8s\n", "route", "responses", "errors", "err%", "req/s", "p50 ms", "p95 ms",
+         "p99 ms", "max ms");
+
+  std::vector<uint32_t> all;
+  uint64_t all_errors[ERR_COUNT] = {0};
+  uint64_t bytes = 0, reconnects = 0, connect_errors = 0;
+  for (size_t r = 0; r < opt.routes.size(); r++) {
+    std::vector<uint32_t> lat;
+    uint64_t errors[ERR_COUNT] = {0};
+    for (auto &w : workers) {
+      RouteResult &rr = w->results()[r];
+      lat.insert(lat.end(), rr.latency_us.begin(), rr.latency_us.end());
+      for (int e = 0; e < ERR_COUNT; e++) errors[e] += rr.errors[e];
+      bytes += rr.bytes;
+    }
+    all.insert(all.end(), lat.begin(), lat.end());
+    for (int e = 0; e < ERR_COUNT; e++) all_errors[e] += errors[e];
+    print_row(opt.routes[r].name.c_str(), lat, errors, measured_s);
+  }
+  if (opt.routes.size() > 1) print_row("all", all, all_errors, measured_s);
+  for (auto &w : workers) {
+    reconnects += w->reconnects_;
+    connect_errors += w->connect_errors_;
+  }
+
+  printf("errors:");
+  for (int e = 0; e < ERR_COUNT; e++)
+    printf(" %s=%llu", ERROR_LABELS[e], static_cast<unsigned long long>(all_errors[e]));
+  printf("  connect_failures=%llu reconnects=%llu  rx=%.1f KiB/s\n", static_cast<unsigned long long>(connect_errors),
+         static_cast<unsigned long long>(reconnects), bytes / 1024.0 / measured_s);
+
+  if (opt.tick_jitter) {
+    printf("control tick under load:\n");
+    for (size_t i = 0; i < opt.targets.size(); i++) report_ticks(opt.targets[i], before[i], scrape_ticks(opt.targets[i]));
+  }
+  if (!opt.encoding.empty()) {
+    printf("response compression (%s):\n", opt.encoding.c_str());
+    for (size_t i = 0; i < opt.targets.size(); i++)
+      report_compress(opt.targets[i], compress_before[i], scrape_compress(opt.targets[i]));
+  }
+  return 0;
+}
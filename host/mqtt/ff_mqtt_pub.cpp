@@ -0,0 +1,246 @@
+// Host build of the FanForge MQTT telemetry publisher.
+//
+// Runs the same FtTelemetryPublisher as the firmware against a synthetic
+// temperature trace and publishes over a minimal MQTT 3.1.1 client (QoS 0 only),
+// so batching, encoding and retained config snapshots can be checked against a
+// local broker (see mosquitto_harness.sh).
+
+#include <poll.h>
+#include <signal.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fanforge_telemetry.h"
+#include "ft_net.h"
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void on_signal(int) { g_stop = 1; }
+
+void put_varint(std::vector<uint8_t> &out, size_t len) {
+  do {
+    uint8_t b = len % 128;
+    len /= 128;
+    if (len > 0) b |= 0x80;
+    out.push_back(b);
+  } while (len > 0);
+}
+
+void put_str(std::vector<uint8_t> &out, const std::string &s) {
+  out.push_back(static_cast<uint8_t>(s.size() >> 8));
+  out.push_back(static_cast<uint8_t>(s.size()));
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+class MqttConnection {
+ public:
+  ~MqttConnection() {
+    if (this->fd_ >= 0) {
+      const uint8_t disconnect[2] = {0xE0, 0x00};
+      ft_write_all(this->fd_, disconnect, sizeof(disconnect));
+      close(this->fd_);
+    }
+  }
+
+  bool connect(const std::string &host, int port, const std::string &client_id, uint16_t keepalive_s) {
+    this->fd_ = ft_tcp_connect(host, port);
+    if (this->fd_ < 0) return false;
+    this->keepalive_s_ = keepalive_s;
+
+    std::vector<uint8_t> body;
+    put_str(body, "MQTT");
+    body.push_back(4);     // protocol level 3.1.1
+    body.push_back(0x02);  // clean session
+    body.push_back(static_cast<uint8_t>(keepalive_s >> 8));
+    body.push_back(static_cast<uint8_t>(keepalive_s));
+    put_str(body, client_id);
+
+    std::vector<uint8_t> pkt{0x10};
+    put_varint(pkt, body.size());
+    pkt.insert(pkt.end(), body.begin(), body.end());
+    if (!ft_write_all(this->fd_, pkt.data(), pkt.size())) return false;
+
+    uint8_t connack[4];
+    size_t got = 0;
+    while (got < sizeof(connack)) {
+      ssize_t r = recv(this->fd_, connack + got, sizeof(connack) - got, 0);
+      if (r <= 0) return false;
+      got += static_cast<size_t>(r);
+    }
+    if (connack[0] != 0x20 || connack[3] != 0) {
+      fprintf(stderr, "broker refused connection (rc=%u)\n", connack[3]);
+      return false;
+    }
+    ft_set_nonblocking(this->fd_);
+    this->last_tx_ = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  bool publish(const std::string &topic, const uint8_t *data, size_t len, bool retain) {
+    this->pkt_.clear();
+    this->pkt_.push_back(static_cast<uint8_t>(0x30 | (retain ? 0x01 : 0x00)));
+    put_varint(this->pkt_, 2 + topic.size() + len);
+    put_str(this->pkt_, topic);
+    this->pkt_.insert(this->pkt_.end(), data, data + len);
+    if (!this->send_(this->pkt_.data(), this->pkt_.size())) return false;
+    this->bytes_sent_ += this->pkt_.size();
+    return true;
+  }
+
+  // Keepalive and discarding broker traffic (PINGRESP); returns false once the link is gone.
+  bool service() {
+    uint8_t scratch[64];
+    for (;;) {
+      ssize_t r = recv(this->fd_, scratch, sizeof(scratch), 0);
+      if (r == 0) return false;
+      if (r < 0) break;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - this->last_tx_ >= std::chrono::seconds(this->keepalive_s_ / 2)) {
+      const uint8_t ping[2] = {0xC0, 0x00};
+      return this->send_(ping, sizeof(ping));
+    }
+    return true;
+  }
+
+  uint64_t bytes_sent() const { return this->bytes_sent_; }
+
+ private:
+  bool send_(const uint8_t *data, size_t len) {
+    while (len > 0) {
+      ssize_t w = ::send(this->fd_, data, len, MSG_NOSIGNAL);
+      if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        pollfd p{this->fd_, POLLOUT, 0};
+        if (poll(&p, 1, 1000) <= 0) return false;
+        continue;
+      }
+      if (w <= 0) return false;
+      data += w;
+      len -= static_cast<size_t>(w);
+    }
+    this->last_tx_ = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  int fd_ = -1;
+  uint16_t keepalive_s_ = 30;
+  std::chrono::steady_clock::time_point last_tx_;
+  std::vector<uint8_t> pkt_;
+  uint64_t bytes_sent_ = 0;
+};
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-mqtt-pub [--broker host[:port]] [--prefix fanforge-host] [--format json|binary]\n"
+          "                   [--tick-ms 200] [--duration-s 30] [--heartbeat-ms 30000]\n"
+          "                   [--batch 10] [--batch-age-ms 2000] [--client-id id]\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string broker = "127.0.0.1:1883";
+  std::string prefix = "fanforge-host";
+  std::string client_id = "fanforge-host-pub";
+  uint32_t tick_ms = 200;
+  double duration_s = 30.0;
+  FtTelemetryOptions opts;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        usage();
+        exit(2);
+      }
+      return argv[++i];
+    };
+    if (a == "--broker") broker = next();
+    else if (a == "--prefix") prefix = next();
+    else if (a == "--client-id") client_id = next();
+    else if (a == "--format") opts.format = std::string(next()) == "binary" ? FT_TELEMETRY_BINARY : FT_TELEMETRY_JSON;
+    else if (a == "--tick-ms") tick_ms = static_cast<uint32_t>(atoi(next()));
+    else if (a == "--duration-s") duration_s = atof(next());
+    else if (a == "--heartbeat-ms") opts.heartbeat_ms = static_cast<uint32_t>(atoi(next()));
+    else if (a == "--batch") opts.max_batch_samples = static_cast<uint8_t>(atoi(next()));
+    else if (a == "--batch-age-ms") opts.max_batch_age_ms = static_cast<uint32_t>(atoi(next()));
+    else {
+      usage();
+      return 2;
+    }
+  }
+  if (tick_ms == 0) tick_ms = 1;
+
+  std::string host;
+  int port = 0;
+  if (!ft_split_host_port(broker, host, port, 1883)) {
+    usage();
+    return 2;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  MqttConnection mqtt;
+  if (!mqtt.connect(host, port, client_id, 30)) {
+    fprintf(stderr, "cannot connect to MQTT broker %s:%d\n", host.c_str(), port);
+    return 1;
+  }
+
+  const std::string telemetry_topic = prefix + "/fanforge/telemetry";
+  const std::string config_topic = prefix + "/fanforge/config";
+  const char *config_snapshot =
+      "{\"mode\":\"auto\",\"smoothing_mode\":\"smooth\",\"points\":[{\"t\":20,\"p\":20},{\"t\":30,\"p\":30},"
+      "{\"t\":40,\"p\":55},{\"t\":50,\"p\":100}],\"min_pwm\":22,\"max_pwm\":100,\"curve_min\":15,\"curve_max\":50,"
+      "\"slew_pct_per_sec\":10,\"failsafe_temp\":80,\"failsafe_pwm\":100,\"manual_pwm\":50}";
+  mqtt.publish(config_topic, reinterpret_cast<const uint8_t *>(config_snapshot), strlen(config_snapshot), true);
+
+  FtTelemetryPublisher pub;
+  pub.configure(opts);
+
+  // Synthetic plant: slow load cycle plus DS18B20-like 0.5 C quantization and a slew-limited fan.
+  std::mt19937 rng(42);
+  std::normal_distribution<float> noise(0.0f, 0.15f);
+  float pwm = 30.0f;
+  const uint64_t total_ticks = static_cast<uint64_t>(duration_s * 1000.0 / tick_ms);
+  auto next_tick = std::chrono::steady_clock::now();
+
+  for (uint64_t tick = 0; tick < total_ticks && !g_stop; tick++) {
+    const uint32_t now_ms = static_cast<uint32_t>(tick * tick_ms);
+    const float phase = static_cast<float>(now_ms) / 60000.0f * 6.2831853f;
+    const float temp = roundf((38.0f + 6.0f * sinf(phase) + noise(rng)) * 2.0f) / 2.0f;
+    const float target = fmaxf(22.0f, fminf(100.0f, 20.0f + (temp - 20.0f) * 2.6f));
+    const float step = 10.0f * tick_ms / 1000.0f;
+    pwm += fmaxf(-step, fminf(step, target - pwm));
+
+    FtTelemetrySample s{now_ms, temp, pwm, target, 0, false};
+    pub.on_tick(s);
+    pub.drain([&](const uint8_t *data, size_t len) { return mqtt.publish(telemetry_topic, data, len, false); });
+    if (!mqtt.service()) {
+      fprintf(stderr, "broker closed the connection\n");
+      return 1;
+    }
+
+    next_tick += std::chrono::milliseconds(tick_ms);
+    std::this_thread::sleep_until(next_tick);
+  }
+  pub.flush();
+  pub.drain([&](const uint8_t *data, size_t len) { return mqtt.publish(telemetry_topic, data, len, false); });
+
+  const FtTelemetryStats &st = pub.stats();
+  printf("ticks=%llu samples=%u messages=%u published=%u dropped=%u bytes=%llu avg_samples_per_msg=%.2f\n",
+         static_cast<unsigned long long>(total_ticks), st.samples_recorded, st.messages_encoded,
+         st.messages_published, st.messages_dropped, static_cast<unsigned long long>(mqtt.bytes_sent()),
+         st.messages_encoded ? static_cast<double>(st.samples_recorded) / st.messages_encoded : 0.0);
+  return 0;
+}
@@ -0,0 +1,40 @@
+#!/usr/bin/env sh
+# Runs the host MQTT publisher against a throwaway local mosquitto broker and
+# checks that batched telemetry and the retained config snapshot arrive.
+#
+#   host/mqtt/mosquitto_harness.sh <build-dir> [json|binary]
+set -eu
+
+BUILD_DIR=${1:?usage: mosquitto_harness.sh <build-dir> [json|binary]}
+FORMAT=${2:-json}
+PORT=${FF_MQTT_PORT:-18830}
+PREFIX=fanforge-harness
+WORK=$(mktemp -d)
+trap 'kill $BROKER_PID $SUB_PID 2>/dev/null || true; rm -rf "$WORK"' EXIT
+
+printf 'listener %s 127.0.0.1\nallow_anonymous true\npersistence false\n' "$PORT" >"$WORK/mosquitto.conf"
+mosquitto -c "$WORK/mosquitto.conf" >"$WORK/broker.log" 2>&1 &
+BROKER_PID=$!
+sleep 0.5
+
+if [ "$FORMAT" = binary ]; then SUB_FMT='%t %x'; else SUB_FMT='%t %p'; fi
+mosquitto_sub -p "$PORT" -t "$PREFIX/fanforge/telemetry" -F "$SUB_FMT" >"$WORK/telemetry.txt" &
+SUB_PID=$!
+sleep 0.2
+
+"$BUILD_DIR/ff-mqtt-pub" --broker "127.0.0.1:$PORT" --prefix "$PREFIX" --format "$FORMAT" \
+  --tick-ms 50 --duration-s 6 --batch 8 --batch-age-ms 1000
+sleep 0.3
+kill $SUB_PID 2>/dev/null || true
+
+# A late subscriber must still receive the retained config snapshot.
+CONFIG=$(mosquitto_sub -p "$PORT" -t "$PREFIX/fanforge/config" -C 1 -W 2)
+MESSAGES=$(wc -l <"$WORK/telemetry.txt")
+
+echo "telemetry messages received: $MESSAGES"
+head -n 3 "$WORK/telemetry.txt"
+echo "retained config: $CONFIG"
+
+[ "$MESSAGES" -gt 0 ] || { echo "FAIL: no telemetry received" >&2; exit 1; }
+case "$CONFIG" in *'"points"'*) ;; *) echo "FAIL: retained config missing" >&2; exit 1 ;; esac
+echo "PASS"
@@ -0,0 +1,211 @@
+// FanForge trace recorder.
+//
+// Polls a device (or the twin) once per sensor period and writes the control
+// loop's inputs as an ft_trace.h trace: the raw DS18B20 reading and any active
+// external temperature or load source from /metrics, plus a config line from
+// /api/config whenever the settings change. The result replays offline with
+// ff-replay.
+
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "ft_net.h"
+#include "ft_trace.h"
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void on_signal(int) { g_stop = true; }
+
+// Minimal field access for the flat /api/config object this firmware emits.
+const char *json_field(const std::string &body, const char *key) {
+  const std::string needle = std::string("\"") + key + "\":";
+  const size_t pos = body.find(needle);
+  return pos == std::string::npos ? nullptr : body.c_str() + pos + needle.size();
+}
+
+std::string json_scalar(const std::string &body, const char *key) {
+  const char *p = json_field(body, key);
+  if (p == nullptr) return "";
+  if (*p == '"') {
+    const char *end = strchr(p + 1, '"');
+    return end ? std::string(p + 1, end) : "";
+  }
+  const char *end = p + strcspn(p, ",}");
+  return std::string(p, end);
+}
+
+// [{"t":20,"p":20},...] -> 20:20,...
+std::string json_points(const std::string &body, const char *key) {
+  const char *p = json_field(body, key);
+  if (p == nullptr || *p != '[') return "";
+  const char *end = strchr(p, ']');
+  std::string out;
+  while (end != nullptr) {
+    const char *t = strstr(p, "\"t\":");
+    const char *v = t ? strstr(t, "\"p\":") : nullptr;
+    if (v == nullptr || v > end) break;
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%s%g:%g", out.empty() ? "" : ",", strtod(t + 4, nullptr), strtod(v + 4, nullptr));
+    out += buf;
+    p = v + 4;
+  }
+  return out;
+}
+
+std::string config_line(const std::string &body) {
+  static const char *SCALARS[] = {"mode",          "smoothing_mode", "min_pwm",     "max_pwm",  "slew_pct_per_sec",
+                                  "failsafe_temp", "failsafe_pwm",   "manual_pwm",  "temp_source", "ff_source",
+                                  "ff_blend",      "ff_decay_s"};
+  std::string line;
+  for (const char *key : SCALARS) {
+    const std::string v = json_scalar(body, key);
+    if (!v.empty()) line += std::string(line.empty() ? "" : " ") + key + "=" + v;
+  }
+  const std::string points = json_points(body, "points");
+  const std::string ff_points = json_points(body, "ff_points");
+  if (!points.empty()) line += " points=" + points;
+  if (!ff_points.empty()) line += " ff_points=" + ff_points;
+  if (json_field(body, "falling_points") != nullptr) {
+    const std::string falling = json_points(body, "falling_points");
+    line += " falling_points=" + (falling.empty() ? std::string("none") : falling);
+  }
+  return line;
+}
+
+// UDP virtual source ids are one byte.
+constexpr unsigned MAX_SENSOR_ID = 256;
+
+struct MetricsSample {
+  float raw_temp = NAN;
+  bool external = false;
+  float source_value[MAX_SENSOR_ID][2];
+  float source_age[MAX_SENSOR_ID][2];
+};
+
+MetricsSample parse_metrics(const std::string &body) {
+  MetricsSample m;
+  for (unsigned i = 0; i < MAX_SENSOR_ID; i++)
+    for (int k = 0; k < 2; k++) m.source_value[i][k] = m.source_age[i][k] = NAN;
+  size_t pos = 0;
+  while (pos < body.size()) {
+    size_t eol = body.find('\n', pos);
+    if (eol == std::string::npos) eol = body.size();
+    const std::string line = body.substr(pos, eol - pos);
+    pos = eol + 1;
+    const size_t sp = line.rfind(' ');
+    if (line.empty() || line[0] == '#' || sp == std::string::npos) continue;
+    const float value = strtof(line.c_str() + sp + 1, nullptr);
+    const std::string name = line.substr(0, sp);
+    if (name == "fanforge_temperature_raw_celsius") {
+      m.raw_temp = value;
+    } else if (name == "fanforge_temperature_source_external") {
+      m.external = value > 0.5f;
+    } else {
+      unsigned sensor = 0, kind = 0;
+      const bool is_value = sscanf(name.c_str(), "fanforge_virtual_source_value{sensor=\"%u\",kind=\"%u\"}", &sensor,
+                                   &kind) == 2;
+      const bool is_age = !is_value && sscanf(name.c_str(),
+                                              "fanforge_virtual_source_age_seconds{sensor=\"%u\",kind=\"%u\"}",
+                                              &sensor, &kind) == 2;
+      if ((is_value || is_age) && sensor < MAX_SENSOR_ID && kind < 2)
+        (is_value ? m.source_value : m.source_age)[sensor][kind] = value;
+    }
+  }
+  return m;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-record --target host[:port] [options]\n"
+          "  --out FILE           trace file (default stdout)\n"
+          "  --period-ms MS       poll period; match the sensor update interval (default 1000)\n"
+          "  --duration-s S       stop after S seconds; 0 = until interrupted (default 0)\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string target, out_path;
+  uint32_t period_ms = 1000;
+  double duration_s = 0.0;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+      return 2;
+    }
+    if (a == "--target") target = argv[++i];
+    else if (a == "--out") out_path = argv[++i];
+    else if (a == "--period-ms") period_ms = static_cast<uint32_t>(atoi(argv[++i]));
+    else if (a == "--duration-s") duration_s = atof(argv[++i]);
+    else {
+      usage();
+      return 2;
+    }
+  }
+  std::string host;
+  int port = 0;
+  if (target.empty() || period_ms == 0 || !ft_split_host_port(target, host, port, 80)) {
+    usage();
+    return 2;
+  }
+  FILE *out = out_path.empty() ? stdout : fopen(out_path.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "cannot write %s\n", out_path.c_str());
+    return 1;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  fprintf(out, "# fanforge-trace v1\n# recorded from %s every %u ms\n", target.c_str(), period_ms);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::string last_config;
+  unsigned temp_source = 0, ff_source = 0;
+  uint64_t samples = 0, failures = 0;
+  for (uint64_t n = 0; !g_stop; n++) {
+    const auto due = start + std::chrono::milliseconds(n * period_ms);
+    std::this_thread::sleep_until(due);
+    const uint32_t t_ms = static_cast<uint32_t>(n * period_ms);
+    if (duration_s > 0.0 && t_ms >= duration_s * 1000.0) break;
+
+    std::string config, metrics;
+    int status = 0;
+    if (!ft_http_get(host, port, "/api/config", config, status) || status != 200 ||
+        !ft_http_get(host, port, "/metrics", metrics, status) || status != 200) {
+      failures++;
+      continue;
+    }
+    const std::string line = config_line(config);
+    if (line != last_config) {
+      fprintf(out, "%u config %s\n", t_ms, line.c_str());
+      last_config = line;
+      temp_source = strtoul(json_scalar(config, "temp_source").c_str(), nullptr, 10);
+      ff_source = strtoul(json_scalar(config, "ff_source").c_str(), nullptr, 10);
+    }
+
+    const MetricsSample m = parse_metrics(metrics);
+    fprintf(out, "%u temp %g\n", t_ms, m.raw_temp);
+    const float stale_s = FT_TRACE_STALE_MS / 1000.0f;
+    if (temp_source > 0 && temp_source < MAX_SENSOR_ID && m.external && m.source_age[temp_source][0] < stale_s)
+      fprintf(out, "%u ext_temp %g\n", t_ms, m.source_value[temp_source][0]);
+    if (ff_source > 0 && ff_source < MAX_SENSOR_ID && m.source_age[ff_source][1] < stale_s)
+      fprintf(out, "%u load %g\n", t_ms, m.source_value[ff_source][1]);
+    fflush(out);
+    samples++;
+  }
+  if (out != stdout) fclose(out);
+  fprintf(stderr, "ff-record: %llu sample(s), %llu failed poll(s)\n", static_cast<unsigned long long>(samples),
+          static_cast<unsigned long long>(failures));
+  return 0;
+}
@@ -0,0 +1,312 @@
+// FanForge trace replay and regression harness.
+//
+// Replays recorded control traces (ft_trace.h, see ff-record) through
+// FtController, the loop fanforge_control_tick() runs on the device, at the
+// firmware's 200 ms tick. Each trace produces a PWM trajectory that can be
+// written out, diffed against a golden trajectory to catch behavior drift after
+// a firmware change, or scored under a candidate config (--set) to see how it
+// would have driven the fans on real production temperatures. Traces replay in
+// parallel, one per worker at a time.
+//
+// Replay is open loop: recorded temperatures do not react to the replayed PWM,
+// so scores compare fan effort and stability, not the resulting temperature.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ft_trace.h"
+
+namespace {
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Device millis() is never 0 by the first tick; the loop treats 0 as "no previous tick".
+constexpr uint32_t REPLAY_EPOCH_MS = 1000;
+
+struct Options {
+  std::vector<std::string> traces;
+  int threads = 0;
+  uint32_t tick_ms = 200;
+  std::string out_dir;
+  std::string golden_dir;
+  bool update_golden = false;
+  float tolerance = 0.01f;
+  std::string candidate;  // key=value ... applied on top of every recorded config
+};
+
+struct Row {
+  uint32_t t_ms;
+  float temp_c;
+  float pwm_pct;
+  float target_pwm_pct;
+  bool failsafe;
+};
+
+struct Result {
+  std::string name;
+  std::string error;
+  std::vector<Row> rows;
+  uint64_t wall_ns = 0;
+  double pwm_sum = 0.0, fan_power_sum = 0.0;
+  float pwm_p95 = NAN;
+  uint32_t reversals = 0, failsafe_ticks = 0;
+  // Golden comparison
+  bool compared = false;
+  uint32_t drift_ticks = 0;
+  float max_diff = 0.0f;
+  uint32_t first_drift_ms = 0;
+};
+
+std::string stem(const std::string &path) {
+  const size_t slash = path.rfind('/');
+  std::string base = slash == std::string::npos ? path : path.substr(slash + 1);
+  const size_t dot = base.rfind('.');
+  return dot == std::string::npos || dot == 0 ? base : base.substr(0, dot);
+}
+
+bool apply_config(const std::string &line, const std::string &candidate, FtControlConfig &cfg, std::string &err) {
+  return ft_trace_apply_config(line, cfg, err) && ft_trace_apply_config(candidate, cfg, err);
+}
+
+void replay(const Options &opt, const std::vector<FtTraceEvent> &events, Result &r) {
+  FtController ctl;
+  ctl.config = ft_trace_default_config();
+  if (!apply_config("", opt.candidate, ctl.config, r.error)) return;
+  if (events.empty()) return;
+
+  float local_temp = NAN, ext_temp = NAN, load = NAN;
+  uint32_t ext_t = 0, load_t = 0;
+  size_t next = 0;
+  const uint32_t end = events.back().t_ms;
+  r.rows.reserve(end / opt.tick_ms + 1);
+  for (uint32_t t = events.front().t_ms; t <= end; t += opt.tick_ms) {
+    for (; next < events.size() && events[next].t_ms <= t; next++) {
+      const FtTraceEvent &ev = events[next];
+      switch (ev.kind) {
+        case FT_TRACE_TEMP:
+          local_temp = ev.value;
+          break;
+        case FT_TRACE_EXT_TEMP:
+          ext_temp = ev.value;
+          ext_t = ev.t_ms;
+          break;
+        case FT_TRACE_LOAD:
+          load = ev.value;
+          load_t = ev.t_ms;
+          break;
+        case FT_TRACE_CONFIG:
+          if (!apply_config(ev.config, opt.candidate, ctl.config, r.error)) return;
+          break;
+      }
+    }
+
+    // Same source resolution as the device: a stale external source falls back to the DS18B20.
+    FtControlInput in;
+    in.now_ms = REPLAY_EPOCH_MS + t;
+    in.temp_external = std::isfinite(ext_temp) && t - ext_t <= FT_TRACE_STALE_MS;
+    in.temp_c = in.temp_external ? ext_temp : local_temp;
+    in.load_pct = ctl.config.ff_enabled && std::isfinite(load) && t - load_t <= FT_TRACE_STALE_MS ? load : NAN;
+    ctl.tick(in);
+
+    const FtControlState &s = ctl.state;
+    r.rows.push_back({t, s.control_temp_valid ? s.control_temp_c : NAN, s.current_pwm_pct, s.last_target_pwm_pct,
+                      s.failsafe_latched});
+    const float pwm = s.current_pwm_pct;
+    r.pwm_sum += pwm;
+    r.fan_power_sum += pwm * pwm * pwm / 1e4f;
+    if (s.failsafe_latched) r.failsafe_ticks++;
+    r.reversals = s.reversals;
+  }
+}
+
+bool write_csv(const std::string &path, const std::vector<Row> &rows) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == nullptr) return false;
+  fprintf(f, "t_ms,temp_c,pwm_pct,target_pwm_pct,failsafe\n");
+  for (const Row &row : rows)
+    fprintf(f, "%u,%.4f,%.4f,%.4f,%d\n", row.t_ms, row.temp_c, row.pwm_pct, row.target_pwm_pct, row.failsafe ? 1 : 0);
+  return fclose(f) == 0;
+}
+
+bool read_csv(const std::string &path, std::vector<Row> &rows) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == nullptr) return false;
+  char line[256];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    Row row;
+    int failsafe = 0;
+    if (sscanf(line, "%u,%f,%f,%f,%d", &row.t_ms, &row.temp_c, &row.pwm_pct, &row.target_pwm_pct, &failsafe) != 5)
+      continue;  // header
+    row.failsafe = failsafe != 0;
+    rows.push_back(row);
+  }
+  fclose(f);
+  return true;
+}
+
+void compare(const std::vector<Row> &golden, Result &r, float tolerance) {
+  r.compared = true;
+  const size_t n = std::max(golden.size(), r.rows.size());
+  for (size_t i = 0; i < n; i++) {
+    float diff;
+    uint32_t t;
+    if (i >= golden.size() || i >= r.rows.size()) {
+      diff = INFINITY;  // trajectories differ in length
+      t = i < r.rows.size() ? r.rows[i].t_ms : golden[i].t_ms;
+    } else {
+      const Row &a = golden[i];
+      const Row &b = r.rows[i];
+      t = b.t_ms;
+      diff = std::max(fabsf(a.pwm_pct - b.pwm_pct), fabsf(a.target_pwm_pct - b.target_pwm_pct));
+      if (a.t_ms != b.t_ms || a.failsafe != b.failsafe) diff = INFINITY;
+    }
+    if (diff > tolerance) {
+      if (r.drift_ticks == 0) r.first_drift_ms = t;
+      r.drift_ticks++;
+      r.max_diff = std::max(r.max_diff, diff);
+    }
+  }
+}
+
+void run_one(const Options &opt, const std::string &path, Result &r) {
+  r.name = stem(path);
+  std::vector<FtTraceEvent> events;
+  if (!ft_trace_load(path.c_str(), events, r.error)) return;
+
+  const uint64_t t0 = now_ns();
+  replay(opt, events, r);
+  r.wall_ns = now_ns() - t0;
+  if (!r.error.empty()) return;
+
+  std::vector<float> pwm;
+  pwm.reserve(r.rows.size());
+  for (const Row &row : r.rows) pwm.push_back(row.pwm_pct);
+  if (!pwm.empty()) {
+    const size_t idx = static_cast<size_t>(std::ceil(0.95 * pwm.size())) - 1;
+    std::nth_element(pwm.begin(), pwm.begin() + idx, pwm.end());
+    r.pwm_p95 = pwm[idx];
+  }
+
+  if (!opt.out_dir.empty() && !write_csv(opt.out_dir + "/" + r.name + ".csv", r.rows))
+    r.error = "cannot write " + opt.out_dir + "/" + r.name + ".csv";
+  if (opt.golden_dir.empty() || !r.error.empty()) return;
+  const std::string golden_path = opt.golden_dir + "/" + r.name + ".csv";
+  if (opt.update_golden) {
+    if (!write_csv(golden_path, r.rows)) r.error = "cannot write " + golden_path;
+    return;
+  }
+  std::vector<Row> golden;
+  if (!read_csv(golden_path, golden)) {
+    r.error = "no golden trajectory " + golden_path;
+    return;
+  }
+  compare(golden, r, opt.tolerance);
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-replay [options] TRACE...\n"
+          "  --threads N          parallel replays (default: hardware concurrency)\n"
+          "  --tick-ms MS         control tick period (default 200)\n"
+          "  --out-dir DIR        write each PWM trajectory to DIR/<trace>.csv\n"
+          "  --golden-dir DIR     diff against DIR/<trace>.csv; exit 1 on drift\n"
+          "  --update-golden      write trajectories into --golden-dir instead of diffing\n"
+          "  --tolerance PCT      allowed PWM difference per tick (default 0.01)\n"
+          "  --set 'k=v ...'      candidate config applied over the recorded one (repeatable),\n"
+          "                       /api/config names, e.g. --set 'points=20:20,35:45,50:100 slew_pct_per_sec=5'\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        usage();
+        exit(2);
+      }
+      return argv[++i];
+    };
+    if (a == "--threads") opt.threads = atoi(next());
+    else if (a == "--tick-ms") opt.tick_ms = static_cast<uint32_t>(atoi(next()));
+    else if (a == "--out-dir") opt.out_dir = next();
+    else if (a == "--golden-dir") opt.golden_dir = next();
+    else if (a == "--update-golden") opt.update_golden = true;
+    else if (a == "--tolerance") opt.tolerance = static_cast<float>(atof(next()));
+    else if (a == "--set") opt.candidate += std::string(opt.candidate.empty() ? "" : " ") + next();
+    else if (a.rfind("--", 0) == 0) {
+      usage();
+      return 2;
+    } else {
+      opt.traces.push_back(a);
+    }
+  }
+  std::string err;
+  FtControlConfig probe;
+  if (!ft_trace_apply_config(opt.candidate, probe, err)) {
+    fprintf(stderr, "--set: %s\n", err.c_str());
+    return 2;
+  }
+  if (opt.traces.empty() || opt.tick_ms == 0 || (opt.update_golden && opt.golden_dir.empty())) {
+    usage();
+    return 2;
+  }
+  if (opt.threads <= 0) opt.threads = std::max(1u, std::thread::hardware_concurrency());
+  opt.threads = std::min<int>(opt.threads, opt.traces.size());
+
+  std::vector<Result> results(opt.traces.size());
+  std::atomic<size_t> next_trace{0};
+  const uint64_t start = now_ns();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < opt.threads; t++) {
+    threads.emplace_back([&]() {
+      for (size_t i; (i = next_trace++) < opt.traces.size();) run_one(opt, opt.traces[i], results[i]);
+    });
+  }
+  for (auto &t : threads) t.join();
+  const double wall_s = (now_ns() - start) / 1e9;
+
+  printf("%-24s %9s %8s %7s %7s %8s %7s %9s  %s\n", "trace", "duration", "ticks", "pwm %", "p95 %", "fan pwr%",
+         "rev/h", "failsafe%", "golden");
+  double sim_s = 0.0;
+  int failed = 0;
+  for (const Result &r : results) {
+    if (!r.error.empty()) {
+      printf("%-24s error: %s\n", r.name.c_str(), r.error.c_str());
+      failed++;
+      continue;
+    }
+    const double n = std::max<size_t>(1, r.rows.size());
+    const double duration_s = r.rows.size() * opt.tick_ms / 1000.0;
+    sim_s += duration_s;
+    char golden[96] = "-";
+    if (opt.update_golden) {
+      snprintf(golden, sizeof(golden), "updated");
+    } else if (r.compared && r.drift_ticks == 0) {
+      snprintf(golden, sizeof(golden), "ok");
+    } else if (r.compared) {
+      snprintf(golden, sizeof(golden), "DRIFT %u tick(s) from t=%.1fs, max %.3g%%", r.drift_ticks,
+               r.first_drift_ms / 1000.0, r.max_diff);
+      failed++;
+    }
+    printf("%-24s %8.0fs %8zu %7.2f %7.2f %8.2f %7.1f %9.3f  %s\n", r.name.c_str(), duration_s, r.rows.size(),
+           r.pwm_sum / n, r.pwm_p95, r.fan_power_sum / n, duration_s > 0 ? r.reversals / (duration_s / 3600.0) : 0.0,
+           100.0 * r.failsafe_ticks / n, golden);
+  }
+  printf("%zu trace(s), %.1f h replayed in %.3f s on %d thread(s) (%.0fx real time)\n", results.size(),
+         sim_s / 3600.0, wall_s, opt.threads, sim_s / std::max(wall_s, 1e-9));
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+// FanForge control trace: the inputs one device's control loop saw over time,
+// as recorded by ff-record and replayed by ff-replay.
+//
+// Text, one event per line, timestamps in ms from the start of the recording:
+//
+//   # fanforge-trace v1
+//   0 config mode=auto smoothing_mode=smooth points=20:20,30:30,40:55,50:100 min_pwm=22 ...
+//   0 temp 31.5          local DS18B20 reading (nan when the sensor has none)
+//   0 ext_temp 42.25     external temperature source (UDP ingest), stale after 2 s
+//   0 load 63            feed-forward load sample (%), stale after 2 s
+//
+// Config lines carry /api/config field names; a line may set any subset of
+// them. Curves are written as t:p pairs (falling_points=none when cleared).
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "fanforge_control.h"
+
+static constexpr uint32_t FT_TRACE_STALE_MS = 2000;  // FT_VSRC_DEFAULT_STALE_MS on the device
+
+enum FtTraceKind {
+  FT_TRACE_TEMP = 0,
+  FT_TRACE_EXT_TEMP,
+  FT_TRACE_LOAD,
+  FT_TRACE_CONFIG,
+};
+
+struct FtTraceEvent {
+  uint32_t t_ms = 0;
+  FtTraceKind kind = FT_TRACE_TEMP;
+  float value = NAN;
+  std::string config;  // key=value ... for FT_TRACE_CONFIG
+};
+
+static inline bool ft_trace_parse_points(const std::string &spec, FtCurve &curve) {
+  FtPoint pts[FT_MAX_POINTS];
+  int n = 0;
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    size_t comma = spec.find(',', pos);
+    if (comma == std::string::npos) comma = spec.size();
+    const std::string item = spec.substr(pos, comma - pos);
+    pos = comma + 1;
+    const size_t colon = item.find(':');
+    if (colon == std::string::npos || n >= FT_MAX_POINTS) return false;
+    pts[n].t = strtof(item.c_str(), nullptr);
+    pts[n].p = strtof(item.c_str() + colon + 1, nullptr);
+    n++;
+  }
+  curve.set(pts, n);
+  return true;
+}
+
+static inline std::string ft_trace_format_points(const FtCurve &curve) {
+  std::string out;
+  char buf[32];
+  for (int i = 0; i < curve.n; i++) {
+    snprintf(buf, sizeof(buf), "%s%g:%g", i ? "," : "", curve.pts[i].t, curve.pts[i].p);
+    out += buf;
+  }
+  return out;
+}
+
+// Applies one key=value ... config line to cfg. Unknown keys are an error so that
+// typos in hand-written candidate configs do not pass silently.
+static inline bool ft_trace_apply_config(const std::string &line, FtControlConfig &cfg, std::string &err) {
+  size_t pos = 0;
+  while (pos < line.size()) {
+    while (pos < line.size() && line[pos] == ' ') pos++;
+    if (pos >= line.size()) break;
+    size_t end = line.find(' ', pos);
+    if (end == std::string::npos) end = line.size();
+    const std::string item = line.substr(pos, end - pos);
+    pos = end;
+    const size_t eq = item.find('=');
+    if (eq == std::string::npos) {
+      err = "expected key=value: " + item;
+      return false;
+    }
+    const std::string key = item.substr(0, eq);
+    const std::string value = item.substr(eq + 1);
+    const float f = strtof(value.c_str(), nullptr);
+    bool ok = true;
+    if (key == "mode") {
+      cfg.mode = value == "manual" ? FT_MODE_MANUAL : (value == "off" ? FT_MODE_OFF : FT_MODE_AUTO);
+    } else if (key == "smoothing_mode") {
+      cfg.curve.smooth = cfg.falling_curve.smooth = value != "linear";
+    } else if (key == "points") {
+      const bool smooth = cfg.curve.smooth;
+      ok = ft_trace_parse_points(value, cfg.curve) && cfg.curve.n >= 2;
+      cfg.curve.smooth = smooth;
+    } else if (key == "ff_points") {
+      ok = ft_trace_parse_points(value, cfg.ff_curve);
+    } else if (key == "falling_points") {
+      // "none" clears it, like an empty falling_points array.
+      const bool smooth = cfg.falling_curve.smooth;
+      if (value == "none")
+        cfg.falling_curve.set(nullptr, 0);
+      else
+        ok = ft_trace_parse_points(value, cfg.falling_curve) && cfg.falling_curve.n >= 2;
+      cfg.falling_curve.smooth = smooth;
+    } else if (key == "min_pwm") {
+      cfg.min_pwm = f;
+    } else if (key == "max_pwm") {
+      cfg.max_pwm = f;
+    } else if (key == "slew_pct_per_sec") {
+      cfg.slew_pct_per_sec = f;
+    } else if (key == "failsafe_temp") {
+      cfg.failsafe_temp = f;
+    } else if (key == "failsafe_pwm") {
+      cfg.failsafe_pwm = f;
+    } else if (key == "manual_pwm") {
+      cfg.manual_pwm = f;
+    } else if (key == "ff_source") {
+      cfg.ff_enabled = f > 0.0f;
+    } else if (key == "ff_blend") {
+      cfg.ff_blend = value == "add" ? 1 : 0;
+    } else if (key == "ff_decay_s") {
+      cfg.ff_decay_s = f;
+    } else if (key == "temp_source" || key == "curve_min" || key == "curve_max") {
+      // Source selection is already resolved in the recorded events; curve_min/max are UI-only.
+    } else {
+      err = "unknown config key: " + key;
+      return false;
+    }
+    if (!ok) {
+      err = "bad value for " + key + ": " + value;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Firmware defaults (the YAML globals' initial values).
+static inline FtControlConfig ft_trace_default_config() {
+  FtControlConfig cfg;
+  std::string err;
+  ft_trace_apply_config("mode=auto smoothing_mode=smooth points=20:20,30:30,40:55,50:100 min_pwm=22 max_pwm=100 "
+                        "slew_pct_per_sec=10 failsafe_temp=80 failsafe_pwm=100 manual_pwm=50 ff_source=0 "
+                        "ff_blend=max ff_decay_s=10 ff_points=0:0,100:40",
+                        cfg, err);
+  return cfg;
+}
+
+static inline bool ft_trace_load(const char *path, std::vector<FtTraceEvent> &out, std::string &err) {
+  FILE *f = fopen(path, "r");
+  if (f == nullptr) {
+    err = std::string("cannot open ") + path;
+    return false;
+  }
+  char line[2048];
+  int lineno = 0;
+  uint32_t last_t = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f) != nullptr) {
+    lineno++;
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+    if (len == 0 || line[0] == '#') continue;
+
+    char *p = line;
+    FtTraceEvent ev;
+    ev.t_ms = static_cast<uint32_t>(strtoul(p, &p, 10));
+    while (*p == ' ') p++;
+    char *kind = p;
+    while (*p && *p != ' ') p++;
+    const std::string k(kind, p - kind);
+    while (*p == ' ') p++;
+    if (k == "temp" || k == "ext_temp" || k == "load") {
+      ev.kind = k == "temp" ? FT_TRACE_TEMP : (k == "ext_temp" ? FT_TRACE_EXT_TEMP : FT_TRACE_LOAD);
+      ev.value = strtof(p, nullptr);
+    } else if (k == "config") {
+      ev.kind = FT_TRACE_CONFIG;
+      ev.config = p;
+      FtControlConfig probe;
+      ok = ft_trace_apply_config(ev.config, probe, err);
+    } else {
+      err = "unknown event '" + k + "'";
+      ok = false;
+    }
+    if (ok && ev.t_ms < last_t) {
+      err = "timestamps go backwards";
+      ok = false;
+    }
+    if (!ok) {
+      err = std::string(path) + ":" + std::to_string(lineno) + ": " + err;
+      break;
+    }
+    last_t = ev.t_ms;
+    out.push_back(std::move(ev));
+  }
+  fclose(f);
+  return ok;
+}
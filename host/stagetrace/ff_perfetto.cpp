@@ -0,0 +1,265 @@
+// FanForge stage trace -> Perfetto / Chrome trace JSON.
+//
+// Reads a /api/trace dump (fanforge_stagetrace.h), from a file or straight
+// from a device, and writes Trace Event Format JSON that ui.perfetto.dev and
+// chrome://tracing open directly:
+//   - "control tick" track: one slice per tick with nested slices per stage
+//     (deadband, curve, feedforward, window, failsafe, slew) sized by their
+//     measured cost, args carrying every intermediate value and flag;
+//   - counter tracks for temperature (raw/control), PWM per stage and tick
+//     interval;
+//   - instant events where failsafe latches/releases, ticks run late, AUTO
+//     loses its temperature, and where the trigger fired.
+// Timestamps are device time relative to the oldest tick in the dump.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "fanforge_stagetrace.h"
+#include "ft_net.h"
+
+namespace {
+
+const char *const STAGE_NAMES[FT_STAGE_COUNT] = {"deadband", "rules",    "curve", "feedforward",
+                                                 "window",   "failsafe", "slew"};
+const char *const MODE_NAMES[] = {"auto", "manual", "off"};
+
+struct Flag {
+  uint8_t bit;
+  const char *name;
+};
+const Flag FLAGS[] = {
+    {FT_STAGE_F_EXTERNAL, "external"},
+    {FT_STAGE_F_DEADBAND_HELD, "deadband_held"},
+    {FT_STAGE_F_FAILSAFE, "failsafe"},
+    {FT_STAGE_F_NO_TEMP, "no_temp"},
+    {FT_STAGE_F_WINDOW_CLAMPED, "window_clamped"},
+    {FT_STAGE_F_SLEW_LIMITED, "slew_limited"},
+    {FT_STAGE_F_LATE, "late"},
+    {FT_STAGE_F_TRIGGER, "trigger"},
+};
+
+class JsonOut {
+ public:
+  explicit JsonOut(FILE *f) : f_(f) { fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f_); }
+  ~JsonOut() { fputs("\n]}\n", f_); }
+
+  // Starts an event object; the caller appends fields and calls end().
+  void begin(const char *ph, const char *name, double ts_us, int tid) {
+    fprintf(this->f_, "%s{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", this->first_ ? "" : ",\n",
+            ph, name, tid, ts_us);
+    this->first_ = false;
+  }
+  void raw(const char *s) { fputs(s, this->f_); }
+  void num(const char *key, double v) {
+    // JSON has no NaN; absent values are omitted.
+    if (std::isfinite(v)) fprintf(this->f_, ",\"%s\":%.4g", key, v);
+  }
+  // Member of an args object; `first` tracks whether a separator is needed.
+  void arg(const char *key, double v, bool &first) {
+    if (!std::isfinite(v)) return;
+    fprintf(this->f_, "%s\"%s\":%.4g", first ? "" : ",", key, v);
+    first = false;
+  }
+  void str(const char *key, const char *v) { fprintf(this->f_, ",\"%s\":\"%s\"", key, v); }
+  void end() { fputc('}', this->f_); }
+
+ private:
+  FILE *f_;
+  bool first_ = true;
+};
+
+constexpr int TID_TICK = 1;
+constexpr int TID_EVENTS = 2;
+
+void emit_counter(JsonOut &out, const char *name, double ts, const char *k1, double v1, const char *k2 = nullptr,
+                  double v2 = NAN) {
+  if (!std::isfinite(v1) && !std::isfinite(v2)) return;
+  out.begin("C", name, ts, TID_TICK);
+  out.raw(",\"args\":{");
+  bool first = true;
+  out.arg(k1, v1, first);
+  if (k2) out.arg(k2, v2, first);
+  out.raw("}");
+  out.end();
+}
+
+void emit_instant(JsonOut &out, const char *name, double ts, bool global) {
+  out.begin("i", name, ts, TID_EVENTS);
+  out.str("s", global ? "g" : "t");
+  out.end();
+}
+
+bool load(const std::string &data, FtStageTraceHeader &h, std::vector<FtStageRecord> &recs, std::string &err) {
+  if (data.size() < sizeof(h)) {
+    err = "dump too short";
+    return false;
+  }
+  memcpy(&h, data.data(), sizeof(h));
+  if (memcmp(h.magic, "FFST", 4) != 0 || h.version != FT_STAGE_TRACE_VERSION) {
+    err = "not a FanForge stage trace (or unsupported version)";
+    return false;
+  }
+  if (h.record_size != sizeof(FtStageRecord) || data.size() < sizeof(h) + h.count * sizeof(FtStageRecord)) {
+    err = "record size mismatch or truncated dump";
+    return false;
+  }
+  recs.resize(h.count);
+  if (h.count > 0) memcpy(recs.data(), data.data() + sizeof(h), h.count * sizeof(FtStageRecord));
+  return true;
+}
+
+void convert(const FtStageTraceHeader &h, const std::vector<FtStageRecord> &recs, FILE *f) {
+  JsonOut out(f);
+  const double cycles_per_us = h.cycles_per_us > 0 ? h.cycles_per_us : 1.0;
+  out.begin("M", "process_name", 0, TID_TICK);
+  out.raw(",\"args\":{\"name\":\"fanforge controller\"}");
+  out.end();
+  out.begin("M", "thread_name", 0, TID_TICK);
+  out.raw(",\"args\":{\"name\":\"control tick\"}");
+  out.end();
+  out.begin("M", "thread_name", 0, TID_EVENTS);
+  out.raw(",\"args\":{\"name\":\"events\"}");
+  out.end();
+  if (recs.empty()) return;
+
+  const uint32_t t0 = recs.front().t_ms;
+  uint8_t prev_flags = 0;
+  for (size_t i = 0; i < recs.size(); i++) {
+    const FtStageRecord &r = recs[i];
+    const double ts = (r.t_ms - t0) * 1000.0;
+
+    double stage_us[FT_STAGE_COUNT];
+    double stages_total = 0.0;
+    for (int s = 0; s < FT_STAGE_COUNT; s++) {
+      stage_us[s] = r.stage_cycles[s] / cycles_per_us;
+      stages_total += stage_us[s];
+    }
+    out.begin("X", "tick", ts, TID_TICK);
+    out.num("dur", std::max<double>(r.tick_us, stages_total));
+    out.raw(",\"args\":{");
+    fprintf(f, "\"mode\":\"%s\",\"interval_ms\":%u,\"tick_us\":%u", r.mode < 3 ? MODE_NAMES[r.mode] : "?",
+            r.interval_ms, r.tick_us);
+    out.num("raw_temp_c", r.raw_temp_c);
+    out.num("control_temp_c", r.control_temp_c);
+    out.num("curve_pwm", r.curve_pwm);
+    out.num("ff_pwm", r.ff_pwm);
+    out.num("window_pwm", r.window_pwm);
+    out.num("target_pwm", r.target_pwm);
+    out.num("output_pwm", r.output_pwm);
+    out.raw(",\"flags\":\"");
+    bool any = false;
+    for (const Flag &fl : FLAGS) {
+      if (r.flags & fl.bit) {
+        fprintf(f, "%s%s", any ? "," : "", fl.name);
+        any = true;
+      }
+    }
+    out.raw("\"}");
+    out.end();
+
+    double stage_ts = ts;
+    for (int s = 0; s < FT_STAGE_COUNT; s++) {
+      if (r.stage_cycles[s] == 0) continue;
+      out.begin("X", STAGE_NAMES[s], stage_ts, TID_TICK);
+      out.num("dur", stage_us[s]);
+      fprintf(f, ",\"args\":{\"cycles\":%u}", r.stage_cycles[s]);
+      out.end();
+      stage_ts += stage_us[s];
+    }
+
+    emit_counter(out, "temperature C", ts, "raw", r.raw_temp_c, "control", r.control_temp_c);
+    emit_counter(out, "curve/window PWM %", ts, "curve", r.curve_pwm, "window", r.window_pwm);
+    emit_counter(out, "target/output PWM %", ts, "target", r.target_pwm, "output", r.output_pwm);
+    emit_counter(out, "feedforward PWM %", ts, "ff", r.ff_pwm);
+    emit_counter(out, "tick interval ms", ts, "interval", r.interval_ms);
+
+    const uint8_t rose = r.flags & ~prev_flags;
+    const uint8_t fell = prev_flags & ~r.flags;
+    if (rose & FT_STAGE_F_FAILSAFE) emit_instant(out, "failsafe latched", ts, false);
+    if (fell & FT_STAGE_F_FAILSAFE) emit_instant(out, "failsafe released", ts, false);
+    if (rose & FT_STAGE_F_NO_TEMP) emit_instant(out, "temperature lost", ts, false);
+    if (fell & FT_STAGE_F_NO_TEMP) emit_instant(out, "temperature back", ts, false);
+    if (r.flags & FT_STAGE_F_LATE) emit_instant(out, "late tick", ts, false);
+    if (i == h.trigger_index) emit_instant(out, "trace trigger", ts, true);
+    prev_flags = r.flags;
+  }
+}
+
+bool read_file(const char *path, std::string &out) {
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) return false;
+  char buf[8192];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-perfetto (--target host[:port] | DUMP) [--out FILE]\n"
+          "  DUMP                 file saved from GET /api/trace\n"
+          "  --target host[:port] download /api/trace from the device\n"
+          "  --out FILE           JSON output (default stdout); open in ui.perfetto.dev\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string target, in_path, out_path;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--target" && i + 1 < argc) target = argv[++i];
+    else if (a == "--out" && i + 1 < argc) out_path = argv[++i];
+    else if (a.rfind("--", 0) != 0 && in_path.empty()) in_path = a;
+    else {
+      usage();
+      return 2;
+    }
+  }
+  if (target.empty() == in_path.empty()) {
+    usage();
+    return 2;
+  }
+
+  std::string data;
+  if (!target.empty()) {
+    std::string host;
+    int port = 0, status = 0;
+    if (!ft_split_host_port(target, host, port, 80) || !ft_http_get(host, port, "/api/trace", data, status) ||
+        status != 200) {
+      fprintf(stderr, "cannot download /api/trace from %s\n", target.c_str());
+      return 1;
+    }
+  } else if (!read_file(in_path.c_str(), data)) {
+    fprintf(stderr, "cannot read %s\n", in_path.c_str());
+    return 1;
+  }
+
+  FtStageTraceHeader h;
+  std::vector<FtStageRecord> recs;
+  std::string err;
+  if (!load(data, h, recs, err)) {
+    fprintf(stderr, "%s\n", err.c_str());
+    return 1;
+  }
+  FILE *f = out_path.empty() ? stdout : fopen(out_path.c_str(), "w");
+  if (f == nullptr) {
+    fprintf(stderr, "cannot write %s\n", out_path.c_str());
+    return 1;
+  }
+  convert(h, recs, f);
+  if (f != stdout) fclose(f);
+
+  static const char *const TRIGGERS[] = {"none", "failsafe", "late", "failsafe+late", "manual"};
+  fprintf(stderr, "%u tick(s), %s, trigger %s%s\n", h.count, h.frozen ? "frozen" : "live",
+          h.trigger <= 4 ? TRIGGERS[h.trigger] : "?",
+          h.trigger_index != 0xFFFF ? (" at tick " + std::to_string(h.trigger_index)).c_str() : "");
+  return 0;
+}
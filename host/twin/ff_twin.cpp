@@ -0,0 +1,371 @@
+// FanForge Linux digital twin.
+//
+// Serves the real FanForgeApiHandler (fanforge_api.h) over HTTP/1.1 with the
+// real control tick driving a simulated enclosure (ft_thermal_sim.h). ESPHome
+// is replaced by the shim headers in host/twin/shim and the YAML globals are
+// generated from fanforge-controller.yaml, so the twin runs the firmware's
+// code paths unmodified. Point the UI's apiBase at http://localhost:<port>.
+//
+// --devices N forks N independent devices on consecutive ports.
+// --flash-file keeps the history partition in a file across restarts.
+// --rack-group joins rack coordination over loopback multicast, so several
+// twins (or the devices of one) can run their curves on a shared aggregate.
+
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esphome.h"
+#include "ft_twin_globals.h"
+#include "fanforge_api.h"
+#include "ft_http_server.h"
+#include "ft_thermal_sim.h"
+
+namespace esphome {
+namespace web_server_base {
+WebServerBase *global_web_server_base = nullptr;
+}  // namespace web_server_base
+}  // namespace esphome
+
+namespace {
+
+using esphome::web_server_idf::AsyncWebHandler;
+using esphome::web_server_idf::AsyncWebServerRequest;
+using esphome::web_server_idf::AsyncWebServerResponse;
+
+constexpr uint32_t TICK_MS = 200;          // interval: in fanforge-controller.yaml
+constexpr uint32_t SENSOR_PERIOD_MS = 1000;  // dallas_temp update_interval
+
+std::chrono::steady_clock::time_point g_start = std::chrono::steady_clock::now();
+double g_speedup = 1.0;
+int g_device = 0;
+bool g_quiet = false;
+
+struct TwinState {
+  FtThermalSim *sim = nullptr;
+  FtHttpServer *server = nullptr;
+  uint32_t last_step_ms = 0;
+  uint32_t last_sensor_ms = 0;
+  uint64_t ticks = 0;
+};
+TwinState g_twin;
+
+float output_pwm_pct() {
+  const float level = id(fan_pwm_output).level;
+  return (FT_PWM_INVERTED ? 1.0f - level : level) * 100.0f;
+}
+
+// One 200 ms interval: advance the plant to "now", refresh the sensor on its
+// own cadence, then run the firmware tick exactly as the YAML interval does.
+void twin_tick() {
+  const uint32_t now = millis();
+  g_twin.sim->step((now - g_twin.last_step_ms) / 1000.0f, output_pwm_pct());
+  g_twin.last_step_ms = now;
+  if (now - g_twin.last_sensor_ms >= SENSOR_PERIOD_MS) {
+    id(temp_c).publish_state(g_twin.sim->read_sensor());
+    fanforge_sensor_event();  // on_value in fanforge-controller.yaml
+    g_twin.last_sensor_ms = now;
+  }
+  fanforge_control_tick();
+  g_twin.ticks++;
+}
+
+// Twin-only routes for steering and observing the simulated plant.
+class FtTwinHandler : public AsyncWebHandler {
+ public:
+  bool canHandle(AsyncWebServerRequest *request) const override {
+    const std::string url = request->url();
+    return url == "/twin/state" || url == "/twin/heat";
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    const std::string url = request->url();
+    if (url == "/twin/heat") {
+      if (request->method() != HTTP_POST) {
+        request->send(405, "application/json", "{\"error\":\"POST only\"}");
+        return;
+      }
+      // ?w=<watts> pins the heat input; no w returns to the configured profile.
+      float w = NAN;
+      if (request->hasArg("w")) {
+        char *end = nullptr;
+        const std::string arg = request->arg("w");
+        w = strtof(arg.c_str(), &end);
+        if (end == arg.c_str() || !std::isfinite(w) || w < 0.0f) {
+          request->send(400, "application/json", "{\"error\":\"w must be a non-negative number\"}");
+          return;
+        }
+      }
+      g_twin.sim->set_heat_override(w);
+    }
+
+    const FtThermalSim &sim = *g_twin.sim;
+    const FtHttpServerStats &hs = g_twin.server->stats();
+    char body[512];
+    snprintf(body, sizeof(body),
+             "{\"device\":%d,\"sim_time_s\":%.1f,\"speedup\":%g,\"ticks\":%llu,\"temp_c\":%.3f,"
+             "\"sensor_c\":%.1f,\"ambient_c\":%.1f,\"heat_w\":%.2f,\"fan_pwm_pct\":%.2f,"
+             "\"http\":{\"connections\":%llu,\"requests\":%llu,\"bad_requests\":%llu}}",
+             g_device, sim.time_s(), g_speedup, static_cast<unsigned long long>(g_twin.ticks), sim.temp_c(),
+             id(temp_c).state, sim.params().ambient_c, sim.heat_w(), sim.pwm_pct(),
+             static_cast<unsigned long long>(hs.connections), static_cast<unsigned long long>(hs.requests),
+             static_cast<unsigned long long>(hs.bad_requests));
+    request->send(200, "application/json", body);
+  }
+};
+
+// Hands a parsed request to the registered handlers, as web_server_idf does.
+void dispatch(const FtTwinHttpRequest &in, FtHttpReply &out) {
+  AsyncWebServerRequest request(in, [&out](const AsyncWebServerResponse &res) {
+    out.code = res.code();
+    out.content_type = res.content_type();
+    out.headers = res.headers();
+    out.body.assign(res.get_content_data(), res.get_content_size());
+  });
+  bool handled = false;
+  for (AsyncWebHandler *h : global_web_server_base->get_handlers()) {
+    if (h->canHandle(&request)) {
+      h->handleRequest(&request);
+      handled = true;
+      break;
+    }
+  }
+  if (!handled) {
+    out.code = 404;
+    out.content_type = "text/plain";
+    out.body = "Not Found";
+  } else if (!request.sent()) {
+    out.code = 500;
+    out.content_type = "text/plain";
+    out.body = "handler did not respond";
+  }
+  // ESPHome's web_server adds this default header to every response built through
+  // web_server_idf; raw httpd responses (admission rejections) set their own.
+  const bool has_origin = std::any_of(out.headers.begin(), out.headers.end(),
+                                      [](const auto &h) { return h.first == "Access-Control-Allow-Origin"; });
+  if (!has_origin) out.headers.emplace_back("Access-Control-Allow-Origin", "*");
+}
+
+struct Options {
+  std::string bind = "127.0.0.1";
+  int port = 8081;
+  int devices = 1;
+  double speedup = 1.0;
+  FtThermalParams plant;
+  FtHeatProfile profile = FT_HEAT_STEADY;
+  int udp_port = 0;
+  std::string udp_key;
+  std::string rack_group;
+  int rack_port = FT_RACK_DEFAULT_PORT;
+  std::string flash_file;
+};
+
+int run_device(const Options &opt, int index) {
+  g_device = index;
+  g_start = std::chrono::steady_clock::now();
+
+  // Devices after the first get a slightly different room and load so a fleet
+  // does not move in lockstep.
+  FtThermalParams plant = opt.plant;
+  if (index > 0) {
+    std::mt19937 rng(static_cast<uint32_t>(index));
+    plant.ambient_c += std::uniform_real_distribution<float>(-2.0f, 2.0f)(rng);
+    plant.heat_w *= std::uniform_real_distribution<float>(0.8f, 1.2f)(rng);
+  }
+  FtThermalSim sim(plant, static_cast<uint32_t>(index + 1));
+  sim.set_profile(opt.profile);
+
+  FtHttpServer server;
+  if (!server.listen(opt.bind, opt.port + index)) {
+    fprintf(stderr, "ff-twin[%d]: cannot listen on %s:%d\n", index, opt.bind.c_str(), opt.port + index);
+    return 1;
+  }
+  g_twin.sim = &sim;
+  g_twin.server = &server;
+
+  if (!opt.flash_file.empty()) {
+    const std::string path = opt.devices > 1 ? opt.flash_file + "." + std::to_string(index) : opt.flash_file;
+    if (!ft_twin_flash_open(path.c_str())) {
+      fprintf(stderr, "ff-twin[%d]: cannot open flash file %s\n", index, path.c_str());
+      return 1;
+    }
+  }
+
+  esphome::web_server_base::WebServerBase web;
+  global_web_server_base = &web;
+  // Same boot sequence as on_boot in fanforge-controller.yaml.
+  fanforge_api_init();
+  if (opt.udp_port > 0) fanforge_udp_ingest_begin(static_cast<uint16_t>(opt.udp_port + index), opt.udp_key.c_str());
+  // The HTTP port doubles as the rack unit id: unique among twins on one host.
+  if (!opt.rack_group.empty())
+    fanforge_rack_begin(opt.rack_group.c_str(), static_cast<uint16_t>(opt.rack_port), opt.udp_key.c_str(),
+                        static_cast<uint16_t>(server.port()), opt.bind == "0.0.0.0" ? nullptr : opt.bind.c_str());
+  web.add_handler(new FtTwinHandler());
+  server.set_dispatch(dispatch);
+
+  int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  const long period_ns = static_cast<long>(TICK_MS * 1e6 / opt.speedup);
+  itimerspec its{};
+  its.it_interval.tv_sec = period_ns / 1000000000L;
+  its.it_interval.tv_nsec = period_ns % 1000000000L;
+  its.it_value = its.it_interval;
+  timerfd_settime(tfd, 0, &its, nullptr);
+  // Missed intervals collapse into one tick, as ESPHome's scheduler does.
+  server.watch(tfd, [tfd]() {
+    uint64_t expirations = 0;
+    if (read(tfd, &expirations, sizeof(expirations)) == sizeof(expirations)) twin_tick();
+  });
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+  bool running = true;
+  server.watch(sfd, [&running]() { running = false; });
+
+  if (!g_quiet || index == 0)
+    fprintf(stderr, "ff-twin[%d]: http://%s:%d (%.1f W, %.1f C ambient, x%g)\n", index, opt.bind.c_str(),
+            server.port(), plant.heat_w, plant.ambient_c, opt.speedup);
+
+  twin_tick();
+  while (running) server.poll(-1);
+  // on_shutdown in fanforge-controller.yaml.
+  fanforge_history_flush();
+  close(tfd);
+  close(sfd);
+  return 0;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: ff-twin [options]\n"
+          "  --port N             HTTP port of the first device (default 8081)\n"
+          "  --bind ADDR          listen address (default 127.0.0.1)\n"
+          "  --devices N          simulated devices on consecutive ports (default 1)\n"
+          "  --speedup X          simulated seconds per wall second (default 1)\n"
+          "  --ambient C          room temperature (default 25)\n"
+          "  --heat-w W           heat load (default 30)\n"
+          "  --profile P          heat profile: steady | bursty | sine (default steady)\n"
+          "  --udp-ingest-port N  enable UDP ingest on N (+device index); needs --udp-key\n"
+          "  --udp-key HEX        32 hex chars, as udp_ingest_key (also keys rack summaries)\n"
+          "  --rack-group ADDR    join rack coordination on multicast group ADDR; needs --udp-key\n"
+          "  --rack-port N        rack multicast port (default 47809)\n"
+          "  --flash-file PATH    keep the history partition in PATH (.N per device with --devices)\n"
+          "  --quiet              only log warnings and errors\n"
+          "Twin-only routes: GET /twin/state, POST /twin/heat?w=<watts> (no w: back to profile).\n");
+}
+
+}  // namespace
+
+// Scaled device clock; both wrap like the ESP32 counters they stand in for.
+static double ft_twin_elapsed_us() {
+  const auto real = std::chrono::steady_clock::now() - g_start;
+  return std::chrono::duration<double, std::micro>(real).count() * g_speedup;
+}
+
+uint32_t ft_twin_clock_us() { return static_cast<uint32_t>(static_cast<uint64_t>(ft_twin_elapsed_us())); }
+
+uint32_t ft_twin_clock_ms() { return static_cast<uint32_t>(static_cast<uint64_t>(ft_twin_elapsed_us() / 1000.0)); }
+
+void ft_twin_log(char level, const char *tag, const char *fmt, ...) {
+  if (g_quiet && level == 'I') return;
+  char msg[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, args);
+  va_end(args);
+  fprintf(stderr, "[%c][%s] dev%d: %s\n", level, tag, g_device, msg);
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        usage();
+        exit(2);
+      }
+      return argv[++i];
+    };
+    if (a == "--port") opt.port = atoi(next());
+    else if (a == "--bind") opt.bind = next();
+    else if (a == "--devices") opt.devices = atoi(next());
+    else if (a == "--speedup") opt.speedup = atof(next());
+    else if (a == "--ambient") opt.plant.ambient_c = static_cast<float>(atof(next()));
+    else if (a == "--heat-w") opt.plant.heat_w = static_cast<float>(atof(next()));
+    else if (a == "--profile") {
+      if (!ft_parse_heat_profile(next(), opt.profile)) {
+        usage();
+        return 2;
+      }
+    } else if (a == "--udp-ingest-port") opt.udp_port = atoi(next());
+    else if (a == "--udp-key") opt.udp_key = next();
+    else if (a == "--rack-group") opt.rack_group = next();
+    else if (a == "--rack-port") opt.rack_port = atoi(next());
+    else if (a == "--flash-file") opt.flash_file = next();
+    else if (a == "--quiet") g_quiet = true;
+    else {
+      usage();
+      return 2;
+    }
+  }
+  if (opt.port < 0 || opt.devices < 1 || opt.port + opt.devices > 65536 || opt.speedup <= 0.0 ||
+      opt.speedup > 1000.0 || opt.rack_port <= 0 || opt.rack_port > 65535) {
+    usage();
+    return 2;
+  }
+  g_speedup = opt.speedup;
+
+  // Children inherit the blocked mask and turn the signals into events.
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  if (opt.devices == 1) return run_device(opt, 0);
+
+  std::vector<pid_t> children;
+  for (int i = 0; i < opt.devices; i++) {
+    pid_t pid = fork();
+    if (pid == 0) _exit(run_device(opt, i));
+    if (pid < 0) {
+      fprintf(stderr, "ff-twin: fork failed after %d devices\n", i);
+      break;
+    }
+    children.push_back(pid);
+  }
+  fprintf(stderr, "ff-twin: %zu devices on ports %d-%d\n", children.size(), opt.port,
+          opt.port + static_cast<int>(children.size()) - 1);
+
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  size_t alive = children.size();
+  bool stopping = false;
+  while (alive > 0) {
+    siginfo_t info;
+    if (sigwaitinfo(&mask, &info) < 0) continue;
+    if (info.si_signo == SIGCHLD) {
+      while (waitpid(-1, nullptr, WNOHANG) > 0) alive--;
+      if (stopping) continue;
+    }
+    // Any signal or an unexpected child exit stops the whole fleet.
+    stopping = true;
+    for (pid_t pid : children) kill(pid, SIGTERM);
+  }
+  return 0;
+}
@@ -0,0 +1,407 @@
+#include "ft_http_server.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+const char *status_text(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 406: return "Not Acceptable";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "Status";
+  }
+}
+
+bool parse_method(const std::string &m, http_method &out) {
+  if (m == "GET") out = HTTP_GET;
+  else if (m == "POST") out = HTTP_POST;
+  else if (m == "OPTIONS") out = HTTP_OPTIONS;
+  else if (m == "HEAD") out = HTTP_HEAD;
+  else if (m == "PUT") out = HTTP_PUT;
+  else if (m == "DELETE") out = HTTP_DELETE;
+  else return false;
+  return true;
+}
+
+std::string trim(const std::string &s) {
+  size_t b = s.find_first_not_of(" \t");
+  if (b == std::string::npos) return "";
+  size_t e = s.find_last_not_of(" \t\r");
+  return s.substr(b, e - b + 1);
+}
+
+std::string lower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+  return s;
+}
+
+}  // namespace
+
+FtHttpServer::FtHttpServer() { this->epfd_ = epoll_create1(EPOLL_CLOEXEC); }
+
+FtHttpServer::~FtHttpServer() {
+  for (auto &kv : this->conns_) close(kv.first);
+  if (this->listen_fd_ >= 0) close(this->listen_fd_);
+  if (this->epfd_ >= 0) close(this->epfd_);
+}
+
+bool FtHttpServer::listen(const std::string &bind_addr, int port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) return false;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, bind_addr.c_str(), &addr.sin_addr) != 1 ||
+      bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 128) != 0) {
+    close(fd);
+    return false;
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+  this->port_ = ntohs(addr.sin_port);
+  this->listen_fd_ = fd;
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl(this->epfd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool FtHttpServer::watch(int fd, std::function<void()> on_ready) {
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(this->epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+  this->watched_[fd] = std::move(on_ready);
+  return true;
+}
+
+void FtHttpServer::poll(int timeout_ms) {
+  epoll_event events[64];
+  const bool pending = !this->work_.empty() || !this->resume_.empty();
+  int n = epoll_wait(this->epfd_, events, 64, pending ? 0 : timeout_ms);
+  for (int i = 0; i < n; i++) {
+    const int fd = events[i].data.fd;
+    if (fd == this->listen_fd_) {
+      this->accept_();
+      continue;
+    }
+    auto w = this->watched_.find(fd);
+    if (w != this->watched_.end()) {
+      w->second();
+      continue;
+    }
+    auto c = this->conns_.find(fd);
+    if (c != this->conns_.end()) this->on_conn_event_(*c->second, events[i].events);
+  }
+  this->run_work_();
+}
+
+bool FtHttpServer::queue_work(httpd_work_fn_t fn, void *arg) {
+  this->work_.emplace_back(fn, arg);
+  return true;
+}
+
+// Runs the work queued before this pass (a chunk that queues the next one
+// waits for the next pass, so sockets get a turn in between), then picks up
+// connections whose async response has completed.
+void FtHttpServer::run_work_() {
+  std::vector<std::pair<httpd_work_fn_t, void *>> work;
+  work.swap(this->work_);
+  for (const auto &w : work) w.first(w.second);
+
+  std::vector<std::pair<int, uint64_t>> resume;
+  resume.swap(this->resume_);
+  for (const auto &r : resume) {
+    Conn *c = this->find_(r.first, r.second);
+    if (c == nullptr) continue;
+    // A body cut short can only be signalled by closing the connection.
+    if (!c->chunk_done || !c->detached_keep_alive) c->close_after_write = true;
+    c->detached = false;
+    c->chunk_head_sent = false;
+    c->chunk_done = false;
+    // Requests pipelined behind the async one waited in the input buffer.
+    if (!this->parse_and_serve_(*c) || !this->flush_(*c) || (c->close_after_write && c->out_off >= c->out.size())) {
+      this->close_(c->fd);
+      continue;
+    }
+    this->update_interest_(*c);
+  }
+}
+
+FtHttpServer::Conn *FtHttpServer::find_(int fd, uint64_t id) {
+  auto c = this->conns_.find(fd);
+  return c != this->conns_.end() && c->second->id == id ? c->second.get() : nullptr;
+}
+
+bool FtHttpServer::send_chunk_(int fd, uint64_t id, const httpd_req *r, const char *buf, size_t len) {
+  Conn *c = this->find_(fd, id);
+  if (c == nullptr || !c->detached || c->chunk_done) return false;
+  char line[160];
+  if (!c->chunk_head_sent) {
+    c->out.append("HTTP/1.1 ").append(r->status).append("\r\n");
+    c->out.append("Content-Type: ").append(r->type).append("\r\n");
+    snprintf(line, sizeof(line), "Transfer-Encoding: chunked\r\nConnection: %s\r\n",
+             c->detached_keep_alive ? "keep-alive" : "close");
+    c->out.append(line);
+    for (const auto &h : r->headers) c->out.append(h.first).append(": ").append(h.second).append("\r\n");
+    c->out.append("\r\n");
+    c->chunk_head_sent = true;
+  }
+  if (len > 0) {
+    snprintf(line, sizeof(line), "%zx\r\n", len);
+    c->out.append(line).append(buf, len).append("\r\n");
+  } else {
+    c->out.append("0\r\n\r\n");
+    c->chunk_done = true;
+  }
+  if (!this->flush_(*c)) {
+    this->close_(fd);
+    return false;
+  }
+  this->update_interest_(*c);
+  return true;
+}
+
+void FtHttpServer::accept_() {
+  for (;;) {
+    sockaddr_in peer{};
+    socklen_t len = sizeof(peer);
+    int fd = accept4(this->listen_fd_, reinterpret_cast<sockaddr *>(&peer), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    auto conn = std::make_unique<Conn>();
+    conn->fd = fd;
+    conn->id = this->next_conn_id_++;
+    char ip[INET_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+    conn->remote_ip = ip;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = fd;
+    if (epoll_ctl(this->epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      close(fd);
+      continue;
+    }
+    this->conns_[fd] = std::move(conn);
+    this->stats_.connections++;
+  }
+}
+
+void FtHttpServer::on_conn_event_(Conn &c, uint32_t events) {
+  const int fd = c.fd;
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    this->close_(fd);
+    return;
+  }
+  if (events & EPOLLOUT) {
+    if (!this->flush_(c)) {
+      this->close_(fd);
+      return;
+    }
+  }
+  if (events & (EPOLLIN | EPOLLRDHUP)) {
+    char buf[4096];
+    bool peer_closed = false;
+    for (;;) {
+      ssize_t r = recv(fd, buf, sizeof(buf), 0);
+      if (r > 0) {
+        c.in.append(buf, static_cast<size_t>(r));
+        continue;
+      }
+      if (r == 0) peer_closed = true;
+      else if (errno != EAGAIN && errno != EWOULDBLOCK) peer_closed = true;
+      break;
+    }
+    if (!this->parse_and_serve_(c) || !this->flush_(c)) {
+      this->close_(fd);
+      return;
+    }
+    if (peer_closed && c.out_off >= c.out.size()) {
+      this->close_(fd);
+      return;
+    }
+  }
+  if (c.close_after_write && c.out_off >= c.out.size()) {
+    this->close_(fd);
+    return;
+  }
+  this->update_interest_(c);
+}
+
+// Serves every complete request in the input buffer (pipelining); false drops the connection.
+bool FtHttpServer::parse_and_serve_(Conn &c) {
+  while (!c.close_after_write && !c.detached) {
+    const size_t hdr_end = c.in.find("\r\n\r\n");
+    if (hdr_end == std::string::npos) {
+      if (c.in.size() > MAX_HEADER_BYTES) {
+        FtHttpReply reply;
+        reply.code = 431;
+        this->stats_.bad_requests++;
+        this->write_reply_(c, reply, false, false);
+      }
+      return true;
+    }
+
+    FtTwinHttpRequest req;
+    req.remote_ip = c.remote_ip;
+    req.sockfd = c.fd;
+    const std::string head = c.in.substr(0, hdr_end);
+    size_t line_end = head.find("\r\n");
+    const std::string request_line = head.substr(0, line_end);
+
+    const size_t sp1 = request_line.find(' ');
+    const size_t sp2 = request_line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1) {
+      FtHttpReply reply;
+      reply.code = 400;
+      this->stats_.bad_requests++;
+      this->write_reply_(c, reply, false, false);
+      return true;
+    }
+    const std::string method = request_line.substr(0, sp1);
+    const std::string target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+    const std::string version = request_line.substr(sp2 + 1);
+
+    bool keep_alive = version == "HTTP/1.1";
+    size_t content_length = 0;
+    bool chunked = false;
+    size_t pos = line_end == std::string::npos ? head.size() : line_end + 2;
+    while (pos < head.size()) {
+      size_t eol = head.find("\r\n", pos);
+      if (eol == std::string::npos) eol = head.size();
+      const std::string line = head.substr(pos, eol - pos);
+      pos = eol + 2;
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos) continue;
+      std::string name = lower(trim(line.substr(0, colon)));
+      std::string value = trim(line.substr(colon + 1));
+      if (name == "content-length") {
+        content_length = strtoul(value.c_str(), nullptr, 10);
+      } else if (name == "transfer-encoding") {
+        chunked = lower(value).find("chunked") != std::string::npos;
+      } else if (name == "connection") {
+        const std::string v = lower(value);
+        if (v == "close") keep_alive = false;
+        else if (v == "keep-alive") keep_alive = true;
+      }
+      req.headers.emplace_back(std::move(name), std::move(value));
+    }
+
+    if (chunked || content_length > MAX_BODY_BYTES) {
+      FtHttpReply reply;
+      reply.code = chunked ? 501 : 413;
+      this->stats_.bad_requests++;
+      this->write_reply_(c, reply, false, false);
+      return true;
+    }
+    if (c.in.size() < hdr_end + 4 + content_length) return true;  // body still arriving
+
+    req.body = c.in.substr(hdr_end + 4, content_length);
+    c.in.erase(0, hdr_end + 4 + content_length);
+
+    const size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    if (q != std::string::npos) req.query = target.substr(q + 1);
+
+    FtHttpReply reply;
+    if (!parse_method(method, req.method)) {
+      reply.code = 501;
+      this->stats_.bad_requests++;
+      this->write_reply_(c, reply, keep_alive, false);
+      continue;
+    }
+    this->stats_.requests++;
+    const int fd = c.fd;
+    const uint64_t id = c.id;
+    req.server = static_cast<FtTwinHttpd *>(this);
+    req.async.begin = [this, fd, id, keep_alive]() {
+      Conn *conn = this->find_(fd, id);
+      if (conn == nullptr || conn->detached) return false;
+      conn->detached = true;
+      conn->detached_keep_alive = keep_alive;
+      return true;
+    };
+    req.async.send_chunk = [this, fd, id](const httpd_req *r, const char *buf, size_t len) {
+      return this->send_chunk_(fd, id, r, buf, len);
+    };
+    req.async.complete = [this, fd, id]() { this->resume_.emplace_back(fd, id); };
+    if (this->dispatch_) {
+      this->dispatch_(req, reply);
+    } else {
+      reply.code = 404;
+    }
+    if (c.detached) break;  // answered later; nothing more is read until then
+    this->write_reply_(c, reply, keep_alive, req.method == HTTP_HEAD);
+  }
+  return true;
+}
+
+void FtHttpServer::write_reply_(Conn &c, const FtHttpReply &reply, bool keep_alive, bool head) {
+  char line[160];
+  snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", reply.code, status_text(reply.code));
+  c.out.append(line);
+  if (!reply.content_type.empty()) {
+    c.out.append("Content-Type: ").append(reply.content_type).append("\r\n");
+  }
+  snprintf(line, sizeof(line), "Content-Length: %zu\r\nConnection: %s\r\n", reply.body.size(),
+           keep_alive ? "keep-alive" : "close");
+  c.out.append(line);
+  for (const auto &h : reply.headers) c.out.append(h.first).append(": ").append(h.second).append("\r\n");
+  c.out.append("\r\n");
+  if (!head) c.out.append(reply.body);
+  if (!keep_alive) c.close_after_write = true;
+}
+
+bool FtHttpServer::flush_(Conn &c) {
+  while (c.out_off < c.out.size()) {
+    ssize_t w = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (w <= 0) return false;
+    c.out_off += static_cast<size_t>(w);
+  }
+  c.out.clear();
+  c.out_off = 0;
+  return true;
+}
+
+void FtHttpServer::update_interest_(Conn &c) {
+  epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLRDHUP | (c.out_off < c.out.size() ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+  ev.data.fd = c.fd;
+  epoll_ctl(this->epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void FtHttpServer::close_(int fd) {
+  epoll_ctl(this->epfd_, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  this->conns_.erase(fd);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// Single-threaded epoll HTTP/1.1 server for the twin.
+//
+// Like ESP-IDF's httpd it serves one request at a time on one task, so handler
+// cost shows up as queueing exactly as it would on the device. Connections are
+// keep-alive; requests are parsed into FtTwinHttpRequest and answered through a
+// dispatch callback. Other fds (tick timer, UDP ingest, signals) can share the
+// loop through watch(). A handler may detach its request and answer it later
+// with a chunked body; work queued with httpd_queue_work runs between event
+// batches, as httpd runs it between sockets.
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "esphome/components/web_server_idf/web_server_idf.h"
+
+using esphome::web_server_idf::FtTwinHeaders;
+using esphome::web_server_idf::FtTwinHttpRequest;
+
+struct FtHttpReply {
+  int code = 200;
+  std::string content_type;
+  FtTwinHeaders headers;
+  std::string body;
+};
+
+struct FtHttpServerStats {
+  uint64_t connections = 0;
+  uint64_t requests = 0;
+  uint64_t bad_requests = 0;
+};
+
+class FtHttpServer : public FtTwinHttpd {
+ public:
+  using DispatchFn = std::function<void(const FtTwinHttpRequest &, FtHttpReply &)>;
+
+  FtHttpServer();
+  ~FtHttpServer();
+
+  bool listen(const std::string &bind_addr, int port);
+  void set_dispatch(DispatchFn fn) { this->dispatch_ = std::move(fn); }
+  // Adds a readable fd to the loop; on_ready runs when it becomes readable.
+  bool watch(int fd, std::function<void()> on_ready);
+  // Runs one loop iteration, waiting up to timeout_ms for events (not at all while work is queued).
+  void poll(int timeout_ms);
+  bool queue_work(httpd_work_fn_t fn, void *arg) override;
+
+  int port() const { return this->port_; }
+  const FtHttpServerStats &stats() const { return this->stats_; }
+
+  static constexpr size_t MAX_HEADER_BYTES = 8192;
+  static constexpr size_t MAX_BODY_BYTES = 16384;
+
+ private:
+  struct Conn {
+    int fd = -1;
+    uint64_t id = 0;  // tells a reused fd apart in async callbacks
+    std::string in;
+    std::string out;
+    size_t out_off = 0;
+    bool close_after_write = false;
+    std::string remote_ip;
+    // Detached request being answered with a chunked body.
+    bool detached = false;
+    bool detached_keep_alive = false;
+    bool chunk_head_sent = false;
+    bool chunk_done = false;
+  };
+
+  void accept_();
+  void on_conn_event_(Conn &c, uint32_t events);
+  bool parse_and_serve_(Conn &c);
+  void write_reply_(Conn &c, const FtHttpReply &reply, bool keep_alive, bool head);
+  bool flush_(Conn &c);
+  void update_interest_(Conn &c);
+  void close_(int fd);
+  Conn *find_(int fd, uint64_t id);
+  bool send_chunk_(int fd, uint64_t id, const httpd_req *r, const char *buf, size_t len);
+  void run_work_();
+
+  int epfd_ = -1;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  DispatchFn dispatch_;
+  std::unordered_map<int, std::unique_ptr<Conn>> conns_;
+  std::unordered_map<int, std::function<void()>> watched_;
+  std::vector<std::pair<httpd_work_fn_t, void *>> work_;
+  std::vector<std::pair<int, uint64_t>> resume_;  // connections whose async response completed
+  uint64_t next_conn_id_ = 1;
+  FtHttpServerStats stats_;
+};
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Generate the twin's ESPHome object declarations from the controller YAML.
+
+ESPHome turns `globals:` and component ids into C++ objects that the lambdas
+and fanforge_api.h reach through id(). The twin declares the same objects from
+the same YAML so a new global cannot silently go missing on the host.
+
+usage: gen_globals.py <fanforge-controller.yaml> <out.h>
+"""
+
+import sys
+
+import yaml
+
+# Component domains the firmware headers touch, mapped to the shim classes.
+COMPONENT_TYPES = {
+    "sensor": "sensor::Sensor",
+    "output": "output::FloatOutput",
+    "select": "select::Select",
+    "number": "number::Number",
+}
+
+
+class _Loader(yaml.SafeLoader):
+    pass
+
+
+# !secret, !lambda, !include ... are irrelevant here; load them as plain values.
+_Loader.add_multi_constructor("!", lambda loader, suffix, node: None)
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    with open(argv[1], encoding="utf-8") as f:
+        config = yaml.load(f, Loader=_Loader)
+
+    lines = [
+        "#pragma once",
+        "",
+        "// Generated by host/twin/gen_globals.py from %s; do not edit." % argv[1].split("/")[-1],
+        "",
+        '#include "esphome.h"',
+        "",
+    ]
+    for g in config.get("globals") or []:
+        ctype = g["type"]
+        initial = str(g.get("initial_value", "")).strip()
+        init = "%s(%s)" % (ctype, initial) if initial else "%s()" % ctype
+        lines.append(
+            "static GlobalsComponent<%s> *%s = new GlobalsComponent<%s>(%s);" % (ctype, g["id"], ctype, init)
+        )
+    lines.append("")
+    for domain, cls in COMPONENT_TYPES.items():
+        for entry in config.get(domain) or []:
+            if isinstance(entry, dict) and "id" in entry:
+                lines.append("static %s *%s = new %s();" % (cls, entry["id"], cls))
+    lines.append("")
+
+    with open(argv[2], "w", encoding="utf-8") as f:
+        f.write("\n".join(lines))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,18 @@
+#pragma once
+
+// Host heap figures stand in for the ESP32 heap_caps API.
+
+#include <malloc.h>
+
+#include <cstddef>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+static inline size_t ft_twin_heap_free() {
+  struct mallinfo2 mi = mallinfo2();
+  return mi.fordblks;
+}
+
+static inline size_t heap_caps_get_free_size(int) { return ft_twin_heap_free(); }
+static inline size_t heap_caps_get_largest_free_block(int) { return ft_twin_heap_free(); }
+static inline size_t heap_caps_get_minimum_free_size(int) { return ft_twin_heap_free(); }
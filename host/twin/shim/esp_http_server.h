@@ -0,0 +1,108 @@
+#pragma once
+
+// The slice of ESP-IDF's httpd that fanforge_api.h calls below web_server_idf:
+// the request's socket, allocation-free raw responses and async (detached,
+// chunked) responses pumped through httpd_queue_work. The twin's
+// AsyncWebServerRequest owns the httpd_req_t; its send hook hands the response
+// back to the twin server, and the async hooks are wired in by the server.
+
+#include <sys/types.h>
+
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "esp_err.h"
+
+#define HTTPD_RESP_USE_STRLEN -1
+#define HTTPD_SOCK_ERR_FAIL -1
+#define HTTPD_SOCK_ERR_TIMEOUT -3
+
+typedef void *httpd_handle_t;
+typedef void (*httpd_work_fn_t)(void *arg);
+
+// The twin server behind httpd_handle_t: runs queued work between socket events.
+class FtTwinHttpd {
+ public:
+  virtual ~FtTwinHttpd() = default;
+  virtual bool queue_work(httpd_work_fn_t fn, void *arg) = 0;
+};
+
+struct httpd_req;
+
+// What the twin server does for a detached request.
+struct FtTwinAsyncHooks {
+  // Takes the request off its handler: no reply is written for it and its
+  // connection reads no further requests until complete() runs.
+  std::function<bool()> begin;
+  std::function<bool(const httpd_req *, const char *, size_t)> send_chunk;  // len 0 ends the body
+  std::function<void()> complete;
+};
+
+struct httpd_req {
+  httpd_handle_t handle = nullptr;
+  int sockfd = -1;
+  const char *status = "200 OK";
+  size_t content_len = 0;
+  std::function<int(char *, size_t)> recv;  // the body web_server_idf left unread
+  const char *type = "text/html";
+  std::vector<std::pair<const char *, const char *>> headers;  // caller-owned, as in ESP-IDF
+  std::function<void(httpd_req *, const char *, size_t)> send;
+  FtTwinAsyncHooks async;
+};
+typedef struct httpd_req httpd_req_t;
+
+static inline int httpd_req_to_sockfd(httpd_req_t *r) { return r->sockfd; }
+
+static inline int httpd_req_recv(httpd_req_t *r, char *buf, size_t len) {
+  return r->recv ? r->recv(buf, len) : HTTPD_SOCK_ERR_FAIL;
+}
+
+static inline esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+  r->status = status;
+  return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+  r->type = type;
+  return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value) {
+  r->headers.emplace_back(field, value);
+  return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t len) {
+  if (!r->send) return ESP_FAIL;
+  r->send(r, buf, len < 0 ? strlen(buf) : static_cast<size_t>(len));
+  return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t len) {
+  if (!r->async.send_chunk) return ESP_FAIL;
+  const size_t n = buf == nullptr ? 0 : len < 0 ? strlen(buf) : static_cast<size_t>(len);
+  return r->async.send_chunk(r, buf, n) ? ESP_OK : ESP_FAIL;
+}
+
+// Hands back a heap copy of the request that stays valid after the handler returns.
+static inline esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out) {
+  if (!r->async.begin || !r->async.begin()) return ESP_FAIL;
+  httpd_req_t *copy = new httpd_req(*r);
+  copy->send = nullptr;
+  copy->recv = nullptr;
+  copy->async.begin = nullptr;
+  *out = copy;
+  return ESP_OK;
+}
+
+static inline esp_err_t httpd_req_async_handler_complete(httpd_req_t *r) {
+  if (r->async.complete) r->async.complete();
+  delete r;
+  return ESP_OK;
+}
+
+static inline esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t fn, void *arg) {
+  return handle != nullptr && static_cast<FtTwinHttpd *>(handle)->queue_work(fn, arg) ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// The twin models the IDF 5 APIs.
+
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
@@ -0,0 +1,100 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF partition API, covering the one data
+// partition the firmware opens ("history"). The partition behaves like NOR
+// flash: erase sets 0xFF and writes can only clear bits. It lives in RAM, or
+// in a file mapped with ft_twin_flash_open() so history survives restarts.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "esp_err.h"
+
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  int subtype;
+  uint32_t address;
+  uint32_t size;
+  uint32_t erase_size;
+  char label[17];
+  uint8_t *data;  // twin only
+} esp_partition_t;
+
+// Same size as the history entry in fanforge-partitions.csv.
+static constexpr uint32_t FT_TWIN_HISTORY_PARTITION_SIZE = 0x10F000;
+static constexpr uint32_t FT_TWIN_FLASH_SECTOR = 4096;
+
+static inline esp_partition_t &ft_twin_history_partition() {
+  static esp_partition_t part = {ESP_PARTITION_TYPE_DATA, 0x40, 0x2F1000, FT_TWIN_HISTORY_PARTITION_SIZE,
+                                 FT_TWIN_FLASH_SECTOR, "history", nullptr};
+  return part;
+}
+
+// Backs the partition with a file (created erased if new). Call before the
+// firmware looks the partition up; without it the partition is RAM only.
+static inline bool ft_twin_flash_open(const char *path) {
+  esp_partition_t &part = ft_twin_history_partition();
+  const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+  const off_t len = lseek(fd, 0, SEEK_END);
+  if (len != static_cast<off_t>(part.size)) {
+    uint8_t erased[FT_TWIN_FLASH_SECTOR];
+    memset(erased, 0xFF, sizeof(erased));
+    if (ftruncate(fd, 0) != 0) {
+      close(fd);
+      return false;
+    }
+    for (uint32_t off = 0; off < part.size; off += sizeof(erased)) {
+      if (pwrite(fd, erased, sizeof(erased), off) != static_cast<ssize_t>(sizeof(erased))) {
+        close(fd);
+        return false;
+      }
+    }
+  }
+  void *map = mmap(nullptr, part.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  part.data = static_cast<uint8_t *>(map);
+  return true;
+}
+
+static inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t,
+                                                              const char *label) {
+  esp_partition_t &part = ft_twin_history_partition();
+  if (type != part.type || label == nullptr || strcmp(label, part.label) != 0) return nullptr;
+  if (part.data == nullptr) {
+    part.data = new uint8_t[part.size];
+    memset(part.data, 0xFF, part.size);
+  }
+  return &part;
+}
+
+static inline esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size) {
+  if (part == nullptr || offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, part->data + offset, size);
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src,
+                                            size_t size) {
+  if (part == nullptr || offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  const uint8_t *in = static_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < size; i++) part->data[offset + i] &= in[i];
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+  if (part == nullptr || offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  if (offset % part->erase_size != 0 || size % part->erase_size != 0) return ESP_ERR_INVALID_ARG;
+  memset(part->data + offset, 0xFF, size);
+  return ESP_OK;
+}
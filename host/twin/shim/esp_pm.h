@@ -0,0 +1,47 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF power manager. The twin never sleeps; it accepts
+// every configuration so the firmware's light-sleep path runs as on a build
+// with tickless idle, and remembers the last one for inspection.
+
+#include "esp_err.h"
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_t;
+
+inline esp_pm_config_t ft_twin_pm_config = {};
+
+static inline esp_err_t esp_pm_configure(const void *config) {
+  if (config == nullptr) return ESP_ERR_INVALID_ARG;
+  ft_twin_pm_config = *static_cast<const esp_pm_config_t *>(config);
+  return ESP_OK;
+}
+
+// Locks are counted but never block anything; the twin has no clocks to gate.
+typedef enum { ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP } esp_pm_lock_type_t;
+typedef struct ft_twin_pm_lock {
+  esp_pm_lock_type_t type;
+  int count;
+} *esp_pm_lock_handle_t;
+
+static inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name,
+                                           esp_pm_lock_handle_t *out) {
+  (void) arg;
+  (void) name;
+  *out = new ft_twin_pm_lock{type, 0};
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t h) {
+  h->count++;
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t h) {
+  if (h->count == 0) return ESP_ERR_INVALID_STATE;
+  h->count--;
+  return ESP_OK;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for the Wi-Fi power-save switch; the twin has no radio.
+
+#include "esp_err.h"
+
+typedef enum {
+  WIFI_PS_NONE = 0,
+  WIFI_PS_MIN_MODEM = 1,
+  WIFI_PS_MAX_MODEM = 2,
+} wifi_ps_type_t;
+
+inline wifi_ps_type_t ft_twin_wifi_ps = WIFI_PS_NONE;
+
+static inline esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+  ft_twin_wifi_ps = type;
+  return ESP_OK;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+// Host stand-in for the parts of ESPHome that the FanForge headers use:
+// time, logging, id() on globals/components and the component types the YAML
+// declares. Only what the firmware touches is modelled.
+
+#define USE_ESP32 1
+
+#include <math.h>  // global isfinite()/isnan(), as the Arduino core provides
+
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ft_twin_clock.h"
+
+namespace esphome {
+
+inline uint32_t millis() { return ft_twin_clock_ms(); }
+inline uint32_t micros() { return ft_twin_clock_us(); }
+
+// A fixed locally administered address; the twin passes explicit rack unit ids.
+inline void get_mac_address_raw(uint8_t *mac) {
+  static const uint8_t twin_mac[6] = {0x02, 0x46, 0x46, 0x00, 0x00, 0x01};
+  for (int i = 0; i < 6; i++) mac[i] = twin_mac[i];
+}
+
+// The main loop's idle delay; the twin's event loop does not use it.
+class Application {
+ public:
+  void set_loop_interval(uint32_t loop_interval) { this->loop_interval_ = loop_interval; }
+  uint32_t get_loop_interval() const { return this->loop_interval_; }
+
+ protected:
+  uint32_t loop_interval_{16};
+};
+inline Application App;
+
+// Preferences (NVS on the device) kept in memory: a twin restart is a fresh flash.
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(std::vector<uint8_t> *slot) : slot_(slot) {}
+  template<typename T> bool save(const T *src) {
+    if (this->slot_ == nullptr) return false;
+    this->slot_->assign(reinterpret_cast<const uint8_t *>(src), reinterpret_cast<const uint8_t *>(src) + sizeof(T));
+    return true;
+  }
+  template<typename T> bool load(T *dest) {
+    if (this->slot_ == nullptr || this->slot_->size() != sizeof(T)) return false;
+    memcpy(dest, this->slot_->data(), sizeof(T));
+    return true;
+  }
+
+ protected:
+  std::vector<uint8_t> *slot_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type) {
+    return ESPPreferenceObject(&this->slots_[type]);
+  }
+  bool sync() { return true; }
+
+ protected:
+  std::map<uint32_t, std::vector<uint8_t>> slots_;
+};
+inline ESPPreferences *global_preferences = new ESPPreferences();
+
+template<typename T> class GlobalsComponent {
+ public:
+  explicit GlobalsComponent(T initial) : value_(initial) {}
+  T &value() { return this->value_; }
+
+ protected:
+  T value_;
+};
+
+namespace globals {
+template<typename T> using RestoringGlobalsComponent = GlobalsComponent<T>;
+}  // namespace globals
+
+template<typename T> T &id(GlobalsComponent<T> *value) { return value->value(); }
+template<typename T> T &id(T *value) { return *value; }
+
+namespace sensor {
+class Sensor {
+ public:
+  void publish_state(float state) { this->state = state; }
+  float state{NAN};
+};
+}  // namespace sensor
+
+namespace output {
+class FloatOutput {
+ public:
+  void set_level(float level) { this->level = level; }
+  float level{0.0f};
+};
+}  // namespace output
+
+namespace select {
+class Select {
+ public:
+  void publish_state(const std::string &state) { this->state = state; }
+  std::string state;
+};
+}  // namespace select
+
+namespace number {
+class Number {
+ public:
+  void publish_state(float state) { this->state = state; }
+  float state{NAN};
+};
+}  // namespace number
+
+}  // namespace esphome
+
+// Arduino String, as used for error messages.
+class String : public std::string {
+ public:
+  String() = default;
+  String(const char *s) : std::string(s ? s : "") {}
+  String(const std::string &s) : std::string(s) {}
+  String operator+(const char *rhs) const { return String(static_cast<const std::string &>(*this) + rhs); }
+  String operator+(const String &rhs) const {
+    return String(static_cast<const std::string &>(*this) + static_cast<const std::string &>(rhs));
+  }
+};
+
+// Arduino's ESP object: the cycle counter runs at a nominal 1000 MHz (host nanoseconds,
+// unscaled by --speedup) so stage costs in the trace are real host time.
+class EspClass {
+ public:
+  uint32_t getCycleCount() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+  }
+  uint32_t getCpuFreqMHz() { return 1000; }
+};
+inline EspClass ESP;
+
+void ft_twin_log(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, ...) ft_twin_log('E', tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ft_twin_log('W', tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ft_twin_log('I', tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ((void) 0)
+#define ESP_LOGV(tag, ...) ((void) 0)
+
+using namespace esphome;
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "esphome/components/web_server_idf/web_server_idf.h"
+
+namespace esphome {
+namespace web_server_base {
+
+class WebServerBase {
+ public:
+  void add_handler(web_server_idf::AsyncWebHandler *handler) { this->handlers_.push_back(handler); }
+  const std::vector<web_server_idf::AsyncWebHandler *> &get_handlers() const { return this->handlers_; }
+
+ protected:
+  std::vector<web_server_idf::AsyncWebHandler *> handlers_;
+};
+
+extern WebServerBase *global_web_server_base;
+
+}  // namespace web_server_base
+}  // namespace esphome
@@ -0,0 +1,295 @@
+#pragma once
+
+// Host stand-in for ESPHome's web_server_idf request/response types. The twin's
+// HTTP server parses the wire request into FtTwinHttpRequest and hands it to the
+// registered AsyncWebHandlers through this adapter; send() returns the response
+// to the server through a callback.
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "esp_http_server.h"
+
+enum http_method {
+  HTTP_DELETE = 0,
+  HTTP_GET = 1,
+  HTTP_HEAD = 2,
+  HTTP_POST = 3,
+  HTTP_PUT = 4,
+  HTTP_OPTIONS = 6,
+};
+
+namespace esphome {
+
+template<typename T> using optional = std::optional<T>;
+
+namespace web_server_idf {
+
+using FtTwinHeaders = std::vector<std::pair<std::string, std::string>>;
+
+struct FtTwinHttpRequest {
+  http_method method = HTTP_GET;
+  std::string path;
+  std::string query;
+  FtTwinHeaders headers;  // names lower-cased by the server
+  std::string body;
+  std::string remote_ip;
+  int sockfd = -1;
+  httpd_handle_t server = nullptr;
+  FtTwinAsyncHooks async;
+};
+
+class AsyncWebServerRequest;
+
+class AsyncWebServerResponse {
+ public:
+  AsyncWebServerResponse(const AsyncWebServerRequest *req, int code, const char *content_type)
+      : req_(req), code_(code), content_type_(content_type ? content_type : "") {}
+  virtual ~AsyncWebServerResponse() = default;
+
+  void addHeader(const char *name, const char *value) { this->headers_.emplace_back(name, value); }
+
+  virtual const char *get_content_data() const = 0;
+  virtual size_t get_content_size() const = 0;
+
+  int code() const { return this->code_; }
+  const std::string &content_type() const { return this->content_type_; }
+  const FtTwinHeaders &headers() const { return this->headers_; }
+
+ protected:
+  const AsyncWebServerRequest *req_;
+  int code_;
+  std::string content_type_;
+  FtTwinHeaders headers_;
+};
+
+class AsyncWebServerResponseContent : public AsyncWebServerResponse {
+ public:
+  AsyncWebServerResponseContent(const AsyncWebServerRequest *req, int code, const char *content_type,
+                                std::string content)
+      : AsyncWebServerResponse(req, code, content_type), content_(std::move(content)) {}
+  const char *get_content_data() const override { return this->content_.data(); }
+  size_t get_content_size() const override { return this->content_.size(); }
+
+ protected:
+  std::string content_;
+};
+
+class AsyncWebServerResponseProgmem : public AsyncWebServerResponse {
+ public:
+  AsyncWebServerResponseProgmem(const AsyncWebServerRequest *req, int code, const char *content_type,
+                                const uint8_t *data, size_t size)
+      : AsyncWebServerResponse(req, code, content_type), data_(data), size_(size) {}
+  const char *get_content_data() const override { return reinterpret_cast<const char *>(this->data_); }
+  size_t get_content_size() const override { return this->size_; }
+
+ protected:
+  const uint8_t *data_;
+  size_t size_;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse {
+ public:
+  AsyncResponseStream(const AsyncWebServerRequest *req, const char *content_type)
+      : AsyncWebServerResponse(req, 200, content_type) {}
+  const char *get_content_data() const override { return this->content_.data(); }
+  size_t get_content_size() const override { return this->content_.size(); }
+
+  void print(const char *str) { this->content_.append(str); }
+  void print(const std::string &str) { this->content_.append(str); }
+  void print(float value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%f", value);
+    this->content_.append(buf);
+  }
+  void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, fmt);
+    char buf[512];
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len > 0) this->content_.append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+  }
+
+ protected:
+  std::string content_;
+};
+
+class AsyncWebParameter {
+ public:
+  AsyncWebParameter(std::string value) : value_(std::move(value)) {}
+  const std::string &value() const { return this->value_; }
+
+ protected:
+  std::string value_;
+};
+
+class AsyncWebServerRequest {
+ public:
+  using SendFn = std::function<void(const AsyncWebServerResponse &)>;
+
+  AsyncWebServerRequest(const FtTwinHttpRequest &req, SendFn send) : req_(req), send_(std::move(send)) {
+    this->raw_.sockfd = req.sockfd;
+    this->raw_.handle = req.server;
+    this->raw_.async = req.async;
+    // A detached request counts as answered; its response goes out in chunks later.
+    this->raw_.async.begin = [this, begin = req.async.begin]() {
+      if (!begin || !begin()) return false;
+      this->sent_ = true;
+      return true;
+    };
+    this->raw_.send = [this](httpd_req_t *r, const char *buf, size_t len) {
+      auto *res = this->beginResponse(atoi(r->status), r->type, std::string(buf, len));
+      for (const auto &h : r->headers) res->addHeader(h.first, h.second);
+      this->send(res);
+    };
+    parse_query_(req.query);
+    // As web_server_idf does: a form-encoded (or untyped) POST body is read and
+    // parsed into args; any other body stays unread for httpd_req_recv.
+    if (req.method == HTTP_POST) {
+      auto type = this->get_header("content-type");
+      if (!type || type->rfind("application/x-www-form-urlencoded", 0) == 0) {
+        parse_query_(req.body);
+      } else {
+        this->raw_.content_len = req.body.size();
+        this->raw_.recv = [this](char *buf, size_t len) {
+          const size_t n = std::min(len, this->req_.body.size() - this->body_read_);
+          memcpy(buf, this->req_.body.data() + this->body_read_, n);
+          this->body_read_ += n;
+          return static_cast<int>(n);
+        };
+      }
+    }
+  }
+
+  operator httpd_req_t *() const { return &this->raw_; }
+
+  http_method method() const { return this->req_.method; }
+  std::string url() const { return this->req_.path; }
+  std::string host() const { return this->get_header("host").value_or(""); }
+  size_t contentLength() const { return this->req_.body.size(); }
+  const FtTwinHttpRequest &twin_request() const { return this->req_; }
+
+  bool hasHeader(const char *name) const { return this->get_header(name).has_value(); }
+  optional<std::string> get_header(const char *name) const {
+    for (const auto &h : this->req_.headers) {
+      if (strcasecmp(h.first.c_str(), name) == 0) return h.second;
+    }
+    return std::nullopt;
+  }
+
+  bool hasParam(const std::string &name) { return this->find_param_(name) != nullptr; }
+  AsyncWebParameter *getParam(const std::string &name) {
+    const std::string *v = this->find_param_(name);
+    if (v == nullptr) return nullptr;
+    this->param_objs_.emplace_back(new AsyncWebParameter(*v));
+    return this->param_objs_.back().get();
+  }
+  bool hasArg(const char *name) { return this->hasParam(name); }
+  std::string arg(const std::string &name) {
+    const std::string *v = this->find_param_(name);
+    return v ? *v : std::string();
+  }
+
+  AsyncWebServerResponse *beginResponse(int code, const char *content_type) {
+    return this->own_(new AsyncWebServerResponseContent(this, code, content_type, ""));
+  }
+  AsyncWebServerResponse *beginResponse(int code, const char *content_type, const std::string &content) {
+    return this->own_(new AsyncWebServerResponseContent(this, code, content_type, content));
+  }
+  AsyncWebServerResponse *beginResponse_P(int code, const char *content_type, const uint8_t *data,
+                                          const size_t data_size) {
+    return this->own_(new AsyncWebServerResponseProgmem(this, code, content_type, data, data_size));
+  }
+  AsyncResponseStream *beginResponseStream(const char *content_type) {
+    auto *res = new AsyncResponseStream(this, content_type);
+    this->own_(res);
+    return res;
+  }
+
+  void send(AsyncWebServerResponse *response) {
+    if (this->sent_) return;
+    this->sent_ = true;
+    this->send_(*response);
+  }
+  void send(int code, const char *content_type = nullptr, const char *content = nullptr) {
+    this->send(this->beginResponse(code, content_type, content ? content : ""));
+  }
+  bool sent() const { return this->sent_; }
+
+ protected:
+  static std::string url_decode_(const std::string &in) {
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      if (in[i] == '+') {
+        out.push_back(' ');
+      } else if (in[i] == '%' && i + 2 < in.size()) {
+        out.push_back(static_cast<char>(strtol(in.substr(i + 1, 2).c_str(), nullptr, 16)));
+        i += 2;
+      } else {
+        out.push_back(in[i]);
+      }
+    }
+    return out;
+  }
+
+  void parse_query_(const std::string &query) {
+    size_t pos = 0;
+    while (pos < query.size()) {
+      size_t amp = query.find('&', pos);
+      if (amp == std::string::npos) amp = query.size();
+      const std::string pair = query.substr(pos, amp - pos);
+      const size_t eq = pair.find('=');
+      if (!pair.empty()) {
+        if (eq == std::string::npos)
+          this->params_.emplace_back(url_decode_(pair), "");
+        else
+          this->params_.emplace_back(url_decode_(pair.substr(0, eq)), url_decode_(pair.substr(eq + 1)));
+      }
+      pos = amp + 1;
+    }
+  }
+
+  const std::string *find_param_(const std::string &name) const {
+    for (const auto &p : this->params_) {
+      if (p.first == name) return &p.second;
+    }
+    return nullptr;
+  }
+
+  AsyncWebServerResponse *own_(AsyncWebServerResponse *res) {
+    this->responses_.emplace_back(res);
+    return res;
+  }
+
+  const FtTwinHttpRequest &req_;
+  SendFn send_;
+  mutable httpd_req_t raw_;
+  size_t body_read_ = 0;
+  bool sent_ = false;
+  FtTwinHeaders params_;
+  std::vector<std::unique_ptr<AsyncWebParameter>> param_objs_;
+  std::vector<std::unique_ptr<AsyncWebServerResponse>> responses_;
+};
+
+class AsyncWebHandler {
+ public:
+  virtual ~AsyncWebHandler() = default;
+  virtual bool canHandle(AsyncWebServerRequest * /*request*/) const { return false; }
+  virtual void handleRequest(AsyncWebServerRequest * /*request*/) {}
+  virtual bool isRequestHandlerTrivial() const { return true; }
+};
+
+}  // namespace web_server_idf
+}  // namespace esphome
@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS kernel header; see task.h.
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
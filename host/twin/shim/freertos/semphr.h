@@ -0,0 +1,32 @@
+#pragma once
+
+// Host stand-in for FreeRTOS mutexes. httpd and the control tick share one
+// event loop in the twin, so a mutex is never contended; taking a held one is
+// a bug in the firmware and aborts.
+
+#include <cstdlib>
+
+#include "FreeRTOS.h"
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE 1
+#define pdFALSE 0
+
+typedef struct ft_twin_mutex {
+  bool held;
+} *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new ft_twin_mutex{false}; }
+
+static inline int xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks) {
+  (void) ticks;
+  if (m->held) abort();
+  m->held = true;
+  return pdTRUE;
+}
+
+static inline int xSemaphoreGive(SemaphoreHandle_t m) {
+  if (!m->held) return pdFALSE;
+  m->held = false;
+  return pdTRUE;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Host stand-in for FreeRTOS task delays. The twin runs httpd and the control
+// tick on one event loop, which services the tick timer between queued work
+// items, so a yielding delay has nothing to give way to.
+
+#include "FreeRTOS.h"
+
+static inline void vTaskDelay(TickType_t ticks) { (void) ticks; }
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Simulated device clock (scaled by the twin's --speedup); defined in ff_twin.cpp.
+uint32_t ft_twin_clock_ms();
+uint32_t ft_twin_clock_us();
@@ -0,0 +1,17 @@
+#pragma once
+
+// lwIP BSD socket names mapped onto POSIX sockets.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define lwip_socket socket
+#define lwip_bind bind
+#define lwip_fcntl fcntl
+#define lwip_recvfrom recvfrom
+#define lwip_sendto sendto
+#define lwip_close close
+#define lwip_setsockopt setsockopt
@@ -0,0 +1,123 @@
+// FanForge curve kernels for the web UI, compiled to WebAssembly.
+//
+// Exposes the firmware's FtCurve and FtController (fanforge_control.h) so
+// curve previews and the UI's simulated output run the exact float math the
+// device runs. The interface is a handful of C exports over static buffers in
+// linear memory, so the module needs no allocator and no JS glue:
+//
+//   - write up to FT_MAX_POINTS sorted (t, p) pairs to ft_wasm_points() and call
+//     ft_wasm_set_curve(n, smooth);
+//   - ft_wasm_eval(temp) evaluates one temperature, ft_wasm_eval_range() a whole
+//     sweep into ft_wasm_output();
+//   - ft_wasm_configure() sets the mode, PWM window, slew and failsafe;
+//     ft_wasm_target_pwm() is the settled target at one temperature,
+//     ft_wasm_tick() advances a live controller by one control interval and
+//     ft_wasm_simulate() runs ft_wasm_input() temperatures through a fresh
+//     controller in one call, one output PWM per sample.
+//
+// Build: emcmake cmake -S host -B build-wasm && cmake --build build-wasm
+// (see src/curveKernels.ts for the loader and the JS fallback).
+
+#include <cstdint>
+
+#include "fanforge_control.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#define FT_WASM_EXPORT extern "C" EMSCRIPTEN_KEEPALIVE
+#else
+#define FT_WASM_EXPORT extern "C"
+#endif
+
+static constexpr int FT_WASM_MAX_SAMPLES = 8192;
+
+// Same start as ff-replay: slew dt is measured from a non-zero last update.
+static constexpr uint32_t FT_WASM_EPOCH_MS = 1000;
+
+static FtPoint ft_wasm_points_buf[FT_MAX_POINTS];
+static float ft_wasm_input_buf[FT_WASM_MAX_SAMPLES];
+static float ft_wasm_output_buf[FT_WASM_MAX_SAMPLES];
+static FtController ft_wasm_ctl;
+
+FT_WASM_EXPORT int ft_wasm_max_points() { return FT_MAX_POINTS; }
+FT_WASM_EXPORT int ft_wasm_max_samples() { return FT_WASM_MAX_SAMPLES; }
+FT_WASM_EXPORT FtPoint *ft_wasm_points() { return ft_wasm_points_buf; }
+FT_WASM_EXPORT float *ft_wasm_input() { return ft_wasm_input_buf; }
+FT_WASM_EXPORT float *ft_wasm_output() { return ft_wasm_output_buf; }
+
+// Loads the curve from ft_wasm_points(); returns the point count kept.
+FT_WASM_EXPORT int ft_wasm_set_curve(int n, int smooth) {
+  ft_wasm_ctl.config.curve.set(ft_wasm_points_buf, n);
+  ft_wasm_ctl.config.curve.smooth = smooth != 0;
+  return ft_wasm_ctl.config.curve.n;
+}
+
+// PCHIP tangent at point i of the loaded curve (for drawing it as Bezier segments).
+FT_WASM_EXPORT float ft_wasm_tangent(int i) {
+  const FtCurve &curve = ft_wasm_ctl.config.curve;
+  return i >= 0 && i < curve.n ? curve.tg[i] : 0.0f;
+}
+
+FT_WASM_EXPORT float ft_wasm_eval(float temp) { return ft_wasm_ctl.config.curve.eval(temp); }
+
+// Evaluates count temperatures evenly spaced over [t0, t1] into ft_wasm_output().
+FT_WASM_EXPORT int ft_wasm_eval_range(float t0, float t1, int count) {
+  if (count > FT_WASM_MAX_SAMPLES) count = FT_WASM_MAX_SAMPLES;
+  if (count <= 0) return 0;
+  const float step = count > 1 ? (t1 - t0) / (count - 1) : 0.0f;
+  for (int i = 0; i < count; i++) ft_wasm_output_buf[i] = ft_wasm_ctl.config.curve.eval(t0 + step * i);
+  return count;
+}
+
+FT_WASM_EXPORT void ft_wasm_configure(int mode, float min_pwm, float max_pwm, float slew_pct_per_sec,
+                                     float failsafe_temp, float failsafe_pwm, float manual_pwm) {
+  FtControlConfig &c = ft_wasm_ctl.config;
+  c.mode = mode == FT_MODE_MANUAL || mode == FT_MODE_OFF ? mode : FT_MODE_AUTO;
+  c.min_pwm = min_pwm;
+  c.max_pwm = max_pwm;
+  c.slew_pct_per_sec = slew_pct_per_sec;
+  c.failsafe_temp = failsafe_temp;
+  c.failsafe_pwm = failsafe_pwm;
+  c.manual_pwm = manual_pwm;
+}
+
+// Resets the live controller to power-on state at the given PWM.
+FT_WASM_EXPORT void ft_wasm_reset(float pwm_pct) {
+  ft_wasm_ctl.state = FtControlState{};
+  ft_wasm_ctl.state.current_pwm_pct = ft_clampf(pwm_pct, 0.0f, 100.0f);
+}
+
+// One control interval of the live controller; returns the output PWM.
+FT_WASM_EXPORT float ft_wasm_tick(uint32_t now_ms, float temp_c) {
+  ft_wasm_ctl.tick(FtControlInput{now_ms + FT_WASM_EPOCH_MS, temp_c, false, NAN});
+  return ft_wasm_ctl.state.current_pwm_pct;
+}
+
+FT_WASM_EXPORT float ft_wasm_target() { return ft_wasm_ctl.state.last_target_pwm_pct; }
+
+// Target PWM (curve, window and failsafe; no deadband history or slew) that a
+// freshly started controller with the live configuration settles on at temp_c.
+FT_WASM_EXPORT float ft_wasm_target_pwm(float temp_c) {
+  FtController probe;
+  probe.config = ft_wasm_ctl.config;
+  probe.tick(FtControlInput{FT_WASM_EPOCH_MS, temp_c, false, NAN});
+  return probe.state.last_target_pwm_pct;
+}
+FT_WASM_EXPORT int ft_wasm_failsafe() { return ft_wasm_ctl.state.failsafe_latched ? 1 : 0; }
+
+// Runs count samples from ft_wasm_input() through a fresh controller with the
+// live configuration, one tick every tick_ms starting at start_pwm, and writes
+// the output PWM after each tick to ft_wasm_output(). The live controller is
+// not disturbed.
+FT_WASM_EXPORT int ft_wasm_simulate(int count, uint32_t tick_ms, float start_pwm) {
+  if (count > FT_WASM_MAX_SAMPLES) count = FT_WASM_MAX_SAMPLES;
+  if (count <= 0) return 0;
+  FtController sim;
+  sim.config = ft_wasm_ctl.config;
+  sim.state.current_pwm_pct = ft_clampf(start_pwm, 0.0f, 100.0f);
+  for (int i = 0; i < count; i++) {
+    sim.tick(FtControlInput{FT_WASM_EPOCH_MS + static_cast<uint32_t>(i) * tick_ms, ft_wasm_input_buf[i], false, NAN});
+    ft_wasm_output_buf[i] = sim.state.current_pwm_pct;
+  }
+  return count;
+}
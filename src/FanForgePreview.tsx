@@ -19,12 +19,15 @@ import {
 } from "./ui";
 import { AlertTriangle, CheckCircle2, ChevronDown, Info, Wifi, WifiOff } from "lucide-react";
 import { AnimatePresence, motion } from "framer-motion";
+import { CURVE_MAX_POINTS, CurveKernel, createJsCurveKernel, loadCurveKernel } from "./curveKernels";
 
 /**
  * FanForge UI (standalone preview)
  * - BIOS-like curve editor with draggable points
  * - Editable settings panel
- * - Simulated live temperature + computed PWM output
+ * - Simulated live temperature + computed PWM output (main curve, window,
+ *   failsafe and slew only; a falling curve, rules or load feed-forward loaded
+ *   from the device are flagged as not simulated)
  * - Optional API wiring (GET/POST) for ESP32 endpoints
  *
  * Expected ESP32 endpoints (suggested):
@@ -85,6 +88,9 @@ type TelemetryPoint = {
   pwm: number;
 };
 
+// The firmware-embedded build (vite --mode device) is served by the controller,
+// so the API is same-origin and live mode is the sensible default.
+const ON_DEVICE = import.meta.env.MODE === "device";
 const DEVICE_POLL_INTERVAL_MS = 1000;
 const GRAPH_SAMPLE_INTERVAL_MS = 1000 / 120;
 const VALUE_INTERPOLATION_MS = 960;
@@ -393,89 +399,14 @@ function normalizeConfig(cfg: Config): Config {
   };
 }
 
-/** Piecewise-linear interpolation on sorted points */
-/** Piecewise-linear interpolation on sorted points */
-function computeCurvePWM(tempC: number, pointsSorted: Array<{ t: number; p: number }>): number {
-  const pts = [...pointsSorted].sort((a, b) => a.t - b.t);
-  if (pts.length === 0) return 0;
-  if (tempC <= pts[0].t) return pts[0].p;
-  if (tempC >= pts[pts.length - 1].t) return pts[pts.length - 1].p;
-
-  for (let i = 0; i < pts.length - 1; i++) {
-    const a = pts[i];
-    const b = pts[i + 1];
-    if (tempC >= a.t && tempC <= b.t) {
-      const u = (tempC - a.t) / (b.t - a.t);
-      return a.p + (b.p - a.p) * u;
-    }
-  }
-  return pts[pts.length - 1].p;
-}
-
-/** Monotone cubic (PCHIP-ish) interpolation to avoid overshoot */
-function computeCurvePWMSmooth(tempC: number, pointsSorted: Array<{ t: number; p: number }>): number {
-  const pts = [...pointsSorted].sort((a, b) => a.t - b.t);
-  if (pts.length === 0) return 0;
-  if (pts.length === 1) return pts[0].p;
-
-  // clamp outside
-  if (tempC <= pts[0].t) return pts[0].p;
-  if (tempC >= pts[pts.length - 1].t) return pts[pts.length - 1].p;
-
-  const xs = pts.map((p) => p.t);
-  const ys = pts.map((p) => p.p);
-
-  // secants
-  const m: number[] = [];
-  for (let i = 0; i < xs.length - 1; i++) {
-    const dx = xs[i + 1] - xs[i];
-    const dy = ys[i + 1] - ys[i];
-    m.push(dy / Math.max(1e-6, dx));
-  }
-
-  // tangents
-  const t: number[] = new Array(xs.length).fill(0);
-  t[0] = m[0];
-  t[xs.length - 1] = m[m.length - 1];
-  for (let i = 1; i < xs.length - 1; i++) {
-    if (m[i - 1] * m[i] <= 0) t[i] = 0;
-    else t[i] = (m[i - 1] + m[i]) / 2;
-  }
-
-  // monotonicity clamp (Fritsch-Carlson)
-  for (let i = 0; i < m.length; i++) {
-    if (Math.abs(m[i]) < 1e-6) {
-      t[i] = 0;
-      t[i + 1] = 0;
-      continue;
-    }
-    const a = t[i] / m[i];
-    const b = t[i + 1] / m[i];
-    const s = a * a + b * b;
-    if (s > 9) {
-      const k = 3 / Math.sqrt(s);
-      t[i] = k * a * m[i];
-      t[i + 1] = k * b * m[i];
-    }
-  }
-
-  // find segment
-  let i = 0;
-  for (; i < xs.length - 1; i++) {
-    if (tempC >= xs[i] && tempC <= xs[i + 1]) break;
-  }
-  const x0 = xs[i], x1 = xs[i + 1];
-  const y0 = ys[i], y1 = ys[i + 1];
-  const h = x1 - x0;
-  const u = (tempC - x0) / Math.max(1e-6, h);
-
-  // Hermite basis
-  const h00 = 2 * u ** 3 - 3 * u ** 2 + 1;
-  const h10 = u ** 3 - 2 * u ** 2 + u;
-  const h01 = -2 * u ** 3 + 3 * u ** 2;
-  const h11 = u ** 3 - u ** 2;
-
-  return h00 * y0 + h10 * h * t[i] + h01 * y1 + h11 * h * t[i + 1];
+// Device settings the preview's kernels do not model; the simulated target and
+// output ignore them, so the UI says so instead of showing a wrong number.
+function unmodelledSettings(c: any): string[] {
+  const out: string[] = [];
+  if (Array.isArray(c?.falling_points) && c.falling_points.length > 0) out.push("falling curve");
+  if (typeof c?.rules === "string" && c.rules.trim() !== "") out.push("rules");
+  if (Number(c?.ff_source) > 0) out.push("load feed-forward");
+  return out;
 }
 
 function validateConfig(cfg: Config): { ok: boolean; errors: string[]; warnings: string[] } {
@@ -485,6 +416,7 @@ function validateConfig(cfg: Config): { ok: boolean; errors: string[]; warnings:
   const window = normalizeTempWindow(cfg.curve_min, cfg.curve_max);
 
   if (cfg.points.length < 2) errors.push("Need at least 2 curve points.");
+  if (cfg.points.length > CURVE_MAX_POINTS) warnings.push(`Only the first ${CURVE_MAX_POINTS} curve points are used by the firmware.`);
   const pts = [...cfg.points].sort((a, b) => a.t - b.t);
   for (let i = 0; i < pts.length; i++) {
     const { t, p } = pts[i];
@@ -524,6 +456,7 @@ function CurveEditor({
   grid = 1,
   smoothingMode,
   onSmoothingChange,
+  kernel,
 }: {
   points: Point[];
   setPoints: React.Dispatch<React.SetStateAction<Point[]>>;
@@ -538,6 +471,7 @@ function CurveEditor({
   grid?: number;
   smoothingMode: "linear" | "smooth";
   onSmoothingChange: (mode: "linear" | "smooth") => void;
+  kernel: CurveKernel;
 }) {
   const svgRef = useRef<SVGSVGElement | null>(null);
   const [dragId, setDragId] = useState<string | null>(null);
@@ -583,50 +517,15 @@ function CurveEditor({
 
   const snap = (v: number) => Math.round(v / grid) * grid;
 
-  // --- monotone cubic smoothing (PCHIP-ish) ---
+  // --- monotone cubic smoothing: the firmware's PCHIP tangents, drawn as Bezier segments ---
   const smoothPathD = useMemo(() => {
     const pts = ptsSorted;
     if (pts.length < 2) return "";
 
     const xs = pts.map((p) => p.t);
     const ys = pts.map((p) => p.p);
-
-    // slopes (secants)
-    const m: number[] = [];
-    for (let i = 0; i < xs.length - 1; i++) {
-      const dx = xs[i + 1] - xs[i];
-      const dy = ys[i + 1] - ys[i];
-      m.push(dy / Math.max(1e-6, dx));
-    }
-
-    // tangents
-    const t: number[] = new Array(xs.length).fill(0);
-    t[0] = m[0];
-    t[xs.length - 1] = m[m.length - 1];
-    for (let i = 1; i < xs.length - 1; i++) {
-      if (m[i - 1] * m[i] <= 0) {
-        t[i] = 0;
-      } else {
-        t[i] = (m[i - 1] + m[i]) / 2;
-      }
-    }
-
-    // clamp tangents to preserve monotonicity (Fritsch-Carlson)
-    for (let i = 0; i < m.length; i++) {
-      if (Math.abs(m[i]) < 1e-6) {
-        t[i] = 0;
-        t[i + 1] = 0;
-        continue;
-      }
-      const a = t[i] / m[i];
-      const b = t[i + 1] / m[i];
-      const s = a * a + b * b;
-      if (s > 9) {
-        const k = 3 / Math.sqrt(s);
-        t[i] = k * a * m[i];
-        t[i + 1] = k * b * m[i];
-      }
-    }
+    kernel.setCurve(pts, true);
+    const t = kernel.tangents();
 
     const segToBezier = (x0: number, y0: number, x1: number, y1: number, t0: number, t1: number) => {
       const dx = x1 - x0;
@@ -640,7 +539,8 @@ function CurveEditor({
     const moveX = xScale(xs[0]);
     const moveY = yScale(ys[0]);
     let d = `M ${moveX} ${moveY}`;
-    for (let i = 0; i < xs.length - 1; i++) {
+    // The firmware keeps only the first CURVE_MAX_POINTS points; draw what it runs.
+    for (let i = 0; i < t.length - 1; i++) {
       const x0 = xScale(xs[i]);
       const y0 = yScale(ys[i]);
       const x1 = xScale(xs[i + 1]);
@@ -649,7 +549,7 @@ function CurveEditor({
       d += ` C ${xScale(bz.c1x)} ${yScale(bz.c1y)} ${xScale(bz.c2x)} ${yScale(bz.c2y)} ${x1} ${y1}`;
     }
     return d;
-  }, [ptsSorted, width, height, pad, xMax]);
+  }, [kernel, ptsSorted, width, height, pad, xMax]);
 
   const polyline = useMemo(
     () => ptsSorted.map((pt) => `${xScale(pt.t)},${yScale(pt.p)}`).join(" "),
@@ -1004,8 +904,8 @@ function CurveEditor({
 // ---------- main component ----------
 export default function FanForgePreview() {
   const [smoothingMode, setSmoothingMode] = useState<SmoothingMode>(DEFAULT_CONFIG.smoothing_mode);
-  const [apiBase, setApiBase] = useState("http://esp32.local");
-  const [useApi, setUseApi] = useState(false);
+  const [apiBase, setApiBase] = useState(ON_DEVICE ? "" : "http://esp32.local");
+  const [useApi, setUseApi] = useState(ON_DEVICE);
   const [connected, setConnected] = useState<null | boolean>(null);
   const [hydrated, setHydrated] = useState(false);
   const [toast, setToast] = useState<ToastState | null>(null);
@@ -1030,10 +930,22 @@ export default function FanForgePreview() {
   const [curveMax, setCurveMax] = useState(BASE_TEMP_MAX);
   const [simRunning, setSimRunning] = useState(true);
   const [simDriftThreshold, setSimDriftThreshold] = useState(0.4);
+  const [unmodelled, setUnmodelled] = useState<string[]>([]);
 
-  // Output simulation with smoothing
+  // Output simulation through the firmware control loop (WASM when built)
   const [pwmOut, setPwmOut] = useState(0);
-  const lastUpdateRef = useRef<number>(Date.now());
+  const simStartRef = useRef<number>(Date.now());
+  const [kernel, setKernel] = useState<CurveKernel>(createJsCurveKernel);
+
+  useEffect(() => {
+    let cancelled = false;
+    loadCurveKernel().then((k) => {
+      if (!cancelled && k.native) setKernel(k);
+    });
+    return () => {
+      cancelled = true;
+    };
+  }, []);
 
   const effectiveConfig = useMemo(() => {
     const next = toConfig(points, cfg);
@@ -1113,23 +1025,12 @@ export default function FanForgePreview() {
 
   const targetPWM = useMemo(() => {
     const c = effectiveConfig;
-    if (c.mode === "off") return 0;
-    if (c.mode === "manual") {
-      return clamp(c.manual_pwm, 0, 100);
-    }
-
     // Clamp temperature input to the currently visible temperature window.
     const temp = clamp(simTemp, curveMin, curveMax);
-
-    let pwm =
-      c.smoothing_mode === "smooth"
-        ? computeCurvePWMSmooth(temp, c.points)
-        : computeCurvePWM(temp, c.points);
-
-    pwm = clamp(pwm, c.min_pwm, c.max_pwm);
-    if (temp >= c.failsafe_temp) pwm = Math.max(pwm, c.failsafe_pwm);
-    return clamp(pwm, 0, 100);
-  }, [effectiveConfig, simTemp, curveMin, curveMax]);
+    kernel.setCurve(c.points, c.smoothing_mode === "smooth");
+    kernel.configure(c);
+    return kernel.targetPwm(temp);
+  }, [kernel, effectiveConfig, simTemp, curveMin, curveMax]);
 
   useEffect(() => {
     if (useApi && connected === true) return;
@@ -1147,20 +1048,13 @@ export default function FanForgePreview() {
   useEffect(() => {
     if (useApi && connected === true) return;
     const id = setInterval(() => {
-      const now = Date.now();
-      const dt = Math.max(0.05, (now - lastUpdateRef.current) / 1000);
-      lastUpdateRef.current = now;
-
       const c = effectiveConfig;
-      const maxStep = clamp(c.slew_pct_per_sec, 0, 100) * dt;
-      setPwmOut((cur) => {
-        const delta = targetPWM - cur;
-        const step = clamp(delta, -maxStep, maxStep);
-        return clamp(cur + step, 0, 100);
-      });
+      kernel.setCurve(c.points, c.smoothing_mode === "smooth");
+      kernel.configure(c);
+      setPwmOut(kernel.tick(Date.now() - simStartRef.current, clamp(simTemp, curveMin, curveMax)));
     }, 120);
     return () => clearInterval(id);
-  }, [effectiveConfig, targetPWM, useApi, connected]);
+  }, [kernel, effectiveConfig, simTemp, curveMin, curveMax, useApi, connected]);
 
   useEffect(() => {
     if (!isLiveDeviceConnected) return;
@@ -1290,6 +1184,7 @@ export default function FanForgePreview() {
         failsafe_pwm: Number(c.failsafe_pwm ?? DEFAULT_CONFIG.failsafe_pwm),
       };
       const sanitized = normalizeConfig(normalized);
+      setUnmodelled(unmodelledSettings(c));
       setCfg(sanitized);
       setSmoothingMode(sanitized.smoothing_mode);
       setPoints(toInternalPoints(sanitized));
@@ -1440,6 +1335,7 @@ export default function FanForgePreview() {
                 setSmoothingMode(mode);
                 setCfg((c) => ({ ...c, smoothing_mode: mode }));
               }}
+              kernel={kernel}
             />
             <div className="rounded-[2rem] border-0 bg-[#ECF0F3] p-4 shadow-[1rem_1rem_2rem_rgba(54,85,153,0.15),-0.5rem_-0.5rem_2rem_rgba(255,255,255,0.7),inset_0.1rem_0.1rem_0.1rem_rgba(255,255,255,0.7),inset_-0.1rem_-0.1rem_0.1rem_rgba(54,85,153,0.15)]">
               <button
@@ -1565,6 +1461,11 @@ export default function FanForgePreview() {
                         <span>{round(curveMin, 0)}°C</span>
                         <span>{curveMax}°C</span>
                       </div>
+                      {unmodelled.length > 0 && (
+                        <div className="rounded-md border border-amber-200 bg-amber-100 px-2 py-1 text-xs text-amber-800">
+                          {`Not simulated: ${unmodelled.join(", ")}. The device's output can differ from this target.`}
+                        </div>
+                      )}
                     </div>
 
                     <div className="flex items-start justify-between gap-3">
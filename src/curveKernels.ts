@@ -0,0 +1,394 @@
+/**
+ * Curve and control-loop kernels shared with the firmware.
+ *
+ * The primary implementation is host/wasm/ft_curve_wasm.cpp: the firmware's own
+ * FtCurve / FtController (fanforge_control.h) compiled to WebAssembly, so curve
+ * previews and the simulated output use the device's exact float math. When
+ * public/fanforge_curve.wasm has not been built (no Emscripten SDK), a JS port
+ * of the same logic is used instead; it differs only in float precision.
+ *
+ * Kernels hold one curve and one live controller. Points are sorted once in
+ * setCurve() and PCHIP tangents are precomputed, so evaluation is a segment
+ * search plus one Hermite polynomial.
+ */
+
+export type CurvePoint = { t: number; p: number };
+
+/** FT_MAX_POINTS: the firmware ignores points beyond this. */
+export const CURVE_MAX_POINTS = 16;
+
+export type ControlSettings = {
+  mode: "auto" | "manual" | "off";
+  min_pwm: number;
+  max_pwm: number;
+  slew_pct_per_sec: number;
+  failsafe_temp: number;
+  failsafe_pwm: number;
+  manual_pwm: number;
+};
+
+export interface CurveKernel {
+  /** true when running the WebAssembly build of the firmware code */
+  readonly native: boolean;
+  setCurve(points: CurvePoint[], smooth: boolean): void;
+  /** PCHIP tangents (dPWM/dC) at each sorted point of the current curve */
+  tangents(): number[];
+  eval(tempC: number): number;
+  /** count evenly spaced temperatures over [t0, t1] */
+  evalRange(t0: number, t1: number, count: number): Float32Array;
+  configure(settings: ControlSettings): void;
+  /** Settled target (curve, running window, failsafe) at tempC, without slew. */
+  targetPwm(tempC: number): number;
+  /** Resets the live controller to power-on state at pwmPct. */
+  reset(pwmPct: number): void;
+  /** One control interval of the live controller; returns the output PWM. */
+  tick(nowMs: number, tempC: number): number;
+  /** Runs temps through a fresh controller, one tick per tickMs; returns output PWM per sample. */
+  simulate(temps: ArrayLike<number>, tickMs: number, startPwm: number): Float32Array;
+}
+
+const MODE_CODES: Record<ControlSettings["mode"], number> = { auto: 0, manual: 1, off: 2 };
+
+function sortedCurve(points: CurvePoint[], maxPoints: number): CurvePoint[] {
+  return [...points].sort((a, b) => a.t - b.t).slice(0, maxPoints);
+}
+
+// ---------- WebAssembly ----------
+
+type WasmExports = {
+  memory: WebAssembly.Memory;
+  ft_wasm_max_points(): number;
+  ft_wasm_max_samples(): number;
+  ft_wasm_points(): number;
+  ft_wasm_input(): number;
+  ft_wasm_output(): number;
+  ft_wasm_set_curve(n: number, smooth: number): number;
+  ft_wasm_tangent(i: number): number;
+  ft_wasm_eval(temp: number): number;
+  ft_wasm_eval_range(t0: number, t1: number, count: number): number;
+  ft_wasm_configure(
+    mode: number,
+    minPwm: number,
+    maxPwm: number,
+    slew: number,
+    failsafeTemp: number,
+    failsafePwm: number,
+    manualPwm: number
+  ): void;
+  ft_wasm_target_pwm(temp: number): number;
+  ft_wasm_reset(pwm: number): void;
+  ft_wasm_tick(nowMs: number, temp: number): number;
+  ft_wasm_simulate(count: number, tickMs: number, startPwm: number): number;
+};
+
+const WASM_EXPORTS: ReadonlyArray<keyof WasmExports> = [
+  "memory",
+  "ft_wasm_max_points",
+  "ft_wasm_max_samples",
+  "ft_wasm_points",
+  "ft_wasm_input",
+  "ft_wasm_output",
+  "ft_wasm_set_curve",
+  "ft_wasm_tangent",
+  "ft_wasm_eval",
+  "ft_wasm_eval_range",
+  "ft_wasm_configure",
+  "ft_wasm_target_pwm",
+  "ft_wasm_reset",
+  "ft_wasm_tick",
+  "ft_wasm_simulate",
+];
+
+class WasmCurveKernel implements CurveKernel {
+  readonly native = true;
+  private readonly maxPoints: number;
+  private readonly maxSamples: number;
+  private n = 0;
+
+  constructor(private readonly x: WasmExports) {
+    this.maxPoints = x.ft_wasm_max_points();
+    this.maxSamples = x.ft_wasm_max_samples();
+  }
+
+  private floats(ptr: number, count: number) {
+    // Re-created per call: the views detach if the module's memory ever grows.
+    return new Float32Array(this.x.memory.buffer, ptr, count);
+  }
+
+  setCurve(points: CurvePoint[], smooth: boolean) {
+    const pts = sortedCurve(points, this.maxPoints);
+    const buf = this.floats(this.x.ft_wasm_points(), pts.length * 2);
+    pts.forEach((pt, i) => {
+      buf[i * 2] = pt.t;
+      buf[i * 2 + 1] = pt.p;
+    });
+    this.n = this.x.ft_wasm_set_curve(pts.length, smooth ? 1 : 0);
+  }
+
+  tangents() {
+    return Array.from({ length: this.n }, (_, i) => this.x.ft_wasm_tangent(i));
+  }
+
+  eval(tempC: number) {
+    return this.x.ft_wasm_eval(tempC);
+  }
+
+  evalRange(t0: number, t1: number, count: number) {
+    const n = this.x.ft_wasm_eval_range(t0, t1, count);
+    return this.floats(this.x.ft_wasm_output(), n).slice();
+  }
+
+  configure(s: ControlSettings) {
+    this.x.ft_wasm_configure(
+      MODE_CODES[s.mode],
+      s.min_pwm,
+      s.max_pwm,
+      s.slew_pct_per_sec,
+      s.failsafe_temp,
+      s.failsafe_pwm,
+      s.manual_pwm
+    );
+  }
+
+  targetPwm(tempC: number) {
+    return this.x.ft_wasm_target_pwm(tempC);
+  }
+
+  reset(pwmPct: number) {
+    this.x.ft_wasm_reset(pwmPct);
+  }
+
+  tick(nowMs: number, tempC: number) {
+    return this.x.ft_wasm_tick(nowMs >>> 0, tempC);
+  }
+
+  simulate(temps: ArrayLike<number>, tickMs: number, startPwm: number) {
+    const count = Math.min(temps.length, this.maxSamples);
+    const input = this.floats(this.x.ft_wasm_input(), count);
+    for (let i = 0; i < count; i++) input[i] = temps[i];
+    const n = this.x.ft_wasm_simulate(count, tickMs >>> 0, startPwm);
+    return this.floats(this.x.ft_wasm_output(), n).slice();
+  }
+}
+
+// ---------- JS fallback (port of fanforge_control.h without feed-forward) ----------
+
+const TEMP_DEADBAND_C = 0.51;
+const FAILSAFE_HYST_C = 1.0;
+const EPOCH_MS = 1000;
+
+const clampf = (v: number, lo: number, hi: number) => (v < lo ? lo : v > hi ? hi : v);
+
+type ControlState = {
+  currentPwm: number;
+  targetPwm: number;
+  lastUpdateMs: number;
+  controlTemp: number;
+  failsafeLatched: boolean;
+};
+
+const freshState = (pwm: number): ControlState => ({
+  currentPwm: clampf(pwm, 0, 100),
+  targetPwm: 0,
+  lastUpdateMs: 0,
+  controlTemp: NaN,
+  failsafeLatched: false,
+});
+
+class JsCurveKernel implements CurveKernel {
+  readonly native = false;
+  private xs: number[] = [];
+  private ys: number[] = [];
+  private tg: number[] = [];
+  private smooth = false;
+  private settings: ControlSettings = {
+    mode: "auto",
+    min_pwm: 22,
+    max_pwm: 100,
+    slew_pct_per_sec: 10,
+    failsafe_temp: 80,
+    failsafe_pwm: 100,
+    manual_pwm: 50,
+  };
+  private live = freshState(0);
+
+  setCurve(points: CurvePoint[], smooth: boolean) {
+    const pts = sortedCurve(points, CURVE_MAX_POINTS);
+    this.xs = pts.map((pt) => pt.t);
+    this.ys = pts.map((pt) => pt.p);
+    this.smooth = smooth;
+    this.tg = new Array(pts.length).fill(0);
+    const n = pts.length;
+    if (n < 2) return;
+
+    // Monotone (Fritsch-Carlson) PCHIP tangents, as ft_curve_smooth_tangents.
+    const m: number[] = [];
+    for (let i = 0; i < n - 1; i++) m.push((this.ys[i + 1] - this.ys[i]) / Math.max(1e-6, this.xs[i + 1] - this.xs[i]));
+    const tg = this.tg;
+    tg[0] = m[0];
+    tg[n - 1] = m[n - 2];
+    for (let i = 1; i < n - 1; i++) tg[i] = m[i - 1] * m[i] <= 0 ? 0 : (m[i - 1] + m[i]) * 0.5;
+    for (let i = 0; i < n - 1; i++) {
+      if (Math.abs(m[i]) < 1e-6) {
+        tg[i] = 0;
+        tg[i + 1] = 0;
+        continue;
+      }
+      const a = tg[i] / m[i];
+      const b = tg[i + 1] / m[i];
+      const s = a * a + b * b;
+      if (s > 9) {
+        const k = 3 / Math.sqrt(s);
+        tg[i] = k * a * m[i];
+        tg[i + 1] = k * b * m[i];
+      }
+    }
+  }
+
+  tangents() {
+    return [...this.tg];
+  }
+
+  eval(tempC: number) {
+    const { xs, ys, tg } = this;
+    const n = xs.length;
+    if (n === 0) return 0;
+    if (tempC <= xs[0]) return ys[0];
+    if (tempC >= xs[n - 1]) return ys[n - 1];
+    let i = 0;
+    while (i < n - 2 && tempC > xs[i + 1]) i++;
+    const h = xs[i + 1] - xs[i];
+    const u = (tempC - xs[i]) / Math.max(1e-6, h);
+    if (!this.smooth) return ys[i] + (ys[i + 1] - ys[i]) * u;
+    const h00 = 2 * u * u * u - 3 * u * u + 1;
+    const h10 = u * u * u - 2 * u * u + u;
+    const h01 = -2 * u * u * u + 3 * u * u;
+    const h11 = u * u * u - u * u;
+    return h00 * ys[i] + h10 * h * tg[i] + h01 * ys[i + 1] + h11 * h * tg[i + 1];
+  }
+
+  evalRange(t0: number, t1: number, count: number) {
+    const out = new Float32Array(Math.max(0, count));
+    const step = count > 1 ? (t1 - t0) / (count - 1) : 0;
+    for (let i = 0; i < out.length; i++) out[i] = this.eval(t0 + step * i);
+    return out;
+  }
+
+  configure(settings: ControlSettings) {
+    this.settings = { ...settings };
+  }
+
+  targetPwm(tempC: number) {
+    const probe = freshState(0);
+    this.step(probe, EPOCH_MS, tempC);
+    return probe.targetPwm;
+  }
+
+  reset(pwmPct: number) {
+    this.live = freshState(pwmPct);
+  }
+
+  tick(nowMs: number, tempC: number) {
+    this.step(this.live, nowMs + EPOCH_MS, tempC);
+    return this.live.currentPwm;
+  }
+
+  simulate(temps: ArrayLike<number>, tickMs: number, startPwm: number) {
+    const state = freshState(startPwm);
+    const out = new Float32Array(temps.length);
+    for (let i = 0; i < temps.length; i++) {
+      this.step(state, EPOCH_MS + i * tickMs, temps[i]);
+      out[i] = state.currentPwm;
+    }
+    return out;
+  }
+
+  // FtController::tick for a local sensor and no load input.
+  private step(s: ControlState, now: number, rawTemp: number) {
+    const c = this.settings;
+    if (Number.isFinite(rawTemp)) {
+      if (!Number.isFinite(s.controlTemp) || Math.abs(rawTemp - s.controlTemp) >= TEMP_DEADBAND_C) {
+        s.controlTemp = rawTemp;
+      }
+    }
+
+    let target = 0;
+    const isAuto = c.mode === "auto";
+    if (c.mode === "manual") {
+      target = clampf(c.manual_pwm, 0, 100);
+    } else if (isAuto) {
+      if (!Number.isFinite(rawTemp) || !Number.isFinite(s.controlTemp)) {
+        s.lastUpdateMs = now;
+        return;
+      }
+      target = clampf(this.eval(s.controlTemp), 0, 100);
+      target = target > 0 ? clampf(target, c.min_pwm, c.max_pwm) : 0;
+      if (s.controlTemp >= c.failsafe_temp) s.failsafeLatched = true;
+      else if (s.controlTemp <= c.failsafe_temp - FAILSAFE_HYST_C) s.failsafeLatched = false;
+      if (s.failsafeLatched) target = Math.max(target, c.failsafe_pwm);
+    } else {
+      s.failsafeLatched = false;
+    }
+    target = clampf(target, 0, 100);
+
+    let next = target;
+    if (isAuto) {
+      const dt = s.lastUpdateMs > 0 && now >= s.lastUpdateMs ? Math.max(0.02, (now - s.lastUpdateMs) / 1000) : 0.2;
+      const maxStep = clampf(c.slew_pct_per_sec, 0, 100) * dt;
+      next = clampf(s.currentPwm + clampf(target - s.currentPwm, -maxStep, maxStep), 0, 100);
+    }
+    s.currentPwm = next;
+    s.targetPwm = target;
+    s.lastUpdateMs = now;
+  }
+}
+
+export function createJsCurveKernel(): CurveKernel {
+  return new JsCurveKernel();
+}
+
+/**
+ * Loads public/fanforge_curve.wasm, falling back to the JS port when it is
+ * missing, cannot be instantiated, lacks an export or fails a known curve
+ * (a module built from mismatched sources).
+ */
+export async function loadCurveKernel(url = new URL("fanforge_curve.wasm", document.baseURI).href): Promise<CurveKernel> {
+  let res: Response;
+  try {
+    res = await fetch(url);
+  } catch {
+    return createJsCurveKernel();
+  }
+  // Not built: the expected case without the Emscripten SDK.
+  if (!res.ok) return createJsCurveKernel();
+  try {
+    const module = await WebAssembly.compile(await res.arrayBuffer());
+    // A standalone Emscripten build may import a few WASI calls it never makes; stub them.
+    const imports: WebAssembly.Imports = {};
+    for (const imp of WebAssembly.Module.imports(module)) {
+      if (imp.kind !== "function") continue;
+      imports[imp.module] ??= {};
+      imports[imp.module][imp.name] = () => 0;
+    }
+    const instance = await WebAssembly.instantiate(module, imports);
+    const raw = instance.exports as Record<string, unknown>;
+    const missing = WASM_EXPORTS.filter((name) => !(name in raw));
+    if (missing.length > 0) throw new Error(`missing exports: ${missing.join(", ")}`);
+    // Standalone builds run static constructors from _initialize instead of main.
+    if (typeof raw._initialize === "function") raw._initialize();
+    const kernel = new WasmCurveKernel(instance.exports as unknown as WasmExports);
+    kernel.setCurve(
+      [
+        { t: 20, p: 20 },
+        { t: 40, p: 60 },
+      ],
+      false
+    );
+    const mid = kernel.eval(30);
+    if (Math.abs(mid - 40) > 1e-3) throw new Error(`curve check: eval(30) = ${mid}, expected 40`);
+    return kernel;
+  } catch (err) {
+    console.warn("fanforge_curve.wasm rejected, using the JS curve kernels:", err);
+    return createJsCurveKernel();
+  }
+}
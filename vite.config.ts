@@ -1,6 +1,9 @@
 import { defineConfig } from "vite";
 import react from "@vitejs/plugin-react";
 
-export default defineConfig({
+// `--mode device` builds the copy embedded in the firmware (npm run build:device):
+// served by the controller itself under /ui/, talking to its API same-origin.
+export default defineConfig(({ mode }) => ({
+  base: mode === "device" ? "/ui/" : "/",
   plugins: [react()],
-});
+}));